@@ -0,0 +1,122 @@
+/*
+   Compression of data sent between ctdb daemons
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "replace.h"
+
+#include <talloc.h>
+#include <tdb.h>
+
+#include "lib/compression/lzxpress_huffman.h"
+
+#include "common/compress.h"
+
+#define COMPRESS_HEADER_SIZE	(2 * sizeof(uint32_t))
+
+int ctdb_compress_data(TALLOC_CTX *mem_ctx, TDB_DATA data, TDB_DATA *result)
+{
+	uint8_t *comp = NULL;
+	ssize_t comp_len = 0;
+	uint32_t len;
+	uint8_t *buf;
+
+	if (data.dsize > UINT32_MAX) {
+		return EINVAL;
+	}
+
+	if (data.dsize > 0) {
+		comp_len = lzxpress_huffman_compress_talloc(mem_ctx,
+							    data.dptr,
+							    data.dsize,
+							    &comp);
+		if (comp_len < 0) {
+			return EIO;
+		}
+	}
+
+	/* Not worth it, send the data as is */
+	if (comp_len == 0 || (size_t)comp_len >= data.dsize) {
+		TALLOC_FREE(comp);
+		comp_len = 0;
+	}
+
+	buf = talloc_size(mem_ctx, COMPRESS_HEADER_SIZE +
+			  (comp_len > 0 ? (size_t)comp_len : data.dsize));
+	if (buf == NULL) {
+		TALLOC_FREE(comp);
+		return ENOMEM;
+	}
+
+	len = data.dsize;
+	memcpy(buf, &len, sizeof(len));
+	len = comp_len;
+	memcpy(buf + sizeof(len), &len, sizeof(len));
+
+	if (comp_len > 0) {
+		memcpy(buf + COMPRESS_HEADER_SIZE, comp, comp_len);
+		TALLOC_FREE(comp);
+	} else if (data.dsize > 0) {
+		memcpy(buf + COMPRESS_HEADER_SIZE, data.dptr, data.dsize);
+	}
+
+	result->dptr = buf;
+	result->dsize = talloc_get_size(buf);
+	return 0;
+}
+
+int ctdb_decompress_data(TALLOC_CTX *mem_ctx, TDB_DATA data,
+			 TDB_DATA *result)
+{
+	uint32_t len, comp_len;
+	uint8_t *buf;
+
+	if (data.dsize < COMPRESS_HEADER_SIZE) {
+		return EMSGSIZE;
+	}
+
+	memcpy(&len, data.dptr, sizeof(len));
+	memcpy(&comp_len, data.dptr + sizeof(len), sizeof(comp_len));
+
+	if (comp_len == 0) {
+		if (data.dsize - COMPRESS_HEADER_SIZE != len) {
+			return EMSGSIZE;
+		}
+
+		buf = talloc_memdup(mem_ctx,
+				    data.dptr + COMPRESS_HEADER_SIZE,
+				    len);
+		if (buf == NULL && len > 0) {
+			return ENOMEM;
+		}
+	} else {
+		if (data.dsize - COMPRESS_HEADER_SIZE != comp_len) {
+			return EMSGSIZE;
+		}
+
+		buf = lzxpress_huffman_decompress_talloc(
+				mem_ctx,
+				data.dptr + COMPRESS_HEADER_SIZE,
+				comp_len,
+				len);
+		if (buf == NULL) {
+			return EPROTO;
+		}
+	}
+
+	result->dptr = buf;
+	result->dsize = len;
+	return 0;
+}
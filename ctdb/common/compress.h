@@ -0,0 +1,56 @@
+/*
+   Compression of data sent between ctdb daemons
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __CTDB_COMPRESS_H__
+#define __CTDB_COMPRESS_H__
+
+#include <talloc.h>
+#include <tdb.h>
+
+/**
+ * @file compress.h
+ *
+ * @brief Compress data blobs with LZXPRESS Huffman
+ *
+ * A compressed blob starts with a header of two uint32_t values, the
+ * uncompressed length and the compressed length, followed by the
+ * compressed data.  If compression does not make the data smaller, the
+ * compressed length is 0 and the data follows uncompressed.
+ */
+
+/**
+ * @brief Compress a data blob
+ *
+ * @param[in] mem_ctx Talloc memory context
+ * @param[in] data The data to compress
+ * @param[out] result The compressed blob, allocated on mem_ctx
+ * @return 0 on success, errno on failure
+ */
+int ctdb_compress_data(TALLOC_CTX *mem_ctx, TDB_DATA data, TDB_DATA *result);
+
+/**
+ * @brief Decompress a blob created by ctdb_compress_data()
+ *
+ * @param[in] mem_ctx Talloc memory context
+ * @param[in] data The compressed blob
+ * @param[out] result The original data, allocated on mem_ctx
+ * @return 0 on success, errno on failure
+ */
+int ctdb_decompress_data(TALLOC_CTX *mem_ctx, TDB_DATA data,
+			 TDB_DATA *result);
+
+#endif /* __CTDB_COMPRESS_H__ */
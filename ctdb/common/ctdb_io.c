@@ -269,21 +269,39 @@ static void queue_dead(struct tevent_context *ev, struct tevent_immediate *im,
 }
 
 
+/* maximum number of queued packets handed to a single writev() */
+#define QUEUE_MAX_IOV 64
+
 /*
   called when an incoming connection is writeable
+
+  All queued packets (up to QUEUE_MAX_IOV) are sent with a single
+  writev(), so the number of syscalls does not grow with the queue.
 */
 static bool queue_io_write(struct ctdb_queue *queue)
 {
 	while (queue->out_queue) {
 		struct ctdb_queue_pkt *pkt = queue->out_queue;
+		struct iovec iov[QUEUE_MAX_IOV];
+		int count = 0;
 		ssize_t n;
+
 		if (queue->ctdb->flags & CTDB_FLAG_TORTURE) {
 			n = write(queue->fd, pkt->data, 1);
 		} else {
-			n = write(queue->fd, pkt->data, pkt->length);
+			for (; pkt != NULL && count < QUEUE_MAX_IOV;
+			     pkt = pkt->next) {
+				iov[count] = (struct iovec) {
+					.iov_base = pkt->data,
+					.iov_len = pkt->length,
+				};
+				count++;
+			}
+			n = writev(queue->fd, iov, count);
 		}
 
 		if (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+			pkt = queue->out_queue;
 			if (pkt->length != pkt->full_length) {
 				/* partial packet sent - we have to drop it */
 				DLIST_REMOVE(queue->out_queue, pkt);
@@ -297,16 +315,22 @@ static bool queue_io_write(struct ctdb_queue *queue)
 			return false;
 		}
 		if (n <= 0) return true;
-		
-		if (n != pkt->length) {
-			pkt->length -= n;
-			pkt->data += n;
-			return true;
-		}
 
-		DLIST_REMOVE(queue->out_queue, pkt);
-		queue->out_queue_length--;
-		talloc_free(pkt);
+		/* drop the packets that went out completely */
+		while (n > 0) {
+			pkt = queue->out_queue;
+
+			if ((size_t)n < pkt->length) {
+				pkt->length -= n;
+				pkt->data += n;
+				return true;
+			}
+
+			n -= pkt->length;
+			DLIST_REMOVE(queue->out_queue, pkt);
+			queue->out_queue_length--;
+			talloc_free(pkt);
+		}
 	}
 
 	TEVENT_FD_NOT_WRITEABLE(queue->fde);
@@ -362,9 +386,14 @@ int ctdb_queue_send(struct ctdb_queue *queue, uint8_t *data, uint32_t length)
 	full_length = length2;
 	
 	/* if the queue is empty then try an immediate write, avoiding
-	   queue overhead. This relies on non-blocking sockets */
+	   queue overhead. This relies on non-blocking sockets.
+
+	   With QueueBatchWrites the packet is always queued. It goes
+	   out once the socket is found writeable, together with all
+	   packets queued until then */
 	if (queue->out_queue == NULL && queue->fd != -1 &&
-	    !(queue->ctdb->flags & CTDB_FLAG_TORTURE)) {
+	    !(queue->ctdb->flags & CTDB_FLAG_TORTURE) &&
+	    queue->ctdb->tunable.queue_batch_writes == 0) {
 		ssize_t n = write(queue->fd, data, length2);
 		if (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
 			TALLOC_FREE(queue->fde);
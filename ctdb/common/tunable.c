@@ -164,6 +164,16 @@ static struct {
 		offsetof(struct ctdb_tunable_list, ip_alloc_algorithm) },
 	{ "AllowMixedVersions", 0, false,
 		offsetof(struct ctdb_tunable_list, allow_mixed_versions) },
+	{ "VacuumTraverseChains", 0, false,
+		offsetof(struct ctdb_tunable_list, vacuum_traverse_chains) },
+	{ "VacuumDeleteQueueTarget", 0, false,
+		offsetof(struct ctdb_tunable_list, vacuum_delete_queue_target) },
+	{ "HotRecordMigrations", 0, false,
+		offsetof(struct ctdb_tunable_list, hot_record_migrations) },
+	{ "QueueBatchWrites", 0, false,
+		offsetof(struct ctdb_tunable_list, queue_batch_writes) },
+	{ "RecoveryCompression", 0, false,
+		offsetof(struct ctdb_tunable_list, recovery_compression) },
 	{ .obsolete = true, }
 };
 
@@ -288,6 +288,7 @@ DisableIPFailover
 ElectionTimeout
 EnableBans
 EventScriptTimeout
+HotRecordMigrations
 FetchCollapse
 HopcountMakeSticky
 IPAllocAlgorithm
@@ -301,9 +302,11 @@ MonitorTimeoutCount
 NoIPFailback
 NoIPTakeover
 PullDBPreallocation
+QueueBatchWrites
 QueueBufferSize
 RecBufferSizeLimit
 RecLockLatencyMs
+RecoveryCompression
 RecdFailCount
 RecdPingTimeout
 RecoverInterval
@@ -321,9 +324,11 @@ TDBMutexEnabled
 TakeoverTimeout
 TickleUpdateInterval
 TraverseTimeout
+VacuumDeleteQueueTarget
 VacuumFastPathCount
 VacuumInterval
 VacuumMaxRunTime
+VacuumTraverseChains
 VerboseMemoryNames
 EOF
 }
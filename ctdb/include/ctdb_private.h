@@ -190,6 +190,27 @@ struct ctdb_daemon_data {
 		}									\
 	}
 
+#define CTDB_UPDATE_RECOVERY_LATENCY(ctdb, value) \
+	{										\
+		if (value > ctdb->statistics.recovery_latency.max)			\
+			ctdb->statistics.recovery_latency.max = value;			\
+		if (value > ctdb->statistics_current.recovery_latency.max)		\
+			ctdb->statistics_current.recovery_latency.max = value;		\
+											\
+		if (ctdb->statistics.recovery_latency.num == 0 ||			\
+		    value < ctdb->statistics.recovery_latency.min)			\
+			ctdb->statistics.recovery_latency.min = value;			\
+		if (ctdb->statistics_current.recovery_latency.num == 0 ||		\
+		    value < ctdb->statistics_current.recovery_latency.min)		\
+			ctdb->statistics_current.recovery_latency.min = value;		\
+											\
+		ctdb->statistics.recovery_latency.total += value;			\
+		ctdb->statistics_current.recovery_latency.total += value;		\
+											\
+		ctdb->statistics.recovery_latency.num++;				\
+		ctdb->statistics_current.recovery_latency.num++;			\
+	}
+
 #define CTDB_UPDATE_DB_LATENCY(ctdb_db, operation, counter, value)			\
 	{										\
 		if (value > ctdb_db->statistics.counter.max)				\
@@ -364,6 +385,7 @@ struct ctdb_db_context {
 	struct revokechild_handle *revokechild_active;
 	struct ctdb_persistent_state *persistent_state;
 	struct trbt_tree *delete_queue;
+	uint32_t delete_queue_count;
 	struct trbt_tree *fetch_queue;
 	struct trbt_tree *sticky_records; 
 	int (*ctdb_ltdb_store_fn)(struct ctdb_db_context *ctdb_db,
@@ -797,7 +819,8 @@ int ctdb_control_reload_nodes_file(struct ctdb_context *ctdb, uint32_t opcode);
 
 int32_t ctdb_control_db_pull(struct ctdb_context *ctdb,
 			     struct ctdb_req_control_old *c,
-			     TDB_DATA indata, TDB_DATA *outdata);
+			     TDB_DATA indata, TDB_DATA *outdata,
+			     bool compress);
 int32_t ctdb_control_db_push_start(struct ctdb_context *ctdb,
 				   TDB_DATA indata);
 int32_t ctdb_control_db_push_confirm(struct ctdb_context *ctdb,
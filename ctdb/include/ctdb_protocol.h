@@ -187,6 +187,8 @@ struct ctdb_db_statistics_old {
 	} vacuum;
 	uint32_t db_ro_delegations;
 	uint32_t db_ro_revokes;
+	uint32_t db_hot_records;
+	uint32_t db_hot_pindowns;
 	uint32_t hop_count_bucket[MAX_COUNT_BUCKETS];
 	uint32_t num_hot_keys;
 	struct {
@@ -399,6 +399,7 @@ enum ctdb_controls {CTDB_CONTROL_PROCESS_EXISTS          = 0,
 		    CTDB_CONTROL_TCP_CLIENT_DISCONNECTED = 159,
 		    CTDB_CONTROL_TCP_CLIENT_PASSED       = 160,
 		    CTDB_CONTROL_START_IPREALLOCATE      = 161,
+		    CTDB_CONTROL_DB_PULL_COMPRESSED      = 162,
 };
 
 #define MAX_COUNT_BUCKETS 16
@@ -470,6 +471,9 @@ struct ctdb_statistics {
 	struct timeval statistics_current_time;
 	uint32_t total_ro_delegations;
 	uint32_t total_ro_revokes;
+	uint32_t total_hot_records;
+	uint32_t total_hot_pindowns;
+	struct ctdb_latency_counter recovery_latency;
 };
 
 #define INVALID_GENERATION 1
@@ -682,6 +686,11 @@ struct ctdb_tunable_list {
 	uint32_t queue_buffer_size;
 	uint32_t ip_alloc_algorithm;
 	uint32_t allow_mixed_versions;
+	uint32_t vacuum_traverse_chains;
+	uint32_t vacuum_delete_queue_target;
+	uint32_t hot_record_migrations;
+	uint32_t queue_batch_writes;
+	uint32_t recovery_compression;
 };
 
 struct ctdb_tickle_list {
@@ -855,6 +864,8 @@ struct ctdb_db_statistics {
 	} vacuum;
 	uint32_t db_ro_delegations;
 	uint32_t db_ro_revokes;
+	uint32_t db_hot_records;
+	uint32_t db_hot_pindowns;
 	uint32_t hop_count_bucket[MAX_COUNT_BUCKETS];
 	uint32_t num_hot_keys;
 	struct {
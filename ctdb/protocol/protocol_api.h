@@ -611,6 +611,11 @@ int ctdb_reply_control_enable_node(struct ctdb_reply_control *reply);
 void ctdb_req_control_start_ipreallocate(struct ctdb_req_control *request);
 int ctdb_reply_control_start_ipreallocate(struct ctdb_reply_control *reply);
 
+void ctdb_req_control_db_pull_compressed(struct ctdb_req_control *request,
+					 struct ctdb_pulldb_ext *pulldb_ext);
+int ctdb_reply_control_db_pull_compressed(struct ctdb_reply_control *reply,
+					  uint32_t *num_records);
+
 /* From protocol/protocol_debug.c */
 
 void ctdb_packet_print(uint8_t *buf, size_t buflen, FILE *fp);
@@ -2369,3 +2369,31 @@ int ctdb_reply_control_start_ipreallocate(struct ctdb_reply_control *reply)
 	return ctdb_reply_control_generic(reply,
 					  CTDB_CONTROL_START_IPREALLOCATE);
 }
+
+/* CTDB_CONTROL_DB_PULL_COMPRESSED */
+
+void ctdb_req_control_db_pull_compressed(struct ctdb_req_control *request,
+					 struct ctdb_pulldb_ext *pulldb_ext)
+{
+	request->opcode = CTDB_CONTROL_DB_PULL_COMPRESSED;
+	request->pad = 0;
+	request->srvid = 0;
+	request->client_id = 0;
+	request->flags = 0;
+
+	request->rdata.opcode = CTDB_CONTROL_DB_PULL_COMPRESSED;
+	request->rdata.data.pulldb_ext = pulldb_ext;
+}
+
+int ctdb_reply_control_db_pull_compressed(struct ctdb_reply_control *reply,
+					  uint32_t *num_records)
+{
+	if (reply->rdata.opcode != CTDB_CONTROL_DB_PULL_COMPRESSED) {
+		return EPROTO;
+	}
+
+	if (reply->status == 0) {
+		*num_records = reply->rdata.data.num_records;
+	}
+	return reply->status;
+}
@@ -367,6 +367,10 @@ static size_t ctdb_req_control_data_len(struct ctdb_req_control_data *cd)
 		len = ctdb_pulldb_ext_len(cd->data.pulldb_ext);
 		break;
 
+	case CTDB_CONTROL_DB_PULL_COMPRESSED:
+		len = ctdb_pulldb_ext_len(cd->data.pulldb_ext);
+		break;
+
 	case CTDB_CONTROL_DB_PUSH_START:
 		len = ctdb_pulldb_ext_len(cd->data.pulldb_ext);
 		break;
@@ -665,6 +669,10 @@ static void ctdb_req_control_data_push(struct ctdb_req_control_data *cd,
 		ctdb_pulldb_ext_push(cd->data.pulldb_ext, buf, &np);
 		break;
 
+	case CTDB_CONTROL_DB_PULL_COMPRESSED:
+		ctdb_pulldb_ext_push(cd->data.pulldb_ext, buf, &np);
+		break;
+
 	case CTDB_CONTROL_DB_PUSH_START:
 		ctdb_pulldb_ext_push(cd->data.pulldb_ext, buf, &np);
 		break;
@@ -992,6 +1000,11 @@ static int ctdb_req_control_data_pull(uint8_t *buf, size_t buflen,
 					   &cd->data.pulldb_ext, &np);
 		break;
 
+	case CTDB_CONTROL_DB_PULL_COMPRESSED:
+		ret = ctdb_pulldb_ext_pull(buf, buflen, mem_ctx,
+					   &cd->data.pulldb_ext, &np);
+		break;
+
 	case CTDB_CONTROL_DB_PUSH_START:
 		ret = ctdb_pulldb_ext_pull(buf, buflen, mem_ctx,
 					   &cd->data.pulldb_ext, &np);
@@ -1372,6 +1385,10 @@ static size_t ctdb_reply_control_data_len(struct ctdb_reply_control_data *cd)
 		len = ctdb_uint32_len(&cd->data.num_records);
 		break;
 
+	case CTDB_CONTROL_DB_PULL_COMPRESSED:
+		len = ctdb_uint32_len(&cd->data.num_records);
+		break;
+
 	case CTDB_CONTROL_DB_PUSH_START:
 		break;
 
@@ -1550,6 +1567,10 @@ static void ctdb_reply_control_data_push(struct ctdb_reply_control_data *cd,
 		ctdb_uint32_push(&cd->data.num_records, buf, &np);
 		break;
 
+	case CTDB_CONTROL_DB_PULL_COMPRESSED:
+		ctdb_uint32_push(&cd->data.num_records, buf, &np);
+		break;
+
 	case CTDB_CONTROL_DB_PUSH_CONFIRM:
 		ctdb_uint32_push(&cd->data.num_records, buf, &np);
 		break;
@@ -1732,6 +1753,11 @@ static int ctdb_reply_control_data_pull(uint8_t *buf, size_t buflen,
 				       &np);
 		break;
 
+	case CTDB_CONTROL_DB_PULL_COMPRESSED:
+		ret = ctdb_uint32_pull(buf, buflen, &cd->data.num_records,
+				       &np);
+		break;
+
 	case CTDB_CONTROL_DB_PUSH_CONFIRM:
 		ret = ctdb_uint32_pull(buf, buflen, &cd->data.num_records,
 				       &np);
@@ -248,6 +248,7 @@ static void ctdb_opcode_print(uint32_t opcode, FILE *fp)
 		{ CTDB_CONTROL_TCP_CLIENT_DISCONNECTED, "TCP_CLIENT_DISCONNECTED" },
 		{ CTDB_CONTROL_TCP_CLIENT_PASSED, "TCP_CLIENT_PASSED" },
 		{ CTDB_CONTROL_START_IPREALLOCATE, "START_IPREALLOCATE" },
+		{ CTDB_CONTROL_DB_PULL_COMPRESSED, "DB_PULL_COMPRESSED" },
 		{ MAP_END, "" },
 	};
 
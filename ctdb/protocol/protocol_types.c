@@ -240,7 +240,10 @@ size_t ctdb_statistics_len(struct ctdb_statistics *in)
 		ctdb_timeval_len(&in->statistics_start_time) +
 		ctdb_timeval_len(&in->statistics_current_time) +
 		ctdb_uint32_len(&in->total_ro_delegations) +
-		ctdb_uint32_len(&in->total_ro_revokes);
+		ctdb_uint32_len(&in->total_ro_revokes) +
+		ctdb_uint32_len(&in->total_hot_records) +
+		ctdb_uint32_len(&in->total_hot_pindowns) +
+		ctdb_latency_counter_len(&in->recovery_latency);
 }
 
 void ctdb_statistics_push(struct ctdb_statistics *in, uint8_t *buf,
@@ -406,6 +409,15 @@ void ctdb_statistics_push(struct ctdb_statistics *in, uint8_t *buf,
 	ctdb_uint32_push(&in->total_ro_revokes, buf+offset, &np);
 	offset += np;
 
+	ctdb_uint32_push(&in->total_hot_records, buf+offset, &np);
+	offset += np;
+
+	ctdb_uint32_push(&in->total_hot_pindowns, buf+offset, &np);
+	offset += np;
+
+	ctdb_latency_counter_push(&in->recovery_latency, buf+offset, &np);
+	offset += np;
+
 	*npush = offset;
 }
 
@@ -774,6 +786,27 @@ static int ctdb_statistics_pull_elems(uint8_t *buf, size_t buflen,
 	}
 	offset += np;
 
+	ret = ctdb_uint32_pull(buf+offset, buflen-offset,
+			       &out->total_hot_records, &np);
+	if (ret != 0) {
+		return ret;
+	}
+	offset += np;
+
+	ret = ctdb_uint32_pull(buf+offset, buflen-offset,
+			       &out->total_hot_pindowns, &np);
+	if (ret != 0) {
+		return ret;
+	}
+	offset += np;
+
+	ret = ctdb_latency_counter_pull(buf+offset, buflen-offset,
+					&out->recovery_latency, &np);
+	if (ret != 0) {
+		return ret;
+	}
+	offset += np;
+
 	*npull = offset;
 	return 0;
 }
@@ -2696,7 +2729,12 @@ size_t ctdb_tunable_list_len(struct ctdb_tunable_list *in)
 		ctdb_uint32_len(&in->rec_buffer_size_limit) +
 		ctdb_uint32_len(&in->queue_buffer_size) +
 		ctdb_uint32_len(&in->ip_alloc_algorithm) +
-		ctdb_uint32_len(&in->allow_mixed_versions);
+		ctdb_uint32_len(&in->allow_mixed_versions) +
+		ctdb_uint32_len(&in->vacuum_traverse_chains) +
+		ctdb_uint32_len(&in->vacuum_delete_queue_target) +
+		ctdb_uint32_len(&in->hot_record_migrations) +
+		ctdb_uint32_len(&in->queue_batch_writes) +
+		ctdb_uint32_len(&in->recovery_compression);
 }
 
 void ctdb_tunable_list_push(struct ctdb_tunable_list *in, uint8_t *buf,
@@ -2890,6 +2928,21 @@ void ctdb_tunable_list_push(struct ctdb_tunable_list *in, uint8_t *buf,
 	ctdb_uint32_push(&in->allow_mixed_versions, buf+offset, &np);
 	offset += np;
 
+	ctdb_uint32_push(&in->vacuum_traverse_chains, buf+offset, &np);
+	offset += np;
+
+	ctdb_uint32_push(&in->vacuum_delete_queue_target, buf+offset, &np);
+	offset += np;
+
+	ctdb_uint32_push(&in->hot_record_migrations, buf+offset, &np);
+	offset += np;
+
+	ctdb_uint32_push(&in->queue_batch_writes, buf+offset, &np);
+	offset += np;
+
+	ctdb_uint32_push(&in->recovery_compression, buf+offset, &np);
+	offset += np;
+
 	*npush = offset;
 }
 
@@ -3335,6 +3388,41 @@ static int ctdb_tunable_list_pull_elems(uint8_t *buf, size_t buflen,
 	}
 	offset += np;
 
+	ret = ctdb_uint32_pull(buf+offset, buflen-offset,
+			       &out->vacuum_traverse_chains, &np);
+	if (ret != 0) {
+		return ret;
+	}
+	offset += np;
+
+	ret = ctdb_uint32_pull(buf+offset, buflen-offset,
+			       &out->vacuum_delete_queue_target, &np);
+	if (ret != 0) {
+		return ret;
+	}
+	offset += np;
+
+	ret = ctdb_uint32_pull(buf+offset, buflen-offset,
+			       &out->hot_record_migrations, &np);
+	if (ret != 0) {
+		return ret;
+	}
+	offset += np;
+
+	ret = ctdb_uint32_pull(buf+offset, buflen-offset,
+			       &out->queue_batch_writes, &np);
+	if (ret != 0) {
+		return ret;
+	}
+	offset += np;
+
+	ret = ctdb_uint32_pull(buf+offset, buflen-offset,
+			       &out->recovery_compression, &np);
+	if (ret != 0) {
+		return ret;
+	}
+	offset += np;
+
 	*npull = offset;
 	return 0;
 }
@@ -4626,6 +4714,8 @@ size_t ctdb_db_statistics_len(struct ctdb_db_statistics *in)
 		ctdb_latency_counter_len(&in->vacuum.latency) +
 		ctdb_uint32_len(&in->db_ro_delegations) +
 		ctdb_uint32_len(&in->db_ro_revokes) +
+		ctdb_uint32_len(&in->db_hot_records) +
+		ctdb_uint32_len(&in->db_hot_pindowns) +
 		MAX_COUNT_BUCKETS *
 			ctdb_uint32_len(&in->hop_count_bucket[0]) +
 		ctdb_uint32_len(&in->num_hot_keys) +
@@ -4677,6 +4767,12 @@ void ctdb_db_statistics_push(struct ctdb_db_statistics *in, uint8_t *buf,
 	ctdb_uint32_push(&in->db_ro_revokes, buf+offset, &np);
 	offset += np;
 
+	ctdb_uint32_push(&in->db_hot_records, buf+offset, &np);
+	offset += np;
+
+	ctdb_uint32_push(&in->db_hot_pindowns, buf+offset, &np);
+	offset += np;
+
 	for (i=0; i<MAX_COUNT_BUCKETS; i++) {
 		ctdb_uint32_push(&in->hop_count_bucket[i], buf+offset, &np);
 		offset += np;
@@ -4781,6 +4877,20 @@ static int ctdb_db_statistics_pull_elems(uint8_t *buf, size_t buflen,
 	}
 	offset += np;
 
+	ret = ctdb_uint32_pull(buf+offset, buflen-offset,
+			       &out->db_hot_records, &np);
+	if (ret != 0) {
+		return ret;
+	}
+	offset += np;
+
+	ret = ctdb_uint32_pull(buf+offset, buflen-offset,
+			       &out->db_hot_pindowns, &np);
+	if (ret != 0) {
+		return ret;
+	}
+	offset += np;
+
 	for (i=0; i<MAX_COUNT_BUCKETS; i++) {
 		ret = ctdb_uint32_pull(buf+offset, buflen-offset,
 				       &out->hop_count_bucket[i], &np);
@@ -377,11 +377,11 @@ static void ctdb_become_dmaster(struct ctdb_db_context *ctdb_db,
 		return;
 	}
 
-	/* we just became DMASTER and this database is "sticky",
+	/* we just became DMASTER and this database has sticky records,
 	   see if the record is flagged as "hot" and set up a pin-down
 	   context to stop migrations for a little while if so
 	*/
-	if (ctdb_db_sticky(ctdb_db)) {
+	if (ctdb_db->sticky_records != NULL) {
 		ctdb_set_sticky_pindown(ctdb, ctdb_db, key);
 	}
 
@@ -954,7 +954,7 @@ void ctdb_request_call(struct ctdb_context *ctdb, struct ctdb_req_header *hdr)
 	/* If this record is pinned down we should defer the
 	   request until the pindown times out
 	*/
-	if (ctdb_db_sticky(ctdb_db)) {
+	if (ctdb_db->sticky_records != NULL) {
 		if (ctdb_defer_pinned_down_request(ctdb, ctdb_db, call->key, hdr) == 0) {
 			DEBUG(DEBUG_WARNING,
 			      ("Defer request for pinned down record in %s\n", ctdb_db->db_name));
@@ -2015,15 +2015,81 @@ int ctdb_add_revoke_deferred_call(struct ctdb_context *ctdb, struct ctdb_db_cont
 	return 0;
 }
 
+/*
+ * A record that keeps migrating onto this node is made sticky, also
+ * in databases not marked STICKY. We are the dmaster right now, so
+ * pin it down straight away.
+ */
+static void ctdb_make_record_hot(struct ctdb_db_context *ctdb_db,
+				 TDB_DATA key)
+{
+	struct ctdb_context *ctdb = ctdb_db->ctdb;
+	TALLOC_CTX *tmp_ctx;
+	struct ctdb_sticky_record *sr;
+	uint32_t *k;
+
+	if (ctdb_db->sticky_records == NULL) {
+		ctdb_db->sticky_records = trbt_create(ctdb_db, 0);
+		if (ctdb_db->sticky_records == NULL) {
+			DEBUG(DEBUG_ERR,
+			      ("Memory error in hot record tracking for %s\n",
+			       ctdb_db->db_name));
+			return;
+		}
+	}
+
+	tmp_ctx = talloc_new(NULL);
+	k = ctdb_key_to_idkey(tmp_ctx, key);
+	if (k == NULL) {
+		DEBUG(DEBUG_ERR,("Failed to allocate key for sticky record\n"));
+		talloc_free(tmp_ctx);
+		return;
+	}
+
+	sr = trbt_lookuparray32(ctdb_db->sticky_records, k[0], &k[0]);
+	if (sr == NULL) {
+		if (ctdb_make_record_sticky(ctdb, ctdb_db, key) != 0) {
+			goto done;
+		}
+		sr = trbt_lookuparray32(ctdb_db->sticky_records,
+					k[0], &k[0]);
+		if (sr == NULL) {
+			goto done;
+		}
+		CTDB_INCREMENT_STAT(ctdb, total_hot_records);
+		CTDB_INCREMENT_DB_STAT(ctdb_db, db_hot_records);
+	}
+
+	if (sr->pindown != NULL) {
+		goto done;
+	}
+	if (ctdb_set_sticky_pindown(ctdb, ctdb_db, key) != 0) {
+		goto done;
+	}
+	if (sr->pindown != NULL) {
+		CTDB_INCREMENT_STAT(ctdb, total_hot_pindowns);
+		CTDB_INCREMENT_DB_STAT(ctdb_db, db_hot_pindowns);
+	}
+
+done:
+	talloc_free(tmp_ctx);
+}
+
 static void ctdb_migration_count_handler(TDB_DATA key, uint64_t counter,
 					 void *private_data)
 {
 	struct ctdb_db_context *ctdb_db = talloc_get_type_abort(
 		private_data, struct ctdb_db_context);
+	uint32_t hot_migrations =
+		ctdb_db->ctdb->tunable.hot_record_migrations;
 	unsigned int value;
 
 	value = (counter < INT_MAX ? counter : INT_MAX);
 	ctdb_update_db_stat_hot_keys(ctdb_db, key, value);
+
+	if ((hot_migrations != 0) && (counter >= hot_migrations)) {
+		ctdb_make_record_hot(ctdb_db, key);
+	}
 }
 
 static void ctdb_migration_cleandb_event(struct tevent_context *ev,
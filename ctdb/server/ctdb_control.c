@@ -803,7 +803,7 @@ static int32_t ctdb_control_dispatch(struct ctdb_context *ctdb,
 
 	case CTDB_CONTROL_DB_PULL:
 		CHECK_CONTROL_DATA_SIZE(sizeof(struct ctdb_pulldb_ext));
-		return ctdb_control_db_pull(ctdb, c, indata, outdata);
+		return ctdb_control_db_pull(ctdb, c, indata, outdata, false);
 
 	case CTDB_CONTROL_DB_PUSH_START:
 		CHECK_CONTROL_DATA_SIZE(sizeof(struct ctdb_pulldb_ext));
@@ -880,6 +880,10 @@ static int32_t ctdb_control_dispatch(struct ctdb_context *ctdb,
 		CHECK_CONTROL_DATA_SIZE(0);
 		return ctdb_control_start_ipreallocate(ctdb, c, async_reply);
 
+	case CTDB_CONTROL_DB_PULL_COMPRESSED:
+		CHECK_CONTROL_DATA_SIZE(sizeof(struct ctdb_pulldb_ext));
+		return ctdb_control_db_pull(ctdb, c, indata, outdata, true);
+
 	default:
 		DEBUG(DEBUG_CRIT,(__location__ " Unknown CTDB control opcode %u\n", opcode));
 		return -1;
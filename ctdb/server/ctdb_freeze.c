@@ -871,6 +871,7 @@ int32_t ctdb_control_wipe_database(struct ctdb_context *ctdb, TDB_DATA indata)
 		talloc_free(ctdb_db->delete_queue);
 		talloc_free(ctdb_db->fetch_queue);
 		ctdb_db->delete_queue = trbt_create(ctdb_db, 0);
+		ctdb_db->delete_queue_count = 0;
 		if (ctdb_db->delete_queue == NULL) {
 			DEBUG(DEBUG_ERR, (__location__ " Failed to re-create "
 					  "the delete queue.\n"));
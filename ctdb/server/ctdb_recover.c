@@ -39,6 +39,7 @@
 #include "common/system.h"
 #include "common/common.h"
 #include "common/logging.h"
+#include "common/compress.h"
 
 #include "ctdb_cluster_mutex.h"
 
@@ -198,8 +199,39 @@ struct db_pull_state {
 	uint32_t pnn;
 	uint64_t srvid;
 	uint32_t num_records;
+	bool compress;
 };
 
+static int db_pull_send(struct db_pull_state *state)
+{
+	TDB_DATA buffer;
+	int ret;
+
+	buffer = ctdb_marshall_finish(state->recs);
+
+	if (state->compress) {
+		ret = ctdb_compress_data(state->recs, buffer, &buffer);
+		if (ret != 0) {
+			DEBUG(DEBUG_ERR,
+			      ("Failed to compress records for db %s, ret=%d\n",
+			       state->ctdb_db->db_name, ret));
+			TALLOC_FREE(state->recs);
+			return -1;
+		}
+	}
+
+	ret = ctdb_daemon_send_message(state->ctdb, state->pnn,
+				       state->srvid, buffer);
+	if (ret != 0) {
+		TALLOC_FREE(state->recs);
+		return -1;
+	}
+
+	state->num_records += state->recs->count;
+	TALLOC_FREE(state->recs);
+	return 0;
+}
+
 static int traverse_db_pull(struct tdb_context *tdb, TDB_DATA key,
 			    TDB_DATA data, void *private_data)
 {
@@ -216,19 +248,12 @@ static int traverse_db_pull(struct tdb_context *tdb, TDB_DATA key,
 
 	if (talloc_get_size(state->recs) >=
 			state->ctdb->tunable.rec_buffer_size_limit) {
-		TDB_DATA buffer;
 		int ret;
 
-		buffer = ctdb_marshall_finish(state->recs);
-		ret = ctdb_daemon_send_message(state->ctdb, state->pnn,
-					       state->srvid, buffer);
+		ret = db_pull_send(state);
 		if (ret != 0) {
-			TALLOC_FREE(state->recs);
 			return -1;
 		}
-
-		state->num_records += state->recs->count;
-		TALLOC_FREE(state->recs);
 	}
 
 	return 0;
@@ -236,7 +261,8 @@ static int traverse_db_pull(struct tdb_context *tdb, TDB_DATA key,
 
 int32_t ctdb_control_db_pull(struct ctdb_context *ctdb,
 			     struct ctdb_req_control_old *c,
-			     TDB_DATA indata, TDB_DATA *outdata)
+			     TDB_DATA indata, TDB_DATA *outdata,
+			     bool compress)
 {
 	struct ctdb_pulldb_ext *pulldb_ext;
 	struct ctdb_db_context *ctdb_db;
@@ -271,6 +297,7 @@ int32_t ctdb_control_db_pull(struct ctdb_context *ctdb,
 	state.pnn = c->hdr.srcnode;
 	state.srvid = pulldb_ext->srvid;
 	state.num_records = 0;
+	state.compress = compress;
 
 	/* If the records are invalid, we are done */
 	if (ctdb_db->invalid_records) {
@@ -294,19 +321,11 @@ int32_t ctdb_control_db_pull(struct ctdb_context *ctdb,
 
 	/* Last few records */
 	if (state.recs != NULL) {
-		TDB_DATA buffer;
-
-		buffer = ctdb_marshall_finish(state.recs);
-		ret = ctdb_daemon_send_message(state.ctdb, state.pnn,
-					       state.srvid, buffer);
+		ret = db_pull_send(&state);
 		if (ret != 0) {
-			TALLOC_FREE(state.recs);
 			ctdb_lockdb_unmark(ctdb_db);
 			return -1;
 		}
-
-		state.num_records += state.recs->count;
-		TALLOC_FREE(state.recs);
 	}
 
 	ctdb_lockdb_unmark(ctdb_db);
@@ -844,9 +863,13 @@ struct recovery_callback_state {
 static void ctdb_end_recovery_callback(struct ctdb_context *ctdb, int status, void *p)
 {
 	struct recovery_callback_state *state = talloc_get_type(p, struct recovery_callback_state);
+	double latency;
 
 	CTDB_INCREMENT_STAT(ctdb, num_recoveries);
 
+	latency = timeval_elapsed(&ctdb->last_recovery_started);
+	CTDB_UPDATE_RECOVERY_LATENCY(ctdb, latency);
+
 	if (status != 0) {
 		DEBUG(DEBUG_ERR,(__location__ " recovered event script failed (status %d)\n", status));
 		if (status == -ETIMEDOUT) {
@@ -39,6 +39,7 @@
 #include "client/client.h"
 
 #include "common/logging.h"
+#include "common/compress.h"
 
 static int recover_timeout = 30;
 
@@ -712,13 +713,18 @@ struct pull_database_state {
 	struct recdb_context *recdb;
 	uint32_t pnn;
 	uint64_t srvid;
+	bool compress;
 	unsigned int num_records;
+	size_t num_bytes;
+	size_t num_wire_bytes;
+	struct timeval start_time;
 	int result;
 };
 
 static void pull_database_handler(uint64_t srvid, TDB_DATA data,
 				  void *private_data);
 static void pull_database_register_done(struct tevent_req *subreq);
+static void pull_database_control(struct tevent_req *req);
 static void pull_database_unregister_done(struct tevent_req *subreq);
 static void pull_database_done(struct tevent_req *subreq);
 
@@ -727,7 +733,8 @@ static struct tevent_req *pull_database_send(
 			struct tevent_context *ev,
 			struct ctdb_client_context *client,
 			uint32_t pnn,
-			struct recdb_context *recdb)
+			struct recdb_context *recdb,
+			bool compress)
 {
 	struct tevent_req *req, *subreq;
 	struct pull_database_state *state;
@@ -742,6 +749,8 @@ static struct tevent_req *pull_database_send(
 	state->recdb = recdb;
 	state->pnn = pnn;
 	state->srvid = srvid_next();
+	state->compress = compress;
+	state->start_time = timeval_current();
 
 	subreq = ctdb_client_set_message_handler_send(
 					state, state->ev, state->client,
@@ -764,6 +773,7 @@ static void pull_database_handler(uint64_t srvid, TDB_DATA data,
 	struct pull_database_state *state = tevent_req_data(
 		req, struct pull_database_state);
 	struct ctdb_rec_buffer *recbuf;
+	TDB_DATA buf = data;
 	size_t np;
 	int ret;
 	bool status;
@@ -772,7 +782,19 @@ static void pull_database_handler(uint64_t srvid, TDB_DATA data,
 		return;
 	}
 
-	ret = ctdb_rec_buffer_pull(data.dptr, data.dsize, state, &recbuf, &np);
+	if (state->compress) {
+		ret = ctdb_decompress_data(state, data, &buf);
+		if (ret != 0) {
+			D_ERR("Invalid compressed data received for DB_PULL"
+			      " messages\n");
+			return;
+		}
+	}
+
+	ret = ctdb_rec_buffer_pull(buf.dptr, buf.dsize, state, &recbuf, &np);
+	if (buf.dptr != data.dptr) {
+		talloc_free(buf.dptr);
+	}
 	if (ret != 0) {
 		D_ERR("Invalid data received for DB_PULL messages\n");
 		return;
@@ -795,6 +817,8 @@ static void pull_database_handler(uint64_t srvid, TDB_DATA data,
 	}
 
 	state->num_records += recbuf->count;
+	state->num_bytes += buf.dsize;
+	state->num_wire_bytes += data.dsize;
 	talloc_free(recbuf);
 }
 
@@ -804,8 +828,6 @@ static void pull_database_register_done(struct tevent_req *subreq)
 		subreq, struct tevent_req);
 	struct pull_database_state *state = tevent_req_data(
 		req, struct pull_database_state);
-	struct ctdb_req_control request;
-	struct ctdb_pulldb_ext pulldb_ext;
 	int ret;
 	bool status;
 
@@ -818,11 +840,26 @@ static void pull_database_register_done(struct tevent_req *subreq)
 		return;
 	}
 
+	pull_database_control(req);
+}
+
+static void pull_database_control(struct tevent_req *req)
+{
+	struct pull_database_state *state = tevent_req_data(
+		req, struct pull_database_state);
+	struct tevent_req *subreq;
+	struct ctdb_req_control request;
+	struct ctdb_pulldb_ext pulldb_ext;
+
 	pulldb_ext.db_id = recdb_id(state->recdb);
 	pulldb_ext.lmaster = CTDB_LMASTER_ANY;
 	pulldb_ext.srvid = state->srvid;
 
-	ctdb_req_control_db_pull(&request, &pulldb_ext);
+	if (state->compress) {
+		ctdb_req_control_db_pull_compressed(&request, &pulldb_ext);
+	} else {
+		ctdb_req_control_db_pull(&request, &pulldb_ext);
+	}
 	subreq = ctdb_client_control_send(state, state->ev, state->client,
 					  state->pnn, TIMEOUT(), &request);
 	if (tevent_req_nomem(subreq, req)) {
@@ -851,8 +888,29 @@ static void pull_database_done(struct tevent_req *subreq)
 		goto unregister;
 	}
 
-	ret = ctdb_reply_control_db_pull(reply, &num_records);
-	talloc_free(reply);
+	if (state->compress) {
+		ret = ctdb_reply_control_db_pull_compressed(reply,
+							    &num_records);
+		talloc_free(reply);
+		if (ret != 0) {
+			/*
+			 * Node does not support compression, pull again.
+			 * Adding the same records to recdb twice is harmless.
+			 */
+			D_NOTICE("control DB_PULL_COMPRESSED failed for %s"
+				 " on node %u, ret=%d, retrying with DB_PULL\n",
+				 recdb_name(state->recdb), state->pnn, ret);
+			state->compress = false;
+			state->num_records = 0;
+			state->num_bytes = 0;
+			state->num_wire_bytes = 0;
+			pull_database_control(req);
+			return;
+		}
+	} else {
+		ret = ctdb_reply_control_db_pull(reply, &num_records);
+		talloc_free(reply);
+	}
 	if (num_records != state->num_records) {
 		D_ERR("mismatch (%u != %u) in DB_PULL records for db %s\n",
 		      num_records, state->num_records,
@@ -861,8 +919,11 @@ static void pull_database_done(struct tevent_req *subreq)
 		goto unregister;
 	}
 
-	D_INFO("Pulled %d records for db %s from node %d\n",
-	       state->num_records, recdb_name(state->recdb), state->pnn);
+	D_INFO("Pulled %u records (%zu bytes, %zu bytes on the wire)"
+	       " for db %s from node %u in %.3f seconds\n",
+	       state->num_records, state->num_bytes, state->num_wire_bytes,
+	       recdb_name(state->recdb), state->pnn,
+	       timeval_elapsed(&state->start_time));
 
 unregister:
 
@@ -1204,6 +1265,7 @@ struct collect_highseqnum_db_state {
 	struct node_list *nlist;
 	uint32_t db_id;
 	struct recdb_context *recdb;
+	bool compress;
 
 	uint32_t max_pnn;
 };
@@ -1217,7 +1279,8 @@ static struct tevent_req *collect_highseqnum_db_send(
 			struct ctdb_client_context *client,
 			struct node_list *nlist,
 			uint32_t db_id,
-			struct recdb_context *recdb)
+			struct recdb_context *recdb,
+			bool compress)
 {
 	struct tevent_req *req, *subreq;
 	struct collect_highseqnum_db_state *state;
@@ -1234,6 +1297,7 @@ static struct tevent_req *collect_highseqnum_db_send(
 	state->nlist = nlist;
 	state->db_id = db_id;
 	state->recdb = recdb;
+	state->compress = compress;
 
 	ctdb_req_control_get_db_seqnum(&request, db_id);
 	subreq = ctdb_client_control_multi_send(mem_ctx,
@@ -1313,7 +1377,8 @@ static void collect_highseqnum_db_seqnum_done(struct tevent_req *subreq)
 				    state->ev,
 				    state->client,
 				    state->max_pnn,
-				    state->recdb);
+				    state->recdb,
+				    state->compress);
 	if (tevent_req_nomem(subreq, req)) {
 		return;
 	}
@@ -1356,6 +1421,7 @@ struct collect_all_db_state {
 	struct node_list *nlist;
 	uint32_t db_id;
 	struct recdb_context *recdb;
+	bool compress;
 
 	struct ctdb_pulldb pulldb;
 	unsigned int index;
@@ -1369,7 +1435,8 @@ static struct tevent_req *collect_all_db_send(
 			struct ctdb_client_context *client,
 			struct node_list *nlist,
 			uint32_t db_id,
-			struct recdb_context *recdb)
+			struct recdb_context *recdb,
+			bool compress)
 {
 	struct tevent_req *req, *subreq;
 	struct collect_all_db_state *state;
@@ -1385,13 +1452,15 @@ static struct tevent_req *collect_all_db_send(
 	state->nlist = nlist;
 	state->db_id = db_id;
 	state->recdb = recdb;
+	state->compress = compress;
 	state->index = 0;
 
 	subreq = pull_database_send(state,
 				    ev,
 				    client,
 				    nlist->pnn_list[state->index],
-				    recdb);
+				    recdb,
+				    compress);
 	if (tevent_req_nomem(subreq, req)) {
 		return tevent_req_post(req, ev);
 	}
@@ -1428,7 +1497,8 @@ static void collect_all_db_pulldb_done(struct tevent_req *subreq)
 				    state->ev,
 				    state->client,
 				    state->nlist->pnn_list[state->index],
-				    state->recdb);
+				    state->recdb,
+				    state->compress);
 	if (tevent_req_nomem(subreq, req)) {
 		return;
 	}
@@ -1744,6 +1814,7 @@ static void recover_db_transaction_started(struct tevent_req *subreq)
 		req, struct recover_db_state);
 	int *err_list;
 	uint32_t flags;
+	bool compress;
 	int ret;
 	bool status;
 
@@ -1781,6 +1852,8 @@ static void recover_db_transaction_started(struct tevent_req *subreq)
 		return;
 	}
 
+	compress = (state->tun_list->recovery_compression != 0);
+
 	if ((flags & CTDB_DB_FLAGS_PERSISTENT) ||
 	    (flags & CTDB_DB_FLAGS_REPLICATED)) {
 		subreq = collect_highseqnum_db_send(state,
@@ -1788,14 +1861,16 @@ static void recover_db_transaction_started(struct tevent_req *subreq)
 						    state->client,
 						    state->nlist,
 						    state->db->db_id,
-						    state->recdb);
+						    state->recdb,
+						    compress);
 	} else {
 		subreq = collect_all_db_send(state,
 					     state->ev,
 					     state->client,
 					     state->nlist,
 					     state->db->db_id,
-					     state->recdb);
+					     state->recdb,
+					     compress);
 	}
 	if (tevent_req_nomem(subreq, req)) {
 		return;
@@ -2028,6 +2103,7 @@ struct db_recovery_one_state {
 	uint32_t generation;
 	struct db *db;
 	int num_fails;
+	struct timeval start_time;
 };
 
 static void db_recovery_one_done(struct tevent_req *subreq);
@@ -2074,6 +2150,7 @@ static struct tevent_req *db_recovery_send(TALLOC_CTX *mem_ctx,
 		substate->nlist = nlist;
 		substate->generation = generation;
 		substate->db = db;
+		substate->start_time = timeval_current();
 
 		subreq = recover_db_send(state,
 					 ev,
@@ -2106,6 +2183,9 @@ static void db_recovery_one_done(struct tevent_req *subreq)
 	TALLOC_FREE(subreq);
 
 	if (status) {
+		D_NOTICE("recovered database 0x%08x in %.3f seconds\n",
+			 substate->db->db_id,
+			 timeval_elapsed(&substate->start_time));
 		talloc_free(substate);
 		goto done;
 	}
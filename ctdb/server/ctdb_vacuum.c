@@ -63,6 +63,8 @@ struct ctdb_vacuum_handle {
 	struct ctdb_db_context *ctdb_db;
 	uint32_t fast_path_count;
 	uint32_t vacuum_interval;
+	/* where the next incremental db traverse starts */
+	uint32_t traverse_chain;
 };
 
 
@@ -840,6 +842,61 @@ static void ctdb_vacuum_traverse_db(struct ctdb_db_context *ctdb_db,
 	return;
 }
 
+/**
+ * read-only traverse of a slice of the database's hash chains.
+ *
+ * This is the incremental variant of ctdb_vacuum_traverse_db(),
+ * used if the tunable VacuumTraverseChains is set. Every chain is
+ * locked on its own, so no lock is held for longer than it takes
+ * to walk a single chain.
+ */
+static void ctdb_vacuum_traverse_chains(struct ctdb_db_context *ctdb_db,
+					struct vacuum_data *vdata,
+					uint32_t first_chain,
+					uint32_t num_chains)
+{
+	struct tdb_context *tdb = ctdb_db->ltdb->tdb;
+	uint32_t hash_size = tdb_hash_size(tdb);
+	uint32_t i;
+	int ret;
+
+	num_chains = MIN(num_chains, hash_size);
+
+	for (i = 0; i < num_chains; i++) {
+		uint32_t chain = (first_chain + i) % hash_size;
+
+		ret = tdb_traverse_chain(tdb, chain, vacuum_traverse, vdata);
+		if (ret == -1 || vdata->traverse_error) {
+			DEBUG(DEBUG_ERR, (__location__ " Traverse error in "
+					  "vacuuming '%s' chain %u\n",
+					  ctdb_db->db_name,
+					  (unsigned)chain));
+			return;
+		}
+	}
+
+	if (vdata->count.db_traverse.total > 0) {
+		DEBUG(DEBUG_INFO,
+		      (__location__
+		       " incremental vacuuming db traverse statistics: "
+		       "db[%s] "
+		       "chains[%u-%u] "
+		       "total[%u] "
+		       "skp[%u] "
+		       "err[%u] "
+		       "sched[%u]\n",
+		       ctdb_db->db_name,
+		       (unsigned)(first_chain % hash_size),
+		       (unsigned)((first_chain + num_chains - 1) % hash_size),
+		       (unsigned)vdata->count.db_traverse.total,
+		       (unsigned)vdata->count.db_traverse.skipped,
+		       (unsigned)vdata->count.db_traverse.error,
+		       (unsigned)vdata->count.db_traverse.scheduled));
+	}
+
+	return;
+}
+
 /**
  * Process the vacuum fetch lists:
  * For records for which we are not the lmaster, tell the lmaster to
@@ -1192,6 +1249,8 @@ fail:
  *    in order to use the traditional heuristics on empty records
  *    to trigger deletion.
  *    This is done only every VacuumFastPathCount'th vacuuming run.
+ *  - With VacuumTraverseChains set, every run instead traverses
+ *    num_chains hash chains starting at first_chain.
  *
  * The traverse runs fill two lists:
  *
@@ -1216,7 +1275,9 @@ fail:
  * This executes in the child context.
  */
 static int ctdb_vacuum_db(struct ctdb_db_context *ctdb_db,
-			  bool full_vacuum_run)
+			  bool full_vacuum_run,
+			  uint32_t first_chain,
+			  uint32_t num_chains)
 {
 	struct ctdb_context *ctdb = ctdb_db->ctdb;
 	int ret, pnn;
@@ -1256,6 +1317,11 @@ static int ctdb_vacuum_db(struct ctdb_db_context *ctdb_db,
 
 	if (full_vacuum_run) {
 		ctdb_vacuum_traverse_db(ctdb_db, vdata);
+	} else if (num_chains > 0) {
+		ctdb_vacuum_traverse_chains(ctdb_db,
+					    vdata,
+					    first_chain,
+					    num_chains);
 	}
 
 	ctdb_process_fetch_queue(ctdb_db);
@@ -1276,14 +1342,19 @@ static int ctdb_vacuum_db(struct ctdb_db_context *ctdb_db,
  * called from the child context
  */
 static int ctdb_vacuum_and_repack_db(struct ctdb_db_context *ctdb_db,
-				     bool full_vacuum_run)
+				     bool full_vacuum_run,
+				     uint32_t first_chain,
+				     uint32_t num_chains)
 {
 	uint32_t repack_limit = ctdb_db->ctdb->tunable.repack_limit;
 	const char *name = ctdb_db->db_name;
 	int freelist_size = 0;
 	int ret;
 
-	if (ctdb_vacuum_db(ctdb_db, full_vacuum_run) != 0) {
+	if (ctdb_vacuum_db(ctdb_db,
+			   full_vacuum_run,
+			   first_chain,
+			   num_chains) != 0) {
 		DEBUG(DEBUG_ERR,(__location__ " Failed to vacuum '%s'\n", name));
 	}
 
@@ -1317,8 +1388,24 @@ static int ctdb_vacuum_and_repack_db(struct ctdb_db_context *ctdb_db,
 static uint32_t get_vacuum_interval(struct ctdb_db_context *ctdb_db)
 {
 	uint32_t interval = ctdb_db->ctdb->tunable.vacuum_interval;
+	uint32_t target = ctdb_db->ctdb->tunable.vacuum_delete_queue_target;
+	uint32_t queued = ctdb_db->delete_queue_count;
+
+	if (target == 0 || interval <= 1) {
+		return interval;
+	}
+
+	if (queued <= target) {
+		return interval;
+	}
+
+	/*
+	 * Come back earlier the more records pile up, so that a
+	 * single run does not have to delete too many of them.
+	 */
+	interval = (uint32_t)((uint64_t)interval * target / queued);
 
-	return interval;
+	return MAX(interval, 1);
 }
 
 static int vacuum_child_destructor(struct ctdb_vacuum_child_context *child_ctx)
@@ -1403,11 +1490,13 @@ static int vacuum_db_child(TALLOC_CTX *mem_ctx,
 			   struct ctdb_db_context *ctdb_db,
 			   bool scheduled,
 			   bool full_vacuum_run,
+			   uint32_t traverse_chains,
 			   struct ctdb_vacuum_child_context **out)
 {
 	struct ctdb_context *ctdb = ctdb_db->ctdb;
 	struct ctdb_vacuum_child_context *child_ctx;
 	struct tevent_fd *fde;
+	uint32_t first_chain = 0;
 	int ret;
 
 	/* we don't vacuum if we are in recovery mode, or db frozen */
@@ -1434,6 +1523,10 @@ static int vacuum_db_child(TALLOC_CTX *mem_ctx,
 		return ENOMEM;
 	}
 
+	if (traverse_chains > 0) {
+		first_chain = ctdb_db->vacuum_handle->traverse_chain;
+	}
+
 
 	ret = pipe(child_ctx->fd);
 	if (ret != 0) {
@@ -1467,7 +1560,10 @@ static int vacuum_db_child(TALLOC_CTX *mem_ctx,
 			return EIO;
 		}
 
-		cc = ctdb_vacuum_and_repack_db(ctdb_db, full_vacuum_run);
+		cc = ctdb_vacuum_and_repack_db(ctdb_db,
+					       full_vacuum_run,
+					       first_chain,
+					       traverse_chains);
 
 		sys_write(child_ctx->fd[1], &cc, 1);
 		_exit(0);
@@ -1476,6 +1572,18 @@ static int vacuum_db_child(TALLOC_CTX *mem_ctx,
 	set_close_on_exec(child_ctx->fd[0]);
 	close(child_ctx->fd[1]);
 
+	if (traverse_chains > 0) {
+		uint32_t hash_size = tdb_hash_size(ctdb_db->ltdb->tdb);
+
+		/*
+		 * The child covers this slice, the next one continues
+		 * after it
+		 */
+		ctdb_db->vacuum_handle->traverse_chain =
+			(first_chain + MIN(traverse_chains, hash_size)) %
+			hash_size;
+	}
+
 	child_ctx->status = VACUUM_RUNNING;
 	child_ctx->scheduled = scheduled;
 	child_ctx->start_time = timeval_current();
@@ -1488,6 +1596,7 @@ static int vacuum_db_child(TALLOC_CTX *mem_ctx,
 	 */
 	talloc_free(ctdb_db->delete_queue);
 	ctdb_db->delete_queue = trbt_create(ctdb_db, 0);
+	ctdb_db->delete_queue_count = 0;
 	if (ctdb_db->delete_queue == NULL) {
 		DBG_ERR("Out of memory when re-creating vacuum tree\n");
 		return ENOMEM;
@@ -1528,6 +1637,7 @@ static void ctdb_vacuum_event(struct tevent_context *ev,
 	struct ctdb_context *ctdb = ctdb_db->ctdb;
 	struct ctdb_vacuum_child_context *child_ctx = NULL;
 	uint32_t fast_path_max = ctdb->tunable.vacuum_fast_path_count;
+	uint32_t traverse_chains = ctdb->tunable.vacuum_traverse_chains;
 	uint32_t vacuum_interval = get_vacuum_interval(ctdb_db);
 	bool full_vacuum_run = false;
 	int ret;
@@ -1550,7 +1660,11 @@ static void ctdb_vacuum_event(struct tevent_context *ev,
 
 	vacuum_handle->vacuum_interval = vacuum_interval;
 
-	if (vacuum_handle->fast_path_count >= fast_path_max) {
+	/*
+	 * The incremental traverse replaces the periodic full one
+	 */
+	if ((traverse_chains == 0) &&
+	    (vacuum_handle->fast_path_count >= fast_path_max)) {
 		if (fast_path_max > 0) {
 			full_vacuum_run = true;
 		}
@@ -1561,6 +1675,7 @@ static void ctdb_vacuum_event(struct tevent_context *ev,
 			      ctdb_db,
 			      true,
 			      full_vacuum_run,
+			      traverse_chains,
 			      &child_ctx);
 
 	if (ret == 0) {
@@ -1645,6 +1760,7 @@ int32_t ctdb_control_db_vacuum(struct ctdb_context *ctdb,
 			      ctdb_db,
 			      false,
 			      db_vacuum->full_vacuum_run,
+			      0,
 			      &child_ctx);
 
 	talloc_free(db_vacuum);
@@ -1710,6 +1826,7 @@ int ctdb_vacuum_init(struct ctdb_db_context *ctdb_db)
 	vacuum_handle->ctdb_db = ctdb_db;
 	vacuum_handle->fast_path_count = 0;
 	vacuum_handle->vacuum_interval = get_vacuum_interval(ctdb_db);
+	vacuum_handle->traverse_chain = 0;
 
 	ctdb_db->vacuum_handle = vacuum_handle;
 
@@ -1769,6 +1886,7 @@ static void remove_record_from_delete_queue(struct ctdb_db_context *ctdb_db,
 			     hash));
 
 	talloc_free(kd);
+	ctdb_db->delete_queue_count--;
 
 	return;
 }
@@ -1826,6 +1944,10 @@ static int insert_record_into_delete_queue(struct ctdb_db_context *ctdb_db,
 		return -1;
 	}
 
+	if (kd == NULL) {
+		ctdb_db->delete_queue_count++;
+	}
+
 	return 0;
 }
 
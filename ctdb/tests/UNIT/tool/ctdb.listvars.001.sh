@@ -61,6 +61,11 @@ RecBufferSizeLimit         = 1000000
 QueueBufferSize            = 1024
 IPAllocAlgorithm           = 2
 AllowMixedVersions         = 0
+VacuumTraverseChains       = 0
+VacuumDeleteQueueTarget    = 0
+HotRecordMigrations        = 0
+QueueBatchWrites           = 0
+RecoveryCompression        = 0
 EOF
 
 simple_test
@@ -0,0 +1,86 @@
+/*
+   compress tests
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "replace.h"
+#include "system/time.h"
+
+#include <assert.h>
+
+#include "common/compress.c"
+
+static void roundtrip(TALLOC_CTX *mem_ctx, TDB_DATA data, bool smaller)
+{
+	TDB_DATA comp, result;
+	int ret;
+
+	ret = ctdb_compress_data(mem_ctx, data, &comp);
+	assert(ret == 0);
+	if (smaller) {
+		assert(comp.dsize < data.dsize);
+	} else {
+		assert(comp.dsize == data.dsize + COMPRESS_HEADER_SIZE);
+	}
+
+	ret = ctdb_decompress_data(mem_ctx, comp, &result);
+	assert(ret == 0);
+	assert(result.dsize == data.dsize);
+	if (data.dsize > 0) {
+		assert(memcmp(result.dptr, data.dptr, data.dsize) == 0);
+	}
+
+	/* Truncated blob */
+	comp.dsize -= 1;
+	ret = ctdb_decompress_data(mem_ctx, comp, &result);
+	assert(ret != 0);
+}
+
+static void test1(void)
+{
+	TALLOC_CTX *mem_ctx;
+	uint8_t buf[64 * 1024];
+	size_t i;
+
+	mem_ctx = talloc_new(NULL);
+	assert(mem_ctx != NULL);
+
+	/* Empty data is sent as is */
+	roundtrip(mem_ctx, (TDB_DATA) { .dsize = 0 }, false);
+
+	/* Repetitive data compresses well */
+	for (i = 0; i < sizeof(buf); i++) {
+		buf[i] = "ctdb record"[i % 11];
+	}
+	roundtrip(mem_ctx, (TDB_DATA) { .dptr = buf, .dsize = sizeof(buf) },
+		  true);
+
+	/* Random data does not */
+	srandom(time(NULL));
+	for (i = 0; i < sizeof(buf); i++) {
+		buf[i] = random() & 0xff;
+	}
+	roundtrip(mem_ctx, (TDB_DATA) { .dptr = buf, .dsize = sizeof(buf) },
+		  false);
+
+	talloc_free(mem_ctx);
+}
+
+int main(void)
+{
+	test1();
+
+	return 0;
+}
@@ -19,10 +19,25 @@
 
 #include "replace.h"
 #include "system/filesys.h"
+#include "system/network.h"
 
 #include <assert.h>
+#include <sys/uio.h>
 
+#include "lib/util/blocking.h"
+
+/* Count the writev() calls made by the queue code */
+static unsigned int test_writev_calls;
+
+static ssize_t test_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	test_writev_calls++;
+	return writev(fd, iov, iovcnt);
+}
+
+#define writev test_writev
 #include "common/ctdb_io.c"
+#undef writev
 
 void ctdb_set_error(struct ctdb_context *ctdb, const char *fmt, ...)
 {
@@ -320,6 +335,56 @@ static void test4(void)
 	TALLOC_FREE(ctdb);
 }
 
+static void test5(void)
+{
+	struct ctdb_context *ctdb;
+	struct ctdb_queue *queue;
+	int sockfd[2], ret;
+	uint32_t pkt[3][8];
+	uint8_t buf[sizeof(pkt)];
+	size_t i;
+	ssize_t n;
+
+	ret = socketpair(AF_UNIX, SOCK_STREAM, 0, sockfd);
+	assert(ret == 0);
+	set_blocking(sockfd[0], false);
+
+	ctdb = talloc_zero(NULL, struct ctdb_context);
+	assert(ctdb != NULL);
+
+	ctdb->ev = tevent_context_init(NULL);
+	ctdb->tunable.queue_batch_writes = 1;
+
+	queue = ctdb_queue_setup(ctdb, ctdb, sockfd[0], 0, test_cb,
+				 NULL, "test queue");
+	assert(queue != NULL);
+
+	for (i = 0; i < ARRAY_SIZE(pkt); i++) {
+		memset(pkt[i], i, sizeof(pkt[i]));
+		pkt[i][0] = sizeof(pkt[i]);
+
+		ret = ctdb_queue_send(queue, (uint8_t *)pkt[i],
+				      sizeof(pkt[i]));
+		assert(ret == 0);
+	}
+
+	/* nothing written yet */
+	assert(ctdb_queue_length(queue) == ARRAY_SIZE(pkt));
+
+	/* all packets go out in one go */
+	test_writev_calls = 0;
+	tevent_loop_once(ctdb->ev);
+	assert(ctdb_queue_length(queue) == 0);
+	assert(test_writev_calls == 1);
+
+	n = read(sockfd[1], buf, sizeof(buf));
+	assert(n == sizeof(buf));
+	assert(memcmp(buf, pkt, sizeof(pkt)) == 0);
+
+	close(sockfd[1]);
+	TALLOC_FREE(ctdb);
+}
+
 int main(int argc, const char **argv)
 {
 	int num;
@@ -348,6 +413,10 @@ int main(int argc, const char **argv)
 		test4();
 		break;
 
+	case 5:
+		test5();
+		break;
+
 	default:
 		fprintf(stderr, "Unknown test number %s\n", argv[1]);
 	}
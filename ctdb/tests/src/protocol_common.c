@@ -148,6 +148,9 @@ void fill_ctdb_statistics(TALLOC_CTX *mem_ctx, struct ctdb_statistics *p)
 	fill_ctdb_timeval(&p->statistics_current_time);
 	p->total_ro_delegations = rand32();
 	p->total_ro_revokes = rand32();
+	p->total_hot_records = rand32();
+	p->total_hot_pindowns = rand32();
+	fill_ctdb_latency_counter(&p->recovery_latency);
 }
 
 void verify_ctdb_statistics(struct ctdb_statistics *p1,
@@ -214,6 +217,10 @@ void verify_ctdb_statistics(struct ctdb_statistics *p1,
 			    &p2->statistics_current_time);
 	assert(p1->total_ro_delegations == p2->total_ro_delegations);
 	assert(p1->total_ro_revokes == p2->total_ro_revokes);
+	assert(p1->total_hot_records == p2->total_hot_records);
+	assert(p1->total_hot_pindowns == p2->total_hot_pindowns);
+	verify_ctdb_latency_counter(&p1->recovery_latency,
+				    &p2->recovery_latency);
 }
 
 void fill_ctdb_vnn_map(TALLOC_CTX *mem_ctx, struct ctdb_vnn_map *p)
@@ -669,6 +676,11 @@ void fill_ctdb_tunable_list(TALLOC_CTX *mem_ctx, struct ctdb_tunable_list *p)
 	p->queue_buffer_size = rand32();
 	p->ip_alloc_algorithm = rand32();
 	p->allow_mixed_versions = rand32();
+	p->vacuum_traverse_chains = rand32();
+	p->vacuum_delete_queue_target = rand32();
+	p->hot_record_migrations = rand32();
+	p->queue_batch_writes = rand32();
+	p->recovery_compression = rand32();
 }
 
 void verify_ctdb_tunable_list(struct ctdb_tunable_list *p1,
@@ -736,6 +748,12 @@ void verify_ctdb_tunable_list(struct ctdb_tunable_list *p1,
 	assert(p1->queue_buffer_size == p2->queue_buffer_size);
 	assert(p1->ip_alloc_algorithm == p2->ip_alloc_algorithm);
 	assert(p1->allow_mixed_versions == p2->allow_mixed_versions);
+	assert(p1->vacuum_traverse_chains == p2->vacuum_traverse_chains);
+	assert(p1->vacuum_delete_queue_target ==
+	       p2->vacuum_delete_queue_target);
+	assert(p1->hot_record_migrations == p2->hot_record_migrations);
+	assert(p1->queue_batch_writes == p2->queue_batch_writes);
+	assert(p1->recovery_compression == p2->recovery_compression);
 }
 
 void fill_ctdb_tickle_list(TALLOC_CTX *mem_ctx, struct ctdb_tickle_list *p)
@@ -1093,6 +1111,8 @@ void fill_ctdb_db_statistics(TALLOC_CTX *mem_ctx,
 
 	p->db_ro_delegations = rand32();
 	p->db_ro_revokes = rand32();
+	p->db_hot_records = rand32();
+	p->db_hot_pindowns = rand32();
 	for (i=0; i<MAX_COUNT_BUCKETS; i++) {
 		p->hop_count_bucket[i] = rand32();
 	}
@@ -1122,6 +1142,8 @@ void verify_ctdb_db_statistics(struct ctdb_db_statistics *p1,
 
 	assert(p1->db_ro_delegations == p2->db_ro_delegations);
 	assert(p1->db_ro_revokes == p2->db_ro_revokes);
+	assert(p1->db_hot_records == p2->db_hot_records);
+	assert(p1->db_hot_pindowns == p2->db_hot_pindowns);
 	for (i=0; i<MAX_COUNT_BUCKETS; i++) {
 		assert(p1->hop_count_bucket[i] == p2->hop_count_bucket[i]);
 	}
@@ -539,6 +539,12 @@ void fill_ctdb_req_control_data(TALLOC_CTX *mem_ctx,
 		fill_ctdb_pulldb_ext(mem_ctx, cd->data.pulldb_ext);
 		break;
 
+	case CTDB_CONTROL_DB_PULL_COMPRESSED:
+		cd->data.pulldb_ext = talloc(mem_ctx, struct ctdb_pulldb_ext);
+		assert(cd->data.pulldb_ext != NULL);
+		fill_ctdb_pulldb_ext(mem_ctx, cd->data.pulldb_ext);
+		break;
+
 	case CTDB_CONTROL_DB_PUSH_START:
 		cd->data.pulldb_ext = talloc(mem_ctx, struct ctdb_pulldb_ext);
 		assert(cd->data.pulldb_ext != NULL);
@@ -953,6 +959,11 @@ void verify_ctdb_req_control_data(struct ctdb_req_control_data *cd,
 				       cd2->data.pulldb_ext);
 		break;
 
+	case CTDB_CONTROL_DB_PULL_COMPRESSED:
+		verify_ctdb_pulldb_ext(cd->data.pulldb_ext,
+				       cd2->data.pulldb_ext);
+		break;
+
 	case CTDB_CONTROL_DB_PUSH_START:
 		verify_ctdb_pulldb_ext(cd->data.pulldb_ext,
 				       cd2->data.pulldb_ext);
@@ -1366,6 +1377,10 @@ void fill_ctdb_reply_control_data(TALLOC_CTX *mem_ctx,
 		cd->data.num_records = rand32();
 		break;
 
+	case CTDB_CONTROL_DB_PULL_COMPRESSED:
+		cd->data.num_records = rand32();
+		break;
+
 	case CTDB_CONTROL_DB_PUSH_CONFIRM:
 		cd->data.num_records = rand32();
 		break;
@@ -1714,6 +1729,10 @@ void verify_ctdb_reply_control_data(struct ctdb_reply_control_data *cd,
 		assert(cd->data.num_records == cd2->data.num_records);
 		break;
 
+	case CTDB_CONTROL_DB_PULL_COMPRESSED:
+		assert(cd->data.num_records == cd2->data.num_records);
+		break;
+
 	case CTDB_CONTROL_DB_PUSH_CONFIRM:
 		assert(cd->data.num_records == cd2->data.num_records);
 		break;
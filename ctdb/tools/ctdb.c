@@ -1685,6 +1685,8 @@ const struct {
 	STATISTICS_FIELD(max_hop_count),
 	STATISTICS_FIELD(total_ro_delegations),
 	STATISTICS_FIELD(total_ro_revokes),
+	STATISTICS_FIELD(total_hot_records),
+	STATISTICS_FIELD(total_hot_pindowns),
 };
 
 #define LATENCY_AVG(v) ((v).num ? (v).total / (v).num : 0.0)
@@ -1725,6 +1727,11 @@ static void print_statistics_machine(struct ctdb_statistics *s,
 		printf("min_childwrite_latency%s", options.sep);
 		printf("avg_childwrite_latency%s", options.sep);
 		printf("max_childwrite_latency%s", options.sep);
+
+		printf("num_recovery_latency%s", options.sep);
+		printf("min_recovery_latency%s", options.sep);
+		printf("avg_recovery_latency%s", options.sep);
+		printf("max_recovery_latency%s", options.sep);
 		printf("\n");
 	}
 
@@ -1762,6 +1769,11 @@ static void print_statistics_machine(struct ctdb_statistics *s,
 	printf("%.6f%s", s->childwrite_latency.min, options.sep);
 	printf("%.6f%s", LATENCY_AVG(s->childwrite_latency), options.sep);
 	printf("%.6f%s", s->childwrite_latency.max, options.sep);
+
+	printf("%d%s", s->recovery_latency.num, options.sep);
+	printf("%.6f%s", s->recovery_latency.min, options.sep);
+	printf("%.6f%s", LATENCY_AVG(s->recovery_latency), options.sep);
+	printf("%.6f%s", s->recovery_latency.max, options.sep);
 	printf("\n");
 }
 
@@ -1860,6 +1872,13 @@ static void print_statistics(struct ctdb_statistics *s)
 	       LATENCY_AVG(s->childwrite_latency),
 	       s->childwrite_latency.max,
 	       s->childwrite_latency.num);
+
+	printf(" %-30s     %.6f/%.6f/%.6f sec out of %d\n",
+	       "recovery_latency   MIN/AVG/MAX",
+	       s->recovery_latency.min,
+	       LATENCY_AVG(s->recovery_latency),
+	       s->recovery_latency.max,
+	       s->recovery_latency.num);
 }
 
 static int control_statistics(TALLOC_CTX *mem_ctx,
@@ -6743,6 +6762,8 @@ const struct {
 #define DBSTATISTICS_FIELD(n) {#n, offsetof(struct ctdb_db_statistics, n)}
 	DBSTATISTICS_FIELD(db_ro_delegations),
 	DBSTATISTICS_FIELD(db_ro_revokes),
+	DBSTATISTICS_FIELD(db_hot_records),
+	DBSTATISTICS_FIELD(db_hot_pindowns),
 	DBSTATISTICS_FIELD(locks.num_calls),
 	DBSTATISTICS_FIELD(locks.num_current),
 	DBSTATISTICS_FIELD(locks.num_pending),
@@ -488,6 +488,84 @@ static int skel_fstatat(
 	return SMB_VFS_NEXT_FSTATAT(handle, dirfsp, smb_fname, sbuf, flags);
 }
 
+struct skel_fstatat_state {
+	struct vfs_aio_state aio_state;
+	int ret;
+	SMB_STRUCT_STAT sbuf;
+};
+
+static void skel_fstatat_done(struct tevent_req *subreq);
+
+static struct tevent_req *skel_fstatat_send(
+			TALLOC_CTX *mem_ctx,
+			struct tevent_context *ev,
+			struct vfs_handle_struct *handle,
+			files_struct *dirfsp,
+			const struct smb_filename *smb_fname,
+			int flags)
+{
+	struct tevent_req *req = NULL;
+	struct skel_fstatat_state *state = NULL;
+	struct tevent_req *subreq = NULL;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct skel_fstatat_state);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	subreq = SMB_VFS_NEXT_FSTATAT_SEND(state,
+					   ev,
+					   handle,
+					   dirfsp,
+					   smb_fname,
+					   flags);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, skel_fstatat_done, req);
+
+	return req;
+}
+
+static void skel_fstatat_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct skel_fstatat_state *state = tevent_req_data(
+		req, struct skel_fstatat_state);
+
+	state->ret = SMB_VFS_NEXT_FSTATAT_RECV(subreq,
+					       &state->aio_state,
+					       &state->sbuf);
+	TALLOC_FREE(subreq);
+	if (state->ret == -1) {
+		tevent_req_error(req, state->aio_state.error);
+		return;
+	}
+
+	tevent_req_done(req);
+}
+
+static int skel_fstatat_recv(struct tevent_req *req,
+			     struct vfs_aio_state *aio_state,
+			     SMB_STRUCT_STAT *sbuf)
+{
+	struct skel_fstatat_state *state = tevent_req_data(
+		req, struct skel_fstatat_state);
+
+	if (tevent_req_is_unix_error(req, &aio_state->error)) {
+		tevent_req_received(req);
+		return -1;
+	}
+
+	*aio_state = state->aio_state;
+	*sbuf = state->sbuf;
+
+	tevent_req_received(req);
+	return 0;
+}
+
 static uint64_t skel_get_alloc_size(struct vfs_handle_struct *handle,
 				    struct files_struct *fsp,
 				    const SMB_STRUCT_STAT *sbuf)
@@ -1307,6 +1385,8 @@ static struct vfs_fn_pointers skel_transparent_fns = {
 	.fstat_fn = skel_fstat,
 	.lstat_fn = skel_lstat,
 	.fstatat_fn = skel_fstatat,
+	.fstatat_send_fn = skel_fstatat_send,
+	.fstatat_recv_fn = skel_fstatat_recv,
 	.get_alloc_size_fn = skel_get_alloc_size,
 	.unlinkat_fn = skel_unlinkat,
 	.fchmod_fn = skel_fchmod,
@@ -445,6 +445,30 @@ NTSTATUS dbwrap_traverse_read(struct db_context *db,
 	return NT_STATUS_OK;
 }
 
+NTSTATUS dbwrap_traverse_read_parallel(struct db_context *db,
+				       unsigned num_threads,
+				       int (*f)(struct db_record*, void*),
+				       void *private_data,
+				       int *count)
+{
+	int ret;
+
+	if (db->traverse_read_parallel == NULL) {
+		return dbwrap_traverse_read(db, f, private_data, count);
+	}
+
+	ret = db->traverse_read_parallel(db, num_threads, f, private_data);
+	if (ret < 0) {
+		return NT_STATUS_INTERNAL_DB_CORRUPTION;
+	}
+
+	if (count != NULL) {
+		*count = ret;
+	}
+
+	return NT_STATUS_OK;
+}
+
 static void dbwrap_null_parser(TDB_DATA key, TDB_DATA val, void* data)
 {
 	return;
@@ -571,6 +595,146 @@ NTSTATUS dbwrap_parse_record_recv(struct tevent_req *req)
 	return tevent_req_simple_recv_ntstatus(req);
 }
 
+struct dbwrap_parse_records_state {
+	struct db_context *db;
+	void (*parser)(size_t idx,
+		       TDB_DATA key,
+		       TDB_DATA data,
+		       void *private_data);
+	void *private_data;
+	size_t idx;
+};
+
+static void dbwrap_parse_records_parser(TDB_DATA key, TDB_DATA data,
+					void *private_data)
+{
+	struct dbwrap_parse_records_state *state = private_data;
+	state->parser(state->idx, key, data, state->private_data);
+}
+
+static void dbwrap_parse_records_done(struct tevent_req *subreq);
+
+struct tevent_req *dbwrap_parse_records_send(
+	TALLOC_CTX *mem_ctx,
+	struct tevent_context *ev,
+	struct db_context *db,
+	const TDB_DATA *keys,
+	size_t num_keys,
+	void (*parser)(size_t idx,
+		       TDB_DATA key,
+		       TDB_DATA data,
+		       void *private_data),
+	void *private_data)
+{
+	struct tevent_req *req = NULL;
+	struct tevent_req *subreq = NULL;
+	struct dbwrap_parse_records_state *state = NULL;
+	TDB_DATA *keys_copy = NULL;
+	uint8_t *buf = NULL;
+	size_t i, buflen;
+	NTSTATUS status;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct dbwrap_parse_records_state);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	*state = (struct dbwrap_parse_records_state) {
+		.db = db,
+		.parser = parser,
+		.private_data = private_data,
+	};
+
+	if (db->parse_records_send == NULL) {
+		/*
+		 * Backend doesn't batch, go through the sync parse_record
+		 */
+		for (i=0; i<num_keys; i++) {
+			state->idx = i;
+			status = db->parse_record(db,
+						  keys[i],
+						  dbwrap_parse_records_parser,
+						  state);
+			if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+				continue;
+			}
+			if (tevent_req_nterror(req, status)) {
+				return tevent_req_post(req, ev);
+			}
+		}
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
+
+	/*
+	 * Like dbwrap_parse_record_send(), copy the keys so that the
+	 * backend can rely on them for the lifetime of the request.
+	 */
+	buflen = 0;
+	for (i=0; i<num_keys; i++) {
+		size_t tmp = buflen + keys[i].dsize;
+		if (tmp < buflen) {
+			tevent_req_nterror(req, NT_STATUS_INVALID_PARAMETER);
+			return tevent_req_post(req, ev);
+		}
+		buflen = tmp;
+	}
+
+	keys_copy = talloc_array(state, TDB_DATA, num_keys);
+	if (tevent_req_nomem(keys_copy, req)) {
+		return tevent_req_post(req, ev);
+	}
+	buf = talloc_size(keys_copy, buflen);
+	if ((buflen != 0) && tevent_req_nomem(buf, req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	for (i=0; i<num_keys; i++) {
+		if (keys[i].dsize != 0) {
+			memcpy(buf, keys[i].dptr, keys[i].dsize);
+		}
+		keys_copy[i] = (TDB_DATA) {
+			.dptr = buf, .dsize = keys[i].dsize,
+		};
+		buf += keys[i].dsize;
+	}
+
+	subreq = db->parse_records_send(state,
+					ev,
+					db,
+					keys_copy,
+					num_keys,
+					parser,
+					private_data);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, dbwrap_parse_records_done, req);
+	return req;
+}
+
+static void dbwrap_parse_records_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct dbwrap_parse_records_state *state = tevent_req_data(
+		req, struct dbwrap_parse_records_state);
+	NTSTATUS status;
+
+	status = state->db->parse_records_recv(subreq);
+	TALLOC_FREE(subreq);
+	if (tevent_req_nterror(req, status)) {
+		return;
+	}
+	tevent_req_done(req);
+}
+
+NTSTATUS dbwrap_parse_records_recv(struct tevent_req *req)
+{
+	return tevent_req_simple_recv_ntstatus(req);
+}
+
 NTSTATUS dbwrap_do_locked(struct db_context *db, TDB_DATA key,
 			  void (*fn)(struct db_record *rec,
 				     TDB_DATA value,
@@ -114,6 +114,16 @@ NTSTATUS dbwrap_traverse_read(struct db_context *db,
 			      int (*f)(struct db_record*, void*),
 			      void *private_data,
 			      int *count);
+/**
+ * Like dbwrap_traverse_read(), but let up to num_threads threads read
+ * the database. f is still called serially from the calling
+ * thread. Backends that can't do this fall back to traverse_read.
+ */
+NTSTATUS dbwrap_traverse_read_parallel(struct db_context *db,
+				       unsigned num_threads,
+				       int (*f)(struct db_record*, void*),
+				       void *private_data,
+				       int *count);
 NTSTATUS dbwrap_parse_record(struct db_context *db, TDB_DATA key,
 			     void (*parser)(TDB_DATA key, TDB_DATA data,
 					    void *private_data),
@@ -150,6 +160,40 @@ struct tevent_req *dbwrap_parse_record_send(
 	void *private_data,
 	enum dbwrap_req_state *req_state);
 NTSTATUS dbwrap_parse_record_recv(struct tevent_req *req);
+/**
+ * Parse a batch of records
+ *
+ * @param[in]  mem_ctx      talloc memory context to use.
+ *
+ * @param[in]  ev           tevent context to use
+ *
+ * @param[in]  db           Database to query
+ *
+ * @param[in]  keys         Record keys, the function makes a copy of them
+ *
+ * @param[in]  num_keys     Number of keys
+ *
+ * @param[in]  parser       Parser callback function, called with the index
+ *                          into keys for every record found
+ *
+ * @param[in]  private_data Private data for the callback function
+ *
+ * @note Records that don't exist don't fail the request, the parser is
+ * just not called for them. Backends like ctdb send all lookups that
+ * can't be served locally in one go instead of one round trip per key.
+ **/
+struct tevent_req *dbwrap_parse_records_send(
+	TALLOC_CTX *mem_ctx,
+	struct tevent_context *ev,
+	struct db_context *db,
+	const TDB_DATA *keys,
+	size_t num_keys,
+	void (*parser)(size_t idx,
+		       TDB_DATA key,
+		       TDB_DATA data,
+		       void *private_data),
+	void *private_data);
+NTSTATUS dbwrap_parse_records_recv(struct tevent_req *req);
 int dbwrap_wipe(struct db_context *db);
 int dbwrap_check(struct db_context *db);
 int dbwrap_get_seqnum(struct db_context *db);
@@ -0,0 +1,700 @@
+/*
+   Unix SMB/CIFS implementation.
+   Database interface wrapper around a sharded in-memory hash table
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "includes.h"
+#include "dbwrap/dbwrap.h"
+#include "dbwrap/dbwrap_private.h"
+#include "dbwrap/dbwrap_hash.h"
+#include "../lib/util/dlinklist.h"
+
+#define DBWRAP_HASH_ALIGN(_size_) (((_size_)+15)&~15)
+
+/*
+ * The top bits of the hash select the shard, the bottom bits the
+ * slot within the shard. Every shard is an open addressing table
+ * with linear probing that grows on its own, so growing never has to
+ * rehash more than a fraction of the database at once. The records
+ * of a shard are talloc children of the shard.
+ */
+#define DBWRAP_HASH_SHARD_BITS 4
+#define DBWRAP_HASH_NUM_SHARDS (1U<<DBWRAP_HASH_SHARD_BITS)
+#define DBWRAP_HASH_MIN_SLOTS 16
+
+struct db_hash_node {
+	struct db_hash_node *prev, *next;
+	uint32_t hash;
+	size_t keysize, valuesize;
+};
+
+struct db_hash_slot {
+	uint32_t hash;
+	struct db_hash_node *node;
+};
+
+struct db_hash_shard {
+	struct db_hash_slot *slots;
+	uint32_t num_slots;
+	uint32_t num_used;
+};
+
+struct db_hash_ctx {
+	struct db_hash_shard *shards[DBWRAP_HASH_NUM_SHARDS];
+	struct db_hash_node *nodes;
+	size_t traverse_read;
+	struct db_hash_node **traverse_nextp;
+};
+
+struct db_hash_rec {
+	struct db_hash_node *node;
+	uint32_t hash;
+};
+
+static struct db_hash_ctx *db_hash_ctx_create(TALLOC_CTX *mem_ctx)
+{
+	struct db_hash_ctx *ctx = NULL;
+	size_t i;
+
+	ctx = talloc_zero(mem_ctx, struct db_hash_ctx);
+	if (ctx == NULL) {
+		return NULL;
+	}
+	for (i=0; i<DBWRAP_HASH_NUM_SHARDS; i++) {
+		ctx->shards[i] = talloc_zero(ctx, struct db_hash_shard);
+		if (ctx->shards[i] == NULL) {
+			TALLOC_FREE(ctx);
+			return NULL;
+		}
+	}
+	return ctx;
+}
+
+static uint32_t db_hash_key(TDB_DATA key)
+{
+	return tdb_jenkins_hash(&key);
+}
+
+static struct db_hash_shard *db_hash_get_shard(struct db_hash_ctx *ctx,
+					       uint32_t hash)
+{
+	return ctx->shards[hash >> (32 - DBWRAP_HASH_SHARD_BITS)];
+}
+
+/*
+ * dissect a db_hash_node into its implicit key and value parts
+ */
+
+static void db_hash_parse_node(struct db_hash_node *node,
+			       TDB_DATA *key, TDB_DATA *value)
+{
+	size_t key_offset, value_offset;
+
+	key_offset = DBWRAP_HASH_ALIGN(sizeof(struct db_hash_node));
+	key->dptr = ((uint8_t *)node) + key_offset;
+	key->dsize = node->keysize;
+
+	value_offset = DBWRAP_HASH_ALIGN(node->keysize);
+	value->dptr = key->dptr + value_offset;
+	value->dsize = node->valuesize;
+}
+
+static ssize_t db_hash_reclen(size_t keylen, size_t valuelen)
+{
+	size_t len, tmp;
+
+	len = DBWRAP_HASH_ALIGN(sizeof(struct db_hash_node));
+
+	tmp = DBWRAP_HASH_ALIGN(keylen);
+	if (tmp < keylen) {
+		goto overflow;
+	}
+
+	len += tmp;
+	if (len < tmp) {
+		goto overflow;
+	}
+
+	len += valuelen;
+	if (len < valuelen) {
+		goto overflow;
+	}
+
+	return len;
+overflow:
+	return -1;
+}
+
+static bool db_hash_find(struct db_hash_shard *shard, TDB_DATA key,
+			 uint32_t hash, uint32_t *pidx)
+{
+	uint32_t mask = shard->num_slots - 1;
+	uint32_t i;
+
+	if (shard->num_slots == 0) {
+		return false;
+	}
+
+	for (i = hash & mask;
+	     shard->slots[i].node != NULL;
+	     i = (i + 1) & mask) {
+		struct db_hash_slot *slot = &shard->slots[i];
+		TDB_DATA this_key, this_val;
+
+		if (slot->hash != hash) {
+			continue;
+		}
+		db_hash_parse_node(slot->node, &this_key, &this_val);
+
+		if ((this_key.dsize == key.dsize) &&
+		    (memcmp(this_key.dptr, key.dptr, key.dsize) == 0)) {
+			*pidx = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint32_t db_hash_node_idx(struct db_hash_shard *shard,
+				 struct db_hash_node *node)
+{
+	uint32_t mask = shard->num_slots - 1;
+	uint32_t i;
+
+	for (i = node->hash & mask;
+	     shard->slots[i].node != NULL;
+	     i = (i + 1) & mask) {
+		if (shard->slots[i].node == node) {
+			return i;
+		}
+	}
+	smb_panic("dbwrap_hash: node not in its shard");
+	return 0;
+}
+
+static void db_hash_link(struct db_hash_slot *slots, uint32_t num_slots,
+			 struct db_hash_slot slot)
+{
+	uint32_t mask = num_slots - 1;
+	uint32_t i;
+
+	for (i = slot.hash & mask;
+	     slots[i].node != NULL;
+	     i = (i + 1) & mask) {
+		;
+	}
+	slots[i] = slot;
+}
+
+static bool db_hash_insert(struct db_hash_shard *shard,
+			   struct db_hash_node *node)
+{
+	struct db_hash_slot slot = { .hash = node->hash, .node = node };
+
+	/*
+	 * Keep the load factor below 3/4, linear probing degrades
+	 * quickly beyond that
+	 */
+	if ((shard->num_used + 1) * 4 > shard->num_slots * 3) {
+		struct db_hash_slot *slots = NULL;
+		uint32_t num_slots;
+		uint32_t i;
+
+		num_slots = MAX(shard->num_slots * 2, DBWRAP_HASH_MIN_SLOTS);
+		if (num_slots <= shard->num_slots) {
+			return false;
+		}
+
+		slots = talloc_zero_array(shard,
+					  struct db_hash_slot,
+					  num_slots);
+		if (slots == NULL) {
+			return false;
+		}
+		for (i=0; i<shard->num_slots; i++) {
+			if (shard->slots[i].node != NULL) {
+				db_hash_link(slots, num_slots,
+					     shard->slots[i]);
+			}
+		}
+		TALLOC_FREE(shard->slots);
+		shard->slots = slots;
+		shard->num_slots = num_slots;
+	}
+
+	db_hash_link(shard->slots, shard->num_slots, slot);
+	shard->num_used += 1;
+	return true;
+}
+
+/*
+ * Remove a slot and move up the ones behind it that would otherwise
+ * not be found anymore. This avoids tombstones.
+ */
+static void db_hash_remove(struct db_hash_shard *shard, uint32_t idx)
+{
+	uint32_t mask = shard->num_slots - 1;
+	uint32_t i = idx;
+	uint32_t j = idx;
+
+	shard->slots[i] = (struct db_hash_slot) { .node = NULL };
+
+	while (true) {
+		uint32_t home;
+		bool in_place;
+
+		j = (j + 1) & mask;
+
+		if (shard->slots[j].node == NULL) {
+			break;
+		}
+
+		home = shard->slots[j].hash & mask;
+
+		/*
+		 * Slot j can stay if its home is cyclically in (i, j]
+		 */
+		if (i <= j) {
+			in_place = (i < home) && (home <= j);
+		} else {
+			in_place = (i < home) || (home <= j);
+		}
+		if (in_place) {
+			continue;
+		}
+
+		shard->slots[i] = shard->slots[j];
+		shard->slots[j] = (struct db_hash_slot) { .node = NULL };
+		i = j;
+	}
+
+	shard->num_used -= 1;
+}
+
+static NTSTATUS db_hash_storev(struct db_record *rec,
+			       const TDB_DATA *dbufs, int num_dbufs, int flag)
+{
+	struct db_hash_ctx *db_ctx = talloc_get_type_abort(
+		rec->db->private_data, struct db_hash_ctx);
+	struct db_hash_rec *rec_priv = (struct db_hash_rec *)rec->private_data;
+	struct db_hash_shard *shard = db_hash_get_shard(db_ctx, rec_priv->hash);
+	struct db_hash_node *node = NULL;
+	ssize_t reclen;
+	TDB_DATA data, this_key, this_val;
+	void *to_free = NULL;
+	bool ok;
+
+	if (db_ctx->traverse_read > 0) {
+		return NT_STATUS_MEDIA_WRITE_PROTECTED;
+	}
+
+	if ((flag == TDB_INSERT) && (rec_priv->node != NULL)) {
+		return NT_STATUS_OBJECT_NAME_COLLISION;
+	}
+
+	if ((flag == TDB_MODIFY) && (rec_priv->node == NULL)) {
+		return NT_STATUS_OBJECT_NAME_NOT_FOUND;
+	}
+
+	if (num_dbufs == 1) {
+		data = dbufs[0];
+	} else {
+		NTSTATUS status;
+
+		data = (TDB_DATA) {0};
+		status = dbwrap_merge_dbufs(&data, rec, dbufs, num_dbufs);
+		if (!NT_STATUS_IS_OK(status)) {
+			return status;
+		}
+		to_free = data.dptr;
+	}
+
+	if (rec_priv->node != NULL) {
+
+		/*
+		 * The record was around previously
+		 */
+
+		db_hash_parse_node(rec_priv->node, &this_key, &this_val);
+
+		if (this_val.dsize >= data.dsize) {
+			/*
+			 * The new value fits into the old space
+			 */
+			memcpy(this_val.dptr, data.dptr, data.dsize);
+			rec_priv->node->valuesize = data.dsize;
+			TALLOC_FREE(to_free);
+			return NT_STATUS_OK;
+		}
+	}
+
+	reclen = db_hash_reclen(rec->key.dsize, data.dsize);
+	if (reclen == -1) {
+		TALLOC_FREE(to_free);
+		return NT_STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	node = talloc_size(shard, reclen);
+	if (node == NULL) {
+		TALLOC_FREE(to_free);
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	*node = (struct db_hash_node) {
+		.hash = rec_priv->hash,
+		.keysize = rec->key.dsize,
+		.valuesize = data.dsize,
+	};
+
+	db_hash_parse_node(node, &this_key, &this_val);
+
+	memcpy(this_key.dptr, rec->key.dptr, node->keysize);
+	if (node->valuesize > 0) {
+		memcpy(this_val.dptr, data.dptr, node->valuesize);
+	}
+	TALLOC_FREE(to_free);
+
+	if (rec_priv->node != NULL) {
+		struct db_hash_node *old = rec_priv->node;
+		uint32_t idx = db_hash_node_idx(shard, old);
+
+		/*
+		 * Not enough space in the existing record, replace it
+		 * in place
+		 */
+		shard->slots[idx].node = node;
+
+		DLIST_ADD_AFTER(db_ctx->nodes, node, old);
+		DLIST_REMOVE(db_ctx->nodes, old);
+
+		if (db_ctx->traverse_nextp != NULL) {
+			if (*db_ctx->traverse_nextp == old) {
+				*db_ctx->traverse_nextp = node;
+			}
+		}
+
+		TALLOC_FREE(old);
+		rec_priv->node = node;
+		rec->key = this_key;
+		return NT_STATUS_OK;
+	}
+
+	ok = db_hash_insert(shard, node);
+	if (!ok) {
+		TALLOC_FREE(node);
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	DLIST_ADD_END(db_ctx->nodes, node);
+	rec_priv->node = node;
+
+	return NT_STATUS_OK;
+}
+
+static NTSTATUS db_hash_delete(struct db_record *rec)
+{
+	struct db_hash_ctx *db_ctx = talloc_get_type_abort(
+		rec->db->private_data, struct db_hash_ctx);
+	struct db_hash_rec *rec_priv = (struct db_hash_rec *)rec->private_data;
+	struct db_hash_shard *shard = db_hash_get_shard(db_ctx, rec_priv->hash);
+	uint32_t idx;
+
+	if (db_ctx->traverse_read > 0) {
+		return NT_STATUS_MEDIA_WRITE_PROTECTED;
+	}
+
+	if (rec_priv->node == NULL) {
+		return NT_STATUS_OK;
+	}
+
+	if (db_ctx->traverse_nextp != NULL) {
+		if (*db_ctx->traverse_nextp == rec_priv->node) {
+			*db_ctx->traverse_nextp = rec_priv->node->next;
+		}
+	}
+
+	idx = db_hash_node_idx(shard, rec_priv->node);
+	db_hash_remove(shard, idx);
+	DLIST_REMOVE(db_ctx->nodes, rec_priv->node);
+	TALLOC_FREE(rec_priv->node);
+
+	return NT_STATUS_OK;
+}
+
+static struct db_hash_node *db_hash_search(struct db_context *db,
+					   TDB_DATA key,
+					   uint32_t hash)
+{
+	struct db_hash_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_hash_ctx);
+	struct db_hash_shard *shard = db_hash_get_shard(ctx, hash);
+	uint32_t idx;
+	bool found;
+
+	found = db_hash_find(shard, key, hash, &idx);
+	if (!found) {
+		return NULL;
+	}
+	return shard->slots[idx].node;
+}
+
+static struct db_record *db_hash_fetch_locked(struct db_context *db_ctx,
+					      TALLOC_CTX *mem_ctx,
+					      TDB_DATA key)
+{
+	struct db_hash_rec *rec_priv;
+	struct db_record *result;
+	struct db_hash_node *node;
+	uint32_t hash;
+	size_t size;
+
+	hash = db_hash_key(key);
+	node = db_hash_search(db_ctx, key, hash);
+
+	/*
+	 * Like db_rbt_fetch_locked(), one talloc for the record, its
+	 * private data and a key that is not in the table yet
+	 */
+
+	size = DBWRAP_HASH_ALIGN(sizeof(struct db_record))
+		+ sizeof(struct db_hash_rec);
+
+	if (node == NULL) {
+		size += key.dsize;
+	}
+
+	result = (struct db_record *)talloc_size(mem_ctx, size);
+	if (result == NULL) {
+		return NULL;
+	}
+
+	rec_priv = (struct db_hash_rec *)
+		((char *)result + DBWRAP_HASH_ALIGN(sizeof(struct db_record)));
+
+	*result = (struct db_record) {
+		.db = db_ctx,
+		.storev = db_hash_storev,
+		.delete_rec = db_hash_delete,
+		.private_data = rec_priv,
+		.value_valid = true,
+	};
+	*rec_priv = (struct db_hash_rec) {
+		.node = node,
+		.hash = hash,
+	};
+
+	if (node != NULL) {
+		db_hash_parse_node(node, &result->key, &result->value);
+	} else {
+		result->key.dptr = (uint8_t *)
+			((char *)rec_priv + sizeof(*rec_priv));
+		result->key.dsize = key.dsize;
+		memcpy(result->key.dptr, key.dptr, key.dsize);
+	}
+
+	return result;
+}
+
+static int db_hash_exists(struct db_context *db, TDB_DATA key)
+{
+	return (db_hash_search(db, key, db_hash_key(key)) != NULL);
+}
+
+static int db_hash_wipe(struct db_context *db)
+{
+	struct db_hash_ctx *old_ctx = talloc_get_type_abort(
+		db->private_data, struct db_hash_ctx);
+	struct db_hash_ctx *new_ctx = db_hash_ctx_create(db);
+	if (new_ctx == NULL) {
+		return -1;
+	}
+	db->private_data = new_ctx;
+	talloc_free(old_ctx);
+	return 0;
+}
+
+static NTSTATUS db_hash_parse_record(struct db_context *db, TDB_DATA key,
+				     void (*parser)(TDB_DATA key,
+						    TDB_DATA data,
+						    void *private_data),
+				     void *private_data)
+{
+	struct db_hash_node *node = NULL;
+	TDB_DATA this_key, this_val;
+
+	node = db_hash_search(db, key, db_hash_key(key));
+	if (node == NULL) {
+		return NT_STATUS_NOT_FOUND;
+	}
+	db_hash_parse_node(node, &this_key, &this_val);
+	parser(this_key, this_val, private_data);
+	return NT_STATUS_OK;
+}
+
+static int db_hash_traverse_internal(struct db_context *db,
+				     int (*f)(struct db_record *db,
+					      void *private_data),
+				     void *private_data, uint32_t* count,
+				     bool rw)
+{
+	struct db_hash_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_hash_ctx);
+	struct db_hash_node *cur = NULL;
+	struct db_hash_node *next = NULL;
+	int ret;
+
+	for (cur = ctx->nodes; cur != NULL; cur = next) {
+		struct db_record rec;
+		struct db_hash_rec rec_priv;
+
+		rec_priv.node = cur;
+		rec_priv.hash = cur->hash;
+		next = rec_priv.node->next;
+
+		ZERO_STRUCT(rec);
+		rec.db = db;
+		rec.private_data = &rec_priv;
+		rec.storev = db_hash_storev;
+		rec.delete_rec = db_hash_delete;
+		db_hash_parse_node(rec_priv.node, &rec.key, &rec.value);
+		rec.value_valid = true;
+
+		if (rw) {
+			ctx->traverse_nextp = &next;
+		}
+		ret = f(&rec, private_data);
+		(*count) ++;
+		if (rw) {
+			ctx->traverse_nextp = NULL;
+		}
+		if (ret != 0) {
+			return ret;
+		}
+		if (rec_priv.node != NULL) {
+			next = rec_priv.node->next;
+		}
+	}
+
+	return 0;
+}
+
+static int db_hash_traverse_read(struct db_context *db,
+				 int (*f)(struct db_record *db,
+					  void *private_data),
+				 void *private_data)
+{
+	struct db_hash_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_hash_ctx);
+	uint32_t count = 0;
+	int ret;
+
+	ctx->traverse_read++;
+	ret = db_hash_traverse_internal(db,
+					f, private_data, &count,
+					false /* rw */);
+	ctx->traverse_read--;
+	if (ret != 0) {
+		return -1;
+	}
+	if (count > INT_MAX) {
+		return -1;
+	}
+	return count;
+}
+
+static int db_hash_traverse(struct db_context *db,
+			    int (*f)(struct db_record *db,
+				     void *private_data),
+			    void *private_data)
+{
+	struct db_hash_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_hash_ctx);
+	uint32_t count = 0;
+	int ret;
+
+	if (ctx->traverse_nextp != NULL) {
+		return -1;
+	};
+
+	if (ctx->traverse_read > 0) {
+		return db_hash_traverse_read(db, f, private_data);
+	}
+
+	ret = db_hash_traverse_internal(db,
+					f, private_data, &count,
+					true /* rw */);
+	if (ret != 0) {
+		return -1;
+	}
+	if (count > INT_MAX) {
+		return -1;
+	}
+	return count;
+}
+
+static int db_hash_get_seqnum(struct db_context *db)
+{
+	return 0;
+}
+
+static int db_hash_trans_dummy(struct db_context *db)
+{
+	/*
+	 * Transactions are pretty pointless in-memory, just return success.
+	 */
+	return 0;
+}
+
+static size_t db_hash_id(struct db_context *db, uint8_t *id, size_t idlen)
+{
+	if (idlen >= sizeof(struct db_context *)) {
+		memcpy(id, &db, sizeof(struct db_context *));
+	}
+	return sizeof(struct db_context *);
+}
+
+struct db_context *db_open_hash(TALLOC_CTX *mem_ctx)
+{
+	struct db_context *result;
+
+	result = talloc_zero(mem_ctx, struct db_context);
+
+	if (result == NULL) {
+		return NULL;
+	}
+
+	result->private_data = db_hash_ctx_create(result);
+
+	if (result->private_data == NULL) {
+		TALLOC_FREE(result);
+		return NULL;
+	}
+
+	result->fetch_locked = db_hash_fetch_locked;
+	result->traverse = db_hash_traverse;
+	result->traverse_read = db_hash_traverse_read;
+	result->get_seqnum = db_hash_get_seqnum;
+	result->transaction_start = db_hash_trans_dummy;
+	result->transaction_commit = db_hash_trans_dummy;
+	result->transaction_cancel = db_hash_trans_dummy;
+	result->exists = db_hash_exists;
+	result->wipe = db_hash_wipe;
+	result->parse_record = db_hash_parse_record;
+	result->id = db_hash_id;
+	result->name = "dbwrap hash";
+
+	return result;
+}
@@ -48,6 +48,11 @@ struct db_context {
 			     int (*f)(struct db_record *rec,
 				      void *private_data),
 			     void *private_data);
+	int (*traverse_read_parallel)(struct db_context *db,
+				      unsigned num_threads,
+				      int (*f)(struct db_record *rec,
+					       void *private_data),
+				      void *private_data);
 	int (*get_seqnum)(struct db_context *db);
 	int (*transaction_start)(struct db_context *db);
 	NTSTATUS (*transaction_start_nonblock)(struct db_context *db);
@@ -66,6 +71,18 @@ struct db_context {
 		void *private_data,
 		enum dbwrap_req_state *req_state);
 	NTSTATUS (*parse_record_recv)(struct tevent_req *req);
+	struct tevent_req *(*parse_records_send)(
+		TALLOC_CTX *mem_ctx,
+		struct tevent_context *ev,
+		struct db_context *db,
+		const TDB_DATA *keys,
+		size_t num_keys,
+		void (*parser)(size_t idx,
+			       TDB_DATA key,
+			       TDB_DATA data,
+			       void *private_data),
+		void *private_data);
+	NTSTATUS (*parse_records_recv)(struct tevent_req *req);
 	NTSTATUS (*do_locked)(struct db_context *db, TDB_DATA key,
 			      void (*fn)(struct db_record *rec,
 					 TDB_DATA value,
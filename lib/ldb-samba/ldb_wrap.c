@@ -220,12 +220,50 @@ int samba_ldb_connect(struct ldb_context *ldb, struct loadparm_context *lp_ctx,
 {
 	int ret;
 	char *real_url = NULL;
+	char *search_threads = NULL;
+	char *index_segment_size = NULL;
+	const char *options[] = { NULL, NULL, NULL };
+	size_t num_options = 0;
+	int num_threads;
+	int segment_size;
 
 	/* allow admins to force non-sync ldb for all databases */
 	if (lpcfg_parm_bool(lp_ctx, NULL, "ldb", "nosync", false)) {
 		flags |= LDB_FLG_NOSYNC;
 	}
 
+	/*
+	 * Fetch the records of large indexed searches in worker
+	 * threads, only the lmdb backend supports this.
+	 */
+	num_threads = lpcfg_parm_int(lp_ctx, NULL, "ldb", "search threads", 0);
+	if (num_threads > 1) {
+		search_threads = talloc_asprintf(ldb, "search_threads:%d",
+						 num_threads);
+		if (search_threads == NULL) {
+			return LDB_ERR_OPERATIONS_ERROR;
+		}
+		options[num_options++] = search_threads;
+	}
+
+	/*
+	 * Split large GUID index records into segments of about this
+	 * many entries.  This changes the on-disk format of those
+	 * records, older versions cannot read them.
+	 */
+	segment_size = lpcfg_parm_int(lp_ctx, NULL, "ldb",
+				      "index segment size", 0);
+	if (segment_size > 0) {
+		index_segment_size = talloc_asprintf(ldb,
+						     "index_segment_size:%d",
+						     segment_size);
+		if (index_segment_size == NULL) {
+			TALLOC_FREE(search_threads);
+			return LDB_ERR_OPERATIONS_ERROR;
+		}
+		options[num_options++] = index_segment_size;
+	}
+
 	if (DEBUGLVL(10)) {
 		flags |= LDB_FLG_ENABLE_TRACING;
 	}
@@ -235,7 +273,9 @@ int samba_ldb_connect(struct ldb_context *ldb, struct loadparm_context *lp_ctx,
 		return LDB_ERR_OPERATIONS_ERROR;
 	}
 
-	ret = ldb_connect(ldb, real_url, flags, NULL);
+	ret = ldb_connect(ldb, real_url, flags, options);
+	TALLOC_FREE(search_threads);
+	TALLOC_FREE(index_segment_size);
 
 	if (ret != LDB_SUCCESS) {
 		return ret;
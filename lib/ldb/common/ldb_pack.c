@@ -750,6 +750,11 @@ static int ldb_unpack_data_flags_v1(struct ldb_context *ldb,
 					   message->num_elements);
 
 	if (remaining != 0) {
+		if (flags & LDB_UNPACK_DATA_FLAG_NO_DEBUG) {
+			/* Let the caller retry and report it */
+			errno = EIO;
+			goto failed;
+		}
 		ldb_debug(ldb, LDB_DEBUG_ERROR,
 			  "Error: %zu bytes unread in ldb_unpack_data_flags",
 			  remaining);
@@ -762,13 +767,58 @@ failed:
 	return -1;
 }
 
+/*
+ * Skip over the value lengths of an element we are not going to
+ * return, advancing q past its values.  Nothing is allocated.
+ */
+static int ldb_unpack_skip_values_v2(uint8_t **_p,
+				     uint8_t **_q,
+				     uint8_t *end_p,
+				     unsigned int num_values,
+				     uint8_t val_len_width)
+{
+	uint8_t *p = *_p;
+	uint8_t *q = *_q;
+	unsigned int j;
+	size_t len;
+
+	for (j = 0; j < num_values; j++) {
+		if (val_len_width == U8_LEN) {
+			len = PULL_LE_U8(p, 0);
+		} else if (val_len_width == U16_LEN) {
+			len = PULL_LE_U16(p, 0);
+		} else if (val_len_width == U32_LEN) {
+			len = PULL_LE_U32(p, 0);
+		} else {
+			return ERANGE;
+		}
+		p += val_len_width;
+
+		if (len + NULL_PAD_BYTE_LEN < len) {
+			return EIO;
+		}
+		if (len + NULL_PAD_BYTE_LEN > end_p - q) {
+			return EIO;
+		}
+		q += len + NULL_PAD_BYTE_LEN;
+	}
+
+	*_p = p;
+	*_q = q;
+	return 0;
+}
+
 /*
  * Unpack a ldb message from a linear buffer in ldb_val
+ *
+ * If attrs is not NULL, only the elements named in attrs are
+ * returned, the others are walked over without being allocated.
  */
 static int ldb_unpack_data_flags_v2(struct ldb_context *ldb,
 				    const struct ldb_val *data,
 				    struct ldb_message *message,
-				    unsigned int flags)
+				    unsigned int flags,
+				    const char * const *attrs)
 {
 	uint8_t *p, *q, *end_p, *value_section_p;
 	unsigned int i, j;
@@ -926,6 +976,32 @@ static int ldb_unpack_data_flags_v2(struct ldb_context *ldb,
 			goto failed;
 		}
 
+		if (attrs != NULL && !ldb_attr_in_list(attrs, attr)) {
+			unsigned int num_values = PULL_LE_U32(p, 0);
+			int ret;
+
+			p += U32_LEN;
+			val_len_width = *p;
+			p += U8_LEN;
+
+			if (val_len_width * num_values >
+			    value_section_p - p) {
+				errno = EIO;
+				goto failed;
+			}
+
+			ret = ldb_unpack_skip_values_v2(&p,
+							&q,
+							end_p,
+							num_values,
+							val_len_width);
+			if (ret != 0) {
+				errno = ret;
+				goto failed;
+			}
+			continue;
+		}
+
 		element = &message->elements[nelem];
 		element->name = attr;
 		element->flags = 0;
@@ -1010,8 +1086,11 @@ static int ldb_unpack_data_flags_v2(struct ldb_context *ldb,
 	 * something went very wrong.
 	 */
 	if (p != value_section_p) {
-		ldb_debug(ldb, LDB_DEBUG_ERROR,
-			  "Error: Data corruption in ldb_unpack_data_flags");
+		if (!(flags & LDB_UNPACK_DATA_FLAG_NO_DEBUG)) {
+			ldb_debug(ldb, LDB_DEBUG_ERROR,
+				  "Error: Data corruption in "
+				  "ldb_unpack_data_flags");
+		}
 		errno = EIO;
 		goto failed;
 	}
@@ -1031,9 +1110,12 @@ static int ldb_unpack_data_flags_v2(struct ldb_context *ldb,
 					   message->num_elements);
 
 	if (q != end_p) {
-		ldb_debug(ldb, LDB_DEBUG_ERROR,
-			  "Error: %zu bytes unread in ldb_unpack_data_flags",
-			  end_p - q);
+		if (!(flags & LDB_UNPACK_DATA_FLAG_NO_DEBUG)) {
+			ldb_debug(ldb, LDB_DEBUG_ERROR,
+				  "Error: %zu bytes unread in "
+				  "ldb_unpack_data_flags",
+				  end_p - q);
+		}
 		errno = EIO;
 		goto failed;
 	}
@@ -1072,7 +1154,8 @@ int ldb_unpack_data_flags(struct ldb_context *ldb,
 
 	format = PULL_LE_U32(data->data, 0);
 	if (format == LDB_PACKING_FORMAT_V2) {
-		return ldb_unpack_data_flags_v2(ldb, data, message, flags);
+		return ldb_unpack_data_flags_v2(ldb, data, message, flags,
+						NULL);
 	}
 
 	/*
@@ -1084,6 +1167,40 @@ int ldb_unpack_data_flags(struct ldb_context *ldb,
 	return ldb_unpack_data_flags_v1(ldb, data, message, flags, format);
 }
 
+/*
+ * Unpack a ldb message from a linear buffer in ldb_val, keeping only
+ * the elements named in attrs.
+ *
+ * A NULL attrs, or one containing "*", unpacks every element.  Only
+ * the V2 format can skip elements cheaply, older formats are always
+ * unpacked in full and the caller must still filter the result.
+ */
+int ldb_unpack_data_attrs(struct ldb_context *ldb,
+			  const struct ldb_val *data,
+			  struct ldb_message *message,
+			  unsigned int flags,
+			  const char * const *attrs)
+{
+	unsigned format;
+
+	if (data->length < U32_LEN) {
+		errno = EIO;
+		return -1;
+	}
+
+	if (attrs != NULL && ldb_attr_in_list(attrs, "*")) {
+		attrs = NULL;
+	}
+
+	format = PULL_LE_U32(data->data, 0);
+	if (format == LDB_PACKING_FORMAT_V2) {
+		return ldb_unpack_data_flags_v2(ldb, data, message, flags,
+						attrs);
+	}
+
+	return ldb_unpack_data_flags_v1(ldb, data, message, flags, format);
+}
+
 
 /*
  * Unpack a ldb message from a linear buffer in ldb_val
@@ -581,12 +581,32 @@ int ldb_msg_elements_take_ownership(struct ldb_message *msg);
  * If LDB_UNPACK_DATA_FLAG_NO_ATTRS is specified, then no attributes
  * are unpacked or returned.
  *
+ * If LDB_UNPACK_DATA_FLAG_NO_DEBUG is specified, nothing is logged
+ * via ldb_debug(), and any record that would have been reported is
+ * rejected with -1 and errno set to EIO instead.  This makes it safe
+ * to call from threads other than the one owning the ldb context;
+ * the caller is expected to unpack again without the flag to get
+ * the error reported.
+ *
  */
 int ldb_unpack_data_flags(struct ldb_context *ldb,
 			  const struct ldb_val *data,
 			  struct ldb_message *message,
 			  unsigned int flags);
 
+/*
+ * As ldb_unpack_data_flags(), but only the elements named in attrs
+ * are returned.  The other elements are skipped without allocation
+ * where the packing format allows it, so callers must still filter
+ * the result.  A NULL attrs, or one containing "*", returns all
+ * elements.
+ */
+int ldb_unpack_data_attrs(struct ldb_context *ldb,
+			  const struct ldb_val *data,
+			  struct ldb_message *message,
+			  unsigned int flags,
+			  const char * const *attrs);
+
 int ldb_unpack_get_format(const struct ldb_val *data,
 			  uint32_t *pack_format_version);
 
@@ -595,6 +615,7 @@ int ldb_unpack_get_format(const struct ldb_val *data,
 #define LDB_UNPACK_DATA_FLAG_NO_VALUES_ALLOC 0x0004
 #define LDB_UNPACK_DATA_FLAG_NO_ATTRS        0x0008
 #define LDB_UNPACK_DATA_FLAG_READ_LOCKED     0x0010
+#define LDB_UNPACK_DATA_FLAG_NO_DEBUG        0x0020
 
 enum ldb_pack_format {
 
@@ -2290,5 +2290,60 @@ int ldb_kv_init_store(struct ldb_kv_private *ldb_kv,
 		}
 	}
 
+	/*
+	 * Fetch and unpack the records of large indexed searches in
+	 * worker threads, if the backend supports it.
+	 */
+	{
+		const char *threads = ldb_options_find(
+			ldb, options, "search_threads");
+		if (threads != NULL) {
+			unsigned long num_threads = 0;
+			errno = 0;
+
+			num_threads = strtoul(threads, NULL, 0);
+			if (errno == ERANGE ||
+			    num_threads > LDB_KV_MAX_SEARCH_THREADS) {
+				ldb_debug(
+					ldb,
+					LDB_DEBUG_WARNING,
+					"Invalid search_threads value [%s], "
+					"using at most %d threads\n",
+					threads,
+					LDB_KV_MAX_SEARCH_THREADS);
+				num_threads = LDB_KV_MAX_SEARCH_THREADS;
+			}
+			ldb_kv->search_threads = num_threads;
+		}
+	}
+
+	/*
+	 * Split GUID index records holding many more than this number
+	 * of GUIDs into segments, so that a change to the index only
+	 * rewrites one segment.
+	 */
+	{
+		const char *size = ldb_options_find(
+			ldb, options, "index_segment_size");
+		if (size != NULL) {
+			unsigned long segment_size = 0;
+			errno = 0;
+
+			segment_size = strtoul(size, NULL, 0);
+			if (errno == ERANGE ||
+			    segment_size > LDB_KV_MAX_INDEX_SEGMENT_SIZE) {
+				ldb_debug(
+					ldb,
+					LDB_DEBUG_WARNING,
+					"Invalid index_segment_size value [%s], "
+					"using %d\n",
+					size,
+					LDB_KV_MAX_INDEX_SEGMENT_SIZE);
+				segment_size = LDB_KV_MAX_INDEX_SEGMENT_SIZE;
+			}
+			ldb_kv->index_segment_size = segment_size;
+		}
+	}
+
 	return LDB_SUCCESS;
 }
@@ -54,6 +54,27 @@ struct kv_db_ops {
 	int (*begin_nested_write)(struct ldb_kv_private *);
 	int (*finish_nested_write)(struct ldb_kv_private *);
 	int (*abort_nested_write)(struct ldb_kv_private *);
+
+	/*
+	 * Optional, to fetch records from worker threads in
+	 * ldb_kv_index_filter().
+	 *
+	 * parallel_read_begin() is called in the main thread while
+	 * holding the read lock.  It returns a reader that sees the
+	 * same data as the read lock, or NULL.
+	 *
+	 * parallel_fetch_and_parse() may be called from any thread, but
+	 * only by one thread at a time for each reader.  It must not
+	 * touch ldb_kv or log anything.
+	 */
+	void *(*parallel_read_begin)(struct ldb_kv_private *ldb_kv,
+				     TALLOC_CTX *mem_ctx);
+	int (*parallel_fetch_and_parse)(void *reader,
+					struct ldb_val key,
+					int (*parser)(struct ldb_val key,
+						      struct ldb_val data,
+						      void *private_data),
+					void *ctx);
 };
 
 /* this private structure is used by the key value backends in the
@@ -146,6 +167,18 @@ struct ldb_kv_private {
 	 * The size to be used for the index transaction cache
 	 */
 	size_t index_transaction_cache_size;
+
+	/*
+	 * Number of threads used to fetch and unpack the records of
+	 * large indexed searches, 0 to do it all in the main thread.
+	 */
+	unsigned int search_threads;
+
+	/*
+	 * Target number of GUIDs in each segment of a large GUID index
+	 * record, 0 to always store the index record as a whole.
+	 */
+	unsigned int index_segment_size;
 };
 
 struct ldb_kv_context {
@@ -170,6 +203,11 @@ struct ldb_kv_context {
 	struct ldb_dn *base;
 	enum ldb_scope scope;
 	const char * const *attrs;
+	/*
+	 * The attributes to unpack from each record, those in attrs
+	 * plus those in tree, or NULL for all of them
+	 */
+	const char * const *unpack_attrs;
 	struct tevent_timer *timeout_event;
 
 	/* error handling */
@@ -199,6 +237,8 @@ struct ldb_kv_repack_context {
 #define LDB_KV_IDXDN     "@IDXDN"
 #define LDB_KV_IDXGUID    "@IDXGUID"
 #define LDB_KV_IDX_DN_GUID "@IDX_DN_GUID"
+#define LDB_KV_IDXSEG     "@IDXSEG"
+#define LDB_KV_IDXSEGBITS "@IDXSEGBITS"
 
 /*
  * This will be used to indicate when a new, yet to be developed
@@ -251,6 +291,17 @@ int ldb_kv_check_at_attributes_values(const struct ldb_val *value);
  */
 #define DEFAULT_INDEX_CACHE_SIZE 491
 
+/*
+ * Upper limit for the "search_threads" option, every thread holds an
+ * LMDB reader slot during the search
+ */
+#define LDB_KV_MAX_SEARCH_THREADS 16
+
+/*
+ * Upper limit for the "index_segment_size" option
+ */
+#define LDB_KV_MAX_INDEX_SEGMENT_SIZE (1024 * 1024)
+
 struct ldb_parse_tree;
 
 int ldb_kv_search_indexed(struct ldb_kv_context *ctx, uint32_t *);
@@ -301,6 +352,23 @@ int ldb_kv_search_key(struct ldb_module *module,
 		      const struct ldb_val ldb_key,
 		      struct ldb_message *msg,
 		      unsigned int unpack_flags);
+int ldb_kv_search_key_attrs(struct ldb_module *module,
+			    struct ldb_kv_private *ldb_kv,
+			    const struct ldb_val ldb_key,
+			    struct ldb_message *msg,
+			    unsigned int unpack_flags,
+			    const char * const *attrs);
+struct ldb_kv_prefetch;
+struct ldb_kv_prefetch *ldb_kv_prefetch_start(TALLOC_CTX *mem_ctx,
+					      struct ldb_kv_private *ldb_kv,
+					      const struct ldb_val *keys,
+					      unsigned int num_keys,
+					      const char * const *attrs);
+bool ldb_kv_prefetch_get(struct ldb_kv_prefetch *prefetch,
+			 unsigned int idx,
+			 TALLOC_CTX *mem_ctx,
+			 struct ldb_message **msg,
+			 int *ret);
 int ldb_kv_filter_attrs_in_place(struct ldb_message *msg,
 				 const char *const *attrs);
 int ldb_kv_search(struct ldb_kv_context *ctx);
@@ -196,6 +196,25 @@ static void ldb_kv_dn_list_sort(struct ldb_kv_private *ldb_kv,
 
 #define LDB_KV_GUID_INDEXING_VERSION 3
 
+/*
+ * A large GUID index record may be split into segments by the top
+ * bits of the GUIDs (see ldb_kv_dn_list_store_segments()).  The head
+ * record then has this version and the number of bits in
+ * @IDXSEGBITS.  The segments are ordinary
+ * LDB_KV_GUID_INDEXING_VERSION records.
+ *
+ * Older versions treat a record without @IDX as an empty list, so the
+ * head also carries LDB_KV_IDX_SEGMENTED as its @IDX.  An older
+ * version finds the @IDX, rejects the version and, failing that, the
+ * length, which is not a multiple of LDB_KV_GUID_SIZE.  It fails
+ * instead of returning no results, and cannot overwrite the head
+ * with a list of its own.
+ */
+#define LDB_KV_GUID_SEGMENTED_INDEXING_VERSION 4
+#define LDB_KV_IDX_SEGMENTED "SEGMENTED"
+
+#define LDB_KV_INDEX_SEGMENT_MAX_BITS 16
+
 static unsigned ldb_kv_max_key_length(struct ldb_kv_private *ldb_kv)
 {
 	if (ldb_kv->max_key_length == 0) {
@@ -230,19 +249,15 @@ int ldb_kv_index_transaction_start(
 }
 
 /*
-  see if two ldb_val structures contain exactly the same data
-  return -1 or 1 for a mismatch, 0 for match
+  load 8 bytes of a GUID as a big-endian word, so that comparing the
+  words gives the same order as memcmp()
 */
-static int ldb_val_equal_exact_for_qsort(const struct ldb_val *v1,
-					 const struct ldb_val *v2)
+static inline uint64_t ldb_kv_guid_word(const uint8_t *p)
 {
-	if (v1->length > v2->length) {
-		return -1;
-	}
-	if (v1->length < v2->length) {
-		return 1;
-	}
-	return memcmp(v1->data, v2->data, v1->length);
+	return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) |
+	       ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32) |
+	       ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) |
+	       ((uint64_t)p[6] << 8) | (uint64_t)p[7];
 }
 
 /*
@@ -258,9 +273,36 @@ static int ldb_val_equal_exact_ordered(const struct ldb_val v1,
 	if (v1.length < v2->length) {
 		return 1;
 	}
+	if (v1.length == LDB_KV_GUID_SIZE) {
+		/*
+		 * The GUID index lists are compared a lot, do it a
+		 * word at a time rather than a byte at a time.
+		 */
+		uint64_t w1 = ldb_kv_guid_word(v1.data);
+		uint64_t w2 = ldb_kv_guid_word(v2->data);
+
+		if (w1 == w2) {
+			w1 = ldb_kv_guid_word(v1.data + 8);
+			w2 = ldb_kv_guid_word(v2->data + 8);
+		}
+		if (w1 == w2) {
+			return 0;
+		}
+		return w1 < w2 ? -1 : 1;
+	}
 	return memcmp(v1.data, v2->data, v1.length);
 }
 
+/*
+  see if two ldb_val structures contain exactly the same data
+  return -1 or 1 for a mismatch, 0 for match
+*/
+static int ldb_val_equal_exact_for_qsort(const struct ldb_val *v1,
+					 const struct ldb_val *v2)
+{
+	return ldb_val_equal_exact_ordered(*v1, v2);
+}
+
 
 /*
   find a entry in a dn_list, using a ldb_val. Uses a case sensitive
@@ -378,6 +420,141 @@ static int ldb_kv_index_idxptr_wrapper(TDB_DATA tdb_key,
 	return 0;
 }
 
+/*
+  return the DN of segment k of a segmented index record, the
+  segments of @INDEX:ATTR:VALUE are @IDXSEG:BITS:K:ATTR:VALUE
+ */
+static struct ldb_dn *ldb_kv_index_segment_dn(struct ldb_context *ldb,
+					      TALLOC_CTX *mem_ctx,
+					      const char *head,
+					      unsigned int bits,
+					      unsigned int k)
+{
+	const size_t indx_len = sizeof(LDB_KV_INDEX) - 1;
+
+	if (strncmp(head, LDB_KV_INDEX, indx_len) != 0) {
+		return NULL;
+	}
+	return ldb_dn_new_fmt(mem_ctx, ldb, "%s:%u:%u%s",
+			      LDB_KV_IDXSEG, bits, k, head + indx_len);
+}
+
+/*
+  the segment of a GUID, given by its top bits.  GUIDs are random, so
+  the segments of a list are of about the same size, and as the lists
+  are sorted each segment is a contiguous slice of the list.
+ */
+static unsigned int ldb_kv_guid_segment(const struct ldb_val *guid,
+					unsigned int bits)
+{
+	unsigned int top = ((unsigned int)guid->data[0] << 8) | guid->data[1];
+
+	return top >> (LDB_KV_INDEX_SEGMENT_MAX_BITS - bits);
+}
+
+/*
+  append the GUIDs in the segments of a segmented index record to a
+  dn_list.  The segments are loaded in GUID order so the list stays
+  sorted, and missing segments are empty.
+ */
+static int ldb_kv_dn_list_load_segments(struct ldb_module *module,
+					const char *head,
+					unsigned int bits,
+					struct dn_list *list)
+{
+	struct ldb_context *ldb = ldb_module_get_ctx(module);
+	unsigned int k;
+
+	if (bits == 0 || bits > LDB_KV_INDEX_SEGMENT_MAX_BITS) {
+		ldb_debug_set(ldb, LDB_DEBUG_ERROR,
+			      "Invalid %s %u for %s",
+			      LDB_KV_IDXSEGBITS, bits, head);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	for (k = 0; k < (1U << bits); k++) {
+		struct ldb_message *msg = NULL;
+		struct ldb_message_element *el = NULL;
+		struct ldb_dn *dn = NULL;
+		size_t n, i;
+		int ret, version;
+
+		msg = ldb_msg_new(list);
+		if (msg == NULL) {
+			return LDB_ERR_OPERATIONS_ERROR;
+		}
+
+		dn = ldb_kv_index_segment_dn(ldb, msg, head, bits, k);
+		if (dn == NULL) {
+			talloc_free(msg);
+			return LDB_ERR_OPERATIONS_ERROR;
+		}
+
+		ret = ldb_kv_search_dn1(module,
+					dn,
+					msg,
+					LDB_UNPACK_DATA_FLAG_NO_DN |
+					LDB_UNPACK_DATA_FLAG_READ_LOCKED);
+		if (ret == LDB_ERR_NO_SUCH_OBJECT) {
+			talloc_free(msg);
+			continue;
+		}
+		if (ret != LDB_SUCCESS) {
+			talloc_free(msg);
+			return ret;
+		}
+
+		version = ldb_msg_find_attr_as_int(msg, LDB_KV_IDXVERSION, 0);
+		el = ldb_msg_find_element(msg, LDB_KV_IDX);
+		if (version != LDB_KV_GUID_INDEXING_VERSION ||
+		    el == NULL || el->num_values == 0 ||
+		    (el->values[0].length % LDB_KV_GUID_SIZE) != 0) {
+			ldb_debug_set(ldb, LDB_DEBUG_ERROR,
+				      "Invalid index segment %s",
+				      ldb_dn_get_linearized(dn));
+			talloc_free(msg);
+			return LDB_ERR_OPERATIONS_ERROR;
+		}
+		talloc_free(dn);
+
+		n = el->values[0].length / LDB_KV_GUID_SIZE;
+		if (n > UINT_MAX - list->count) {
+			talloc_free(msg);
+			return LDB_ERR_OPERATIONS_ERROR;
+		}
+
+		if (list->count + n > talloc_array_length(list->dn)) {
+			size_t len = MAX(list->count + n,
+					 talloc_array_length(list->dn) * 2);
+			struct ldb_val *dn_vals = NULL;
+
+			dn_vals = talloc_realloc(list, list->dn,
+						 struct ldb_val, len);
+			if (dn_vals == NULL) {
+				talloc_free(msg);
+				return LDB_ERR_OPERATIONS_ERROR;
+			}
+			list->dn = dn_vals;
+		}
+
+		/*
+		 * The actual data is on msg.
+		 */
+		talloc_steal(list->dn, msg);
+		for (i = 0; i < n; i++) {
+			list->dn[list->count + i].data
+				= &el->values[0].data[i * LDB_KV_GUID_SIZE];
+			list->dn[list->count + i].length = LDB_KV_GUID_SIZE;
+		}
+		list->count += n;
+
+		/* We don't need msg->elements any more */
+		talloc_free(msg->elements);
+	}
+
+	return LDB_SUCCESS;
+}
+
 /*
   return the @IDX list in an index entry for a dn as a
   struct dn_list
@@ -527,14 +704,31 @@ normal_index:
 		return ret;
 	}
 
+	version = ldb_msg_find_attr_as_int(msg, LDB_KV_IDXVERSION, 0);
+
+	if (ldb_kv->cache->GUID_index_attribute != NULL &&
+	    version == LDB_KV_GUID_SEGMENTED_INDEXING_VERSION) {
+		unsigned int bits =
+			ldb_msg_find_attr_as_uint(msg, LDB_KV_IDXSEGBITS, 0);
+
+		talloc_free(msg);
+		ret = ldb_kv_dn_list_load_segments(module,
+						   ldb_dn_get_linearized(dn),
+						   bits,
+						   list);
+		if (ret != LDB_SUCCESS) {
+			TALLOC_FREE(list->dn);
+			list->count = 0;
+		}
+		return ret;
+	}
+
 	el = ldb_msg_find_element(msg, LDB_KV_IDX);
 	if (!el) {
 		talloc_free(msg);
 		return LDB_SUCCESS;
 	}
 
-	version = ldb_msg_find_attr_as_int(msg, LDB_KV_IDXVERSION, 0);
-
 	/*
 	 * we avoid copying the strings by stealing the list.  We have
 	 * to steal msg onto el->values (which looks odd) because
@@ -688,48 +882,478 @@ int ldb_kv_key_dn_from_idx(struct ldb_module *module,
 				continue;
 			}
 
-			if (ret != LDB_SUCCESS) {
-				/* an internal error */
-				TALLOC_FREE(rec);
-				TALLOC_FREE(list);
-				return LDB_ERR_OPERATIONS_ERROR;
-			}
+			if (ret != LDB_SUCCESS) {
+				/* an internal error */
+				TALLOC_FREE(rec);
+				TALLOC_FREE(list);
+				return LDB_ERR_OPERATIONS_ERROR;
+			}
+
+			/*
+			 * We found the actual DN that we wanted from in the
+			 * multiple values that matched the index
+			 * (due to truncation), so return that.
+			 *
+			 */
+			if (ldb_dn_compare(dn, rec->dn) == 0) {
+				index = i;
+				TALLOC_FREE(rec);
+				break;
+			}
+		}
+
+		/*
+		 * We matched the index but the actual DN we wanted
+		 * was not here.
+		 */
+		if (index == -1) {
+			TALLOC_FREE(list);
+			return LDB_ERR_NO_SUCH_OBJECT;
+		}
+	}
+
+	/* The ldb_key memory is allocated by the caller */
+	ret = ldb_kv_guid_to_key(&list->dn[index], ldb_key);
+	TALLOC_FREE(list);
+
+	if (ret != LDB_SUCCESS) {
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	return LDB_SUCCESS;
+}
+
+
+
+/*
+  add the GUIDs of a dn_list to an index record, as a single @IDX
+  value
+ */
+static int ldb_kv_index_add_guids(struct ldb_module *module,
+				  struct ldb_message *msg,
+				  const struct ldb_val *guids,
+				  unsigned int count)
+{
+	struct ldb_message_element *el;
+	struct ldb_val v;
+	unsigned int i;
+	int ret;
+
+	ret = ldb_msg_add_empty(msg, LDB_KV_IDX, LDB_FLAG_MOD_ADD, &el);
+	if (ret != LDB_SUCCESS) {
+		return ldb_module_oom(module);
+	}
+
+	el->values = talloc_array(msg, struct ldb_val, 1);
+	if (el->values == NULL) {
+		return ldb_module_oom(module);
+	}
+
+	v.data = talloc_array_size(el->values, count, LDB_KV_GUID_SIZE);
+	if (v.data == NULL) {
+		return ldb_module_oom(module);
+	}
+
+	v.length = talloc_get_size(v.data);
+
+	for (i = 0; i < count; i++) {
+		if (guids[i].length != LDB_KV_GUID_SIZE) {
+			return ldb_module_operr(module);
+		}
+		memcpy(&v.data[LDB_KV_GUID_SIZE*i],
+		       guids[i].data,
+		       LDB_KV_GUID_SIZE);
+	}
+	el->values[0] = v;
+	el->num_values = 1;
+	return LDB_SUCCESS;
+}
+
+struct ldb_kv_index_head_state {
+	struct ldb_module *module;
+	unsigned int bits;
+	/* The number of GUIDs in a record that is not segmented */
+	unsigned int count;
+};
+
+static int ldb_kv_index_head_parser(_UNUSED_ struct ldb_val key,
+				    struct ldb_val data,
+				    void *private_data)
+{
+	struct ldb_kv_index_head_state *state = private_data;
+	struct ldb_message *msg = NULL;
+	int ret, version;
+
+	msg = ldb_msg_new(state->module);
+	if (msg == NULL) {
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	/*
+	 * Only the attributes are looked at, so don't copy the
+	 * (possibly large) @IDX value
+	 */
+	ret = ldb_unpack_data_flags(ldb_module_get_ctx(state->module),
+				    &data,
+				    msg,
+				    LDB_UNPACK_DATA_FLAG_NO_DN |
+				    LDB_UNPACK_DATA_FLAG_NO_VALUES_ALLOC);
+	if (ret != 0) {
+		talloc_free(msg);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	version = ldb_msg_find_attr_as_int(msg, LDB_KV_IDXVERSION, 0);
+	if (version == LDB_KV_GUID_SEGMENTED_INDEXING_VERSION) {
+		state->bits = ldb_msg_find_attr_as_uint(msg,
+							LDB_KV_IDXSEGBITS,
+							0);
+	} else {
+		struct ldb_message_element *el =
+			ldb_msg_find_element(msg, LDB_KV_IDX);
+		if (el != NULL && el->num_values > 0) {
+			state->count =
+				el->values[0].length / LDB_KV_GUID_SIZE;
+		}
+	}
+	talloc_free(msg);
+	return LDB_SUCCESS;
+}
+
+/*
+  find how many bits the index record for a dn is currently
+  segmented by on disk, 0 if it is not segmented or does not exist
+ */
+static int ldb_kv_index_segment_bits_load(struct ldb_module *module,
+					  struct ldb_kv_private *ldb_kv,
+					  struct ldb_dn *dn,
+					  unsigned int *bits)
+{
+	struct ldb_kv_index_head_state state = {
+		.module = module,
+	};
+	struct ldb_val key;
+	int ret;
+
+	key = ldb_kv_key_dn(module, dn);
+	if (key.data == NULL) {
+		return ldb_module_oom(module);
+	}
+
+	ret = ldb_kv->kv_ops->fetch_and_parse(
+	    ldb_kv, key, ldb_kv_index_head_parser, &state);
+	talloc_free(key.data);
+
+	if (ret == -1) {
+		ret = ldb_kv->kv_ops->error(ldb_kv);
+		if (ret == LDB_SUCCESS) {
+			ret = LDB_ERR_OPERATIONS_ERROR;
+		}
+	}
+	if (ret == LDB_ERR_NO_SUCH_OBJECT) {
+		*bits = 0;
+		return LDB_SUCCESS;
+	}
+	if (ret != LDB_SUCCESS) {
+		return ret;
+	}
+
+	if (state.bits > LDB_KV_INDEX_SEGMENT_MAX_BITS) {
+		ldb_debug_set(ldb_module_get_ctx(module), LDB_DEBUG_ERROR,
+			      "Invalid %s %u for %s",
+			      LDB_KV_IDXSEGBITS, state.bits,
+			      ldb_dn_get_linearized(dn));
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+	*bits = state.bits;
+	return LDB_SUCCESS;
+}
+
+/*
+  choose how many bits of the GUIDs to segment an index record of
+  count GUIDs by, 0 to store it whole.
+
+  A record is split once it holds more than two segments worth of
+  GUIDs, and the split is kept while the segments hold between a
+  quarter and twice the segment size, so that a list growing or
+  shrinking around a boundary is not re-split on every commit.
+ */
+static unsigned int ldb_kv_index_segment_bits(struct ldb_kv_private *ldb_kv,
+					      struct ldb_dn *dn,
+					      unsigned int count,
+					      unsigned int old_bits)
+{
+	const size_t indx_len = sizeof(LDB_KV_INDEX) - 1;
+	unsigned int size = ldb_kv->index_segment_size;
+	const char *head = NULL;
+	unsigned int bits;
+	int key_len;
+
+	if (size == 0) {
+		return 0;
+	}
+
+	if (old_bits != 0) {
+		unsigned int per_segment = count >> old_bits;
+		if (per_segment >= size / 4 && per_segment <= size * 2) {
+			return old_bits;
+		}
+	}
+
+	if (count <= size * 2) {
+		return 0;
+	}
+
+	bits = 1;
+	while ((count >> bits) > size &&
+	       bits < LDB_KV_INDEX_SEGMENT_MAX_BITS) {
+		bits++;
+	}
+
+	/*
+	 * The segment keys are a little longer than the head, so keep
+	 * the record whole if the longest of them would not fit.
+	 */
+	head = ldb_dn_get_linearized(dn);
+	if (head == NULL || strncmp(head, LDB_KV_INDEX, indx_len) != 0) {
+		return 0;
+	}
+	key_len = snprintf(NULL, 0, "DN=%s:%u:%u%s",
+			   LDB_KV_IDXSEG, bits, (1U << bits) - 1,
+			   head + indx_len);
+	if (key_len < 0 ||
+	    (unsigned int)key_len + 1 > ldb_kv_max_key_length(ldb_kv)) {
+		return 0;
+	}
+
+	return bits;
+}
+
+struct ldb_kv_index_segment_cmp {
+	struct ldb_val packed;
+	bool equal;
+};
+
+static int ldb_kv_index_segment_cmp_parser(_UNUSED_ struct ldb_val key,
+					   struct ldb_val data,
+					   void *private_data)
+{
+	struct ldb_kv_index_segment_cmp *cmp = private_data;
+
+	cmp->equal = data.length == cmp->packed.length &&
+		     memcmp(data.data, cmp->packed.data, data.length) == 0;
+	return LDB_SUCCESS;
+}
+
+/*
+  save one segment of a segmented index record, unless it is
+  unchanged on disk.  Empty segments are deleted.
+ */
+static int ldb_kv_index_segment_store(struct ldb_module *module,
+				      struct ldb_kv_private *ldb_kv,
+				      struct ldb_dn *dn,
+				      const struct ldb_val *guids,
+				      unsigned int count)
+{
+	struct ldb_kv_index_segment_cmp cmp = {
+		.equal = false,
+	};
+	struct ldb_message *msg;
+	struct ldb_val key;
+	int ret;
+
+	msg = ldb_msg_new(module);
+	if (!msg) {
+		return ldb_module_oom(module);
+	}
+
+	msg->dn = dn;
+
+	if (count == 0) {
+		ret = ldb_kv_delete_noindex(module, msg);
+		if (ret == LDB_ERR_NO_SUCH_OBJECT) {
+			ret = LDB_SUCCESS;
+		}
+		TALLOC_FREE(msg);
+		return ret;
+	}
+
+	ret = ldb_msg_add_fmt(msg, LDB_KV_IDXVERSION, "%u",
+			      LDB_KV_GUID_INDEXING_VERSION);
+	if (ret != LDB_SUCCESS) {
+		TALLOC_FREE(msg);
+		return ldb_module_oom(module);
+	}
+
+	ret = ldb_kv_index_add_guids(module, msg, guids, count);
+	if (ret != LDB_SUCCESS) {
+		TALLOC_FREE(msg);
+		return ret;
+	}
+
+	/*
+	 * Most segments of a large index are not touched by a
+	 * transaction, comparing them is much cheaper than writing
+	 * them again.
+	 */
+	ret = ldb_pack_data(ldb_module_get_ctx(module),
+			    msg, &cmp.packed,
+			    ldb_kv->pack_format_version);
+	if (ret == -1) {
+		TALLOC_FREE(msg);
+		return LDB_ERR_OTHER;
+	}
+
+	key = ldb_kv_key_dn(msg, dn);
+	if (key.data == NULL) {
+		talloc_free(cmp.packed.data);
+		TALLOC_FREE(msg);
+		return ldb_module_oom(module);
+	}
+
+	ret = ldb_kv->kv_ops->fetch_and_parse(
+	    ldb_kv, key, ldb_kv_index_segment_cmp_parser, &cmp);
+	talloc_free(cmp.packed.data);
+	if (ret == LDB_SUCCESS && cmp.equal) {
+		TALLOC_FREE(msg);
+		return LDB_SUCCESS;
+	}
+
+	ret = ldb_kv_store(module, msg, TDB_REPLACE);
+	TALLOC_FREE(msg);
+	return ret;
+}
+
+/*
+  delete the segments of an index record segmented by bits
+ */
+static int ldb_kv_index_segments_delete(struct ldb_module *module,
+					struct ldb_dn *dn,
+					unsigned int bits)
+{
+	struct ldb_context *ldb = ldb_module_get_ctx(module);
+	const char *head = ldb_dn_get_linearized(dn);
+	unsigned int k;
+
+	for (k = 0; k < (1U << bits); k++) {
+		struct ldb_message *msg;
+		int ret;
+
+		msg = ldb_msg_new(module);
+		if (!msg) {
+			return ldb_module_oom(module);
+		}
+
+		msg->dn = ldb_kv_index_segment_dn(ldb, msg, head, bits, k);
+		if (msg->dn == NULL) {
+			TALLOC_FREE(msg);
+			return ldb_module_operr(module);
+		}
+
+		ret = ldb_kv_delete_noindex(module, msg);
+		TALLOC_FREE(msg);
+		if (ret != LDB_SUCCESS && ret != LDB_ERR_NO_SUCH_OBJECT) {
+			return ret;
+		}
+	}
+	return LDB_SUCCESS;
+}
+
+/*
+  save a dn_list as a segmented index record.
 
-			/*
-			 * We found the actual DN that we wanted from in the
-			 * multiple values that matched the index
-			 * (due to truncation), so return that.
-			 *
-			 */
-			if (ldb_dn_compare(dn, rec->dn) == 0) {
-				index = i;
-				TALLOC_FREE(rec);
-				break;
-			}
+  Segment k holds the GUIDs whose top bits are k, so a change to the
+  list only changes one segment, and only that segment is written.
+  The head record is only rewritten when the number of bits changes,
+  and then the segments of the old split are deleted.
+ */
+static int ldb_kv_dn_list_store_segments(struct ldb_module *module,
+					 struct ldb_kv_private *ldb_kv,
+					 struct ldb_dn *dn,
+					 struct dn_list *list,
+					 unsigned int old_bits,
+					 unsigned int bits)
+{
+	struct ldb_context *ldb = ldb_module_get_ctx(module);
+	const char *head = ldb_dn_get_linearized(dn);
+	struct ldb_message *msg;
+	unsigned int i = 0;
+	unsigned int k;
+	int ret;
+
+	for (k = 0; k < (1U << bits); k++) {
+		unsigned int first = i;
+		struct ldb_dn *seg_dn;
+
+		while (i < list->count &&
+		       list->dn[i].length == LDB_KV_GUID_SIZE &&
+		       ldb_kv_guid_segment(&list->dn[i], bits) == k) {
+			i++;
 		}
 
-		/*
-		 * We matched the index but the actual DN we wanted
-		 * was not here.
-		 */
-		if (index == -1) {
-			TALLOC_FREE(list);
-			return LDB_ERR_NO_SUCH_OBJECT;
+		seg_dn = ldb_kv_index_segment_dn(ldb, module, head, bits, k);
+		if (seg_dn == NULL) {
+			return ldb_module_operr(module);
+		}
+
+		ret = ldb_kv_index_segment_store(module,
+						 ldb_kv,
+						 seg_dn,
+						 &list->dn[first],
+						 i - first);
+		talloc_free(seg_dn);
+		if (ret != LDB_SUCCESS) {
+			return ret;
 		}
 	}
 
-	/* The ldb_key memory is allocated by the caller */
-	ret = ldb_kv_guid_to_key(&list->dn[index], ldb_key);
-	TALLOC_FREE(list);
+	/* The list must be sorted, and hold only GUIDs */
+	if (i != list->count) {
+		return ldb_module_operr(module);
+	}
+
+	if (bits == old_bits) {
+		return LDB_SUCCESS;
+	}
 
+	msg = ldb_msg_new(module);
+	if (!msg) {
+		return ldb_module_oom(module);
+	}
+
+	msg->dn = dn;
+
+	ret = ldb_msg_add_fmt(msg, LDB_KV_IDXVERSION, "%u",
+			      LDB_KV_GUID_SEGMENTED_INDEXING_VERSION);
 	if (ret != LDB_SUCCESS) {
-		return LDB_ERR_OPERATIONS_ERROR;
+		TALLOC_FREE(msg);
+		return ldb_module_oom(module);
 	}
 
-	return LDB_SUCCESS;
-}
+	ret = ldb_msg_add_fmt(msg, LDB_KV_IDXSEGBITS, "%u", bits);
+	if (ret != LDB_SUCCESS) {
+		TALLOC_FREE(msg);
+		return ldb_module_oom(module);
+	}
 
+	/* Make older versions fail, see LDB_KV_IDX_SEGMENTED */
+	ret = ldb_msg_add_string(msg, LDB_KV_IDX, LDB_KV_IDX_SEGMENTED);
+	if (ret != LDB_SUCCESS) {
+		TALLOC_FREE(msg);
+		return ldb_module_oom(module);
+	}
+
+	ret = ldb_kv_store(module, msg, TDB_REPLACE);
+	TALLOC_FREE(msg);
+	if (ret != LDB_SUCCESS) {
+		return ret;
+	}
 
+	if (old_bits != 0) {
+		return ldb_kv_index_segments_delete(module, dn, old_bits);
+	}
+	return LDB_SUCCESS;
+}
 
 /*
   save a dn_list into a full @IDX style record
@@ -740,8 +1364,34 @@ static int ldb_kv_dn_list_store_full(struct ldb_module *module,
 				     struct dn_list *list)
 {
 	struct ldb_message *msg;
+	unsigned int old_bits = 0;
 	int ret;
 
+	if (ldb_kv->cache->GUID_index_attribute != NULL) {
+		unsigned int bits;
+
+		ret = ldb_kv_index_segment_bits_load(module,
+						     ldb_kv,
+						     dn,
+						     &old_bits);
+		if (ret != LDB_SUCCESS) {
+			return ret;
+		}
+
+		bits = ldb_kv_index_segment_bits(ldb_kv,
+						 dn,
+						 list->count,
+						 old_bits);
+		if (bits != 0) {
+			return ldb_kv_dn_list_store_segments(module,
+							     ldb_kv,
+							     dn,
+							     list,
+							     old_bits,
+							     bits);
+		}
+	}
+
 	msg = ldb_msg_new(module);
 	if (!msg) {
 		return ldb_module_oom(module);
@@ -755,7 +1405,7 @@ static int ldb_kv_dn_list_store_full(struct ldb_module *module,
 			ret = LDB_SUCCESS;
 		}
 		TALLOC_FREE(msg);
-		return ret;
+		goto done;
 	}
 
 	if (ldb_kv->cache->GUID_index_attribute == NULL) {
@@ -777,52 +1427,38 @@ static int ldb_kv_dn_list_store_full(struct ldb_module *module,
 	if (list->count > 0) {
 		struct ldb_message_element *el;
 
-		ret = ldb_msg_add_empty(msg, LDB_KV_IDX, LDB_FLAG_MOD_ADD, &el);
-		if (ret != LDB_SUCCESS) {
-			TALLOC_FREE(msg);
-			return ldb_module_oom(module);
-		}
-
 		if (ldb_kv->cache->GUID_index_attribute == NULL) {
-			el->values = list->dn;
-			el->num_values = list->count;
-		} else {
-			struct ldb_val v;
-			unsigned int i;
-			el->values = talloc_array(msg,
-						  struct ldb_val, 1);
-			if (el->values == NULL) {
+			ret = ldb_msg_add_empty(msg, LDB_KV_IDX,
+						LDB_FLAG_MOD_ADD, &el);
+			if (ret != LDB_SUCCESS) {
 				TALLOC_FREE(msg);
 				return ldb_module_oom(module);
 			}
-
-			v.data = talloc_array_size(el->values,
-						   list->count,
-						   LDB_KV_GUID_SIZE);
-			if (v.data == NULL) {
+			el->values = list->dn;
+			el->num_values = list->count;
+		} else {
+			ret = ldb_kv_index_add_guids(module,
+						     msg,
+						     list->dn,
+						     list->count);
+			if (ret != LDB_SUCCESS) {
 				TALLOC_FREE(msg);
-				return ldb_module_oom(module);
-			}
-
-			v.length = talloc_get_size(v.data);
-
-			for (i = 0; i < list->count; i++) {
-				if (list->dn[i].length !=
-				    LDB_KV_GUID_SIZE) {
-					TALLOC_FREE(msg);
-					return ldb_module_operr(module);
-				}
-				memcpy(&v.data[LDB_KV_GUID_SIZE*i],
-				       list->dn[i].data,
-				       LDB_KV_GUID_SIZE);
+				return ret;
 			}
-			el->values[0] = v;
-			el->num_values = 1;
 		}
 	}
 
 	ret = ldb_kv_store(module, msg, TDB_REPLACE);
 	TALLOC_FREE(msg);
+
+done:
+	/*
+	 * The record is now whole (or gone), drop the segments it
+	 * was split into before.
+	 */
+	if (ret == LDB_SUCCESS && old_bits != 0) {
+		ret = ldb_kv_index_segments_delete(module, dn, old_bits);
+	}
 	return ret;
 }
 
@@ -1412,6 +2048,88 @@ static int ldb_kv_index_dn_leaf(struct ldb_module *module,
 }
 
 
+/*
+ * With a long list this many times longer than the short one, find
+ * the entries of the short list by galloping through the long one,
+ * rather than walking both lists in step.
+ */
+#define LDB_KV_GALLOP_RATIO 32
+
+/*
+  intersect two sorted GUID lists into dn3, which has room for
+  short_list->count entries.  Every entry of short_list that is also
+  in long_list is kept, in order.  Returns the number of entries
+*/
+static unsigned int ldb_kv_guid_list_intersect(
+	const struct dn_list *short_list,
+	const struct dn_list *long_list,
+	struct ldb_val *dn3)
+{
+	unsigned int i, j = 0, k = 0;
+
+	if (long_list->count / short_list->count < LDB_KV_GALLOP_RATIO) {
+		for (i = 0; i < short_list->count; i++) {
+			int cmp = -1;
+
+			while (j < long_list->count) {
+				cmp = ldb_val_equal_exact_ordered(
+					short_list->dn[i], &long_list->dn[j]);
+				if (cmp <= 0) {
+					break;
+				}
+				j++;
+			}
+			if (j == long_list->count) {
+				break;
+			}
+			if (cmp == 0) {
+				dn3[k++] = short_list->dn[i];
+			}
+		}
+		return k;
+	}
+
+	for (i = 0; i < short_list->count; i++) {
+		unsigned int lo = j, hi, step = 1;
+
+		/*
+		 * Find a range [lo, hi) of the long list that holds the
+		 * first entry not smaller than short_list->dn[i]
+		 */
+		hi = lo;
+		while (hi < long_list->count &&
+		       ldb_val_equal_exact_ordered(short_list->dn[i],
+						   &long_list->dn[hi]) > 0) {
+			lo = hi + 1;
+			hi += step;
+			step *= 2;
+		}
+		hi = MIN(hi + 1, long_list->count);
+
+		while (lo < hi) {
+			unsigned int mid = lo + (hi - lo) / 2;
+
+			if (ldb_val_equal_exact_ordered(
+				    short_list->dn[i],
+				    &long_list->dn[mid]) > 0) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+
+		j = lo;
+		if (j == long_list->count) {
+			break;
+		}
+		if (ldb_val_equal_exact_ordered(short_list->dn[i],
+						&long_list->dn[j]) == 0) {
+			dn3[k++] = short_list->dn[i];
+		}
+	}
+	return k;
+}
+
 /*
   list intersection
   list = list & list2
@@ -1481,12 +2199,19 @@ static bool list_intersect(struct ldb_kv_private *ldb_kv,
 	}
 	list3->count = 0;
 
-	for (i=0;i<short_list->count;i++) {
-		/* For the GUID index case, this is a binary search */
-		if (ldb_kv_dn_list_find_val(
-			ldb_kv, long_list, &short_list->dn[i]) != -1) {
-			list3->dn[list3->count] = short_list->dn[i];
-			list3->count++;
+	if (ldb_kv->cache->GUID_index_attribute != NULL) {
+		/* Both lists are sorted in the GUID index case */
+		list3->count = ldb_kv_guid_list_intersect(short_list,
+							  long_list,
+							  list3->dn);
+	} else {
+		for (i = 0; i < short_list->count; i++) {
+			if (ldb_kv_dn_list_find_val(ldb_kv,
+						    long_list,
+						    &short_list->dn[i]) != -1) {
+				list3->dn[list3->count] = short_list->dn[i];
+				list3->count++;
+			}
 		}
 	}
 
@@ -1684,6 +2409,140 @@ static bool ldb_kv_index_unique(struct ldb_context *ldb,
 	return false;
 }
 
+/*
+ * Once an AND has narrowed the candidates down to this many, it is
+ * cheaper to check them against the filter than to load index lists
+ * LDB_KV_GALLOP_RATIO times longer or of unknown length.
+ */
+#define LDB_KV_INDEX_AND_SELECTIVE 32
+
+/*
+  estimate how many entries the index will return for a branch of an
+  AND, without loading the index list.  Returns UINT_MAX if this is
+  not a simple indexed equality test or there is no estimate.
+
+  The estimate comes from the index record itself: the length of the
+  @IDX value, or the number of segments of a segmented record.  In a
+  transaction the index cache is looked at first, as its lists have
+  not been written out yet.
+
+  This costs one key lookup and an unpack of the record by
+  ldb_kv_index_head_parser().  That unpack uses
+  LDB_UNPACK_DATA_FLAG_NO_VALUES_ALLOC, so the @IDX value is only
+  pointed at, not copied or split into GUIDs.
+ */
+static unsigned int ldb_kv_index_dn_estimate(
+	struct ldb_module *module,
+	struct ldb_kv_private *ldb_kv,
+	const struct ldb_parse_tree *tree)
+{
+	struct ldb_context *ldb = ldb_module_get_ctx(module);
+	struct ldb_kv_index_head_state state = {
+		.module = module,
+	};
+	enum key_truncation truncation = KEY_NOT_TRUNCATED;
+	unsigned int estimate = UINT_MAX;
+	struct ldb_dn *dn = NULL;
+	struct ldb_val key;
+	int ret;
+
+	if (ldb_kv->cache->GUID_index_attribute == NULL ||
+	    tree->operation != LDB_OP_EQUALITY ||
+	    tree->u.equality.attr[0] == '@' ||
+	    ldb_attr_dn(tree->u.equality.attr) == 0 ||
+	    !ldb_kv_is_indexed(module, ldb_kv, tree->u.equality.attr)) {
+		return UINT_MAX;
+	}
+
+	dn = ldb_kv_index_key(ldb,
+			      module,
+			      ldb_kv,
+			      tree->u.equality.attr,
+			      &tree->u.equality.value,
+			      NULL,
+			      &truncation);
+	if (dn == NULL) {
+		return UINT_MAX;
+	}
+
+	if (ldb_kv->idxptr != NULL) {
+		struct ldb_dn_list_state cached = {
+			.module = module,
+		};
+		TDB_DATA rec_key = {
+			.dptr = discard_const_p(unsigned char,
+						ldb_dn_get_linearized(dn)),
+		};
+
+		rec_key.dsize = strlen((char *)rec_key.dptr);
+
+		ret = -1;
+		if (ldb_kv->nested_idx_ptr != NULL) {
+			ret = tdb_parse_record(ldb_kv->nested_idx_ptr->itdb,
+					       rec_key,
+					       ldb_kv_index_idxptr_wrapper,
+					       &cached);
+		}
+		if (ret == -1) {
+			ret = tdb_parse_record(ldb_kv->idxptr->itdb,
+					       rec_key,
+					       ldb_kv_index_idxptr_wrapper,
+					       &cached);
+		}
+		if (ret == 0 && cached.list != NULL) {
+			talloc_free(dn);
+			return cached.list->count;
+		}
+	}
+
+	key = ldb_kv_key_dn(dn, dn);
+	if (key.data == NULL) {
+		talloc_free(dn);
+		return UINT_MAX;
+	}
+
+	ret = ldb_kv->kv_ops->fetch_and_parse(
+	    ldb_kv, key, ldb_kv_index_head_parser, &state);
+	talloc_free(dn);
+
+	if (ret == LDB_ERR_NO_SUCH_OBJECT) {
+		return 0;
+	}
+	if (ret != LDB_SUCCESS) {
+		return UINT_MAX;
+	}
+
+	if (state.bits == 0) {
+		estimate = state.count;
+	} else if (state.bits <= LDB_KV_INDEX_SEGMENT_MAX_BITS &&
+		   ldb_kv->index_segment_size != 0) {
+		/* The segments hold about this many each */
+		uint64_t n = (uint64_t)ldb_kv->index_segment_size
+			<< state.bits;
+		estimate = MIN(n, UINT_MAX - 1);
+	} else {
+		/* Large, but the segment size is not known */
+		estimate = UINT_MAX - 1;
+	}
+	return estimate;
+}
+
+struct ldb_kv_index_and_branch {
+	unsigned int idx;
+	unsigned int estimate;
+};
+
+static int ldb_kv_index_and_branch_cmp(
+	const struct ldb_kv_index_and_branch *b1,
+	const struct ldb_kv_index_and_branch *b2)
+{
+	if (b1->estimate != b2->estimate) {
+		return b1->estimate < b2->estimate ? -1 : 1;
+	}
+	/* Keep the filter order otherwise */
+	return NUMERIC_CMP(b1->idx, b2->idx);
+}
+
 /*
   process an AND expression (intersection)
  */
@@ -1693,7 +2552,9 @@ static int ldb_kv_index_dn_and(struct ldb_module *module,
 			       struct dn_list *list)
 {
 	struct ldb_context *ldb;
-	unsigned int i;
+	struct ldb_kv_index_and_branch *branches = NULL;
+	unsigned int num_branches;
+	unsigned int i, b;
 	bool found;
 
 	ldb = ldb_module_get_ctx(module);
@@ -1728,11 +2589,33 @@ static int ldb_kv_index_dn_and(struct ldb_module *module,
 		}
 	}
 
+	/*
+	 * Plan the order of the intersection, smallest lists first so
+	 * that the giant lists (like objectClass=user) are only loaded
+	 * if they still narrow the result.
+	 */
+	num_branches = tree->u.list.num_elements;
+	branches = talloc_array(list, struct ldb_kv_index_and_branch,
+				num_branches);
+	if (branches == NULL) {
+		return ldb_module_oom(module);
+	}
+	for (i = 0; i < num_branches; i++) {
+		branches[i].idx = i;
+		branches[i].estimate = UINT_MAX;
+		if (num_branches > 1) {
+			branches[i].estimate = ldb_kv_index_dn_estimate(
+				module, ldb_kv, tree->u.list.elements[i]);
+		}
+	}
+	TYPESAFE_QSORT(branches, num_branches, ldb_kv_index_and_branch_cmp);
+
 	/* now do a full intersection */
 	found = false;
 
-	for (i=0; i<tree->u.list.num_elements; i++) {
-		const struct ldb_parse_tree *subtree = tree->u.list.elements[i];
+	for (b = 0; b < num_branches; b++) {
+		const struct ldb_parse_tree *subtree =
+			tree->u.list.elements[branches[b].idx];
 		struct dn_list *list2;
 		int ret;
 
@@ -1748,6 +2631,7 @@ static int ldb_kv_index_dn_and(struct ldb_module *module,
 			list->dn = NULL;
 			list->count = 0;
 			talloc_free(list2);
+			talloc_free(branches);
 			return LDB_ERR_NO_SUCH_OBJECT;
 		}
 
@@ -1764,20 +2648,38 @@ static int ldb_kv_index_dn_and(struct ldb_module *module,
 			found = true;
 		} else if (!list_intersect(ldb_kv, list, list2)) {
 			talloc_free(list2);
+			talloc_free(branches);
 			return LDB_ERR_OPERATIONS_ERROR;
 		}
 
 		if (list->count == 0) {
 			list->dn = NULL;
+			talloc_free(branches);
 			return LDB_ERR_NO_SUCH_OBJECT;
 		}
 
 		if (list->count < 2) {
 			/* it isn't worth loading the next part of the tree */
+			talloc_free(branches);
+			return LDB_SUCCESS;
+		}
+
+		/*
+		 * The remaining branches are no smaller than the next
+		 * one, if that is much longer than the candidates we
+		 * have, leave the rest to ldb_match_message()
+		 */
+		if (b + 1 < num_branches &&
+		    list->count <= LDB_KV_INDEX_AND_SELECTIVE &&
+		    branches[b + 1].estimate / list->count >=
+		    LDB_KV_GALLOP_RATIO) {
+			talloc_free(branches);
 			return LDB_SUCCESS;
 		}
 	}
 
+	talloc_free(branches);
+
 	if (!found) {
 		/* none of the attributes were indexed */
 		return LDB_ERR_OPERATIONS_ERROR;
@@ -1793,7 +2695,7 @@ struct ldb_kv_ordered_index_context {
 };
 
 static int traverse_range_index(_UNUSED_ struct ldb_kv_private *ldb_kv,
-				_UNUSED_ struct ldb_val key,
+				struct ldb_val key,
 				struct ldb_val data,
 				void *state)
 {
@@ -1820,14 +2722,42 @@ static int traverse_range_index(_UNUSED_ struct ldb_kv_private *ldb_kv,
 		return ctx->error;
 	}
 
+	version = ldb_msg_find_attr_as_int(msg, LDB_KV_IDXVERSION, 0);
+
+	if (version == LDB_KV_GUID_SEGMENTED_INDEXING_VERSION) {
+		unsigned int bits =
+			ldb_msg_find_attr_as_uint(msg, LDB_KV_IDXSEGBITS, 0);
+		const char *head = NULL;
+
+		/* the offset of 3 is to remove the DN= prefix. */
+		if (key.length <= 3) {
+			talloc_free(msg);
+			ctx->error = LDB_ERR_OPERATIONS_ERROR;
+			return ctx->error;
+		}
+		head = talloc_strndup(msg,
+				      (const char *)key.data + 3,
+				      key.length - 3);
+		if (head == NULL) {
+			talloc_free(msg);
+			ctx->error = LDB_ERR_OPERATIONS_ERROR;
+			return ctx->error;
+		}
+
+		ctx->error = ldb_kv_dn_list_load_segments(module,
+							  head,
+							  bits,
+							  ctx->dn_list);
+		talloc_free(msg);
+		return ctx->error;
+	}
+
 	el = ldb_msg_find_element(msg, LDB_KV_IDX);
 	if (!el) {
 		talloc_free(msg);
 		return LDB_SUCCESS;
 	}
 
-	version = ldb_msg_find_attr_as_int(msg, LDB_KV_IDXVERSION, 0);
-
 	/*
 	 * we avoid copying the strings by stealing the list.  We have
 	 * to steal msg onto el->values (which looks odd) because
@@ -2289,6 +3219,7 @@ static int ldb_kv_index_filter(struct ldb_kv_private *ldb_kv,
 	unsigned int num_keys = 0;
 	uint8_t previous_guid_key[LDB_KV_GUID_KEY_SIZE] = {0};
 	struct ldb_val *keys = NULL;
+	struct ldb_kv_prefetch *prefetch = NULL;
 
 	/*
 	 * We have to allocate the key list (rather than just walk the
@@ -2366,12 +3297,20 @@ static int ldb_kv_index_filter(struct ldb_kv_private *ldb_kv,
 	}
 
 
+	/*
+	 * For a long list fetch the records in worker threads, if the
+	 * backend allows.  This returns NULL otherwise.
+	 */
+	prefetch = ldb_kv_prefetch_start(keys, ldb_kv, keys, num_keys,
+					 ac->unpack_attrs);
+
 	/*
 	 * Now that the list is a safe copy, send the callbacks
 	 */
 	for (i = 0; i < num_keys; i++) {
 		int ret;
 		bool matched;
+		bool prefetched;
 
 		/*
 		 * Check the time every 64 records, to reduce calls to
@@ -2413,24 +3352,28 @@ static int ldb_kv_index_filter(struct ldb_kv_private *ldb_kv,
 			}
 		}
 
-		msg = ldb_msg_new(ac);
-		if (!msg) {
-			talloc_free(keys);
-			return LDB_ERR_OPERATIONS_ERROR;
-		}
+		prefetched = ldb_kv_prefetch_get(prefetch, i, ac, &msg, &ret);
+		if (!prefetched) {
+			msg = ldb_msg_new(ac);
+			if (!msg) {
+				talloc_free(keys);
+				return LDB_ERR_OPERATIONS_ERROR;
+			}
 
-		ret =
-		    ldb_kv_search_key(ac->module,
-				      ldb_kv,
-				      keys[i],
-				      msg,
-				      LDB_UNPACK_DATA_FLAG_NO_VALUES_ALLOC |
-				      /*
-				       * The entry point ldb_kv_search_indexed is
-				       * only called from the read-locked
-				       * ldb_kv_search.
-				       */
-				      LDB_UNPACK_DATA_FLAG_READ_LOCKED);
+			ret = ldb_kv_search_key_attrs(
+				ac->module,
+				ldb_kv,
+				keys[i],
+				msg,
+				LDB_UNPACK_DATA_FLAG_NO_VALUES_ALLOC |
+				/*
+				 * The entry point ldb_kv_search_indexed is
+				 * only called from the read-locked
+				 * ldb_kv_search.
+				 */
+				LDB_UNPACK_DATA_FLAG_READ_LOCKED,
+				ac->unpack_attrs);
+		}
 		if (ret == LDB_ERR_NO_SUCH_OBJECT) {
 			/*
 			 * the record has disappeared? yes, this can
@@ -2473,6 +3416,7 @@ static int ldb_kv_index_filter(struct ldb_kv_private *ldb_kv,
 		if (ldb->redact.callback != NULL) {
 			ret = ldb->redact.callback(ldb->redact.module, ac->req, msg);
 			if (ret != LDB_SUCCESS) {
+				talloc_free(keys);
 				talloc_free(msg);
 				return ret;
 			}
@@ -2492,6 +3436,7 @@ static int ldb_kv_index_filter(struct ldb_kv_private *ldb_kv,
 
 		ret = ldb_msg_add_distinguished_name(msg);
 		if (ret == -1) {
+			talloc_free(keys);
 			talloc_free(msg);
 			return LDB_ERR_OPERATIONS_ERROR;
 		}
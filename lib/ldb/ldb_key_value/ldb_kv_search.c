@@ -34,6 +34,10 @@
 #include "ldb_kv.h"
 #include "ldb_private.h"
 #include "lib/util/attr.h"
+#ifdef HAVE_PTHREAD
+#include "system/threads.h"
+#include "system/wait.h"
+#endif
 /*
   search the database for a single simple dn.
   return LDB_ERR_NO_SUCH_OBJECT on record-not-found
@@ -102,6 +106,7 @@ struct ldb_kv_parse_data_unpack_ctx {
 	struct ldb_module *module;
 	struct ldb_kv_private *ldb_kv;
 	unsigned int unpack_flags;
+	const char * const *attrs;
 };
 
 static int ldb_kv_parse_data_unpack(struct ldb_val key,
@@ -151,8 +156,9 @@ static int ldb_kv_parse_data_unpack(struct ldb_val key,
 		}
 	}
 
-	ret = ldb_unpack_data_flags(ldb, &data_parse,
-				    ctx->msg, ctx->unpack_flags);
+	ret = ldb_unpack_data_attrs(ldb, &data_parse,
+				    ctx->msg, ctx->unpack_flags,
+				    ctx->attrs);
 	if (ret == -1) {
 		if (data_parse.data != data.data) {
 			talloc_free(data_parse.data);
@@ -178,13 +184,34 @@ int ldb_kv_search_key(struct ldb_module *module,
 		      const struct ldb_val ldb_key,
 		      struct ldb_message *msg,
 		      unsigned int unpack_flags)
+{
+	return ldb_kv_search_key_attrs(module,
+				       ldb_kv,
+				       ldb_key,
+				       msg,
+				       unpack_flags,
+				       NULL);
+}
+
+/*
+  as ldb_kv_search_key(), but only unpack the attributes in attrs
+  (or all of them if attrs is NULL), the caller still has to filter
+  the message as the record may be in a format that can't be skipped
+*/
+int ldb_kv_search_key_attrs(struct ldb_module *module,
+			    struct ldb_kv_private *ldb_kv,
+			    const struct ldb_val ldb_key,
+			    struct ldb_message *msg,
+			    unsigned int unpack_flags,
+			    const char * const *attrs)
 {
 	int ret;
 	struct ldb_kv_parse_data_unpack_ctx ctx = {
 		.msg = msg,
 		.module = module,
 		.unpack_flags = unpack_flags,
-		.ldb_kv = ldb_kv
+		.ldb_kv = ldb_kv,
+		.attrs = attrs
 	};
 
 	memset(msg, 0, sizeof(*msg));
@@ -212,6 +239,371 @@ int ldb_kv_search_key(struct ldb_module *module,
 	return LDB_SUCCESS;
 }
 
+/*
+ * Prefetch the records of an indexed search.
+ *
+ * The keys are handed out in windows.  The records of a window are
+ * fetched and unpacked by up to search_threads worker threads, each
+ * with its own reader from the backend, while the main thread matches
+ * and returns the records of the previous window.
+ *
+ * Only the fetch and ldb_unpack_data_flags() run in the workers, each
+ * on its own talloc hierarchy.  Matching, redaction and the callbacks
+ * use the schema, the modules and the talloc tree of the ldb_context,
+ * so they stay in the main thread and see the records in index order.
+ */
+#ifdef HAVE_PTHREAD
+
+/* Keys per worker in each window */
+#define LDB_KV_PREFETCH_BATCH 256
+
+struct ldb_kv_prefetch_slot {
+	struct ldb_message *msg;
+	int ret;
+};
+
+struct ldb_kv_prefetch_worker {
+	struct ldb_kv_prefetch *prefetch;
+	void *reader;
+	pthread_t thread;
+	bool running;
+	unsigned int first;
+	unsigned int count;
+	/*
+	 * The messages of the window being fetched and of the one
+	 * being consumed
+	 */
+	TALLOC_CTX *mem_ctx[2];
+	unsigned int ctx_idx;
+};
+
+struct ldb_kv_prefetch {
+	struct ldb_kv_private *ldb_kv;
+	struct ldb_context *ldb;
+	struct ldb_val *keys;
+	unsigned int num_keys;
+	/* Owned by the caller, only read by the workers */
+	const char * const *attrs;
+	struct ldb_kv_prefetch_slot *slots;
+	struct ldb_kv_prefetch_worker *workers;
+	unsigned int num_workers;
+	unsigned int num_windows;
+	/* Keys below next have been handed to the workers */
+	unsigned int next;
+	/* Keys below ready have been fetched */
+	unsigned int ready;
+	bool stopped;
+};
+
+struct ldb_kv_prefetch_unpack_ctx {
+	struct ldb_context *ldb;
+	struct ldb_message *msg;
+	const char * const *attrs;
+};
+
+static int ldb_kv_prefetch_unpack(_UNUSED_ struct ldb_val key,
+				  struct ldb_val data,
+				  void *private_data)
+{
+	struct ldb_kv_prefetch_unpack_ctx *ctx = private_data;
+	int ret;
+
+	/*
+	 * The reader keeps the data stable until the prefetch is freed,
+	 * and the values are duplicated before the message is returned.
+	 *
+	 * We are not on the main thread, so do not log. A corrupt
+	 * record fails here and is unpacked again, and reported, by
+	 * the main thread.
+	 */
+	ret = ldb_unpack_data_attrs(ctx->ldb, &data, ctx->msg,
+				    LDB_UNPACK_DATA_FLAG_NO_VALUES_ALLOC |
+				    LDB_UNPACK_DATA_FLAG_READ_LOCKED |
+				    LDB_UNPACK_DATA_FLAG_NO_DEBUG,
+				    ctx->attrs);
+	if (ret == -1) {
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+	return LDB_SUCCESS;
+}
+
+static void *ldb_kv_prefetch_worker_fn(void *private_data)
+{
+	struct ldb_kv_prefetch_worker *w = private_data;
+	struct ldb_kv_prefetch *prefetch = w->prefetch;
+	const struct kv_db_ops *ops = prefetch->ldb_kv->kv_ops;
+	TALLOC_CTX *mem_ctx = w->mem_ctx[w->ctx_idx];
+	unsigned int i;
+
+	for (i = w->first; i < w->first + w->count; i++) {
+		struct ldb_kv_prefetch_slot *slot = &prefetch->slots[i];
+		struct ldb_kv_prefetch_unpack_ctx ctx = {
+			.ldb = prefetch->ldb,
+			.attrs = prefetch->attrs,
+		};
+
+		ctx.msg = ldb_msg_new(mem_ctx);
+		if (ctx.msg == NULL) {
+			break;
+		}
+
+		slot->ret = ops->parallel_fetch_and_parse(
+			w->reader, prefetch->keys[i],
+			ldb_kv_prefetch_unpack, &ctx);
+		slot->msg = ctx.msg;
+	}
+
+	return NULL;
+}
+
+static void ldb_kv_prefetch_launch(struct ldb_kv_prefetch *prefetch)
+{
+	unsigned int first = prefetch->next;
+	unsigned int ctx_idx = prefetch->num_windows % 2;
+	unsigned int window, per_worker, i;
+	sigset_t mask, omask;
+
+	window = MIN(prefetch->num_keys - first,
+		     prefetch->num_workers * LDB_KV_PREFETCH_BATCH);
+	if (window == 0) {
+		return;
+	}
+	per_worker = (window + prefetch->num_workers - 1) /
+		prefetch->num_workers;
+
+	/* Signals are for the main thread, not for the workers */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, &omask);
+
+	for (i = 0; i < prefetch->num_workers; i++) {
+		struct ldb_kv_prefetch_worker *w = &prefetch->workers[i];
+		unsigned int start = MIN(i * per_worker, window);
+		unsigned int end = MIN(start + per_worker, window);
+		unsigned int j;
+		int ret;
+
+		w->first = first + start;
+		w->count = end - start;
+
+		/*
+		 * Anything the worker does not get to is fetched again
+		 * by the main thread
+		 */
+		for (j = w->first; j < w->first + w->count; j++) {
+			prefetch->slots[j].ret = LDB_ERR_OPERATIONS_ERROR;
+		}
+		if (w->count == 0) {
+			continue;
+		}
+
+		/* The window before the last one has been consumed */
+		TALLOC_FREE(w->mem_ctx[ctx_idx]);
+		w->mem_ctx[ctx_idx] = talloc_new(NULL);
+		if (w->mem_ctx[ctx_idx] == NULL) {
+			continue;
+		}
+		w->ctx_idx = ctx_idx;
+
+		ret = pthread_create(&w->thread, NULL,
+				     ldb_kv_prefetch_worker_fn, w);
+		if (ret != 0) {
+			continue;
+		}
+		w->running = true;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &omask, NULL);
+
+	prefetch->next = first + window;
+	prefetch->num_windows += 1;
+}
+
+static void ldb_kv_prefetch_join(struct ldb_kv_prefetch *prefetch)
+{
+	unsigned int i;
+
+	for (i = 0; i < prefetch->num_workers; i++) {
+		struct ldb_kv_prefetch_worker *w = &prefetch->workers[i];
+
+		if (w->running) {
+			pthread_join(w->thread, NULL);
+			w->running = false;
+		}
+	}
+
+	prefetch->ready = prefetch->next;
+}
+
+static void ldb_kv_prefetch_stop(struct ldb_kv_prefetch *prefetch)
+{
+	unsigned int i;
+
+	ldb_kv_prefetch_join(prefetch);
+
+	for (i = 0; i < prefetch->num_workers; i++) {
+		struct ldb_kv_prefetch_worker *w = &prefetch->workers[i];
+
+		TALLOC_FREE(w->mem_ctx[0]);
+		TALLOC_FREE(w->mem_ctx[1]);
+	}
+
+	prefetch->stopped = true;
+}
+
+static int ldb_kv_prefetch_destructor(struct ldb_kv_prefetch *prefetch)
+{
+	/* The workers use the readers, which are freed after this */
+	ldb_kv_prefetch_stop(prefetch);
+	return 0;
+}
+
+#endif /* HAVE_PTHREAD */
+
+/*
+ * Start fetching the records for keys in worker threads.
+ *
+ * Returns NULL if the search should be done in the main thread,
+ * because the list is short, the backend has no parallel readers,
+ * a transaction is active or threads are not available.
+ */
+struct ldb_kv_prefetch *ldb_kv_prefetch_start(TALLOC_CTX *mem_ctx,
+					      struct ldb_kv_private *ldb_kv,
+					      const struct ldb_val *keys,
+					      unsigned int num_keys,
+					      const char * const *attrs)
+{
+#ifdef HAVE_PTHREAD
+	const struct kv_db_ops *ops = ldb_kv->kv_ops;
+	struct ldb_kv_prefetch *prefetch = NULL;
+	unsigned int num_threads = ldb_kv->search_threads;
+	size_t key_size = 0;
+	uint8_t *key_data = NULL;
+	unsigned int i;
+
+	if (num_threads < 2 ||
+	    num_keys < 2 * LDB_KV_PREFETCH_BATCH ||
+	    ops->parallel_read_begin == NULL ||
+	    ops->parallel_fetch_and_parse == NULL ||
+	    !(ops->options & LDB_KV_OPTION_STABLE_READ_LOCK) ||
+	    ops->transaction_active(ldb_kv)) {
+		return NULL;
+	}
+
+	prefetch = talloc_zero(mem_ctx, struct ldb_kv_prefetch);
+	if (prefetch == NULL) {
+		return NULL;
+	}
+	prefetch->ldb_kv = ldb_kv;
+	prefetch->ldb = ldb_module_get_ctx(ldb_kv->module);
+	prefetch->num_keys = num_keys;
+	prefetch->attrs = attrs;
+
+	/*
+	 * Take a copy of the keys, so the workers do not depend on
+	 * the order in which the caller frees things.
+	 */
+	for (i = 0; i < num_keys; i++) {
+		key_size += keys[i].length;
+	}
+	prefetch->keys = talloc_array(prefetch, struct ldb_val, num_keys);
+	key_data = talloc_size(prefetch, key_size);
+	prefetch->slots = talloc_zero_array(prefetch,
+					    struct ldb_kv_prefetch_slot,
+					    num_keys);
+	prefetch->workers = talloc_zero_array(prefetch,
+					      struct ldb_kv_prefetch_worker,
+					      num_threads);
+	if (prefetch->keys == NULL || key_data == NULL ||
+	    prefetch->slots == NULL || prefetch->workers == NULL) {
+		TALLOC_FREE(prefetch);
+		return NULL;
+	}
+	for (i = 0; i < num_keys; i++) {
+		if (keys[i].length > 0) {
+			memcpy(key_data, keys[i].data, keys[i].length);
+		}
+		prefetch->keys[i].data = key_data;
+		prefetch->keys[i].length = keys[i].length;
+		key_data += keys[i].length;
+	}
+
+	for (i = 0; i < num_threads; i++) {
+		struct ldb_kv_prefetch_worker *w = &prefetch->workers[i];
+
+		w->prefetch = prefetch;
+		w->reader = ops->parallel_read_begin(ldb_kv, prefetch);
+		if (w->reader == NULL) {
+			break;
+		}
+	}
+	if (i < 2) {
+		TALLOC_FREE(prefetch);
+		return NULL;
+	}
+	prefetch->num_workers = i;
+
+	talloc_set_destructor(prefetch, ldb_kv_prefetch_destructor);
+
+	ldb_kv_prefetch_launch(prefetch);
+
+	return prefetch;
+#else
+	return NULL;
+#endif
+}
+
+/*
+ * Get the prefetched record for keys[idx], idx must increase with
+ * every call.
+ *
+ * Returns false if the caller has to fetch the record itself, *ret is
+ * LDB_SUCCESS or LDB_ERR_NO_SUCH_OBJECT otherwise.
+ */
+bool ldb_kv_prefetch_get(struct ldb_kv_prefetch *prefetch,
+			 unsigned int idx,
+			 TALLOC_CTX *mem_ctx,
+			 struct ldb_message **msg,
+			 int *ret)
+{
+#ifdef HAVE_PTHREAD
+	struct ldb_kv_prefetch_slot *slot = NULL;
+
+	if (prefetch == NULL || prefetch->stopped) {
+		return false;
+	}
+
+	if (prefetch->ldb_kv->kv_ops->transaction_active(prefetch->ldb_kv)) {
+		/*
+		 * A callback started a transaction, the records have
+		 * to come from it from now on.
+		 */
+		ldb_kv_prefetch_stop(prefetch);
+		return false;
+	}
+
+	if (idx >= prefetch->ready) {
+		ldb_kv_prefetch_join(prefetch);
+		ldb_kv_prefetch_launch(prefetch);
+	}
+	if (idx >= prefetch->ready) {
+		return false;
+	}
+
+	slot = &prefetch->slots[idx];
+	if (slot->ret != LDB_SUCCESS && slot->ret != LDB_ERR_NO_SUCH_OBJECT) {
+		/* Retry, and report any error, in the main thread */
+		return false;
+	}
+
+	*msg = talloc_steal(mem_ctx, slot->msg);
+	slot->msg = NULL;
+	*ret = slot->ret;
+	return true;
+#else
+	return false;
+#endif
+}
+
 /*
   search the database for a single simple dn, returning all attributes
   in a single message
@@ -378,8 +770,9 @@ static int search_func(_UNUSED_ struct ldb_kv_private *ldb_kv,
 	}
 
 	/* unpack the record */
-	ret = ldb_unpack_data_flags(ldb, &val, msg,
-				    LDB_UNPACK_DATA_FLAG_NO_VALUES_ALLOC);
+	ret = ldb_unpack_data_attrs(ldb, &val, msg,
+				    LDB_UNPACK_DATA_FLAG_NO_VALUES_ALLOC,
+				    ac->unpack_attrs);
 	if (ret == -1) {
 		talloc_free(msg);
 		ac->error = LDB_ERR_OPERATIONS_ERROR;
@@ -633,6 +1026,101 @@ static int ldb_kv_search_and_return_base(struct ldb_kv_private *ldb_kv,
 	return LDB_SUCCESS;
 }
 
+struct ldb_kv_unpack_attrs_ctx {
+	TALLOC_CTX *mem_ctx;
+	const char **attrs;
+};
+
+static int ldb_kv_unpack_attrs_add(struct ldb_parse_tree *tree,
+				   void *private_data)
+{
+	struct ldb_kv_unpack_attrs_ctx *ctx = private_data;
+	const char **attrs = NULL;
+	const char *attr = NULL;
+
+	switch (tree->operation) {
+	case LDB_OP_EQUALITY:
+		attr = tree->u.equality.attr;
+		break;
+	case LDB_OP_GREATER:
+	case LDB_OP_LESS:
+	case LDB_OP_APPROX:
+		attr = tree->u.comparison.attr;
+		break;
+	case LDB_OP_SUBSTRING:
+		attr = tree->u.substring.attr;
+		break;
+	case LDB_OP_PRESENT:
+		attr = tree->u.present.attr;
+		break;
+	case LDB_OP_EXTENDED:
+		/*
+		 * Without an attribute, or with dnAttributes, the
+		 * rule may look at any element of the message
+		 */
+		if (tree->u.extended.attr == NULL ||
+		    tree->u.extended.dnAttributes) {
+			return LDB_ERR_UNWILLING_TO_PERFORM;
+		}
+		attr = tree->u.extended.attr;
+		break;
+	default:
+		return LDB_SUCCESS;
+	}
+
+	if (ldb_attr_in_list(ctx->attrs, attr)) {
+		return LDB_SUCCESS;
+	}
+
+	attrs = ldb_attr_list_copy_add(ctx->mem_ctx, ctx->attrs, attr);
+	if (attrs == NULL) {
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+	talloc_free(ctx->attrs);
+	ctx->attrs = attrs;
+
+	return LDB_SUCCESS;
+}
+
+/*
+ * Work out which attributes a search has to unpack from each record:
+ * the attributes it returns and those the filter looks at.
+ *
+ * Returns NULL if every attribute is needed.  The redaction callback
+ * only looks at these and at attributes the module installing it
+ * adds to the request.
+ */
+static const char * const *ldb_kv_unpack_attrs(
+	TALLOC_CTX *mem_ctx,
+	const char * const *attrs,
+	const struct ldb_parse_tree *tree)
+{
+	struct ldb_kv_unpack_attrs_ctx ctx = {
+		.mem_ctx = mem_ctx,
+	};
+	int ret;
+
+	if (attrs == NULL || ldb_attr_in_list(attrs, "*")) {
+		return NULL;
+	}
+
+	ctx.attrs = ldb_attr_list_copy(mem_ctx, attrs);
+	if (ctx.attrs == NULL) {
+		return NULL;
+	}
+
+	ret = ldb_parse_tree_walk(discard_const_p(struct ldb_parse_tree,
+						  tree),
+				  ldb_kv_unpack_attrs_add,
+				  &ctx);
+	if (ret != LDB_SUCCESS) {
+		TALLOC_FREE(ctx.attrs);
+		return NULL;
+	}
+
+	return ctx.attrs;
+}
+
 /*
   search the database with a LDAP-like expression.
   choses a search method
@@ -669,6 +1157,9 @@ int ldb_kv_search(struct ldb_kv_context *ctx)
 	ctx->scope = req->op.search.scope;
 	ctx->base = req->op.search.base;
 	ctx->attrs = req->op.search.attrs;
+	ctx->unpack_attrs = ldb_kv_unpack_attrs(ctx,
+						req->op.search.attrs,
+						req->op.search.tree);
 
 	if ((req->op.search.base == NULL) || (ldb_dn_is_null(req->op.search.base) == true)) {
 
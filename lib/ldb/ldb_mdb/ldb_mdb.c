@@ -794,6 +794,97 @@ static int lmdb_nested_transaction_cancel(struct ldb_kv_private *ldb_kv)
 	return ret;
 }
 
+/*
+ * A private read transaction for a thread fetching records for
+ * ldb_kv_index_filter().  The env is opened with MDB_NOTLS, so the
+ * transaction is not bound to the thread that created it.
+ */
+struct lmdb_parallel_reader {
+	MDB_txn *txn;
+	MDB_dbi dbi;
+};
+
+static int lmdb_parallel_reader_destructor(struct lmdb_parallel_reader *r)
+{
+	mdb_txn_abort(r->txn);
+	return 0;
+}
+
+static void *lmdb_parallel_read_begin(struct ldb_kv_private *ldb_kv,
+				      TALLOC_CTX *mem_ctx)
+{
+	struct lmdb_private *lmdb = ldb_kv->lmdb_private;
+	struct lmdb_parallel_reader *r = NULL;
+	int ret;
+
+	if (lmdb->read_txn == NULL || lmdb_transaction_active(ldb_kv)) {
+		return NULL;
+	}
+
+	r = talloc_zero(mem_ctx, struct lmdb_parallel_reader);
+	if (r == NULL) {
+		return NULL;
+	}
+
+	/*
+	 * This fails with MDB_READERS_FULL if all reader slots are in
+	 * use, the search then runs in the main thread.
+	 */
+	ret = mdb_txn_begin(lmdb->env, NULL, MDB_RDONLY, &r->txn);
+	if (ret != MDB_SUCCESS) {
+		TALLOC_FREE(r);
+		return NULL;
+	}
+	talloc_set_destructor(r, lmdb_parallel_reader_destructor);
+
+	/*
+	 * The reader has to see exactly what the read lock sees, a
+	 * write by another process may have been committed since.
+	 */
+	if (mdb_txn_id(r->txn) != mdb_txn_id(lmdb->read_txn)) {
+		TALLOC_FREE(r);
+		return NULL;
+	}
+
+	/*
+	 * Must not be called by concurrent transactions, so it is done
+	 * here and not in the worker.
+	 */
+	ret = mdb_dbi_open(r->txn, NULL, 0, &r->dbi);
+	if (ret != MDB_SUCCESS) {
+		TALLOC_FREE(r);
+		return NULL;
+	}
+
+	return r;
+}
+
+static int lmdb_parallel_parse_record(void *reader,
+				      struct ldb_val key,
+				      int (*parser)(struct ldb_val key,
+						    struct ldb_val data,
+						    void *private_data),
+				      void *ctx)
+{
+	struct lmdb_parallel_reader *r = reader;
+	MDB_val mdb_key;
+	MDB_val mdb_data;
+	struct ldb_val data;
+	int ret;
+
+	mdb_key.mv_size = key.length;
+	mdb_key.mv_data = key.data;
+
+	ret = mdb_get(r->txn, r->dbi, &mdb_key, &mdb_data);
+	if (ret != MDB_SUCCESS) {
+		return ldb_mdb_err_map(ret);
+	}
+	data.data = mdb_data.mv_data;
+	data.length = mdb_data.mv_size;
+
+	return parser(key, data, ctx);
+}
+
 static struct kv_db_ops lmdb_key_value_ops = {
 	.options            = LDB_KV_OPTION_STABLE_READ_LOCK,
 
@@ -818,6 +909,8 @@ static struct kv_db_ops lmdb_key_value_ops = {
 	.begin_nested_write = lmdb_nested_transaction_start,
 	.finish_nested_write = lmdb_nested_transaction_commit,
 	.abort_nested_write = lmdb_nested_transaction_cancel,
+	.parallel_read_begin = lmdb_parallel_read_begin,
+	.parallel_fetch_and_parse = lmdb_parallel_parse_record,
 };
 
 static const char *lmdb_get_path(const char *url)
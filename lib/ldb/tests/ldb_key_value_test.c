@@ -351,6 +351,903 @@ static void test_init_store_set_index_cache_size_range(void **state)
 	TALLOC_FREE(ldb);
 }
 
+/*
+ * Test that ldb_kv_init_store sets the number of search threads
+ */
+static void test_init_store_search_threads(void **state)
+{
+	struct test_ctx *test_ctx = talloc_get_type_abort(
+		*state,
+		struct test_ctx);
+	struct ldb_module *module = NULL;
+	struct ldb_kv_private *ldb_kv = NULL;
+	struct ldb_context *ldb = NULL;
+	const char *options[] = {"search_threads:4", NULL};
+	int ret = LDB_SUCCESS;
+
+	module = talloc_zero(test_ctx, struct ldb_module);
+	ldb = talloc_zero(test_ctx, struct ldb_context);
+	ldb_kv = talloc_zero(test_ctx, struct ldb_kv_private);
+
+	ret = ldb_kv_init_store(ldb_kv, "test", ldb, options, &module);
+	assert_int_equal(LDB_SUCCESS, ret);
+	assert_int_equal(4, ldb_kv->search_threads);
+
+	TALLOC_FREE(ldb_kv);
+	TALLOC_FREE(module);
+	TALLOC_FREE(ldb);
+}
+
+/*
+ * Test that ldb_kv_init_store limits the number of search threads
+ */
+static void test_init_store_search_threads_range(void **state)
+{
+	struct test_ctx *test_ctx = talloc_get_type_abort(
+		*state,
+		struct test_ctx);
+	struct ldb_module *module = NULL;
+	struct ldb_kv_private *ldb_kv = NULL;
+	struct ldb_context *ldb = NULL;
+	const char *options[] = {"search_threads:1000", NULL};
+	int ret = LDB_SUCCESS;
+
+	module = talloc_zero(test_ctx, struct ldb_module);
+	ldb = talloc_zero(test_ctx, struct ldb_context);
+	ldb_kv = talloc_zero(test_ctx, struct ldb_kv_private);
+
+	ret = ldb_kv_init_store(ldb_kv, "test", ldb, options, &module);
+	assert_int_equal(LDB_SUCCESS, ret);
+	assert_int_equal(LDB_KV_MAX_SEARCH_THREADS, ldb_kv->search_threads);
+
+	TALLOC_FREE(ldb_kv);
+	TALLOC_FREE(module);
+	TALLOC_FREE(ldb);
+}
+
+#define NUM_PREFETCH_RECS 5000
+static struct ldb_val prefetch_recs[NUM_PREFETCH_RECS];
+static bool prefetch_transaction;
+static unsigned int prefetch_debug_calls;
+
+static void prefetch_debug(void *context,
+			   enum ldb_debug_level level,
+			   const char *fmt,
+			   va_list ap)
+{
+	prefetch_debug_calls += 1;
+}
+
+static bool mock_transaction_active(struct ldb_kv_private *ldb_kv)
+{
+	return prefetch_transaction;
+}
+
+static void *mock_parallel_read_begin(struct ldb_kv_private *ldb_kv,
+				      TALLOC_CTX *mem_ctx)
+{
+	return talloc_zero(mem_ctx, uint8_t);
+}
+
+/*
+ * Every 7th record is missing and every 11th fails to fetch
+ */
+static int mock_parallel_fetch_and_parse(
+	void *reader,
+	struct ldb_val key,
+	int (*parser)(struct ldb_val key,
+		      struct ldb_val data,
+		      void *private_data),
+	void *ctx)
+{
+	unsigned int i = strtoul((const char *)key.data, NULL, 10);
+
+	if (i % 7 == 0) {
+		return LDB_ERR_NO_SUCH_OBJECT;
+	}
+	if (i % 11 == 0) {
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+	return parser(key, prefetch_recs[i], ctx);
+}
+
+/*
+ * Test that ldb_kv_prefetch_get returns the records in key order.
+ *
+ * Every 13th record has trailing garbage. The workers must leave those
+ * to the main thread without logging anything.
+ */
+static void test_prefetch(void **state)
+{
+	struct test_ctx *test_ctx = talloc_get_type_abort(
+		*state,
+		struct test_ctx);
+	struct ldb_context *ldb = NULL;
+	struct ldb_module *module = NULL;
+	struct ldb_kv_private *ldb_kv = NULL;
+	struct ldb_kv_prefetch *prefetch = NULL;
+	struct ldb_val *keys = NULL;
+	unsigned int i;
+	int ret = LDB_SUCCESS;
+	const struct kv_db_ops ops = {
+		.options = LDB_KV_OPTION_STABLE_READ_LOCK,
+		.transaction_active = mock_transaction_active,
+		.parallel_read_begin = mock_parallel_read_begin,
+		.parallel_fetch_and_parse = mock_parallel_fetch_and_parse,
+	};
+
+	ldb = ldb_init(test_ctx, NULL);
+	assert_non_null(ldb);
+	module = talloc_zero(test_ctx, struct ldb_module);
+	module->ldb = ldb;
+	ldb_kv = talloc_zero(test_ctx, struct ldb_kv_private);
+	ldb_kv->kv_ops = &ops;
+	ldb_kv->module = module;
+	ldb_kv->search_threads = 4;
+
+	keys = talloc_array(test_ctx, struct ldb_val, NUM_PREFETCH_RECS);
+	assert_non_null(keys);
+
+	for (i = 0; i < NUM_PREFETCH_RECS; i++) {
+		struct ldb_message *msg = ldb_msg_new(test_ctx);
+
+		assert_non_null(msg);
+		msg->dn = ldb_dn_new_fmt(msg, ldb, "cn=%u", i);
+		assert_non_null(msg->dn);
+		ret = ldb_msg_add_fmt(msg, "num", "%u", i);
+		assert_int_equal(LDB_SUCCESS, ret);
+		ret = ldb_pack_data(ldb, msg, &prefetch_recs[i],
+				    LDB_PACKING_FORMAT_V2);
+		assert_int_equal(0, ret);
+		talloc_steal(test_ctx, prefetch_recs[i].data);
+		TALLOC_FREE(msg);
+
+		if (i % 13 == 0) {
+			uint8_t *data = talloc_realloc(
+				test_ctx,
+				prefetch_recs[i].data,
+				uint8_t,
+				prefetch_recs[i].length + 1);
+			assert_non_null(data);
+			data[prefetch_recs[i].length] = 0;
+			prefetch_recs[i].data = data;
+			prefetch_recs[i].length += 1;
+		}
+
+		keys[i].data = (uint8_t *)talloc_asprintf(keys, "%u", i);
+		assert_non_null(keys[i].data);
+		keys[i].length = strlen((const char *)keys[i].data) + 1;
+	}
+
+	/* Too short for the threads */
+	prefetch = ldb_kv_prefetch_start(keys, ldb_kv, keys, 10, NULL);
+	assert_null(prefetch);
+
+	prefetch_transaction = true;
+	prefetch = ldb_kv_prefetch_start(keys, ldb_kv, keys,
+					 NUM_PREFETCH_RECS, NULL);
+	assert_null(prefetch);
+	prefetch_transaction = false;
+
+	ldb_set_debug(ldb, prefetch_debug, NULL);
+	prefetch_debug_calls = 0;
+
+	prefetch = ldb_kv_prefetch_start(keys, ldb_kv, keys,
+					 NUM_PREFETCH_RECS, NULL);
+#ifdef HAVE_PTHREAD
+	assert_non_null(prefetch);
+#else
+	assert_null(prefetch);
+	skip();
+#endif
+
+	for (i = 0; i < NUM_PREFETCH_RECS; i++) {
+		struct ldb_message *msg = NULL;
+		bool ok;
+
+		if (i == NUM_PREFETCH_RECS - 100) {
+			/* A callback started a transaction */
+			prefetch_transaction = true;
+		}
+
+		ok = ldb_kv_prefetch_get(prefetch, i, test_ctx, &msg, &ret);
+		if (prefetch_transaction ||
+		    (i % 7 != 0 && (i % 11 == 0 || i % 13 == 0))) {
+			assert_false(ok);
+			continue;
+		}
+		assert_true(ok);
+		if (i % 7 == 0) {
+			assert_int_equal(LDB_ERR_NO_SUCH_OBJECT, ret);
+		} else {
+			char *dn = talloc_asprintf(msg, "cn=%u", i);
+
+			assert_int_equal(LDB_SUCCESS, ret);
+			assert_string_equal(dn, ldb_dn_get_linearized(msg->dn));
+			assert_int_equal(i, ldb_msg_find_attr_as_uint(msg,
+								      "num",
+								      0));
+		}
+		assert_ptr_equal(test_ctx, talloc_parent(msg));
+		TALLOC_FREE(msg);
+	}
+	prefetch_transaction = false;
+	assert_int_equal(0, prefetch_debug_calls);
+
+	TALLOC_FREE(keys);
+	TALLOC_FREE(ldb_kv);
+	TALLOC_FREE(module);
+	TALLOC_FREE(ldb);
+}
+
+static void make_guid_list(TALLOC_CTX *mem_ctx,
+			   struct dn_list *list,
+			   unsigned int count,
+			   unsigned int stride)
+{
+	unsigned int i;
+
+	list->dn = talloc_array(mem_ctx, struct ldb_val, count);
+	assert_non_null(list->dn);
+	list->count = count;
+
+	/* GUIDs sorted by i * stride, the second word is set as well */
+	for (i = 0; i < count; i++) {
+		uint8_t *guid = talloc_zero_array(list->dn,
+						  uint8_t,
+						  LDB_KV_GUID_SIZE);
+		unsigned int v = i * stride;
+
+		assert_non_null(guid);
+		guid[6] = (v >> 8) & 0xff;
+		guid[7] = v & 0xff;
+		guid[15] = (v * 7) & 0xff;
+		list->dn[i].data = guid;
+		list->dn[i].length = LDB_KV_GUID_SIZE;
+	}
+}
+
+/*
+ * Test the intersection of sorted GUID lists, walking both lists and
+ * galloping through the long one
+ */
+static void test_guid_list_intersect(void **state)
+{
+	struct test_ctx *test_ctx = talloc_get_type_abort(
+		*state,
+		struct test_ctx);
+	unsigned int strides[][2] = {
+		{ 3, 5 },	/* similar length */
+		{ 2, 1 },
+		{ 1, 200 },	/* gallop */
+		{ 997, 1 },
+	};
+	unsigned int s;
+
+	for (s = 0; s < ARRAY_SIZE(strides); s++) {
+		struct dn_list l1 = {}, l2 = {};
+		const struct dn_list *short_list = NULL, *long_list = NULL;
+		struct ldb_val *dn3 = NULL;
+		unsigned int max = 60000;
+		unsigned int i, k, expected = 0;
+
+		make_guid_list(test_ctx, &l1, max / strides[s][0],
+			       strides[s][0]);
+		make_guid_list(test_ctx, &l2, max / strides[s][1],
+			       strides[s][1]);
+		if (l1.count < l2.count) {
+			short_list = &l1;
+			long_list = &l2;
+		} else {
+			short_list = &l2;
+			long_list = &l1;
+		}
+
+		dn3 = talloc_array(test_ctx, struct ldb_val,
+				   short_list->count);
+		assert_non_null(dn3);
+
+		k = ldb_kv_guid_list_intersect(short_list, long_list, dn3);
+
+		/* Multiples of both strides */
+		for (i = 0; i < short_list->count; i++) {
+			unsigned int v = i * (short_list == &l1 ?
+					      strides[s][0] : strides[s][1]);
+			if (v % strides[s][0] == 0 &&
+			    v % strides[s][1] == 0 &&
+			    v / strides[s][0] < l1.count &&
+			    v / strides[s][1] < l2.count) {
+				assert_true(expected < k);
+				assert_int_equal(0,
+						 ldb_val_equal_exact_ordered(
+							 short_list->dn[i],
+							 &dn3[expected]));
+				expected++;
+			}
+		}
+		assert_int_equal(expected, k);
+
+		TALLOC_FREE(l1.dn);
+		TALLOC_FREE(l2.dn);
+		TALLOC_FREE(dn3);
+	}
+}
+
+/*
+ * A kv backend on an in-memory tdb, counting the records written
+ */
+static struct tdb_context *segment_tdb;
+static unsigned int segment_stores;
+
+static int mock_tdb_store(struct ldb_kv_private *ldb_kv,
+			  struct ldb_val key,
+			  struct ldb_val data,
+			  int flags)
+{
+	TDB_DATA k = { .dptr = key.data, .dsize = key.length };
+	TDB_DATA d = { .dptr = data.data, .dsize = data.length };
+
+	segment_stores++;
+	return tdb_store(segment_tdb, k, d, flags);
+}
+
+static int mock_tdb_delete(struct ldb_kv_private *ldb_kv, struct ldb_val key)
+{
+	TDB_DATA k = { .dptr = key.data, .dsize = key.length };
+
+	return tdb_delete(segment_tdb, k);
+}
+
+static int mock_tdb_error(struct ldb_kv_private *ldb_kv)
+{
+	return ltdb_err_map(tdb_error(segment_tdb));
+}
+
+struct mock_tdb_parse_ctx {
+	int (*parser)(struct ldb_val key,
+		      struct ldb_val data,
+		      void *private_data);
+	void *private_data;
+	int ret;
+};
+
+static int mock_tdb_parse_wrapper(TDB_DATA key, TDB_DATA data, void *private)
+{
+	struct mock_tdb_parse_ctx *ctx = private;
+	struct ldb_val k = { .data = key.dptr, .length = key.dsize };
+	struct ldb_val d = { .data = data.dptr, .length = data.dsize };
+
+	ctx->ret = ctx->parser(k, d, ctx->private_data);
+	return ctx->ret;
+}
+
+static int mock_tdb_fetch_and_parse(struct ldb_kv_private *ldb_kv,
+				    struct ldb_val key,
+				    int (*parser)(struct ldb_val key,
+						  struct ldb_val data,
+						  void *private_data),
+				    void *private_data)
+{
+	TDB_DATA k = { .dptr = key.data, .dsize = key.length };
+	struct mock_tdb_parse_ctx ctx = {
+		.parser = parser,
+		.private_data = private_data,
+	};
+	int ret;
+
+	ret = tdb_parse_record(segment_tdb, k, mock_tdb_parse_wrapper, &ctx);
+	if (ret == -1) {
+		return ltdb_err_map(tdb_error(segment_tdb));
+	}
+	return ctx.ret;
+}
+
+static int count_records(struct tdb_context *tdb,
+			 TDB_DATA key,
+			 TDB_DATA data,
+			 void *private)
+{
+	return 0;
+}
+
+/*
+ * Sorted GUIDs spread evenly over the first two bytes
+ */
+static void make_spread_guid_list(TALLOC_CTX *mem_ctx,
+				  struct dn_list *list,
+				  unsigned int count)
+{
+	unsigned int i;
+
+	list->dn = talloc_array(mem_ctx, struct ldb_val, count);
+	assert_non_null(list->dn);
+	list->count = count;
+
+	for (i = 0; i < count; i++) {
+		uint8_t *guid = talloc_zero_array(list->dn,
+						  uint8_t,
+						  LDB_KV_GUID_SIZE);
+		unsigned int v = (i * 65536) / count;
+
+		assert_non_null(guid);
+		guid[0] = (v >> 8) & 0xff;
+		guid[1] = v & 0xff;
+		guid[15] = i & 0xff;
+		list->dn[i].data = guid;
+		list->dn[i].length = LDB_KV_GUID_SIZE;
+	}
+}
+
+static void assert_dn_list_equal(struct dn_list *l1, struct dn_list *l2)
+{
+	unsigned int i;
+
+	assert_int_equal(l1->count, l2->count);
+	for (i = 0; i < l1->count; i++) {
+		assert_int_equal(0, ldb_val_equal_exact_ordered(l1->dn[i],
+								&l2->dn[i]));
+	}
+}
+
+/*
+ * The GUID index part of ldb_kv_dn_list_load() from before index
+ * records were segmented, standing in for an older ldb opening the
+ * database
+ */
+static int baseline_dn_list_load(struct ldb_module *module,
+				 struct ldb_dn *dn,
+				 struct dn_list *list)
+{
+	struct ldb_message *msg = NULL;
+	struct ldb_message_element *el = NULL;
+	unsigned int i;
+	int ret, version;
+
+	msg = ldb_msg_new(list);
+	if (msg == NULL) {
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	ret = ldb_kv_search_dn1(module,
+				dn,
+				msg,
+				LDB_UNPACK_DATA_FLAG_NO_DN |
+				LDB_UNPACK_DATA_FLAG_READ_LOCKED);
+	if (ret != LDB_SUCCESS) {
+		talloc_free(msg);
+		return ret;
+	}
+
+	el = ldb_msg_find_element(msg, LDB_KV_IDX);
+	if (!el) {
+		talloc_free(msg);
+		return LDB_SUCCESS;
+	}
+
+	version = ldb_msg_find_attr_as_int(msg, LDB_KV_IDXVERSION, 0);
+	if (version != LDB_KV_GUID_INDEXING_VERSION) {
+		talloc_free(msg);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	if (el->num_values == 0) {
+		talloc_free(msg);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	if ((el->values[0].length % LDB_KV_GUID_SIZE) != 0) {
+		talloc_free(msg);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	list->count = el->values[0].length / LDB_KV_GUID_SIZE;
+	list->dn = talloc_array(list, struct ldb_val, list->count);
+	if (list->dn == NULL) {
+		talloc_free(msg);
+		return LDB_ERR_OPERATIONS_ERROR;
+	}
+
+	talloc_steal(list->dn, msg);
+	for (i = 0; i < list->count; i++) {
+		list->dn[i].data = &el->values[0].data[i * LDB_KV_GUID_SIZE];
+		list->dn[i].length = LDB_KV_GUID_SIZE;
+	}
+
+	talloc_free(msg->elements);
+	return LDB_SUCCESS;
+}
+
+/*
+ * Test that large GUID index records are split into segments, that a
+ * change only rewrites one segment, and that the segments are removed
+ * again when the list shrinks
+ */
+static void test_index_segments(void **state)
+{
+	struct test_ctx *test_ctx = talloc_get_type_abort(
+		*state,
+		struct test_ctx);
+	struct ldb_context *ldb = NULL;
+	struct ldb_module *module = NULL;
+	struct ldb_kv_private *ldb_kv = NULL;
+	struct ldb_dn *dn = NULL;
+	struct dn_list list = {};
+	struct dn_list *loaded = NULL;
+	struct ldb_val extra;
+	uint8_t extra_guid[LDB_KV_GUID_SIZE] = { 0x80, 0x00, 0x01 };
+	unsigned int pos;
+	int ret;
+	const struct kv_db_ops ops = {
+		.store = mock_tdb_store,
+		.delete = mock_tdb_delete,
+		.fetch_and_parse = mock_tdb_fetch_and_parse,
+		.error = mock_tdb_error,
+	};
+
+	ldb = ldb_init(test_ctx, NULL);
+	assert_non_null(ldb);
+	module = talloc_zero(test_ctx, struct ldb_module);
+	module->ldb = ldb;
+	ldb_kv = talloc_zero(test_ctx, struct ldb_kv_private);
+	ldb_kv->kv_ops = &ops;
+	ldb_kv->cache = talloc_zero(ldb_kv, struct ldb_kv_cache);
+	ldb_kv->cache->GUID_index_attribute = "objectGUID";
+	ldb_kv->pack_format_version = LDB_PACKING_FORMAT_V2;
+	ldb_kv->index_segment_size = 16;
+	ldb_module_set_private(module, ldb_kv);
+
+	segment_tdb = tdb_open(NULL, 0, TDB_INTERNAL, O_RDWR, 0);
+	assert_non_null(segment_tdb);
+
+	dn = ldb_dn_new(test_ctx, ldb, "@INDEX:OBJECTCLASS:USER");
+	assert_non_null(dn);
+
+	/* 100 GUIDs are split 8 ways: the head and 8 segments */
+	make_spread_guid_list(test_ctx, &list, 100);
+	ret = ldb_kv_dn_list_store_full(module, ldb_kv, dn, &list);
+	assert_int_equal(LDB_SUCCESS, ret);
+	assert_int_equal(9, tdb_traverse(segment_tdb, count_records, NULL));
+
+	loaded = talloc_zero(test_ctx, struct dn_list);
+	assert_non_null(loaded);
+	ret = ldb_kv_dn_list_load(module, ldb_kv, dn, loaded,
+				  DN_LIST_WILL_BE_READ_ONLY);
+	assert_int_equal(LDB_SUCCESS, ret);
+	assert_dn_list_equal(&list, loaded);
+	TALLOC_FREE(loaded);
+
+	/* An older version fails, rather than seeing an empty list */
+	loaded = talloc_zero(test_ctx, struct dn_list);
+	assert_non_null(loaded);
+	ret = baseline_dn_list_load(module, dn, loaded);
+	assert_int_equal(LDB_ERR_OPERATIONS_ERROR, ret);
+	assert_int_equal(0, loaded->count);
+	TALLOC_FREE(loaded);
+
+	/* Adding one GUID only rewrites its segment */
+	extra.data = extra_guid;
+	extra.length = sizeof(extra_guid);
+	for (pos = 0; pos < list.count; pos++) {
+		if (ldb_val_equal_exact_ordered(extra, &list.dn[pos]) < 0) {
+			break;
+		}
+	}
+	list.dn = talloc_realloc(test_ctx, list.dn, struct ldb_val,
+				 list.count + 1);
+	assert_non_null(list.dn);
+	memmove(&list.dn[pos + 1], &list.dn[pos],
+		(list.count - pos) * sizeof(list.dn[0]));
+	list.dn[pos] = extra;
+	list.count++;
+
+	segment_stores = 0;
+	ret = ldb_kv_dn_list_store_full(module, ldb_kv, dn, &list);
+	assert_int_equal(LDB_SUCCESS, ret);
+	assert_int_equal(1, segment_stores);
+
+	loaded = talloc_zero(test_ctx, struct dn_list);
+	assert_non_null(loaded);
+	ret = ldb_kv_dn_list_load(module, ldb_kv, dn, loaded,
+				  DN_LIST_WILL_BE_READ_ONLY);
+	assert_int_equal(LDB_SUCCESS, ret);
+	assert_dn_list_equal(&list, loaded);
+	TALLOC_FREE(loaded);
+
+	/* A short list is stored whole, and the segments removed */
+	list.count = 5;
+	ret = ldb_kv_dn_list_store_full(module, ldb_kv, dn, &list);
+	assert_int_equal(LDB_SUCCESS, ret);
+	assert_int_equal(1, tdb_traverse(segment_tdb, count_records, NULL));
+
+	loaded = talloc_zero(test_ctx, struct dn_list);
+	assert_non_null(loaded);
+	ret = ldb_kv_dn_list_load(module, ldb_kv, dn, loaded,
+				  DN_LIST_WILL_BE_READ_ONLY);
+	assert_int_equal(LDB_SUCCESS, ret);
+	assert_dn_list_equal(&list, loaded);
+	TALLOC_FREE(loaded);
+
+	/* An empty list removes everything */
+	TALLOC_FREE(list.dn);
+	make_spread_guid_list(test_ctx, &list, 200);
+	ret = ldb_kv_dn_list_store_full(module, ldb_kv, dn, &list);
+	assert_int_equal(LDB_SUCCESS, ret);
+	assert_true(tdb_traverse(segment_tdb, count_records, NULL) > 1);
+	list.count = 0;
+	ret = ldb_kv_dn_list_store_full(module, ldb_kv, dn, &list);
+	assert_int_equal(LDB_SUCCESS, ret);
+	assert_int_equal(0, tdb_traverse(segment_tdb, count_records, NULL));
+
+	tdb_close(segment_tdb);
+	segment_tdb = NULL;
+	TALLOC_FREE(list.dn);
+	TALLOC_FREE(ldb_kv);
+	TALLOC_FREE(module);
+	TALLOC_FREE(ldb);
+}
+
+static void store_index(struct ldb_module *module,
+			struct ldb_kv_private *ldb_kv,
+			const char *attr,
+			const char *value,
+			struct dn_list *list)
+{
+	struct ldb_context *ldb = ldb_module_get_ctx(module);
+	enum key_truncation truncation = KEY_NOT_TRUNCATED;
+	struct ldb_val v = {
+		.data = discard_const_p(uint8_t, value),
+		.length = strlen(value),
+	};
+	struct ldb_dn *dn = NULL;
+	int ret;
+
+	dn = ldb_kv_index_key(ldb, module, ldb_kv, attr, &v, NULL,
+			      &truncation);
+	assert_non_null(dn);
+	ret = ldb_kv_dn_list_store_full(module, ldb_kv, dn, list);
+	assert_int_equal(LDB_SUCCESS, ret);
+	TALLOC_FREE(dn);
+}
+
+static int index_dn_and(TALLOC_CTX *mem_ctx,
+			struct ldb_module *module,
+			struct ldb_kv_private *ldb_kv,
+			const char *filter,
+			unsigned int *count)
+{
+	struct ldb_parse_tree *tree = NULL;
+	struct dn_list *list = NULL;
+	int ret;
+
+	tree = ldb_parse_tree(mem_ctx, filter);
+	assert_non_null(tree);
+	list = talloc_zero(mem_ctx, struct dn_list);
+	assert_non_null(list);
+
+	ret = ldb_kv_index_dn_and(module, ldb_kv, tree, list);
+	*count = list->count;
+	TALLOC_FREE(list);
+	TALLOC_FREE(tree);
+	return ret;
+}
+
+/*
+ * Test that the branches of an AND are loaded smallest first, and
+ * that a selective result does not load the much longer lists
+ */
+static void test_index_dn_and_plan(void **state)
+{
+	struct test_ctx *test_ctx = talloc_get_type_abort(
+		*state,
+		struct test_ctx);
+	struct ldb_context *ldb = NULL;
+	struct ldb_module *module = NULL;
+	struct ldb_kv_private *ldb_kv = NULL;
+	struct ldb_parse_tree *tree = NULL;
+	struct dn_list big = {}, medium = {}, small = {};
+	unsigned int count, i;
+	int ret;
+	const struct kv_db_ops ops = {
+		.store = mock_tdb_store,
+		.delete = mock_tdb_delete,
+		.fetch_and_parse = mock_tdb_fetch_and_parse,
+		.error = mock_tdb_error,
+	};
+
+	ldb = ldb_init(test_ctx, NULL);
+	assert_non_null(ldb);
+	module = talloc_zero(test_ctx, struct ldb_module);
+	module->ldb = ldb;
+	ldb_kv = talloc_zero(test_ctx, struct ldb_kv_private);
+	ldb_kv->kv_ops = &ops;
+	ldb_kv->cache = talloc_zero(ldb_kv, struct ldb_kv_cache);
+	ldb_kv->cache->GUID_index_attribute = "objectGUID";
+	ldb_kv->cache->attribute_indexes = true;
+	ldb_kv->cache->indexlist = ldb_msg_new(ldb_kv->cache);
+	assert_non_null(ldb_kv->cache->indexlist);
+	ret = ldb_msg_add_string(ldb_kv->cache->indexlist,
+				 LDB_KV_IDXATTR, "cn");
+	assert_int_equal(LDB_SUCCESS, ret);
+	ret = ldb_msg_add_string(ldb_kv->cache->indexlist,
+				 LDB_KV_IDXATTR, "sn");
+	assert_int_equal(LDB_SUCCESS, ret);
+	ret = ldb_msg_add_string(ldb_kv->cache->indexlist,
+				 LDB_KV_IDXATTR, "ou");
+	assert_int_equal(LDB_SUCCESS, ret);
+	ldb_kv->pack_format_version = LDB_PACKING_FORMAT_V2;
+	ldb_module_set_private(module, ldb_kv);
+
+	segment_tdb = tdb_open(NULL, 0, TDB_INTERNAL, O_RDWR, 0);
+	assert_non_null(segment_tdb);
+
+	/*
+	 * small and medium are not in big, the last byte of a GUID
+	 * differs
+	 */
+	make_spread_guid_list(test_ctx, &big, 1000);
+	make_spread_guid_list(test_ctx, &medium, 100);
+	make_spread_guid_list(test_ctx, &small, 5);
+	for (i = 0; i < medium.count; i++) {
+		medium.dn[i].data[14] = 1;
+	}
+	for (i = 0; i < small.count; i++) {
+		small.dn[i].data[14] = 2;
+	}
+	store_index(module, ldb_kv, "cn", "big", &big);
+	store_index(module, ldb_kv, "sn", "medium", &medium);
+	store_index(module, ldb_kv, "ou", "small", &small);
+
+	tree = ldb_parse_tree(test_ctx, "(cn=big)");
+	assert_non_null(tree);
+	assert_int_equal(1000, ldb_kv_index_dn_estimate(module, ldb_kv, tree));
+	TALLOC_FREE(tree);
+	tree = ldb_parse_tree(test_ctx, "(cn=none)");
+	assert_non_null(tree);
+	assert_int_equal(0, ldb_kv_index_dn_estimate(module, ldb_kv, tree));
+	TALLOC_FREE(tree);
+	tree = ldb_parse_tree(test_ctx, "(description=big)");
+	assert_non_null(tree);
+	assert_int_equal(UINT_MAX,
+			 ldb_kv_index_dn_estimate(module, ldb_kv, tree));
+	TALLOC_FREE(tree);
+
+	/* big is never loaded, the small candidates are returned */
+	ret = index_dn_and(test_ctx, module, ldb_kv,
+			   "(&(cn=big)(ou=small))", &count);
+	assert_int_equal(LDB_SUCCESS, ret);
+	assert_int_equal(5, count);
+
+	/* medium is not long enough to skip */
+	ret = index_dn_and(test_ctx, module, ldb_kv,
+			   "(&(cn=big)(sn=medium)(ou=small))", &count);
+	assert_int_equal(LDB_ERR_NO_SUCH_OBJECT, ret);
+
+	/* A missing value ends the AND before anything is loaded */
+	ret = index_dn_and(test_ctx, module, ldb_kv,
+			   "(&(cn=big)(sn=none))", &count);
+	assert_int_equal(LDB_ERR_NO_SUCH_OBJECT, ret);
+
+	tdb_close(segment_tdb);
+	segment_tdb = NULL;
+	TALLOC_FREE(big.dn);
+	TALLOC_FREE(medium.dn);
+	TALLOC_FREE(small.dn);
+	TALLOC_FREE(ldb_kv);
+	TALLOC_FREE(module);
+	TALLOC_FREE(ldb);
+}
+
+/*
+ * Test that a search only unpacks the attributes it returns or
+ * matches on, and that the skipped ones are walked over correctly.
+ */
+static void test_unpack_attrs(void **state)
+{
+	struct test_ctx *test_ctx = talloc_get_type_abort(
+		*state,
+		struct test_ctx);
+	struct ldb_context *ldb = NULL;
+	struct ldb_message *msg = NULL;
+	struct ldb_message *unpacked = NULL;
+	struct ldb_parse_tree *tree = NULL;
+	const char * const *unpack_attrs = NULL;
+	struct ldb_val data;
+	const char *attrs[] = { "cn", NULL };
+	const char *star[] = { "cn", "*", NULL };
+	const char *none[] = { NULL };
+	char big[300];
+	int ret;
+
+	ldb = ldb_init(test_ctx, NULL);
+	assert_non_null(ldb);
+
+	tree = ldb_parse_tree(test_ctx, "(&(sn=x)(|(ou=y)(!(cn=z))))");
+	assert_non_null(tree);
+	unpack_attrs = ldb_kv_unpack_attrs(test_ctx, attrs, tree);
+	assert_non_null(unpack_attrs);
+	assert_non_null(unpack_attrs[2]);
+	assert_null(unpack_attrs[3]);
+	assert_true(ldb_attr_in_list(unpack_attrs, "cn"));
+	assert_true(ldb_attr_in_list(unpack_attrs, "sn"));
+	assert_true(ldb_attr_in_list(unpack_attrs, "ou"));
+
+	/* Only the filter attributes if none are returned */
+	unpack_attrs = ldb_kv_unpack_attrs(test_ctx, none, tree);
+	assert_non_null(unpack_attrs);
+	assert_non_null(unpack_attrs[2]);
+	assert_null(unpack_attrs[3]);
+
+	/* Everything is needed for *, NULL or dnAttributes */
+	assert_null(ldb_kv_unpack_attrs(test_ctx, NULL, tree));
+	assert_null(ldb_kv_unpack_attrs(test_ctx, star, tree));
+	tree = ldb_parse_tree(test_ctx, "(:dn:2.5.13.5:=z)");
+	assert_non_null(tree);
+	assert_null(ldb_kv_unpack_attrs(test_ctx, attrs, tree));
+
+	/* Skip elements with one, several and wide values */
+	memset(big, 'b', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+	msg = ldb_msg_new(test_ctx);
+	assert_non_null(msg);
+	msg->dn = ldb_dn_new(msg, ldb, "cn=test");
+	assert_non_null(msg->dn);
+	ret = ldb_msg_add_string(msg, "description", big);
+	assert_int_equal(LDB_SUCCESS, ret);
+	ret = ldb_msg_add_string(msg, "cn", "test");
+	assert_int_equal(LDB_SUCCESS, ret);
+	ret = ldb_msg_add_string(msg, "member", "a");
+	assert_int_equal(LDB_SUCCESS, ret);
+	ret = ldb_msg_add_string(msg, "member", "b");
+	assert_int_equal(LDB_SUCCESS, ret);
+	ret = ldb_msg_add_string(msg, "sn", "x");
+	assert_int_equal(LDB_SUCCESS, ret);
+	ret = ldb_pack_data(ldb, msg, &data, LDB_PACKING_FORMAT_V2);
+	assert_int_equal(0, ret);
+	talloc_steal(msg, data.data);
+
+	unpacked = ldb_msg_new(test_ctx);
+	assert_non_null(unpacked);
+	ret = ldb_unpack_data_attrs(ldb, &data, unpacked,
+				    LDB_UNPACK_DATA_FLAG_NO_VALUES_ALLOC,
+				    (const char * const []) { "SN", "cn", NULL });
+	assert_int_equal(0, ret);
+	assert_int_equal(2, unpacked->num_elements);
+	assert_string_equal("cn", unpacked->elements[0].name);
+	assert_string_equal("test",
+			    (const char *)unpacked->elements[0].values[0].data);
+	assert_string_equal("sn", unpacked->elements[1].name);
+	assert_string_equal("x",
+			    (const char *)unpacked->elements[1].values[0].data);
+	assert_string_equal("cn=test", ldb_dn_get_linearized(unpacked->dn));
+	TALLOC_FREE(unpacked);
+
+	unpacked = ldb_msg_new(test_ctx);
+	assert_non_null(unpacked);
+	ret = ldb_unpack_data_attrs(ldb, &data, unpacked, 0, none);
+	assert_int_equal(0, ret);
+	assert_int_equal(0, unpacked->num_elements);
+	TALLOC_FREE(unpacked);
+
+	unpacked = ldb_msg_new(test_ctx);
+	assert_non_null(unpacked);
+	ret = ldb_unpack_data_attrs(ldb, &data, unpacked, 0, star);
+	assert_int_equal(0, ret);
+	assert_int_equal(4, unpacked->num_elements);
+	assert_int_equal(2, unpacked->elements[2].num_values);
+	TALLOC_FREE(unpacked);
+
+	/* A truncated record is still rejected */
+	data.length -= 1;
+	unpacked = ldb_msg_new(test_ctx);
+	assert_non_null(unpacked);
+	ret = ldb_unpack_data_attrs(ldb, &data, unpacked, 0, attrs);
+	assert_int_equal(-1, ret);
+	TALLOC_FREE(unpacked);
+
+	TALLOC_FREE(msg);
+	TALLOC_FREE(ldb);
+}
+
 int main(int argc, const char **argv)
 {
 	const struct CMUnitTest tests[] = {
@@ -382,6 +1279,34 @@ int main(int argc, const char **argv)
 			test_init_store_set_index_cache_size_range,
 			setup,
 			teardown),
+		cmocka_unit_test_setup_teardown(
+			test_init_store_search_threads,
+			setup,
+			teardown),
+		cmocka_unit_test_setup_teardown(
+			test_init_store_search_threads_range,
+			setup,
+			teardown),
+		cmocka_unit_test_setup_teardown(
+			test_prefetch,
+			setup,
+			teardown),
+		cmocka_unit_test_setup_teardown(
+			test_guid_list_intersect,
+			setup,
+			teardown),
+		cmocka_unit_test_setup_teardown(
+			test_index_segments,
+			setup,
+			teardown),
+		cmocka_unit_test_setup_teardown(
+			test_index_dn_and_plan,
+			setup,
+			teardown),
+		cmocka_unit_test_setup_teardown(
+			test_unpack_attrs,
+			setup,
+			teardown),
 	};
 
 	cmocka_set_message_output(CM_OUTPUT_SUBUNIT);
@@ -55,6 +55,10 @@ static bool tdb_check_header(struct tdb_context *tdb, tdb_off_t *recovery)
 	if (hdr.hash_size != tdb->hash_size)
 		goto corrupt;
 
+	if ((tdb->feature_flags & TDB_FEATURE_FLAG_RESIZE) &&
+	    hdr.hash_buckets != 0 && hdr.hash_buckets < hdr.hash_size)
+		goto corrupt;
+
 	if (hdr.recovery_start != 0 &&
 	    hdr.recovery_start < TDB_DATA_START(tdb->hash_size))
 		goto corrupt;
@@ -324,6 +328,34 @@ static bool tdb_check_free_record(struct tdb_context *tdb,
 	return true;
 }
 
+/* Check that a hash segment is one the header knows about. */
+static bool tdb_check_hash_segment(struct tdb_context *tdb,
+				   tdb_off_t off,
+				   const struct tdb_record *rec)
+{
+	unsigned k;
+
+	if (!tdb_check_record(tdb, off, rec))
+		return false;
+
+	for (k = 0; k < TDB_HASH_SEGMENTS; k++) {
+		tdb_off_t segment;
+
+		if (tdb_ofs_read(tdb, TDB_HASH_SEGMENT_OFS(k), &segment) == -1)
+			return false;
+		if (segment != off)
+			continue;
+		if (rec->data_len != (tdb->hash_size << k) * sizeof(tdb_off_t))
+			break;
+		return true;
+	}
+
+	tdb->ecode = TDB_ERR_CORRUPT;
+	TDB_LOG((tdb, TDB_DEBUG_ERROR,
+		 "Unexpected hash segment at offset %u\n", off));
+	return false;
+}
+
 /* Slow, but should be very rare. */
 size_t tdb_dead_space(struct tdb_context *tdb, tdb_off_t off)
 {
@@ -343,7 +375,7 @@ _PUBLIC_ int tdb_check(struct tdb_context *tdb,
 	      int (*check)(TDB_DATA key, TDB_DATA data, void *private_data),
 	      void *private_data)
 {
-	unsigned int h;
+	unsigned int h, c;
 	unsigned char **hashes;
 	tdb_off_t off, recovery_start;
 	struct tdb_record rec;
@@ -398,6 +430,30 @@ _PUBLIC_ int tdb_check(struct tdb_context *tdb,
 			record_offset(hashes[h], off);
 	}
 
+	/* The free lists per size class all go into hashes[0]. */
+	for (c = TDB_FREELIST_FIRST(tdb); c < TDB_FREELIST_CLASSES; c++) {
+		if (tdb_ofs_read(tdb, TDB_FREELIST_TOP(c), &off) == -1)
+			goto free;
+		if (off)
+			record_offset(hashes[0], off);
+	}
+
+	/* A resizable tdb can have more chains under each lock. */
+	for (h = 0; h < tdb->hash_size; h++) {
+		uint32_t cursor = 0;
+		tdb_off_t top;
+		int ret;
+
+		while ((ret = tdb_hash_list_next(tdb, h, &cursor, &top)) == 1) {
+			if (tdb_ofs_read(tdb, top, &off) == -1)
+				goto free;
+			if (off)
+				record_offset(hashes[h+1], off);
+		}
+		if (ret == -1)
+			goto free;
+	}
+
 	/* For each record, read it in and check it's ok. */
 	for (off = TDB_DATA_START(tdb->hash_size);
 	     off < tdb->map_size;
@@ -416,6 +472,10 @@ _PUBLIC_ int tdb_check(struct tdb_context *tdb,
 			if (!tdb_check_free_record(tdb, off, &rec, hashes))
 				goto free;
 			break;
+		case TDB_HASH_SEGMENT_MAGIC:
+			if (!tdb_check_hash_segment(tdb, off, &rec))
+				goto free;
+			break;
 		/* If we crash after ftruncate, we can get zeroes or fill. */
 		case TDB_RECOVERY_INVALID_MAGIC:
 		case 0x42424242:
@@ -58,37 +58,61 @@ static tdb_off_t tdb_dump_record(struct tdb_context *tdb, int hash,
 	return rec.next;
 }
 
+/*
+ * A resizable tdb can have more chains under a lock, and the freelist
+ * lock can cover one list per size class.
+ */
+static bool tdb_dump_next_top(struct tdb_context *tdb, int i,
+			      uint32_t *cursor, tdb_off_t *top)
+{
+	if (i == -1) {
+		if (*cursor >= TDB_FREELIST_CLASSES) {
+			return false;
+		}
+		*cursor += 1;
+		*top = TDB_FREELIST_TOP(*cursor);
+		return true;
+	}
+	return (tdb_hash_list_next(tdb, i, cursor, top) == 1);
+}
+
 static int tdb_dump_chain(struct tdb_context *tdb, int i)
 {
 	struct tdb_chainwalk_ctx chainwalk;
 	tdb_off_t rec_ptr, top;
+	uint32_t cursor = 0;
+
+	if (tdb_lock(tdb, i, F_WRLCK) != 0)
+		return -1;
 
 	if (i == -1) {
-		top = FREELIST_TOP;
+		cursor = TDB_FREELIST_FIRST(tdb);
+		top = TDB_FREELIST_TOP(cursor);
 	} else {
-		top = TDB_HASH_TOP(i);
+		top = tdb_hash_list_top(tdb, i, cursor);
+		if (top == 0)
+			return tdb_unlock(tdb, i, F_WRLCK);
 	}
 
-	if (tdb_lock(tdb, i, F_WRLCK) != 0)
-		return -1;
-
-	if (tdb_ofs_read(tdb, top, &rec_ptr) == -1)
-		return tdb_unlock(tdb, i, F_WRLCK);
+	do {
+		if (tdb_ofs_read(tdb, top, &rec_ptr) == -1)
+			return tdb_unlock(tdb, i, F_WRLCK);
 
-	tdb_chainwalk_init(&chainwalk, rec_ptr);
+		tdb_chainwalk_init(&chainwalk, rec_ptr);
 
-	if (rec_ptr)
-		printf("hash=%d\n", i);
+		if (rec_ptr)
+			printf("hash=%d\n", i);
 
-	while (rec_ptr) {
-		bool ok;
-		rec_ptr = tdb_dump_record(tdb, i, rec_ptr);
-		ok = tdb_chainwalk_check(tdb, &chainwalk, rec_ptr);
-		if (!ok) {
-			printf("circular hash chain %d\n", i);
-			break;
+		while (rec_ptr) {
+			bool ok;
+			rec_ptr = tdb_dump_record(tdb, i, rec_ptr);
+			ok = tdb_chainwalk_check(tdb, &chainwalk, rec_ptr);
+			if (!ok) {
+				printf("circular hash chain %d\n", i);
+				break;
+			}
 		}
-	}
+	} while (tdb_dump_next_top(tdb, i, &cursor, &top));
 
 	return tdb_unlock(tdb, i, F_WRLCK);
 }
@@ -109,38 +133,41 @@ _PUBLIC_ int tdb_printfreelist(struct tdb_context *tdb)
 	long total_free = 0;
 	tdb_off_t offset, rec_ptr;
 	struct tdb_record rec;
+	unsigned c;
 
 	if ((ret = tdb_lock(tdb, -1, F_WRLCK)) != 0)
 		return ret;
 
-	offset = FREELIST_TOP;
+	for (c = TDB_FREELIST_FIRST(tdb); c <= TDB_FREELIST_CLASSES; c++) {
+		offset = TDB_FREELIST_TOP(c);
 
-	/* read in the freelist top */
-	if (tdb_ofs_read(tdb, offset, &rec_ptr) == -1) {
-		tdb_unlock(tdb, -1, F_WRLCK);
-		return 0;
-	}
-
-	printf("freelist top=[0x%08x]\n", rec_ptr );
-	while (rec_ptr) {
-		if (tdb->methods->tdb_read(tdb, rec_ptr, (char *)&rec,
-					   sizeof(rec), DOCONV()) == -1) {
+		/* read in the freelist top */
+		if (tdb_ofs_read(tdb, offset, &rec_ptr) == -1) {
 			tdb_unlock(tdb, -1, F_WRLCK);
-			return -1;
+			return 0;
 		}
 
-		if (rec.magic != TDB_FREE_MAGIC) {
-			printf("bad magic 0x%08x in free list\n", rec.magic);
-			tdb_unlock(tdb, -1, F_WRLCK);
-			return -1;
+		printf("freelist top=[0x%08x]\n", rec_ptr );
+		while (rec_ptr) {
+			if (tdb->methods->tdb_read(tdb, rec_ptr, (char *)&rec,
+						   sizeof(rec), DOCONV()) == -1) {
+				tdb_unlock(tdb, -1, F_WRLCK);
+				return -1;
+			}
+
+			if (rec.magic != TDB_FREE_MAGIC) {
+				printf("bad magic 0x%08x in free list\n", rec.magic);
+				tdb_unlock(tdb, -1, F_WRLCK);
+				return -1;
+			}
+
+			printf("entry offset=[0x%08x], rec.rec_len = [0x%08x (%u)] (end = 0x%08x)\n",
+			       rec_ptr, rec.rec_len, rec.rec_len, rec_ptr + rec.rec_len);
+			total_free += rec.rec_len;
+
+			/* move to the next record */
+			rec_ptr = rec.next;
 		}
-
-		printf("entry offset=[0x%08x], rec.rec_len = [0x%08x (%u)] (end = 0x%08x)\n",
-		       rec_ptr, rec.rec_len, rec.rec_len, rec_ptr + rec.rec_len);
-		total_free += rec.rec_len;
-
-		/* move to the next record */
-		rec_ptr = rec.next;
 	}
 	printf("total rec_len = [0x%08lx (%lu)]\n", total_free, total_free);
 
@@ -67,6 +67,60 @@ static int update_tailer(struct tdb_context *tdb, tdb_off_t offset,
 			 &totalsize);
 }
 
+/*
+ * The free list a free record of rec_len belongs into. Returns
+ * TDB_FREELIST_CLASSES for the list at FREELIST_TOP.
+ *
+ * A record grown by a merge with its right neighbour stays where it
+ * is until an allocation walks over it, so a list can also hold
+ * records of a larger class. It never holds smaller ones.
+ */
+unsigned tdb_freelist_class(struct tdb_context *tdb, tdb_len_t rec_len)
+{
+	unsigned c;
+
+	if (!(tdb->feature_flags & TDB_FEATURE_FLAG_FREELIST_CLASSES)) {
+		return TDB_FREELIST_CLASSES;
+	}
+
+	for (c = 0; c < TDB_FREELIST_CLASSES; c++) {
+		if (rec_len < TDB_FREELIST_CLASS_SIZE(c)) {
+			break;
+		}
+	}
+	return c;
+}
+
+/* Put a free record at the front of free list c (must hold allocation lock) */
+static int tdb_freelist_push(struct tdb_context *tdb, unsigned c,
+			     tdb_off_t offset, struct tdb_record *rec)
+{
+	tdb_off_t top = TDB_FREELIST_TOP(c);
+
+	rec->magic = TDB_FREE_MAGIC;
+
+	if (tdb_ofs_read(tdb, top, &rec->next) == -1 ||
+	    tdb_rec_write(tdb, offset, rec) == -1 ||
+	    tdb_ofs_write(tdb, top, &offset) == -1) {
+		return -1;
+	}
+	return 0;
+}
+
+/* Empty all free lists, called from tdb_wipe_all() */
+int tdb_freelist_wipe(struct tdb_context *tdb)
+{
+	tdb_off_t zero = 0;
+	unsigned c;
+
+	for (c = TDB_FREELIST_FIRST(tdb); c <= TDB_FREELIST_CLASSES; c++) {
+		if (tdb_ofs_write(tdb, TDB_FREELIST_TOP(c), &zero) == -1) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
 /**
  * Read the record directly on the left.
  * Fail if there is no record on the left.
@@ -299,11 +353,8 @@ int tdb_free(struct tdb_context *tdb, tdb_off_t offset, struct tdb_record *rec)
 
 	/* Nothing to merge, prepend to free list */
 
-	rec->magic = TDB_FREE_MAGIC;
-
-	if (tdb_ofs_read(tdb, FREELIST_TOP, &rec->next) == -1 ||
-	    tdb_rec_write(tdb, offset, rec) == -1 ||
-	    tdb_ofs_write(tdb, FREELIST_TOP, &offset) == -1) {
+	if (tdb_freelist_push(tdb, tdb_freelist_class(tdb, rec->rec_len),
+			      offset, rec) == -1) {
 		TDB_LOG((tdb, TDB_DEBUG_FATAL, "tdb_free record write failed at offset=%u\n", offset));
 		goto fail;
 	}
@@ -329,10 +380,11 @@ done:
    able to free up the record without fragmentation
  */
 static tdb_off_t tdb_allocate_ofs(struct tdb_context *tdb,
-				  tdb_len_t length, tdb_off_t rec_ptr,
+				  tdb_len_t length, unsigned c, tdb_off_t rec_ptr,
 				  struct tdb_record *rec, tdb_off_t last_ptr)
 {
 #define MIN_REC_SIZE (sizeof(struct tdb_record) + sizeof(tdb_off_t) + 8)
+	unsigned new_c;
 
 	if (rec->rec_len < length + MIN_REC_SIZE) {
 		/* we have to grab the whole record */
@@ -352,7 +404,17 @@ static tdb_off_t tdb_allocate_ofs(struct tdb_context *tdb,
 
 	/* we're going to just shorten the existing record */
 	rec->rec_len -= (length + sizeof(*rec));
-	if (tdb_rec_write(tdb, rec_ptr, rec) == -1) {
+
+	new_c = tdb_freelist_class(tdb, rec->rec_len);
+	if (new_c != c) {
+		/* the rest goes into the list for its size */
+		if (tdb_ofs_write(tdb, last_ptr, &rec->next) == -1) {
+			return 0;
+		}
+		if (tdb_freelist_push(tdb, new_c, rec_ptr, rec) == -1) {
+			return 0;
+		}
+	} else if (tdb_rec_write(tdb, rec_ptr, rec) == -1) {
 		return 0;
 	}
 	if (update_tailer(tdb, rec_ptr, rec) == -1) {
@@ -377,46 +439,40 @@ static tdb_off_t tdb_allocate_ofs(struct tdb_context *tdb,
 	return rec_ptr;
 }
 
-/* allocate some space from the free list. The offset returned points
-   to a unconnected tdb_record within the database with room for at
-   least length bytes of total data
+struct tdb_bestfit {
+	tdb_off_t rec_ptr, last_ptr;
+	tdb_len_t rec_len;
+};
 
-   0 is returned if the space could not be allocated
+/*
+  walk free list c looking for a record of at least length bytes
+
+  With first_fit the first record that is large enough is taken,
+  otherwise the walk does a best fit search.
  */
-static tdb_off_t tdb_allocate_from_freelist(
-	struct tdb_context *tdb, tdb_len_t length, struct tdb_record *rec)
+static int tdb_freelist_search(struct tdb_context *tdb, unsigned c,
+			       tdb_len_t length, bool first_fit,
+			       struct tdb_bestfit *bestfit,
+			       bool *merge_created_candidate)
 {
-	tdb_off_t rec_ptr, last_ptr, newrec_ptr;
+	tdb_off_t rec_ptr, last_ptr;
 	struct tdb_chainwalk_ctx chainwalk;
+	struct tdb_record rec;
 	bool modified;
-	struct {
-		tdb_off_t rec_ptr, last_ptr;
-		tdb_len_t rec_len;
-	} bestfit;
 	float multiplier = 1.0;
-	bool merge_created_candidate;
 
-	/* over-allocate to reduce fragmentation */
-	length *= 1.25;
-
-	/* Extra bytes required for tailer */
-	length += sizeof(tdb_off_t);
-	length = TDB_ALIGN(length, TDB_ALIGNMENT);
-
- again:
-	merge_created_candidate = false;
-	last_ptr = FREELIST_TOP;
+	last_ptr = TDB_FREELIST_TOP(c);
 
 	/* read in the freelist top */
-	if (tdb_ofs_read(tdb, FREELIST_TOP, &rec_ptr) == -1)
-		return 0;
+	if (tdb_ofs_read(tdb, last_ptr, &rec_ptr) == -1)
+		return -1;
 
 	modified = false;
 	tdb_chainwalk_init(&chainwalk, rec_ptr);
 
-	bestfit.rec_ptr = 0;
-	bestfit.last_ptr = 0;
-	bestfit.rec_len = 0;
+	bestfit->rec_ptr = 0;
+	bestfit->last_ptr = 0;
+	bestfit->rec_len = 0;
 
 	/*
 	   this is a best fit allocation strategy. Originally we used
@@ -425,24 +481,25 @@ static tdb_off_t tdb_allocate_from_freelist(
 	 */
 	while (rec_ptr) {
 		int ret;
+		unsigned rec_c;
 		tdb_off_t left_ptr;
 		struct tdb_record left_rec;
 
-		if (tdb_rec_free_read(tdb, rec_ptr, rec) == -1) {
-			return 0;
+		if (tdb_rec_free_read(tdb, rec_ptr, &rec) == -1) {
+			return -1;
 		}
 
-		ret = check_merge_with_left_record(tdb, rec_ptr, rec,
+		ret = check_merge_with_left_record(tdb, rec_ptr, &rec,
 						   &left_ptr, &left_rec);
 		if (ret == -1) {
-			return 0;
+			return -1;
 		}
 		if (ret == 1) {
 			/* merged */
-			rec_ptr = rec->next;
-			ret = tdb_ofs_write(tdb, last_ptr, &rec->next);
+			rec_ptr = rec.next;
+			ret = tdb_ofs_write(tdb, last_ptr, &rec.next);
 			if (ret == -1) {
-				return 0;
+				return -1;
 			}
 
 			/*
@@ -466,12 +523,12 @@ static tdb_off_t tdb_allocate_from_freelist(
 			 * This way we can avoid expanding the database.
 			 */
 
-			if (bestfit.rec_ptr == left_ptr) {
-				bestfit.rec_len = left_rec.rec_len;
+			if (bestfit->rec_ptr == left_ptr) {
+				bestfit->rec_len = left_rec.rec_len;
 			}
 
 			if (left_rec.rec_len > length) {
-				merge_created_candidate = true;
+				*merge_created_candidate = true;
 			}
 
 			modified = true;
@@ -479,24 +536,47 @@ static tdb_off_t tdb_allocate_from_freelist(
 			continue;
 		}
 
-		if (rec->rec_len >= length) {
-			if (bestfit.rec_ptr == 0 ||
-			    rec->rec_len < bestfit.rec_len) {
-				bestfit.rec_len = rec->rec_len;
-				bestfit.rec_ptr = rec_ptr;
-				bestfit.last_ptr = last_ptr;
+		rec_c = tdb_freelist_class(tdb, rec.rec_len);
+		if (rec_c > c) {
+			/*
+			 * Grown by merges since it was freed, move it
+			 * to the list for its size.
+			 */
+			tdb_off_t next_ptr = rec.next;
+
+			if (tdb_ofs_write(tdb, last_ptr, &rec.next) == -1) {
+				return -1;
+			}
+			if (tdb_freelist_push(tdb, rec_c, rec_ptr, &rec) == -1) {
+				return -1;
+			}
+			rec_ptr = next_ptr;
+			modified = true;
+
+			continue;
+		}
+
+		if (rec.rec_len >= length) {
+			if (bestfit->rec_ptr == 0 ||
+			    rec.rec_len < bestfit->rec_len) {
+				bestfit->rec_len = rec.rec_len;
+				bestfit->rec_ptr = rec_ptr;
+				bestfit->last_ptr = last_ptr;
+			}
+			if (first_fit) {
+				break;
 			}
 		}
 
 		/* move to the next record */
 		last_ptr = rec_ptr;
-		rec_ptr = rec->next;
+		rec_ptr = rec.next;
 
 		if (!modified) {
 			bool ok;
 			ok = tdb_chainwalk_check(tdb, &chainwalk, rec_ptr);
 			if (!ok) {
-				return 0;
+				return -1;
 			}
 		}
 
@@ -504,8 +584,8 @@ static tdb_off_t tdb_allocate_from_freelist(
 		   stop searching if its also not too big. The
 		   definition of 'too big' changes as we scan
 		   through */
-		if (bestfit.rec_len > 0 &&
-		    bestfit.rec_len < length * multiplier) {
+		if (bestfit->rec_len > 0 &&
+		    bestfit->rec_len < length * multiplier) {
 			break;
 		}
 
@@ -516,24 +596,94 @@ static tdb_off_t tdb_allocate_from_freelist(
 		multiplier *= 1.05;
 	}
 
-	if (bestfit.rec_ptr != 0) {
+	return 0;
+}
+
+/* allocate some space from the free list. The offset returned points
+   to a unconnected tdb_record within the database with room for at
+   least length bytes of total data
+
+   0 is returned if the space could not be allocated
+ */
+static tdb_off_t tdb_allocate_from_freelist(
+	struct tdb_context *tdb, tdb_len_t length, struct tdb_record *rec)
+{
+	struct tdb_bestfit bestfit;
+	bool merge_created_candidate;
+	bool walked_lower = false;
+	unsigned first, c;
+
+	/* over-allocate to reduce fragmentation */
+	length *= 1.25;
+
+	/* Extra bytes required for tailer */
+	length += sizeof(tdb_off_t);
+	length = TDB_ALIGN(length, TDB_ALIGNMENT);
+
+	/*
+	 * The list for our size can hold smaller records, all lists
+	 * above it only hold records that are large enough. There we
+	 * take the first one, except in the list at FREELIST_TOP with
+	 * all the large records.
+	 */
+	first = tdb_freelist_class(tdb, length);
+
+ again:
+	merge_created_candidate = false;
+
+	for (c = first; c <= TDB_FREELIST_CLASSES; c++) {
+		bool first_fit = (c > first) && (c < TDB_FREELIST_CLASSES);
+		int ret;
+
+		ret = tdb_freelist_search(tdb, c, length, first_fit,
+					  &bestfit, &merge_created_candidate);
+		if (ret == -1) {
+			return 0;
+		}
+		if (bestfit.rec_ptr == 0) {
+			continue;
+		}
+
 		if (tdb_rec_free_read(tdb, bestfit.rec_ptr, rec) == -1) {
 			return 0;
 		}
 
-		newrec_ptr = tdb_allocate_ofs(tdb, length, bestfit.rec_ptr,
-					      rec, bestfit.last_ptr);
-		return newrec_ptr;
+		return tdb_allocate_ofs(tdb, length, c, bestfit.rec_ptr,
+					rec, bestfit.last_ptr);
 	}
 
 	if (merge_created_candidate) {
 		goto again;
 	}
 
+	/*
+	 * A merge with the right neighbour, for example with the space
+	 * tdb_expand() adds, can leave a large record in a list below
+	 * ours. Walk those once to move such records up before growing
+	 * the file.
+	 */
+	if (!walked_lower && (first > TDB_FREELIST_FIRST(tdb))) {
+		walked_lower = true;
+
+		for (c = TDB_FREELIST_FIRST(tdb); c < first; c++) {
+			int ret;
+
+			ret = tdb_freelist_search(tdb, c, length, false,
+						  &bestfit,
+						  &merge_created_candidate);
+			if (ret == -1) {
+				return 0;
+			}
+		}
+		goto again;
+	}
+
 	/* we didn't find enough space. See if we can expand the
 	   database and if we can then try again */
-	if (tdb_expand(tdb, length + sizeof(*rec)) == 0)
+	if (tdb_expand(tdb, length + sizeof(*rec)) == 0) {
+		walked_lower = false;
 		goto again;
+	}
 
 	return 0;
 }
@@ -650,6 +800,7 @@ static int tdb_freelist_merge_adjacent(struct tdb_context *tdb,
 	tdb_off_t cur, next;
 	int count = 0;
 	int merged = 0;
+	unsigned c;
 	int ret;
 
 	ret = tdb_lock(tdb, -1, F_RDLCK);
@@ -657,32 +808,36 @@ static int tdb_freelist_merge_adjacent(struct tdb_context *tdb,
 		return -1;
 	}
 
-	cur = FREELIST_TOP;
-	while (tdb_ofs_read(tdb, cur, &next) == 0 && next != 0) {
-		tdb_off_t next2;
+	for (c = TDB_FREELIST_FIRST(tdb); c <= TDB_FREELIST_CLASSES; c++) {
+		cur = TDB_FREELIST_TOP(c);
+		while (tdb_ofs_read(tdb, cur, &next) == 0 && next != 0) {
+			tdb_off_t next2;
 
-		count++;
-
-		ret = check_merge_ptr_with_left_record(tdb, next, &next2);
-		if (ret == -1) {
-			goto done;
-		}
-		if (ret == 1) {
-			/*
-			 * merged:
-			 * now let cur->next point to next2 instead of next
-			 */
+			count++;
 
-			ret = tdb_ofs_write(tdb, cur, &next2);
-			if (ret != 0) {
+			ret = check_merge_ptr_with_left_record(tdb, next,
+							       &next2);
+			if (ret == -1) {
 				goto done;
 			}
+			if (ret == 1) {
+				/*
+				 * merged:
+				 * now let cur->next point to next2 instead
+				 * of next
+				 */
+
+				ret = tdb_ofs_write(tdb, cur, &next2);
+				if (ret != 0) {
+					goto done;
+				}
+
+				next = next2;
+				merged++;
+			}
 
-			next = next2;
-			merged++;
+			cur = next;
 		}
-
-		cur = next;
 	}
 
 	if (count_records != NULL) {
@@ -707,14 +862,17 @@ static int tdb_freelist_size_no_merge(struct tdb_context *tdb)
 {
 	tdb_off_t ptr;
 	int count=0;
+	unsigned c;
 
 	if (tdb_lock(tdb, -1, F_RDLCK) == -1) {
 		return -1;
 	}
 
-	ptr = FREELIST_TOP;
-	while (tdb_ofs_read(tdb, ptr, &ptr) == 0 && ptr != 0) {
-		count++;
+	for (c = TDB_FREELIST_FIRST(tdb); c <= TDB_FREELIST_CLASSES; c++) {
+		ptr = TDB_FREELIST_TOP(c);
+		while (tdb_ofs_read(tdb, ptr, &ptr) == 0 && ptr != 0) {
+			count++;
+		}
 	}
 
 	tdb_unlock(tdb, -1, F_RDLCK);
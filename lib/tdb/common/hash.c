@@ -343,3 +343,439 @@ _PUBLIC_ unsigned int tdb_jenkins_hash(TDB_DATA *key)
 {
 	return hashlittle(key->dptr, key->dsize);
 }
+
+/*
+ * Online growth of the hash table, a variant of linear hashing.
+ *
+ * A tdb created with TDB_RESIZABLE starts out with the hash_size
+ * chains behind the header, like any other tdb. When a store adds a
+ * record to a chain that already holds TDB_HASH_SPLIT_LENGTH records,
+ * one more chain is split: The chain at the split cursor hands about
+ * half of its records to a new chain at the end of the table. When
+ * all hash_size << level chains are split, the level goes up by one
+ * and the split cursor starts at 0 again.
+ *
+ * header.hash_buckets holds the number of chains, the level and the
+ * split cursor are derived from it. The chains beyond hash_size live
+ * in segment records allocated from the freelist: segment k holds the
+ * hash_size << k chains starting at chain hash_size << k.
+ *
+ * Chain c only ever holds records with hash % hash_size == c %
+ * hash_size, so the lock list of a record stays BUCKET(hash) and the
+ * on-disk locking is unchanged. A split only needs the lock on the
+ * list of the chain it splits, and hash_buckets only changes with
+ * that lock held. A lookup in another list might see hash_buckets
+ * change under it, but that never changes the chain its hash maps to.
+ */
+
+static unsigned tdb_hash_level(uint32_t hash_size, uint32_t buckets)
+{
+	unsigned level = 0;
+
+	while ((level < TDB_HASH_SEGMENTS) &&
+	       (((uint64_t)hash_size << (level+1)) <= buckets)) {
+		level += 1;
+	}
+	return level;
+}
+
+/*
+ * Map a hash to its chain. The chain holds all hashes that are equal
+ * modulo hash_size << *plevel.
+ *
+ * "hash" is 64 bits wide so that traverse can pass in
+ * list + hash_size * cursor.
+ */
+static uint32_t tdb_hash_chain(uint32_t hash_size, uint32_t buckets,
+			       uint64_t hash, unsigned *plevel)
+{
+	unsigned level = tdb_hash_level(hash_size, buckets);
+	uint64_t size = (uint64_t)hash_size << level;
+	uint64_t chain = hash % size;
+
+	if (chain < buckets - size) {
+		/* This one has already been split */
+		chain = hash % (size * 2);
+		level += 1;
+	}
+
+	if (plevel != NULL) {
+		*plevel = level;
+	}
+	return chain;
+}
+
+static tdb_off_t tdb_hash_chain_top(struct tdb_context *tdb, uint32_t chain)
+{
+	tdb_off_t segment;
+	unsigned k = 0;
+
+	if (chain < tdb->hash_size) {
+		return TDB_HASH_TOP(chain);
+	}
+
+	while (((uint64_t)tdb->hash_size << (k+1)) <= chain) {
+		k += 1;
+	}
+
+	if (tdb_ofs_read(tdb, TDB_HASH_SEGMENT_OFS(k), &segment) == -1) {
+		return 0;
+	}
+	if (segment == 0) {
+		tdb->ecode = TDB_ERR_CORRUPT;
+		TDB_LOG((tdb, TDB_DEBUG_FATAL, "tdb_hash_chain_top: "
+			 "no segment for chain %"PRIu32"\n", chain));
+		return 0;
+	}
+
+	return segment + sizeof(struct tdb_record)
+		+ (chain - (tdb->hash_size << k)) * sizeof(tdb_off_t);
+}
+
+int tdb_hash_buckets(struct tdb_context *tdb, uint32_t *pbuckets)
+{
+	uint32_t buckets = tdb->hash_size;
+
+	if (tdb->feature_flags & TDB_FEATURE_FLAG_RESIZE) {
+		if (tdb_ofs_read(tdb, TDB_HASH_BUCKETS_OFS, &buckets) == -1) {
+			return -1;
+		}
+		buckets = MAX(buckets, tdb->hash_size);
+	}
+
+	*pbuckets = buckets;
+	return 0;
+}
+
+tdb_off_t _tdb_hash_top(struct tdb_context *tdb, uint32_t hash)
+{
+	uint32_t buckets, chain;
+
+	if (tdb_hash_buckets(tdb, &buckets) == -1) {
+		return 0;
+	}
+	chain = tdb_hash_chain(tdb->hash_size, buckets, hash, NULL);
+
+	return tdb_hash_chain_top(tdb, chain);
+}
+
+/*
+ * A traverse walks all chains of a lock list, but it drops the lock
+ * whenever it calls out, so chains can be split while it runs. The
+ * cursor numbers the chains of the list: chain list + hash_size * j
+ * is visited for all cursors that are equal to j modulo 1 << level.
+ * Cursors are walked in bit-reversed order, which makes the two halves
+ * of a split chain follow each other right where the chain was. So
+ * every record is visited exactly once, no matter whether its chain
+ * was split before or after the traverse got there. tdb_hash_split()
+ * makes sure that no chain is split while a traverse sits on it.
+ */
+
+static uint32_t tdb_hash_cursor_rev(uint32_t cursor)
+{
+	uint32_t rev = 0;
+	unsigned i;
+
+	for (i=0; i<TDB_HASH_SEGMENTS; i++) {
+		rev = (rev << 1) | (cursor & 1);
+		cursor >>= 1;
+	}
+	return rev;
+}
+
+tdb_off_t tdb_hash_list_top(struct tdb_context *tdb, uint32_t list,
+			    uint32_t cursor)
+{
+	uint32_t buckets, chain;
+
+	if (!(tdb->feature_flags & TDB_FEATURE_FLAG_RESIZE)) {
+		return TDB_HASH_TOP(list);
+	}
+
+	if (tdb_hash_buckets(tdb, &buckets) == -1) {
+		return 0;
+	}
+	chain = tdb_hash_chain(tdb->hash_size, buckets,
+			       list + (uint64_t)tdb->hash_size * cursor, NULL);
+
+	return tdb_hash_chain_top(tdb, chain);
+}
+
+/*
+ * Move *cursor past the chain it points to. Returns 1 and the head of
+ * the next chain of the list in *ptop, 0 if the list is done and -1
+ * on error. The caller must hold the lock on "list".
+ */
+int tdb_hash_list_next(struct tdb_context *tdb, uint32_t list,
+		       uint32_t *cursor, tdb_off_t *ptop)
+{
+	uint32_t mask = (1U << TDB_HASH_SEGMENTS) - 1;
+	uint32_t buckets, rev;
+	unsigned level;
+	tdb_off_t top;
+
+	if (!(tdb->feature_flags & TDB_FEATURE_FLAG_RESIZE)) {
+		return 0;
+	}
+
+	if (tdb_hash_buckets(tdb, &buckets) == -1) {
+		return -1;
+	}
+	tdb_hash_chain(tdb->hash_size, buckets,
+		       list + (uint64_t)tdb->hash_size * (*cursor), &level);
+
+	/* Skip all cursors that map to the chain we just did */
+	rev = tdb_hash_cursor_rev(*cursor | (mask & ~((1U << level) - 1)));
+	if (rev == mask) {
+		return 0;
+	}
+	*cursor = tdb_hash_cursor_rev(rev + 1);
+
+	top = tdb_hash_list_top(tdb, list, *cursor);
+	if (top == 0) {
+		return -1;
+	}
+	*ptop = top;
+	return 1;
+}
+
+/*
+ * The cursor of the chain "hash" lives in, for tdb_nextkey() to pick
+ * up a traverse from a key.
+ */
+int tdb_hash_list_cursor(struct tdb_context *tdb, uint32_t hash,
+			 uint32_t *cursor)
+{
+	uint32_t buckets, chain;
+
+	if (tdb_hash_buckets(tdb, &buckets) == -1) {
+		return -1;
+	}
+	chain = tdb_hash_chain(tdb->hash_size, buckets, hash, NULL);
+
+	*cursor = chain / tdb->hash_size;
+	return 0;
+}
+
+/* Make sure segment k exists, the chains in a new segment are empty */
+static int tdb_hash_segment(struct tdb_context *tdb, uint32_t hash,
+			    unsigned k)
+{
+	static const uint8_t zeros[4096];
+	tdb_len_t len = (tdb->hash_size << k) * sizeof(tdb_off_t);
+	struct tdb_record rec;
+	tdb_off_t segment;
+	tdb_len_t ofs;
+
+	if (tdb_ofs_read(tdb, TDB_HASH_SEGMENT_OFS(k), &segment) == -1) {
+		return -1;
+	}
+	if (segment != 0) {
+		return 0;
+	}
+
+	segment = tdb_allocate(tdb, hash, len, &rec);
+	if (segment == 0) {
+		return -1;
+	}
+
+	rec.next = 0;
+	rec.key_len = 0;
+	rec.data_len = len;
+	rec.full_hash = 0;
+	rec.magic = TDB_HASH_SEGMENT_MAGIC;
+
+	if (tdb_rec_write(tdb, segment, &rec) == -1) {
+		return -1;
+	}
+
+	for (ofs = 0; ofs < len; ofs += sizeof(zeros)) {
+		tdb_len_t n = MIN(len - ofs, sizeof(zeros));
+		int ret;
+
+		ret = tdb->methods->tdb_write(
+			tdb, segment + sizeof(rec) + ofs, zeros, n);
+		if (ret == -1) {
+			return -1;
+		}
+	}
+
+	return tdb_ofs_write(tdb, TDB_HASH_SEGMENT_OFS(k), &segment);
+}
+
+/*
+ * Split the chain at the split cursor. The caller holds the lock on
+ * its list and on BUCKET(hash).
+ */
+static int tdb_hash_split(struct tdb_context *tdb, uint32_t hash,
+			  uint32_t buckets)
+{
+	unsigned level = tdb_hash_level(tdb->hash_size, buckets);
+	uint32_t size = tdb->hash_size << level;
+	uint32_t split = buckets - size;
+	struct tdb_chainwalk_ctx chainwalk;
+	struct tdb_record rec;
+	tdb_off_t tops[2], last[2], rec_ptr;
+	tdb_off_t zero = 0;
+	int i;
+
+	if (tdb_hash_segment(tdb, hash, level) == -1) {
+		return -1;
+	}
+
+	tops[0] = tdb_hash_chain_top(tdb, split);
+	tops[1] = tdb_hash_chain_top(tdb, size + split);
+	if ((tops[0] == 0) || (tops[1] == 0)) {
+		return -1;
+	}
+
+	/*
+	 * A traverse continues from the record it sits on, don't pull
+	 * that one into another chain. Nobody can start sitting on one
+	 * of our records, we hold the list lock.
+	 */
+	if (tdb_ofs_read(tdb, tops[0], &rec_ptr) == -1) {
+		return -1;
+	}
+	tdb_chainwalk_init(&chainwalk, rec_ptr);
+
+	while (rec_ptr != 0) {
+		if (tdb_write_lock_record(tdb, rec_ptr) == -1) {
+			/* Try again with the next store */
+			return 0;
+		}
+		if (tdb_write_unlock_record(tdb, rec_ptr) == -1) {
+			return -1;
+		}
+		if (tdb_rec_read(tdb, rec_ptr, &rec) == -1) {
+			return -1;
+		}
+		rec_ptr = rec.next;
+
+		if (!tdb_chainwalk_check(tdb, &chainwalk, rec_ptr)) {
+			return -1;
+		}
+	}
+
+	last[0] = tops[0];
+	last[1] = tops[1];
+
+	if (tdb_ofs_read(tdb, tops[0], &rec_ptr) == -1) {
+		return -1;
+	}
+
+	while (rec_ptr != 0) {
+		if (tdb_rec_read(tdb, rec_ptr, &rec) == -1) {
+			return -1;
+		}
+
+		i = ((rec.full_hash % ((uint64_t)size * 2)) != split);
+
+		if (tdb_ofs_write(tdb, last[i], &rec_ptr) == -1) {
+			return -1;
+		}
+		last[i] = rec_ptr;
+		rec_ptr = rec.next;
+	}
+
+	for (i=0; i<2; i++) {
+		if (tdb_ofs_write(tdb, last[i], &zero) == -1) {
+			return -1;
+		}
+	}
+
+	buckets += 1;
+
+	return tdb_ofs_write(tdb, TDB_HASH_BUCKETS_OFS, &buckets);
+}
+
+/*
+ * Called after a new record went into the chain of "hash", with
+ * BUCKET(hash) locked. Splits a chain if that one got too long.
+ */
+int tdb_hash_grow(struct tdb_context *tdb, uint32_t hash)
+{
+	tdb_off_t top, rec_ptr;
+	uint32_t buckets, list;
+	unsigned length = 0;
+	unsigned level;
+	int ret;
+
+	if (!(tdb->feature_flags & TDB_FEATURE_FLAG_RESIZE)) {
+		return 0;
+	}
+
+	top = tdb_hash_top(tdb, hash);
+	if ((top == 0) || (tdb_ofs_read(tdb, top, &rec_ptr) == -1)) {
+		return -1;
+	}
+
+	while ((rec_ptr != 0) && (length <= TDB_HASH_SPLIT_LENGTH)) {
+		/* rec.next is the first field in the record */
+		if (tdb_ofs_read(tdb, rec_ptr, &rec_ptr) == -1) {
+			return -1;
+		}
+		length += 1;
+	}
+
+	if (length <= TDB_HASH_SPLIT_LENGTH) {
+		return 0;
+	}
+
+	if (tdb_hash_buckets(tdb, &buckets) == -1) {
+		return -1;
+	}
+	level = tdb_hash_level(tdb->hash_size, buckets);
+
+	if ((level == TDB_HASH_SEGMENTS) ||
+	    ((((uint64_t)tdb->hash_size << (level+1)) * sizeof(tdb_off_t))
+	     > UINT32_MAX)) {
+		/* That's as big as it gets */
+		return 0;
+	}
+
+	list = (buckets - (tdb->hash_size << level)) % tdb->hash_size;
+
+	/*
+	 * We already hold BUCKET(hash). Don't wait for a second list
+	 * lock, the next store will find the chain still too long.
+	 */
+	if (tdb_lock_nonblock(tdb, list, F_WRLCK) == -1) {
+		return 0;
+	}
+
+	/* Someone else might have split in the meantime */
+	ret = tdb_hash_buckets(tdb, &buckets);
+	if (ret == 0) {
+		level = tdb_hash_level(tdb->hash_size, buckets);
+
+		if ((buckets - (tdb->hash_size << level)) % tdb->hash_size
+		    == list) {
+			ret = tdb_hash_split(tdb, hash, buckets);
+		}
+	}
+
+	tdb_unlock(tdb, list, F_WRLCK);
+	return ret;
+}
+
+/* Called from tdb_wipe_all(): back to hash_size chains */
+int tdb_hash_wipe(struct tdb_context *tdb)
+{
+	tdb_off_t zero = 0;
+	unsigned k;
+
+	if (!(tdb->feature_flags & TDB_FEATURE_FLAG_RESIZE)) {
+		return 0;
+	}
+
+	if (tdb_ofs_write(tdb, TDB_HASH_BUCKETS_OFS, &zero) == -1) {
+		return -1;
+	}
+	for (k=0; k<TDB_HASH_SEGMENTS; k++) {
+		if (tdb_ofs_write(tdb, TDB_HASH_SEGMENT_OFS(k), &zero) == -1) {
+			return -1;
+		}
+	}
+	return 0;
+}
@@ -362,6 +362,8 @@ int tdb_nest_lock(struct tdb_context *tdb, uint32_t offset, int ltype,
 				if (ret != 0) {
 					return ret;
 				}
+			} else {
+				tdb_mutex_seqlock_lock(tdb, offset, F_WRLCK);
 			}
 			new_lck->ltype = F_WRLCK;
 		}
@@ -391,6 +393,10 @@ int tdb_nest_lock(struct tdb_context *tdb, uint32_t offset, int ltype,
 		return -1;
 	}
 
+	if (!(flags & TDB_LOCK_MARK_ONLY)) {
+		tdb_mutex_seqlock_lock(tdb, offset, ltype);
+	}
+
 	new_lck = &tdb->lockrecs[tdb->num_lockrecs];
 
 	new_lck->off = offset;
@@ -549,6 +555,7 @@ int tdb_nest_unlock(struct tdb_context *tdb, uint32_t offset, int ltype,
 	if (mark_lock) {
 		ret = 0;
 	} else {
+		tdb_mutex_seqlock_unlock(tdb, offset, lck->ltype);
 		ret = tdb_brunlock(tdb, ltype, offset, 1);
 	}
 
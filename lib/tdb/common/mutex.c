@@ -73,6 +73,12 @@ struct tdb_mutexes {
 	 * one mutex per hashchain.
 	 */
 	pthread_mutex_t hashchains[1];
+
+	/*
+	 * With TDB_FEATURE_FLAG_SEQLOCK the mutexes are followed by
+	 * one sequence counter per hash chain and one for the
+	 * allrecord lock, see tdb_mutex_seqlock_read_begin().
+	 */
 };
 
 bool tdb_have_mutexes(struct tdb_context *tdb)
@@ -91,6 +97,10 @@ size_t tdb_mutex_size(struct tdb_context *tdb)
 	mutex_size = sizeof(struct tdb_mutexes);
 	mutex_size += tdb->hash_size * sizeof(pthread_mutex_t);
 
+	if (tdb->feature_flags & TDB_FEATURE_FLAG_SEQLOCK) {
+		mutex_size += (tdb->hash_size + 1) * sizeof(uint32_t);
+	}
+
 	return TDB_ALIGN(mutex_size, tdb->page_size);
 }
 
@@ -193,8 +203,183 @@ static int chain_mutex_lock(pthread_mutex_t *m, bool waitflag)
 	return pthread_mutex_consistent(m);
 }
 
-static int allrecord_mutex_lock(struct tdb_mutexes *m, bool waitflag)
+/*
+ * Sequence counters for readers that don't lock, the classic seqlock.
+ *
+ * Anyone who modifies a hash chain holds its mutex as F_WRLCK. Taking
+ * that lock makes the chain's counter odd, dropping it makes it even
+ * again, see tdb_mutex_seqlock_lock() called from tdb_nest_lock().
+ * The allrecord lock does the same with its own counter, it is held
+ * during transaction commits and tdb_wipe_all().
+ *
+ * A reader notes both counters, gives up if one is odd, walks the
+ * chain and copies what it needs. If the counters did not change
+ * meanwhile, the copy is consistent. Readers never write to the
+ * mutex area, so they don't serialize with each other.
+ *
+ * A writer that dies leaves an odd counter behind. Whoever gets the
+ * mutex next with EOWNERDEAD or with the counter still odd makes it
+ * even again: nobody else can write the chain while we hold its lock.
+ */
+
+static uint32_t *tdb_mutex_seqlocks(struct tdb_context *tdb)
+{
+	struct tdb_mutexes *m = tdb->mutexes;
+
+	return (uint32_t *)&m->hashchains[tdb->hash_size + 1];
+}
+
+static bool tdb_have_seqlocks(struct tdb_context *tdb)
+{
+#ifdef TDB_HAVE_SEQLOCK
+	return ((tdb->feature_flags & TDB_FEATURE_FLAG_SEQLOCK) &&
+		(tdb->mutexes != NULL));
+#else
+	return false;
+#endif
+}
+
+#ifdef TDB_HAVE_SEQLOCK
+
+/* idx is the chain number, tdb->hash_size for the allrecord lock */
+
+static void tdb_mutex_seqlock_begin(struct tdb_context *tdb, unsigned idx)
+{
+	uint32_t *seq = &tdb_mutex_seqlocks(tdb)[idx];
+	uint32_t s = __atomic_load_n(seq, __ATOMIC_RELAXED);
+
+	__atomic_store_n(seq, (s + 1) | 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void tdb_mutex_seqlock_end(struct tdb_context *tdb, unsigned idx)
+{
+	uint32_t *seq = &tdb_mutex_seqlocks(tdb)[idx];
+	uint32_t s = __atomic_load_n(seq, __ATOMIC_RELAXED);
+
+	__atomic_store_n(seq, (s + 1) & ~1U, __ATOMIC_RELEASE);
+}
+
+static void tdb_mutex_seqlock_repair(struct tdb_context *tdb, unsigned idx)
+{
+	uint32_t *seq;
+
+	if (!tdb_have_seqlocks(tdb)) {
+		return;
+	}
+
+	seq = &tdb_mutex_seqlocks(tdb)[idx];
+
+	if (__atomic_load_n(seq, __ATOMIC_RELAXED) & 1) {
+		tdb_mutex_seqlock_end(tdb, idx);
+	}
+}
+
+#else
+
+static void tdb_mutex_seqlock_begin(struct tdb_context *tdb, unsigned idx)
+{
+	return;
+}
+
+static void tdb_mutex_seqlock_end(struct tdb_context *tdb, unsigned idx)
+{
+	return;
+}
+
+static void tdb_mutex_seqlock_repair(struct tdb_context *tdb, unsigned idx)
+{
+	return;
+}
+
+#endif
+
+/*
+ * Called from tdb_nest_lock() for every lock it takes in the kernel
+ * (or upgrades to F_WRLCK), the caller only modifies the chain with
+ * F_WRLCK.
+ */
+void tdb_mutex_seqlock_lock(struct tdb_context *tdb, off_t off, int ltype)
+{
+	unsigned idx;
+
+	if (!tdb_have_seqlocks(tdb)) {
+		return;
+	}
+	if (!tdb_mutex_index(tdb, off, 1, &idx) || (idx == 0)) {
+		/* Not a hash chain */
+		return;
+	}
+
+	if (ltype == F_WRLCK) {
+		tdb_mutex_seqlock_begin(tdb, idx - 1);
+	} else {
+		tdb_mutex_seqlock_repair(tdb, idx - 1);
+	}
+}
+
+void tdb_mutex_seqlock_unlock(struct tdb_context *tdb, off_t off, int ltype)
 {
+	unsigned idx;
+
+	if (!tdb_have_seqlocks(tdb)) {
+		return;
+	}
+	if (!tdb_mutex_index(tdb, off, 1, &idx) || (idx == 0)) {
+		return;
+	}
+
+	if (ltype == F_WRLCK) {
+		tdb_mutex_seqlock_end(tdb, idx - 1);
+	}
+}
+
+/*
+ * Start an unlocked read of hash chain "list". Returns false if
+ * there's a writer around, the caller has to take the lock then.
+ */
+bool tdb_mutex_seqlock_read_begin(struct tdb_context *tdb, uint32_t list,
+				  uint32_t seq[2])
+{
+#ifdef TDB_HAVE_SEQLOCK
+	uint32_t *seqs;
+
+	if (!tdb_have_seqlocks(tdb)) {
+		return false;
+	}
+	seqs = tdb_mutex_seqlocks(tdb);
+
+	seq[0] = __atomic_load_n(&seqs[tdb->hash_size], __ATOMIC_ACQUIRE);
+	seq[1] = __atomic_load_n(&seqs[list], __ATOMIC_ACQUIRE);
+
+	return (((seq[0] | seq[1]) & 1) == 0);
+#else
+	return false;
+#endif
+}
+
+/*
+ * Did anyone modify the chain since tdb_mutex_seqlock_read_begin()?
+ */
+bool tdb_mutex_seqlock_read_valid(struct tdb_context *tdb, uint32_t list,
+				  const uint32_t seq[2])
+{
+#ifdef TDB_HAVE_SEQLOCK
+	uint32_t *seqs = tdb_mutex_seqlocks(tdb);
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return ((__atomic_load_n(&seqs[list], __ATOMIC_RELAXED) == seq[1]) &&
+		(__atomic_load_n(&seqs[tdb->hash_size], __ATOMIC_RELAXED) ==
+		 seq[0]));
+#else
+	return false;
+#endif
+}
+
+static int allrecord_mutex_lock(struct tdb_context *tdb, bool waitflag)
+{
+	struct tdb_mutexes *m = tdb->mutexes;
 	int ret;
 
 	if (waitflag) {
@@ -212,6 +397,7 @@ static int allrecord_mutex_lock(struct tdb_mutexes *m, bool waitflag)
 	 * tdb_needs_recovery.
 	 */
 	m->allrecord_lock = F_UNLCK;
+	tdb_mutex_seqlock_repair(tdb, tdb->hash_size);
 
 	return pthread_mutex_consistent(&m->allrecord_mutex);
 }
@@ -304,7 +490,7 @@ again:
 		errno = ret;
 		goto fail;
 	}
-	ret = allrecord_mutex_lock(m, waitflag);
+	ret = allrecord_mutex_lock(tdb, waitflag);
 	if (ret == EBUSY) {
 		ret = EAGAIN;
 	}
@@ -371,7 +557,7 @@ int tdb_mutex_allrecord_lock(struct tdb_context *tdb, int ltype,
 		return 0;
 	}
 
-	ret = allrecord_mutex_lock(m, waitflag);
+	ret = allrecord_mutex_lock(tdb, waitflag);
 	if (!waitflag && (ret == EBUSY)) {
 		errno = EAGAIN;
 		tdb->ecode = TDB_ERR_LOCK;
@@ -422,6 +608,10 @@ int tdb_mutex_allrecord_lock(struct tdb_context *tdb, int ltype,
 			goto fail_unroll_allrecord_lock;
 		}
 	}
+	if (ltype == F_WRLCK) {
+		tdb_mutex_seqlock_begin(tdb, tdb->hash_size);
+	}
+
 	/*
 	 * We leave this routine with m->allrecord_mutex locked
 	 */
@@ -488,6 +678,8 @@ int tdb_mutex_allrecord_upgrade(struct tdb_context *tdb)
 		}
 	}
 
+	tdb_mutex_seqlock_begin(tdb, tdb->hash_size);
+
 	return 0;
 
 fail_unroll_allrecord_lock:
@@ -513,6 +705,8 @@ void tdb_mutex_allrecord_downgrade(struct tdb_context *tdb)
 		return;
 	}
 
+	tdb_mutex_seqlock_end(tdb, tdb->hash_size);
+
 	m->allrecord_lock = F_RDLCK;
 	return;
 }
@@ -545,6 +739,10 @@ int tdb_mutex_allrecord_unlock(struct tdb_context *tdb)
 	old = m->allrecord_lock;
 	m->allrecord_lock = F_UNLCK;
 
+	if (old == F_WRLCK) {
+		tdb_mutex_seqlock_end(tdb, tdb->hash_size);
+	}
+
 	ret = pthread_mutex_unlock(&m->allrecord_mutex);
 	if (ret != 0) {
 		m->allrecord_lock = old;
@@ -596,6 +794,11 @@ int tdb_mutex_init(struct tdb_context *tdb)
 
 	m->allrecord_lock = F_UNLCK;
 
+	if (tdb->feature_flags & TDB_FEATURE_FLAG_SEQLOCK) {
+		memset(tdb_mutex_seqlocks(tdb), 0,
+		       (tdb->hash_size + 1) * sizeof(uint32_t));
+	}
+
 	ret = pthread_mutex_init(&m->allrecord_mutex, &ma);
 	if (ret != 0) {
 		goto fail;
@@ -1052,6 +1255,28 @@ void tdb_mutex_allrecord_downgrade(struct tdb_context *tdb)
 	return;
 }
 
+void tdb_mutex_seqlock_lock(struct tdb_context *tdb, off_t off, int ltype)
+{
+	return;
+}
+
+void tdb_mutex_seqlock_unlock(struct tdb_context *tdb, off_t off, int ltype)
+{
+	return;
+}
+
+bool tdb_mutex_seqlock_read_begin(struct tdb_context *tdb, uint32_t list,
+				  uint32_t seq[2])
+{
+	return false;
+}
+
+bool tdb_mutex_seqlock_read_valid(struct tdb_context *tdb, uint32_t list,
+				  const uint32_t seq[2])
+{
+	return false;
+}
+
 int tdb_mutex_mmap(struct tdb_context *tdb)
 {
 	errno = ENOSYS;
@@ -85,6 +85,33 @@ static int tdb_new_database(struct tdb_context *tdb, struct tdb_header *header,
 		newdb->feature_flags |= TDB_FEATURE_FLAG_MUTEX;
 	}
 
+	/*
+	 * A resizable tdb starts out with hash_size chains, see
+	 * tdb_hash_grow().
+	 */
+	if (tdb->flags & TDB_RESIZABLE) {
+		newdb->feature_flags |= TDB_FEATURE_FLAG_RESIZE;
+	}
+
+	/*
+	 * Small free records go into lists per size class, see
+	 * tdb_freelist_class().
+	 */
+	if (tdb->flags & TDB_SIZE_CLASSES) {
+		newdb->feature_flags |= TDB_FEATURE_FLAG_FREELIST_CLASSES;
+	}
+
+#ifdef TDB_HAVE_SEQLOCK
+	/*
+	 * The sequence counters for tdb_parse_record() live in the
+	 * mutex area, see tdb_mutex_seqlock_read_begin().
+	 */
+	if ((newdb->feature_flags & TDB_FEATURE_FLAG_MUTEX) &&
+	    (tdb->flags & TDB_OPTIMISTIC_READS)) {
+		newdb->feature_flags |= TDB_FEATURE_FLAG_SEQLOCK;
+	}
+#endif
+
 	/*
 	 * If we have any features we add the FEATURE_FLAG_MAGIC, overwriting the
 	 * TDB_HASH_RWLOCK_MAGIC above.
@@ -201,6 +201,44 @@ static void free_table(struct found_table *found)
 	free(found->arr);
 }
 
+static void walk_chain(struct tdb_context *tdb, struct found_table *found,
+		       tdb_off_t top, bool freelist)
+{
+	bool slow_chase = false;
+	tdb_off_t slow_off = top;
+	struct tdb_record rec;
+	tdb_off_t off;
+
+	if (tdb_ofs_read(tdb, top, &off) == -1)
+		return;
+
+	while (off && off != slow_off) {
+		if (tdb->methods->tdb_read(tdb, off, &rec, sizeof(rec),
+					   DOCONV()) != 0) {
+			break;
+		}
+
+		if (freelist) {
+			/* Don't mark garbage as free. */
+			if (rec.magic != TDB_FREE_MAGIC) {
+				break;
+			}
+			mark_free_area(found, off, sizeof(rec) + rec.rec_len);
+		} else {
+			found_in_hashchain(found, off);
+		}
+
+		off = rec.next;
+
+		/* Loop detection using second pointer at half-speed */
+		if (slow_chase) {
+			/* First entry happens to be next ptr */
+			tdb_ofs_read(tdb, slow_off, &slow_off);
+		}
+		slow_chase = !slow_chase;
+	}
+}
+
 static void logging_suppressed(struct tdb_context *tdb,
 			       enum tdb_debug_level level, const char *fmt, ...)
 {
@@ -212,6 +250,7 @@ _PUBLIC_ int tdb_rescue(struct tdb_context *tdb,
 {
 	struct found_table found = { NULL, 0, 0 };
 	tdb_off_t h, off, i;
+	unsigned c;
 	tdb_log_func oldlog = tdb->log.log_fn;
 	struct tdb_record rec;
 	TDB_DATA key;
@@ -250,39 +289,23 @@ _PUBLIC_ int tdb_rescue(struct tdb_context *tdb,
 
 	/* Walk hash chains to positive vet. */
 	for (h = 0; h < 1+tdb->hash_size; h++) {
-		bool slow_chase = false;
-		tdb_off_t slow_off = FREELIST_TOP + h*sizeof(tdb_off_t);
-
-		if (tdb_ofs_read(tdb, FREELIST_TOP + h*sizeof(tdb_off_t),
-				 &off) == -1)
-			continue;
-
-		while (off && off != slow_off) {
-			if (tdb->methods->tdb_read(tdb, off, &rec, sizeof(rec),
-						   DOCONV()) != 0) {
-				break;
-			}
+		/* 0 is the free list, rest are hash chains. */
+		walk_chain(tdb, &found, FREELIST_TOP + h*sizeof(tdb_off_t),
+			   h == 0);
+	}
 
-			/* 0 is the free list, rest are hash chains. */
-			if (h == 0) {
-				/* Don't mark garbage as free. */
-				if (rec.magic != TDB_FREE_MAGIC) {
-					break;
-				}
-				mark_free_area(&found, off,
-					       sizeof(rec) + rec.rec_len);
-			} else {
-				found_in_hashchain(&found, off);
-			}
+	/* And the free lists per size class. */
+	for (c = TDB_FREELIST_FIRST(tdb); c < TDB_FREELIST_CLASSES; c++) {
+		walk_chain(tdb, &found, TDB_FREELIST_TOP(c), true);
+	}
 
-			off = rec.next;
+	/* Including those a resizable tdb has grown. */
+	for (h = 0; h < tdb->hash_size; h++) {
+		uint32_t cursor = 0;
+		tdb_off_t top;
 
-			/* Loop detection using second pointer at half-speed */
-			if (slow_chase) {
-				/* First entry happens to be next ptr */
-				tdb_ofs_read(tdb, slow_off, &slow_off);
-			}
-			slow_chase = !slow_chase;
+		while (tdb_hash_list_next(tdb, h, &cursor, &top) == 1) {
+			walk_chain(tdb, &found, top, false);
 		}
 	}
 
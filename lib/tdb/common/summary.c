@@ -24,6 +24,9 @@
 	"Incompatible hash: %s\n" \
 	"Active/supported feature flags: 0x%08x/0x%08x\n" \
 	"Robust mutexes locking: %s\n" \
+	"Resizable hash table: %s\n" \
+	"Free list size classes: %s\n" \
+	"Optimistic reads: %s\n" \
 	"Smallest/average/largest keys: %zu/%zu/%zu\n" \
 	"Smallest/average/largest data: %zu/%zu/%zu\n" \
 	"Smallest/average/largest padding: %zu/%zu/%zu\n" \
@@ -69,13 +72,13 @@ static size_t tally_mean(const struct tally *tally)
 	return tally->total / tally->num;
 }
 
-static size_t get_hash_length(struct tdb_context *tdb, unsigned int i)
+static size_t get_hash_length(struct tdb_context *tdb, tdb_off_t top)
 {
 	tdb_off_t rec_ptr;
 	struct tdb_chainwalk_ctx chainwalk;
 	size_t count = 0;
 
-	if (tdb_ofs_read(tdb, TDB_HASH_TOP(i), &rec_ptr) == -1)
+	if (tdb_ofs_read(tdb, top, &rec_ptr) == -1)
 		return 0;
 
 	tdb_chainwalk_init(&chainwalk, rec_ptr);
@@ -107,6 +110,7 @@ _PUBLIC_ char *tdb_summary(struct tdb_context *tdb)
 	size_t unc = 0;
 	int len;
 	struct tdb_record recovery;
+	size_t hash_space;
 
 	/* Read-only databases use no locking at all: it's best-effort.
 	 * We may have a write lock already, so skip that case too. */
@@ -129,6 +133,7 @@ _PUBLIC_ char *tdb_summary(struct tdb_context *tdb)
 	tally_init(&extra);
 	tally_init(&hashval);
 	tally_init(&uncoal);
+	hash_space = tdb->hash_size * sizeof(tdb_off_t);
 
 	for (off = TDB_DATA_START(tdb->hash_size);
 	     off < tdb->map_size - 1;
@@ -164,6 +169,12 @@ _PUBLIC_ char *tdb_summary(struct tdb_context *tdb)
 		case TDB_DEAD_MAGIC:
 			tally_add(&dead, rec.rec_len);
 			break;
+		case TDB_HASH_SEGMENT_MAGIC:
+			hash_space += rec.data_len;
+			if (unc > 1)
+				tally_add(&uncoal, unc - 1);
+			unc = 0;
+			break;
 		default:
 			TDB_LOG((tdb, TDB_DEBUG_ERROR,
 				 "Unexpected record magic 0x%x at offset %u\n",
@@ -174,8 +185,18 @@ _PUBLIC_ char *tdb_summary(struct tdb_context *tdb)
 	if (unc > 1)
 		tally_add(&uncoal, unc - 1);
 
-	for (off = 0; off < tdb->hash_size; off++)
-		tally_add(&hashval, get_hash_length(tdb, off));
+	for (off = 0; off < tdb->hash_size; off++) {
+		uint32_t cursor = 0;
+		tdb_off_t top;
+
+		top = tdb_hash_list_top(tdb, off, cursor);
+		if (top == 0)
+			goto unlock;
+
+		do {
+			tally_add(&hashval, get_hash_length(tdb, top));
+		} while (tdb_hash_list_next(tdb, off, &cursor, &top) == 1);
+	}
 
 	file_size = tdb->hdr_ofs + tdb->map_size;
 
@@ -186,6 +207,9 @@ _PUBLIC_ char *tdb_summary(struct tdb_context *tdb)
 		 (tdb->hash_fn == tdb_jenkins_hash)?"yes":"no",
 		 (unsigned)tdb->feature_flags, TDB_SUPPORTED_FEATURE_FLAGS,
 		 (tdb->feature_flags & TDB_FEATURE_FLAG_MUTEX)?"yes":"no",
+		 (tdb->feature_flags & TDB_FEATURE_FLAG_RESIZE)?"yes":"no",
+		 (tdb->feature_flags & TDB_FEATURE_FLAG_FREELIST_CLASSES)?"yes":"no",
+		 (tdb->feature_flags & TDB_FEATURE_FLAG_SEQLOCK)?"yes":"no",
 		 keys.min, tally_mean(&keys), keys.max,
 		 data.min, tally_mean(&data), data.max,
 		 extra.min, tally_mean(&extra), extra.max,
@@ -205,8 +229,7 @@ _PUBLIC_ char *tdb_summary(struct tdb_context *tdb)
 		 (keys.num + freet.num + dead.num)
 		 * (sizeof(struct tdb_record) + sizeof(uint32_t))
 		 * 100.0 / file_size,
-		 tdb->hash_size * sizeof(tdb_off_t)
-		 * 100.0 / file_size);
+		 hash_space * 100.0 / file_size);
 	if (len == -1) {
 		goto unlock;
 	}
@@ -122,11 +122,15 @@ bool tdb_chainwalk_check(struct tdb_context *tdb,
 static tdb_off_t tdb_find(struct tdb_context *tdb, TDB_DATA key, uint32_t hash,
 			struct tdb_record *r)
 {
-	tdb_off_t rec_ptr;
+	tdb_off_t rec_ptr, top;
 	struct tdb_chainwalk_ctx chainwalk;
 
+	top = tdb_hash_top(tdb, hash);
+	if (top == 0)
+		return 0;
+
 	/* read in the hash top */
-	if (tdb_ofs_read(tdb, TDB_HASH_TOP(hash), &rec_ptr) == -1)
+	if (tdb_ofs_read(tdb, top, &rec_ptr) == -1)
 		return 0;
 
 	tdb_chainwalk_init(&chainwalk, rec_ptr);
@@ -295,6 +299,158 @@ _PUBLIC_ TDB_DATA tdb_fetch(struct tdb_context *tdb, TDB_DATA key)
 	return ret;
 }
 
+/*
+ * Pointer to len bytes at off in our mmap, NULL if they are not all
+ * mapped. Without the chain lock we might be following a stale
+ * pointer, so unlike tdb_oob() this does not log or remap.
+ */
+static const uint8_t *tdb_unlocked_ptr(struct tdb_context *tdb,
+				       uint64_t off, uint64_t len)
+{
+	if (off + len > tdb->map_size) {
+		return NULL;
+	}
+	return (const uint8_t *)tdb->map_ptr + off;
+}
+
+/*
+ * Records up to this size are copied out by tdb_parse_record_unlocked(),
+ * larger ones are handed to the parser straight from the mmap under the
+ * chain lock.
+ */
+#define TDB_UNLOCKED_PARSE_MAX 65536
+
+/*
+ * tdb_parse_record() without the chain lock for databases with
+ * TDB_FEATURE_FLAG_SEQLOCK, see tdb_mutex_seqlock_read_begin(). We walk
+ * the chain in the mmap and copy the data out, the copy is only given
+ * to the parser if no writer touched the chain meanwhile.
+ *
+ * Returns false if the caller has to do the locked lookup, otherwise
+ * *pret is what tdb_parse_record() returns.
+ */
+static bool tdb_parse_record_unlocked(struct tdb_context *tdb, TDB_DATA key,
+				      uint32_t hash,
+				      int (*parser)(TDB_DATA key,
+						    TDB_DATA data,
+						    void *private_data),
+				      void *private_data,
+				      int *pret)
+{
+	uint32_t list = BUCKET(hash);
+	unsigned attempt;
+
+	if (!(tdb->feature_flags & TDB_FEATURE_FLAG_SEQLOCK) ||
+	    (tdb->transaction != NULL) ||
+	    (tdb->allrecord_lock.count != 0) ||
+	    (tdb->flags & TDB_CONVERT) ||
+	    (tdb->map_ptr == NULL)) {
+		return false;
+	}
+
+	for (attempt = 0; attempt < 3; attempt++) {
+		uint8_t buf[256];
+		struct tdb_record rec;
+		const uint8_t *p;
+		tdb_off_t top, rec_ptr;
+		uint32_t seq[2];
+		uint32_t steps = 0;
+
+		if (!tdb_mutex_seqlock_read_begin(tdb, list, seq)) {
+			return false;
+		}
+
+		top = tdb_hash_top(tdb, hash);
+		if (top == 0) {
+			return false;
+		}
+		p = tdb_unlocked_ptr(tdb, top, sizeof(rec_ptr));
+		if (p == NULL) {
+			return false;
+		}
+		memcpy(&rec_ptr, p, sizeof(rec_ptr));
+
+		while (rec_ptr != 0) {
+			p = tdb_unlocked_ptr(tdb, rec_ptr, sizeof(rec));
+			if (p == NULL) {
+				break;
+			}
+			memcpy(&rec, p, sizeof(rec));
+
+			if ((rec.magic != TDB_MAGIC) && !TDB_DEAD(&rec)) {
+				break;
+			}
+
+			if ((rec.magic == TDB_MAGIC) &&
+			    (rec.full_hash == hash) &&
+			    (rec.key_len == key.dsize)) {
+				TDB_DATA data = { .dsize = rec.data_len };
+
+				p = tdb_unlocked_ptr(
+					tdb, (uint64_t)rec_ptr + sizeof(rec),
+					(uint64_t)rec.key_len + rec.data_len);
+				if (p == NULL) {
+					break;
+				}
+				if (memcmp(p, key.dptr, key.dsize) != 0) {
+					goto next;
+				}
+
+				if (data.dsize > TDB_UNLOCKED_PARSE_MAX) {
+					return false;
+				}
+				data.dptr = buf;
+				if (data.dsize > sizeof(buf)) {
+					data.dptr = malloc(data.dsize);
+					if (data.dptr == NULL) {
+						return false;
+					}
+				}
+				memcpy(data.dptr, p + rec.key_len, data.dsize);
+
+				if (!tdb_mutex_seqlock_read_valid(
+					    tdb, list, seq)) {
+					if (data.dptr != buf) {
+						free(data.dptr);
+					}
+					break;
+				}
+
+				tdb_trace_1rec_ret(tdb, "tdb_parse_record",
+						   key, 0);
+				*pret = parser(key, data, private_data);
+
+				if (data.dptr != buf) {
+					free(data.dptr);
+				}
+				return true;
+			}
+		next:
+			rec_ptr = rec.next;
+			steps += 1;
+
+			if (steps > tdb->map_size / sizeof(rec)) {
+				/* A loop, let tdb_find() complain */
+				return false;
+			}
+			if (((steps % 64) == 0) &&
+			    !tdb_mutex_seqlock_read_valid(tdb, list, seq)) {
+				break;
+			}
+		}
+
+		if ((rec_ptr == 0) &&
+		    tdb_mutex_seqlock_read_valid(tdb, list, seq)) {
+			tdb_trace_1rec_ret(tdb, "tdb_parse_record", key, -1);
+			tdb->ecode = TDB_ERR_NOEXIST;
+			*pret = -1;
+			return true;
+		}
+	}
+
+	return false;
+}
+
 /*
  * Find an entry in the database and hand the record's data to a parsing
  * function. The parsing function is executed under the chain read lock, so it
@@ -307,6 +463,10 @@ _PUBLIC_ TDB_DATA tdb_fetch(struct tdb_context *tdb, TDB_DATA key)
  * case. If a transaction is open or no mmap is available, it has to do
  * malloc/read/parse/free.
  *
+ * Databases created with TDB_OPTIMISTIC_READS copy records up to 64k out
+ * of the mmap without taking the chain lock, so readers don't serialize
+ * on the chain mutex. The parser then runs without any lock held.
+ *
  * This is interesting for all readers of potentially large data structures in
  * the tdb records, ldb indexes being one example.
  *
@@ -326,6 +486,11 @@ _PUBLIC_ int tdb_parse_record(struct tdb_context *tdb, TDB_DATA key,
 	/* find which hash bucket it is in */
 	hash = tdb->hash_fn(&key);
 
+	if (tdb_parse_record_unlocked(tdb, key, hash, parser, private_data,
+				      &ret)) {
+		return ret;
+	}
+
 	if (!(rec_ptr = tdb_find_lock_hash(tdb,key,hash,F_RDLCK,&rec))) {
 		/* record not found */
 		tdb_trace_1rec_ret(tdb, "tdb_parse_record", key, -1);
@@ -413,7 +578,10 @@ int tdb_trim_dead(struct tdb_context *tdb, uint32_t hash)
 	int num_dead = 0;
 	int ret;
 
-	last_ptr = TDB_HASH_TOP(hash);
+	last_ptr = tdb_hash_top(tdb, hash);
+	if (last_ptr == 0) {
+		return -1;
+	}
 
 	/*
 	 * Init chainwalk with the pointer to the hash top. It might
@@ -563,7 +731,9 @@ tdb_off_t tdb_find_dead(struct tdb_context *tdb, uint32_t hash,
 
 	length += sizeof(tdb_off_t); /* tailer */
 
-	last_ptr = TDB_HASH_TOP(hash);
+	last_ptr = tdb_hash_top(tdb, hash);
+	if (last_ptr == 0)
+		return 0;
 
 	/* read in the hash top */
 	if (tdb_ofs_read(tdb, last_ptr, &rec_ptr) == -1)
@@ -607,7 +777,7 @@ static int _tdb_storev(struct tdb_context *tdb, TDB_DATA key,
 		       int flag, uint32_t hash)
 {
 	struct tdb_record rec;
-	tdb_off_t rec_ptr, ofs;
+	tdb_off_t rec_ptr, ofs, top;
 	tdb_len_t rec_len, dbufs_len;
 	int i;
 	int ret = -1;
@@ -670,8 +840,12 @@ static int _tdb_storev(struct tdb_context *tdb, TDB_DATA key,
 		goto fail;
 	}
 
+	top = tdb_hash_top(tdb, hash);
+	if (top == 0)
+		goto fail;
+
 	/* Read hash top into next ptr */
-	if (tdb_ofs_read(tdb, TDB_HASH_TOP(hash), &rec.next) == -1)
+	if (tdb_ofs_read(tdb, top, &rec.next) == -1)
 		goto fail;
 
 	rec.key_len = key.dsize;
@@ -707,12 +881,26 @@ static int _tdb_storev(struct tdb_context *tdb, TDB_DATA key,
 		ofs += dbufs[i].dsize;
 	}
 
-	ret = tdb_ofs_write(tdb, TDB_HASH_TOP(hash), &rec_ptr);
+	ret = tdb_ofs_write(tdb, top, &rec_ptr);
 	if (ret == -1) {
 		/* Need to tdb_unallocate() here */
 		goto fail;
 	}
 
+	/*
+	 * The chain got longer, see whether a resizable tdb should
+	 * grow. Failing to do so does not fail the store.
+	 */
+	if (tdb->feature_flags & TDB_FEATURE_FLAG_RESIZE) {
+		enum TDB_ERROR ecode = tdb->ecode;
+
+		if (tdb_hash_grow(tdb, hash) == -1) {
+			TDB_LOG((tdb, TDB_DEBUG_WARNING, "_tdb_storev: "
+				 "failed to grow the hash table\n"));
+		}
+		tdb->ecode = ecode;
+	}
+
  done:
 	ret = 0;
  fail:
@@ -1011,8 +1199,14 @@ _PUBLIC_ int tdb_wipe_all(struct tdb_context *tdb)
 		}
 	}
 
+	/* and the chains a resizable tdb has grown */
+	if (tdb_hash_wipe(tdb) == -1) {
+		TDB_LOG((tdb, TDB_DEBUG_FATAL,"tdb_wipe_all: failed to wipe hash segments\n"));
+		goto failed;
+	}
+
 	/* wipe the freelist */
-	if (tdb_ofs_write(tdb, FREELIST_TOP, &offset) == -1) {
+	if (tdb_freelist_wipe(tdb) == -1) {
 		TDB_LOG((tdb, TDB_DEBUG_FATAL,"tdb_wipe_all: failed to write freelist\n"));
 		goto failed;
 	}
@@ -54,6 +54,7 @@ typedef uint32_t tdb_off_t;
 #define TDB_RECOVERY_INVALID_MAGIC (0x0)
 #define TDB_HASH_RWLOCK_MAGIC (0xbad1a51U)
 #define TDB_FEATURE_FLAG_MAGIC (0xbad1a52U)
+#define TDB_HASH_SEGMENT_MAGIC (0x5e6f1a53U)
 #define TDB_ALIGNMENT 4
 #define DEFAULT_HASH_SIZE 131
 #define FREELIST_TOP (sizeof(struct tdb_header))
@@ -66,15 +67,60 @@ typedef uint32_t tdb_off_t;
 #define TDB_DATA_START(hash_size) (TDB_HASH_TOP(hash_size-1) + sizeof(tdb_off_t))
 #define TDB_RECOVERY_HEAD offsetof(struct tdb_header, recovery_start)
 #define TDB_SEQNUM_OFS    offsetof(struct tdb_header, sequence_number)
+#define TDB_HASH_BUCKETS_OFS offsetof(struct tdb_header, hash_buckets)
+#define TDB_HASH_SEGMENT_OFS(k) \
+	(offsetof(struct tdb_header, hash_segments) + (k)*sizeof(tdb_off_t))
+#define TDB_FREELIST_CLASS_OFS(c) \
+	(offsetof(struct tdb_header, freelist_classes) + (c)*sizeof(tdb_off_t))
 #define TDB_PAD_BYTE 0x42
 #define TDB_PAD_U32  0x42424242
 
 #define TDB_FEATURE_FLAG_MUTEX 0x00000001
+#define TDB_FEATURE_FLAG_RESIZE 0x00000002
+#define TDB_FEATURE_FLAG_FREELIST_CLASSES 0x00000004
+#define TDB_FEATURE_FLAG_SEQLOCK 0x00000008
+
+/*
+ * The per-chain sequence counters in the mutex area need atomic
+ * loads and stores. Without them we can't take part in the protocol.
+ */
+#if defined(USE_TDB_MUTEX_LOCKING) && \
+	defined(HAVE___ATOMIC_ADD_FETCH) && defined(HAVE___ATOMIC_ADD_LOAD)
+#define TDB_HAVE_SEQLOCK 1
+#define TDB_SUPPORTED_SEQLOCK_FLAG TDB_FEATURE_FLAG_SEQLOCK
+#else
+#define TDB_SUPPORTED_SEQLOCK_FLAG 0
+#endif
 
 #define TDB_SUPPORTED_FEATURE_FLAGS ( \
 	TDB_FEATURE_FLAG_MUTEX | \
+	TDB_FEATURE_FLAG_RESIZE | \
+	TDB_FEATURE_FLAG_FREELIST_CLASSES | \
+	TDB_SUPPORTED_SEQLOCK_FLAG | \
 	0)
 
+/*
+ * A resizable tdb can grow to hash_size << TDB_HASH_SEGMENTS chains.
+ * A new record stored in a chain that already holds
+ * TDB_HASH_SPLIT_LENGTH records triggers the split of one chain.
+ */
+#define TDB_HASH_SEGMENTS 16
+#define TDB_HASH_SPLIT_LENGTH 4
+
+/*
+ * With TDB_FEATURE_FLAG_FREELIST_CLASSES free records with a rec_len
+ * below TDB_FREELIST_CLASS_SIZE(c) and not below the limit of class
+ * c-1 go into list c, larger ones into the list at FREELIST_TOP.
+ */
+#define TDB_FREELIST_CLASSES 7
+#define TDB_FREELIST_CLASS_SIZE(c) (64U << (c))
+#define TDB_FREELIST_TOP(c) (((c) == TDB_FREELIST_CLASSES) ? \
+	FREELIST_TOP : TDB_FREELIST_CLASS_OFS(c))
+/* The first free list to walk, the one at FREELIST_TOP is the last one */
+#define TDB_FREELIST_FIRST(tdb) \
+	(((tdb)->feature_flags & TDB_FEATURE_FLAG_FREELIST_CLASSES) ? \
+	 0 : TDB_FREELIST_CLASSES)
+
 /* NB assumes there is a local variable called "tdb" that is the
  * current context, also takes doubly-parenthesized print-style
  * argument. */
@@ -182,7 +228,12 @@ struct tdb_header {
 	uint32_t magic2_hash; /* hash of TDB_MAGIC. */
 	uint32_t feature_flags;
 	tdb_len_t mutex_size; /* set if TDB_FEATURE_FLAG_MUTEX is set */
-	tdb_off_t reserved[25];
+	/* the following are only used if TDB_FEATURE_FLAG_RESIZE is set */
+	uint32_t hash_buckets; /* number of hash chains, 0 for hash_size */
+	tdb_off_t hash_segments[TDB_HASH_SEGMENTS]; /* chains >= hash_size */
+	/* the following are only used if TDB_FEATURE_FLAG_FREELIST_CLASSES is set */
+	tdb_off_t freelist_classes[TDB_FREELIST_CLASSES]; /* small free records */
+	tdb_off_t reserved[25 - 1 - TDB_HASH_SEGMENTS - TDB_FREELIST_CLASSES];
 };
 
 struct tdb_lock_type {
@@ -201,6 +252,7 @@ struct tdb_traverse_lock {
 	uint32_t off;
 	uint32_t list;
 	int lock_rw;
+	uint32_t cursor; /* chain within list, see tdb_hash_list_next() */
 };
 
 void tdb_chainwalk_init(struct tdb_chainwalk_ctx *ctx, tdb_off_t ptr);
@@ -302,6 +354,8 @@ int tdb_ofs_read(struct tdb_context *tdb, tdb_off_t offset, tdb_off_t *d);
 int tdb_ofs_write(struct tdb_context *tdb, tdb_off_t offset, tdb_off_t *d);
 void *tdb_convert(void *buf, uint32_t size);
 int tdb_free(struct tdb_context *tdb, tdb_off_t offset, struct tdb_record *rec);
+unsigned tdb_freelist_class(struct tdb_context *tdb, tdb_len_t rec_len);
+int tdb_freelist_wipe(struct tdb_context *tdb);
 tdb_off_t tdb_allocate(struct tdb_context *tdb, int hash, tdb_len_t length,
 		       struct tdb_record *rec);
 
@@ -352,6 +406,30 @@ bool tdb_add_off_t(tdb_off_t a, tdb_off_t b, tdb_off_t *pret);
 /* tdb_off_t and tdb_len_t right now are both uint32_t */
 #define tdb_add_len_t tdb_add_off_t
 
+tdb_off_t _tdb_hash_top(struct tdb_context *tdb, uint32_t hash);
+
+/*
+ * Offset of the head of the hash chain "hash" lives in, 0 on error.
+ * The caller must hold the lock on BUCKET(hash).
+ */
+static inline tdb_off_t tdb_hash_top(struct tdb_context *tdb, uint32_t hash)
+{
+	if (likely(!(tdb->feature_flags & TDB_FEATURE_FLAG_RESIZE))) {
+		return TDB_HASH_TOP(hash);
+	}
+	return _tdb_hash_top(tdb, hash);
+}
+
+int tdb_hash_buckets(struct tdb_context *tdb, uint32_t *pbuckets);
+tdb_off_t tdb_hash_list_top(struct tdb_context *tdb, uint32_t list,
+			    uint32_t cursor);
+int tdb_hash_list_next(struct tdb_context *tdb, uint32_t list,
+		       uint32_t *cursor, tdb_off_t *ptop);
+int tdb_hash_list_cursor(struct tdb_context *tdb, uint32_t hash,
+			 uint32_t *cursor);
+int tdb_hash_grow(struct tdb_context *tdb, uint32_t hash);
+int tdb_hash_wipe(struct tdb_context *tdb);
+
 size_t tdb_mutex_size(struct tdb_context *tdb);
 bool tdb_have_mutexes(struct tdb_context *tdb);
 int tdb_mutex_init(struct tdb_context *tdb);
@@ -366,5 +444,11 @@ int tdb_mutex_allrecord_lock(struct tdb_context *tdb, int ltype,
 int tdb_mutex_allrecord_unlock(struct tdb_context *tdb);
 int tdb_mutex_allrecord_upgrade(struct tdb_context *tdb);
 void tdb_mutex_allrecord_downgrade(struct tdb_context *tdb);
+void tdb_mutex_seqlock_lock(struct tdb_context *tdb, off_t off, int ltype);
+void tdb_mutex_seqlock_unlock(struct tdb_context *tdb, off_t off, int ltype);
+bool tdb_mutex_seqlock_read_begin(struct tdb_context *tdb, uint32_t list,
+				  uint32_t seq[2]);
+bool tdb_mutex_seqlock_read_valid(struct tdb_context *tdb, uint32_t list,
+				  const uint32_t seq[2]);
 
 #endif /* TDB_PRIVATE_H */
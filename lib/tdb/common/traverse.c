@@ -26,6 +26,7 @@
 */
 
 #include "tdb_private.h"
+#include "system/threads.h"
 
 #define TDB_NEXT_LOCK_ERR ((tdb_off_t)-1)
 
@@ -37,8 +38,11 @@ static tdb_off_t tdb_next_lock(struct tdb_context *tdb, struct tdb_traverse_lock
 	int want_next = (tlock->off != 0);
 
 	/* Lock each chain from the start one. */
-	for (; tlock->list < tdb->hash_size; tlock->list++) {
+	for (; tlock->list < tdb->hash_size; tlock->list++, tlock->cursor = 0) {
 		if (!tlock->off && tlock->list != 0) {
+			uint32_t list = tlock->list;
+			uint32_t buckets;
+
 			/* this is an optimisation for the common case where
 			   the hash chain is empty, which is particularly
 			   common for the use of tdb with ldb, where large
@@ -66,8 +70,18 @@ static tdb_off_t tdb_next_lock(struct tdb_context *tdb, struct tdb_traverse_lock
 			   With a non-indexed ldb search this trick gains us a
 			   factor of around 80 in speed on a linux 2.6.x
 			   system (testing using ldbtest).
+
+			   Once a resizable tdb has grown, the heads we look
+			   at are only the first chain of each list. Only
+			   trust them as long as there are no other chains.
+			   We look at the number of chains after the heads,
+			   it never shrinks.
 			*/
-			tdb->methods->next_hash_chain(tdb, &tlock->list);
+			tdb->methods->next_hash_chain(tdb, &list);
+			if (tdb_hash_buckets(tdb, &buckets) == 0 &&
+			    buckets == tdb->hash_size) {
+				tlock->list = list;
+			}
 			if (tlock->list == tdb->hash_size) {
 				continue;
 			}
@@ -78,8 +92,11 @@ static tdb_off_t tdb_next_lock(struct tdb_context *tdb, struct tdb_traverse_lock
 
 		/* No previous record?  Start at top of chain. */
 		if (!tlock->off) {
-			if (tdb_ofs_read(tdb, TDB_HASH_TOP(tlock->list),
-				     &tlock->off) == -1)
+			tdb_off_t top = tdb_hash_list_top(tdb, tlock->list,
+							  tlock->cursor);
+			if (top == 0)
+				goto fail;
+			if (tdb_ofs_read(tdb, top, &tlock->off) == -1)
 				goto fail;
 		} else {
 			/* Otherwise unlock the previous record. */
@@ -94,26 +111,41 @@ static tdb_off_t tdb_next_lock(struct tdb_context *tdb, struct tdb_traverse_lock
 			tlock->off = rec->next;
 		}
 
-		/* Iterate through chain */
-		while( tlock->off) {
-			if (tdb_rec_read(tdb, tlock->off, rec) == -1)
-				goto fail;
+		while (true) {
+			tdb_off_t top;
+			int ret;
 
-			/* Detect infinite loops. From "Shlomi Yaakobovich" <Shlomi@exanet.com>. */
-			if (tlock->off == rec->next) {
-				tdb->ecode = TDB_ERR_CORRUPT;
-				TDB_LOG((tdb, TDB_DEBUG_FATAL, "tdb_next_lock: loop detected.\n"));
-				goto fail;
-			}
+			/* Iterate through chain */
+			while( tlock->off) {
+				if (tdb_rec_read(tdb, tlock->off, rec) == -1)
+					goto fail;
 
-			if (!TDB_DEAD(rec)) {
-				/* Woohoo: we found one! */
-				if (tdb_lock_record(tdb, tlock->off) != 0)
+				/* Detect infinite loops. From "Shlomi Yaakobovich" <Shlomi@exanet.com>. */
+				if (tlock->off == rec->next) {
+					tdb->ecode = TDB_ERR_CORRUPT;
+					TDB_LOG((tdb, TDB_DEBUG_FATAL, "tdb_next_lock: loop detected.\n"));
 					goto fail;
-				return tlock->off;
+				}
+
+				if (!TDB_DEAD(rec)) {
+					/* Woohoo: we found one! */
+					if (tdb_lock_record(tdb, tlock->off) != 0)
+						goto fail;
+					return tlock->off;
+				}
+
+				tlock->off = rec->next;
 			}
 
-			tlock->off = rec->next;
+			/* Other chains under this lock? */
+			ret = tdb_hash_list_next(tdb, tlock->list,
+						 &tlock->cursor, &top);
+			if (ret == -1)
+				goto fail;
+			if (ret == 0)
+				break;
+			if (tdb_ofs_read(tdb, top, &tlock->off) == -1)
+				goto fail;
 		}
 		tdb_unlock(tdb, tlock->list, tlock->lock_rw);
 		want_next = 0;
@@ -246,7 +278,7 @@ out:
 _PUBLIC_ int tdb_traverse_read(struct tdb_context *tdb,
 		      tdb_traverse_func fn, void *private_data)
 {
-	struct tdb_traverse_lock tl = { NULL, 0, 0, F_RDLCK };
+	struct tdb_traverse_lock tl = { .lock_rw = F_RDLCK };
 	int ret;
 
 	tdb->traverse_read++;
@@ -267,7 +299,7 @@ _PUBLIC_ int tdb_traverse_read(struct tdb_context *tdb,
 _PUBLIC_ int tdb_traverse(struct tdb_context *tdb,
 		 tdb_traverse_func fn, void *private_data)
 {
-	struct tdb_traverse_lock tl = { NULL, 0, 0, F_WRLCK };
+	struct tdb_traverse_lock tl = { .lock_rw = F_WRLCK };
 	enum tdb_lock_flags lock_flags;
 	int ret;
 
@@ -312,6 +344,7 @@ _PUBLIC_ TDB_DATA tdb_firstkey(struct tdb_context *tdb)
 	if (tdb_unlock_record(tdb, tdb->travlocks.off) != 0)
 		return tdb_null;
 	tdb->travlocks.off = tdb->travlocks.list = 0;
+	tdb->travlocks.cursor = 0;
 	tdb->travlocks.lock_rw = F_RDLCK;
 
 	/* Grab first record: locks chain and returned record. */
@@ -374,6 +407,11 @@ _PUBLIC_ TDB_DATA tdb_nextkey(struct tdb_context *tdb, TDB_DATA oldkey)
 			return tdb_null;
 		}
 		tdb->travlocks.list = BUCKET(rec.full_hash);
+		if (tdb_hash_list_cursor(tdb, rec.full_hash,
+					 &tdb->travlocks.cursor) != 0) {
+			TDB_LOG((tdb, TDB_DEBUG_FATAL, "tdb_nextkey: tdb_hash_list_cursor failed!\n"));
+			return tdb_null;
+		}
 		if (tdb_lock_record(tdb, tdb->travlocks.off) != 0) {
 			TDB_LOG((tdb, TDB_DEBUG_FATAL, "tdb_nextkey: lock_record failed (%s)!\n", strerror(errno)));
 			return tdb_null;
@@ -404,8 +442,9 @@ _PUBLIC_ int tdb_traverse_chain(struct tdb_context *tdb,
 				tdb_traverse_func fn,
 				void *private_data)
 {
-	tdb_off_t rec_ptr;
+	tdb_off_t rec_ptr, top;
 	struct tdb_chainwalk_ctx chainwalk;
+	uint32_t cursor = 0;
 	int count = 0;
 	int ret;
 
@@ -426,7 +465,13 @@ _PUBLIC_ int tdb_traverse_chain(struct tdb_context *tdb,
 
 	tdb->traverse_read += 1;
 
-	ret = tdb_ofs_read(tdb, TDB_HASH_TOP(chain), &rec_ptr);
+	top = tdb_hash_list_top(tdb, chain, cursor);
+	if (top == 0) {
+		goto fail;
+	}
+
+next_chain:
+	ret = tdb_ofs_read(tdb, top, &rec_ptr);
 	if (ret == -1) {
 		goto fail;
 	}
@@ -473,7 +518,7 @@ _PUBLIC_ int tdb_traverse_chain(struct tdb_context *tdb,
 			count += 1;
 
 			if (ret != 0) {
-				break;
+				goto done;
 			}
 		}
 
@@ -484,6 +529,16 @@ _PUBLIC_ int tdb_traverse_chain(struct tdb_context *tdb,
 			goto fail;
 		}
 	}
+
+	/* A resizable tdb might have more chains under this lock */
+	ret = tdb_hash_list_next(tdb, chain, &cursor, &top);
+	if (ret == -1) {
+		goto fail;
+	}
+	if (ret == 1) {
+		goto next_chain;
+	}
+done:
 	tdb->traverse_read -= 1;
 	tdb_unlock(tdb, chain, F_RDLCK);
 	return count;
@@ -508,3 +563,393 @@ _PUBLIC_ int tdb_traverse_key_chain(struct tdb_context *tdb,
 
 	return ret;
 }
+
+#ifdef USE_TDB_MUTEX_LOCKING
+
+/*
+ * tdb_traverse_read_parallel(): Worker threads walk disjoint ranges of
+ * lock lists with tdb_traverse_chain() and copy the records into
+ * batches. The calling thread hands the batches to fn, so fn is called
+ * serially, without any tdb lock held, just like with
+ * tdb_traverse_read().
+ *
+ * Each worker uses a private copy of the tdb_context with its own lock
+ * array and its own mmap, so nobody remaps under its feet. This only
+ * works with mutexes: they are owned by a thread, fcntl locks are
+ * owned by the whole process.
+ */
+
+struct tdb_parallel_batch {
+	struct tdb_parallel_batch *next;
+	uint8_t *buf;
+	size_t used;
+	size_t size;
+	bool nomem;
+};
+
+struct tdb_parallel_state {
+	struct tdb_context *tdb;
+	struct tdb_context wtdb; /* template for the workers */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	uint32_t next_list;
+	uint32_t lists_per_batch;
+	unsigned running;
+	unsigned queued;
+	unsigned max_queued;
+	struct tdb_parallel_batch *head, **tail;
+	bool stop;
+	enum TDB_ERROR ecode;
+};
+
+static void tdb_parallel_batch_free(struct tdb_parallel_batch *batch)
+{
+	if (batch != NULL) {
+		free(batch->buf);
+		free(batch);
+	}
+}
+
+/* Records are stored as key_len, data_len, key, data */
+static int tdb_parallel_collect(struct tdb_context *tdb, TDB_DATA key,
+				TDB_DATA data, void *private_data)
+{
+	struct tdb_parallel_batch *batch = private_data;
+	uint32_t lens[2] = { key.dsize, data.dsize };
+	size_t needed = sizeof(lens) + key.dsize + data.dsize;
+
+	if (batch->size - batch->used < needed) {
+		size_t size = MAX(batch->size * 2, batch->used + needed);
+		uint8_t *buf = realloc(batch->buf, size);
+
+		if (buf == NULL) {
+			batch->nomem = true;
+			return -1;
+		}
+		batch->buf = buf;
+		batch->size = size;
+	}
+
+	memcpy(batch->buf + batch->used, lens, sizeof(lens));
+	batch->used += sizeof(lens);
+	memcpy(batch->buf + batch->used, key.dptr, key.dsize);
+	batch->used += key.dsize;
+	memcpy(batch->buf + batch->used, data.dptr, data.dsize);
+	batch->used += data.dsize;
+
+	return 0;
+}
+
+/* Is this list empty? Only a hint, we don't hold its lock */
+static bool tdb_parallel_list_empty(struct tdb_context *tdb, uint32_t list)
+{
+	uint32_t buckets;
+	tdb_off_t off;
+
+	/* A grown resizable tdb has more chains per list */
+	if ((tdb_hash_buckets(tdb, &buckets) != 0) ||
+	    (buckets != tdb->hash_size)) {
+		return false;
+	}
+	if (tdb_ofs_read(tdb, TDB_HASH_TOP(list), &off) != 0) {
+		return false;
+	}
+	return (off == 0);
+}
+
+static void tdb_parallel_fail(struct tdb_parallel_state *state,
+			      enum TDB_ERROR ecode)
+{
+	pthread_mutex_lock(&state->mutex);
+	if (state->ecode == TDB_SUCCESS) {
+		state->ecode = ecode;
+	}
+	state->stop = true;
+	pthread_cond_broadcast(&state->cond);
+	pthread_mutex_unlock(&state->mutex);
+}
+
+static void *tdb_parallel_worker(void *private_data)
+{
+	struct tdb_parallel_state *state = private_data;
+	struct tdb_context *tdb = state->tdb;
+	struct tdb_context wtdb = state->wtdb;
+
+	if (tdb_mmap(&wtdb) != 0) {
+		tdb_parallel_fail(state, wtdb.ecode);
+		goto done;
+	}
+
+	while (true) {
+		struct tdb_parallel_batch *batch;
+		uint32_t list, end;
+
+		pthread_mutex_lock(&state->mutex);
+		list = state->next_list;
+		if (state->stop || (list >= tdb->hash_size)) {
+			pthread_mutex_unlock(&state->mutex);
+			break;
+		}
+		end = MIN(list + state->lists_per_batch, tdb->hash_size);
+		state->next_list = end;
+		pthread_mutex_unlock(&state->mutex);
+
+		batch = calloc(1, sizeof(*batch));
+		if (batch == NULL) {
+			tdb_parallel_fail(state, TDB_ERR_OOM);
+			break;
+		}
+
+		for (; list < end; list++) {
+			int ret;
+
+			if (tdb_parallel_list_empty(&wtdb, list)) {
+				continue;
+			}
+			ret = tdb_traverse_chain(&wtdb, list,
+						 tdb_parallel_collect, batch);
+			if (ret == -1) {
+				break;
+			}
+		}
+		if (list < end) {
+			tdb_parallel_fail(state, batch->nomem ?
+					  TDB_ERR_OOM : wtdb.ecode);
+			tdb_parallel_batch_free(batch);
+			break;
+		}
+
+		if (batch->used == 0) {
+			tdb_parallel_batch_free(batch);
+			continue;
+		}
+
+		pthread_mutex_lock(&state->mutex);
+		while (!state->stop && (state->queued >= state->max_queued)) {
+			pthread_cond_wait(&state->cond, &state->mutex);
+		}
+		if (state->stop) {
+			pthread_mutex_unlock(&state->mutex);
+			tdb_parallel_batch_free(batch);
+			break;
+		}
+		*state->tail = batch;
+		state->tail = &batch->next;
+		state->queued += 1;
+		pthread_cond_broadcast(&state->cond);
+		pthread_mutex_unlock(&state->mutex);
+	}
+
+done:
+	tdb_munmap(&wtdb);
+	SAFE_FREE(wtdb.lockrecs);
+
+	pthread_mutex_lock(&state->mutex);
+	state->running -= 1;
+	pthread_cond_broadcast(&state->cond);
+	pthread_mutex_unlock(&state->mutex);
+
+	return NULL;
+}
+
+/* Hand the records of a batch to fn, returns the count, -1 to stop */
+static int tdb_parallel_call(struct tdb_context *tdb,
+			     struct tdb_parallel_batch *batch,
+			     tdb_traverse_func fn, void *private_data,
+			     bool *stop)
+{
+	size_t ofs = 0;
+	int count = 0;
+
+	while (ofs < batch->used) {
+		uint32_t lens[2];
+		TDB_DATA key, data;
+
+		memcpy(lens, batch->buf + ofs, sizeof(lens));
+		ofs += sizeof(lens);
+		key = (TDB_DATA) { .dptr = batch->buf + ofs,
+				   .dsize = lens[0] };
+		ofs += lens[0];
+		data = (TDB_DATA) { .dptr = batch->buf + ofs,
+				    .dsize = lens[1] };
+		ofs += lens[1];
+
+		count += 1;
+
+		tdb_trace_1rec_retrec(tdb, "traverse", key, data);
+
+		if ((fn != NULL) && (fn(tdb, key, data, private_data) != 0)) {
+			*stop = true;
+			break;
+		}
+	}
+	return count;
+}
+
+static int tdb_traverse_read_threads(struct tdb_context *tdb,
+				     unsigned num_threads,
+				     tdb_traverse_func fn, void *private_data)
+{
+	struct tdb_parallel_state state = {
+		.tdb = tdb,
+		.max_queued = num_threads * 2,
+	};
+	pthread_t *threads;
+	sigset_t mask, omask;
+	unsigned i, started;
+	int ret, count = 0;
+	bool stop = false;
+
+	threads = calloc(num_threads, sizeof(pthread_t));
+	if (threads == NULL) {
+		return tdb_traverse_read(tdb, fn, private_data);
+	}
+
+	/* Enough batches for all threads to stay busy towards the end */
+	state.lists_per_batch = MAX(1, tdb->hash_size / (num_threads * 64));
+	state.tail = &state.head;
+
+	/*
+	 * fn may use tdb while the workers start, so they copy this
+	 * instead of tdb itself.
+	 */
+	state.wtdb = *tdb;
+	state.wtdb.map_ptr = NULL;
+	state.wtdb.num_lockrecs = 0;
+	state.wtdb.lockrecs = NULL;
+	state.wtdb.lockrecs_array_length = 0;
+	state.wtdb.travlocks = (struct tdb_traverse_lock) {
+		.lock_rw = F_RDLCK,
+	};
+	state.wtdb.next = NULL;
+	state.wtdb.ecode = TDB_SUCCESS;
+
+	ret = pthread_mutex_init(&state.mutex, NULL);
+	if (ret != 0) {
+		free(threads);
+		return tdb_traverse_read(tdb, fn, private_data);
+	}
+	ret = pthread_cond_init(&state.cond, NULL);
+	if (ret != 0) {
+		pthread_mutex_destroy(&state.mutex);
+		free(threads);
+		return tdb_traverse_read(tdb, fn, private_data);
+	}
+
+	/* Signals are for the calling thread, not for the workers */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, &omask);
+
+	for (started = 0; started < num_threads; started++) {
+		pthread_mutex_lock(&state.mutex);
+		state.running += 1;
+		pthread_mutex_unlock(&state.mutex);
+
+		ret = pthread_create(&threads[started], NULL,
+				     tdb_parallel_worker, &state);
+		if (ret != 0) {
+			pthread_mutex_lock(&state.mutex);
+			state.running -= 1;
+			pthread_mutex_unlock(&state.mutex);
+			break;
+		}
+	}
+
+	pthread_sigmask(SIG_SETMASK, &omask, NULL);
+
+	if (started == 0) {
+		pthread_cond_destroy(&state.cond);
+		pthread_mutex_destroy(&state.mutex);
+		free(threads);
+		return tdb_traverse_read(tdb, fn, private_data);
+	}
+
+	tdb->traverse_read++;
+	tdb_trace(tdb, "tdb_traverse_read_parallel_start");
+
+	pthread_mutex_lock(&state.mutex);
+
+	while (true) {
+		struct tdb_parallel_batch *batch = state.head;
+
+		if (batch == NULL) {
+			if (state.running == 0) {
+				break;
+			}
+			pthread_cond_wait(&state.cond, &state.mutex);
+			continue;
+		}
+
+		state.head = batch->next;
+		if (state.head == NULL) {
+			state.tail = &state.head;
+		}
+		state.queued -= 1;
+		pthread_cond_broadcast(&state.cond);
+
+		if (stop) {
+			/* Just drain what the workers had queued */
+			tdb_parallel_batch_free(batch);
+			continue;
+		}
+
+		pthread_mutex_unlock(&state.mutex);
+
+		count += tdb_parallel_call(tdb, batch, fn, private_data,
+					   &stop);
+		tdb_parallel_batch_free(batch);
+
+		pthread_mutex_lock(&state.mutex);
+		if (stop) {
+			state.stop = true;
+			pthread_cond_broadcast(&state.cond);
+		}
+	}
+
+	pthread_mutex_unlock(&state.mutex);
+
+	for (i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	free(threads);
+
+	pthread_cond_destroy(&state.cond);
+	pthread_mutex_destroy(&state.mutex);
+
+	tdb->traverse_read--;
+	tdb_trace_ret(tdb, "tdb_traverse_read_parallel_end", count);
+
+	if (state.ecode != TDB_SUCCESS) {
+		tdb->ecode = state.ecode;
+		return -1;
+	}
+	return count;
+}
+
+#endif
+
+_PUBLIC_ int tdb_traverse_read_parallel(struct tdb_context *tdb,
+					unsigned num_threads,
+					tdb_traverse_func fn,
+					void *private_data)
+{
+#ifdef USE_TDB_MUTEX_LOCKING
+	/*
+	 * The workers take the chain locks, so we must not hold
+	 * any. Transactions and traverses keep state in the
+	 * tdb_context that the workers don't see.
+	 */
+	if ((num_threads > 1) &&
+	    tdb_have_mutexes(tdb) &&
+	    !(tdb->flags & TDB_INTERNAL) &&
+	    (tdb->transaction == NULL) &&
+	    !tdb_have_extra_locks(tdb) &&
+	    (tdb->travlocks.next == NULL) &&
+	    (tdb->traverse_read == 0)) {
+		num_threads = MIN(num_threads, tdb->hash_size);
+		return tdb_traverse_read_threads(tdb, num_threads, fn,
+						 private_data);
+	}
+#endif
+	return tdb_traverse_read(tdb, fn, private_data);
+}
@@ -97,6 +97,13 @@ extern "C" {
 #define TDB_MUTEX_LOCKING 4096 /** optimized locking using robust mutexes if supported,
                                    only with tdb >= 1.3.0 and TDB_CLEAR_IF_FIRST
                                    after checking tdb_runtime_check_for_robust_mutexes() */
+#define TDB_RESIZABLE 8192 /** Grow the hash table as records are added,
+                               can't be opened by tdb < 1.4.16 */
+#define TDB_SIZE_CLASSES 16384 /** Keep free space in per-size lists,
+                                  can't be opened by tdb < 1.4.16 */
+#define TDB_OPTIMISTIC_READS 32768 /** tdb_parse_record() without chain locks,
+                                       only with TDB_MUTEX_LOCKING,
+                                       can't be opened by tdb < 1.4.16 */
 
 /** The tdb error codes */
 enum TDB_ERROR {TDB_SUCCESS=0, TDB_ERR_CORRUPT, TDB_ERR_IO, TDB_ERR_LOCK, 
@@ -165,6 +172,19 @@ struct tdb_logging_context {
  *                                             can't be opened by tdb < 1.3.0.
  *                                             Only valid in combination with TDB_CLEAR_IF_FIRST
  *                                             after checking tdb_runtime_check_for_robust_mutexes()\n
+ *                         TDB_RESIZABLE - Grow the number of hash chains with the number
+ *                                         of records, can't be opened by tdb < 1.4.16.
+ *                                         Only has an effect when the database is created.\n
+ *                         TDB_SIZE_CLASSES - Keep free records in separate lists per size,
+ *                                            can't be opened by tdb < 1.4.16.
+ *                                            Only has an effect when the database is created.\n
+ *                         TDB_OPTIMISTIC_READS - tdb_parse_record() validates per-chain
+ *                                                sequence counters instead of taking
+ *                                                the chain lock. Only valid in
+ *                                                combination with TDB_MUTEX_LOCKING,
+ *                                                can't be opened by tdb < 1.4.16.
+ *                                                Only has an effect when the database
+ *                                                is created.\n
  *
  * @param[in]  open_flags Flags for the open(2) function.
  *
@@ -206,6 +226,19 @@ _PUBLIC_ struct tdb_context *tdb_open(const char *name, int hash_size, int tdb_f
  *                                             can't be opened by tdb < 1.3.0.
  *                                             Only valid in combination with TDB_CLEAR_IF_FIRST
  *                                             after checking tdb_runtime_check_for_robust_mutexes()\n
+ *                         TDB_RESIZABLE - Grow the number of hash chains with the number
+ *                                         of records, can't be opened by tdb < 1.4.16.
+ *                                         Only has an effect when the database is created.\n
+ *                         TDB_SIZE_CLASSES - Keep free records in separate lists per size,
+ *                                            can't be opened by tdb < 1.4.16.
+ *                                            Only has an effect when the database is created.\n
+ *                         TDB_OPTIMISTIC_READS - tdb_parse_record() validates per-chain
+ *                                                sequence counters instead of taking
+ *                                                the chain lock. Only valid in
+ *                                                combination with TDB_MUTEX_LOCKING,
+ *                                                can't be opened by tdb < 1.4.16.
+ *                                                Only has an effect when the database
+ *                                                is created.\n
  *
  * @param[in]  open_flags Flags for the open(2) function.
  *
@@ -493,6 +526,40 @@ _PUBLIC_ int tdb_traverse(struct tdb_context *tdb, tdb_traverse_func fn, void *p
  */
 _PUBLIC_ int tdb_traverse_read(struct tdb_context *tdb, tdb_traverse_func fn, void *private_data);
 
+/**
+ * @brief Traverse the entire database using several threads.
+ *
+ * This is like tdb_traverse_read(), but up to num_threads threads walk
+ * separate parts of the hash table at the same time, each taking the
+ * read locks of its own chains. This speeds up traversing large
+ * databases that are not in the page cache.
+ *
+ * fn is still called from the calling thread, one record after the
+ * other and without holding any lock. The records are copied out of
+ * the database under the chain lock first, so fn might see a record
+ * that has been modified or deleted meanwhile.
+ *
+ * The threads need the chain locks to be owned by a thread, not by the
+ * process. If the database does not use TDB_MUTEX_LOCKING, if we are
+ * inside a transaction or hold any lock, this falls back to
+ * tdb_traverse_read().
+ *
+ * @param[in]  tdb      The database to traverse.
+ *
+ * @param[in]  num_threads The maximum number of threads to use.
+ *
+ * @param[in]  fn       The function to call on each entry.
+ *
+ * @param[in]  private_data The private data which should be passed to the
+ *                          traversing function.
+ *
+ * @return              The record count traversed, -1 on error.
+ */
+_PUBLIC_ int tdb_traverse_read_parallel(struct tdb_context *tdb,
+					unsigned num_threads,
+					tdb_traverse_func fn,
+					void *private_data);
+
 /**
  * @brief Traverse a single hash chain
  *
@@ -512,6 +579,9 @@ _PUBLIC_ int tdb_traverse_read(struct tdb_context *tdb, tdb_traverse_func fn, vo
  * To walk the entire database, call this function tdb_hash_size()
  * times, with 0<=chain<tdb_hash_size(tdb).
  *
+ * In a TDB_RESIZABLE database that has grown, this walks all chains
+ * that share the lock of "chain".
+ *
  * @param[in]  tdb      The database to traverse.
  *
  * @param[in]  chain    The hash chain number to traverse.
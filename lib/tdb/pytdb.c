@@ -813,6 +813,9 @@ PyObject* module_init(void)
 	PyModule_AddIntConstant(m, "ALLOW_NESTING", TDB_ALLOW_NESTING);
 	PyModule_AddIntConstant(m, "DISALLOW_NESTING", TDB_DISALLOW_NESTING);
 	PyModule_AddIntConstant(m, "INCOMPATIBLE_HASH", TDB_INCOMPATIBLE_HASH);
+	PyModule_AddIntConstant(m, "RESIZABLE", TDB_RESIZABLE);
+	PyModule_AddIntConstant(m, "SIZE_CLASSES", TDB_SIZE_CLASSES);
+	PyModule_AddIntConstant(m, "OPTIMISTIC_READS", TDB_OPTIMISTIC_READS);
 
 	PyModule_AddStringConstant(m, "__docformat__", "restructuredText");
 
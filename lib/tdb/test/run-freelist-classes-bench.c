@@ -0,0 +1,115 @@
+#include "../common/tdb_private.h"
+#include "../common/io.c"
+#include "../common/tdb.c"
+#include "../common/lock.c"
+#include "../common/freelist.c"
+#include "../common/freelistcheck.c"
+#include "../common/traverse.c"
+#include "../common/transaction.c"
+#include "../common/error.c"
+#include "../common/open.c"
+#include "../common/check.c"
+#include "../common/hash.c"
+#include "../common/mutex.c"
+#include "tap-interface.h"
+#include <stdlib.h>
+#include "logging.h"
+
+#define NUM_RECORDS 20000
+#define NUM_CHURN 5000
+
+static uint8_t buf[8192];
+
+static double timeval_elapsed2(const struct timeval *tv1, const struct timeval *tv2)
+{
+	return (tv2->tv_sec - tv1->tv_sec) +
+	       (tv2->tv_usec - tv1->tv_usec)*1.0e-6;
+}
+
+static double timeval_elapsed(const struct timeval *tv)
+{
+	struct timeval tv2;
+	gettimeofday(&tv2, NULL);
+	return timeval_elapsed2(tv, &tv2);
+}
+
+static TDB_DATA num_key(unsigned *i)
+{
+	return (TDB_DATA) { .dptr = (uint8_t *)i, .dsize = sizeof(*i) };
+}
+
+/*
+ * Fill the free list with lots of small holes, then time a churn of
+ * small and large records on top of that. With a single free list
+ * every large allocation walks over all the small holes.
+ */
+static bool churn(int tdb_flags, const char *what, double *elapsed)
+{
+	struct tdb_context *tdb;
+	struct timeval start;
+	unsigned i, k;
+	int num_free;
+	bool ok = true;
+
+	tdb = tdb_open_ex("run-freelist-classes-bench.tdb", 1031,
+			  TDB_CLEAR_IF_FIRST|tdb_flags,
+			  O_CREAT|O_TRUNC|O_RDWR, 0600, &taplogctx, NULL);
+	if (tdb == NULL) {
+		return false;
+	}
+
+	srandom(1);
+
+	for (i = 0; i < NUM_RECORDS; i++) {
+		TDB_DATA data = { .dptr = buf, .dsize = 16 + random() % 200 };
+		k = i;
+		ok &= (tdb_store(tdb, num_key(&k), data, TDB_INSERT) == 0);
+	}
+	for (i = 0; i < NUM_RECORDS; i += 2) {
+		k = i;
+		ok &= (tdb_delete(tdb, num_key(&k)) == 0);
+	}
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < NUM_CHURN; i++) {
+		TDB_DATA data = { .dptr = buf };
+
+		data.dsize = (i % 4 == 0) ? 1024 + random() % 4096 :
+			16 + random() % 200;
+		k = NUM_RECORDS + i;
+		ok &= (tdb_store(tdb, num_key(&k), data, TDB_INSERT) == 0);
+
+		if (i % 2 == 1) {
+			k = NUM_RECORDS + i - 1;
+			ok &= (tdb_delete(tdb, num_key(&k)) == 0);
+		}
+	}
+
+	*elapsed = timeval_elapsed(&start);
+
+	ok &= (tdb_check(tdb, NULL, NULL) == 0);
+	ok &= (tdb_validate_freelist(tdb, &num_free) == 0);
+
+	diag("%s: %d stores in %f seconds, %d free records",
+	     what, NUM_CHURN, *elapsed, num_free);
+
+	tdb_close(tdb);
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	double single, classes;
+
+	plan_tests(2);
+
+	ok(churn(0, "single free list", &single),
+	   "churn on a single free list should succeed");
+	ok(churn(TDB_SIZE_CLASSES, "free list size classes", &classes),
+	   "churn on free list size classes should succeed");
+
+	diag("size classes took %.0f%% of the time", classes * 100 / single);
+
+	return exit_status();
+}
@@ -0,0 +1,193 @@
+#include "../common/tdb_private.h"
+#include "../common/io.c"
+#include "../common/tdb.c"
+#include "../common/lock.c"
+#include "../common/freelist.c"
+#include "../common/traverse.c"
+#include "../common/transaction.c"
+#include "../common/error.c"
+#include "../common/open.c"
+#include "../common/check.c"
+#include "../common/hash.c"
+#include "../common/summary.c"
+#include "../common/mutex.c"
+#include "tap-interface.h"
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdarg.h>
+
+#define NUM_STORES 5000
+
+static TDB_DATA key;
+static uint8_t buf[512];
+
+static void log_fn(struct tdb_context *tdb, enum tdb_debug_level level,
+		   const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+}
+
+/* All bytes of a value are the same, its length depends on the byte */
+static TDB_DATA make_data(unsigned i)
+{
+	uint8_t c = 'a' + (i % 26);
+
+	memset(buf, c, sizeof(buf));
+	return (TDB_DATA) { .dptr = buf, .dsize = 1 + (c * 3) % sizeof(buf) };
+}
+
+static int check_data(TDB_DATA rec_key, TDB_DATA data, void *private_data)
+{
+	bool *consistent = private_data;
+	size_t i;
+
+	*consistent = (data.dsize != 0) &&
+		(data.dsize == 1 + (data.dptr[0] * 3) % sizeof(buf));
+
+	for (i = 1; *consistent && (i < data.dsize); i++) {
+		*consistent = (data.dptr[i] == data.dptr[0]);
+	}
+	return 0;
+}
+
+static int do_child(int tdb_flags, int to, int from)
+{
+	struct tdb_context *tdb;
+	unsigned int log_count;
+	struct tdb_logging_context log_ctx = { log_fn, &log_count };
+	unsigned i;
+	int ret;
+	char c = 0;
+
+	tdb = tdb_open_ex("mutex-seqlock.tdb", 0, tdb_flags,
+			  O_RDWR|O_CREAT, 0755, &log_ctx, NULL);
+	if (tdb == NULL) {
+		return 1;
+	}
+	if (tdb_store(tdb, key, make_data(0), 0) != 0) {
+		return 2;
+	}
+
+	ret = tdb_chainlock_read(tdb, key);
+	if (ret != 0) {
+		return 3;
+	}
+
+	write(to, &c, sizeof(c));
+	read(from, &c, sizeof(c));
+
+	ret = tdb_chainunlock_read(tdb, key);
+	if (ret != 0) {
+		return 4;
+	}
+
+	for (i = 0; i < NUM_STORES; i++) {
+		if (tdb_store(tdb, key, make_data(i), 0) != 0) {
+			return 5;
+		}
+	}
+
+	write(to, &c, sizeof(c));
+
+	tdb_close(tdb);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct tdb_context *tdb;
+	unsigned int log_count;
+	struct tdb_logging_context log_ctx = { log_fn, &log_count };
+	int ret, status;
+	pid_t child, wait_ret;
+	int fromchild[2];
+	int tochild[2];
+	char c;
+	int tdb_flags;
+	unsigned parses;
+	bool consistent, all_consistent;
+	char *summary;
+
+	if (!tdb_runtime_check_for_robust_mutexes() ||
+	    !(TDB_SUPPORTED_FEATURE_FLAGS & TDB_FEATURE_FLAG_SEQLOCK)) {
+		skip(1, "No robust mutex or atomics support");
+		return exit_status();
+	}
+
+	plan_tests(9);
+
+	key.dsize = strlen("hi");
+	key.dptr = discard_const_p(uint8_t, "hi");
+
+	pipe(fromchild);
+	pipe(tochild);
+
+	tdb_flags = TDB_INCOMPATIBLE_HASH|
+		TDB_MUTEX_LOCKING|
+		TDB_OPTIMISTIC_READS|
+		TDB_CLEAR_IF_FIRST;
+
+	child = fork();
+	if (child == 0) {
+		close(fromchild[0]);
+		close(tochild[1]);
+		return do_child(tdb_flags, fromchild[1], tochild[0]);
+	}
+	close(fromchild[1]);
+	close(tochild[0]);
+
+	/* A reader that does not get done in time blocks on the mutex */
+	alarm(60);
+
+	read(fromchild[0], &c, sizeof(c));
+
+	tdb = tdb_open_ex("mutex-seqlock.tdb", 0, tdb_flags,
+			  O_RDWR|O_CREAT, 0755, &log_ctx, NULL);
+	ok(tdb, "tdb_open_ex should succeed");
+	ok1(tdb->feature_flags & TDB_FEATURE_FLAG_SEQLOCK);
+
+	consistent = false;
+	ret = tdb_parse_record(tdb, key, check_data, &consistent);
+	ok(ret == 0 && consistent,
+	   "tdb_parse_record should not wait for the chain mutex");
+
+	ret = tdb_chainlock_nonblock(tdb, key);
+	ok(ret == -1, "the child should still hold the chain mutex");
+
+	write(tochild[1], &c, sizeof(c));
+
+	/* Parse while the child keeps replacing the record */
+	all_consistent = true;
+	parses = 0;
+	do {
+		ret = tdb_parse_record(tdb, key, check_data, &consistent);
+		all_consistent &= (ret == 0) && consistent;
+		parses += 1;
+	} while ((parses < NUM_STORES) ||
+		 (read(fromchild[0], &c, sizeof(c)) != sizeof(c)));
+	ok(all_consistent, "tdb_parse_record should only see whole records");
+
+	wait_ret = wait(&status);
+	ok(wait_ret == child && WIFEXITED(status) && WEXITSTATUS(status) == 0,
+	   "child should have exited correctly");
+
+	summary = tdb_summary(tdb);
+	ok1(summary != NULL && strstr(summary, "Optimistic reads: yes"));
+	free(summary);
+
+	ret = tdb_delete(tdb, key);
+	ok(ret == 0, "tdb_delete should succeed");
+
+	ret = tdb_parse_record(tdb, key, check_data, &consistent);
+	ok(ret == -1 && tdb_error(tdb) == TDB_ERR_NOEXIST,
+	   "tdb_parse_record should not find a deleted record");
+
+	tdb_close(tdb);
+
+	diag("%u parses during %d stores", parses, NUM_STORES);
+	return exit_status();
+}
@@ -0,0 +1,166 @@
+#include "../common/tdb_private.h"
+#include "../common/io.c"
+#include "../common/tdb.c"
+#include "../common/lock.c"
+#include "../common/freelist.c"
+#include "../common/traverse.c"
+#include "../common/transaction.c"
+#include "../common/error.c"
+#include "../common/open.c"
+#include "../common/check.c"
+#include "../common/hash.c"
+#include "../common/summary.c"
+#include "../common/mutex.c"
+#include "tap-interface.h"
+#include <stdlib.h>
+#include "logging.h"
+
+#define NUM_RECORDS 2000
+
+static uint8_t seen[NUM_RECORDS * 2];
+
+static TDB_DATA num_key(unsigned i)
+{
+	static unsigned k;
+
+	k = i;
+	return (TDB_DATA) { .dptr = (uint8_t *)&k, .dsize = sizeof(k) };
+}
+
+static int count_fn(struct tdb_context *tdb, TDB_DATA key, TDB_DATA data,
+		    void *private_data)
+{
+	unsigned *count = private_data;
+	unsigned i;
+
+	if (key.dsize != sizeof(i)) {
+		return -1;
+	}
+	memcpy(&i, key.dptr, sizeof(i));
+	if (i >= NUM_RECORDS * 2) {
+		return -1;
+	}
+	seen[i] += 1;
+	*count += 1;
+	return 0;
+}
+
+/* Stores more records while walking, so chains get split under us */
+static int grow_fn(struct tdb_context *tdb, TDB_DATA key, TDB_DATA data,
+		   void *private_data)
+{
+	unsigned i;
+
+	if (count_fn(tdb, key, data, private_data) != 0) {
+		return -1;
+	}
+	memcpy(&i, key.dptr, sizeof(i));
+	if (i < NUM_RECORDS) {
+		if (tdb_store(tdb, num_key(i + NUM_RECORDS), data,
+			      TDB_INSERT) != 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static bool all_seen_once(unsigned from, unsigned to)
+{
+	unsigned i;
+
+	for (i = from; i < to; i++) {
+		if (seen[i] != 1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	struct tdb_context *tdb;
+	TDB_DATA key, data;
+	uint32_t buckets;
+	unsigned i, count;
+	bool ok;
+	char *summary;
+
+	plan_tests(22);
+
+	tdb = tdb_open_ex("run-resize.tdb", 7,
+			  TDB_CLEAR_IF_FIRST|TDB_RESIZABLE,
+			  O_CREAT|O_TRUNC|O_RDWR, 0600, &taplogctx, NULL);
+	ok1(tdb);
+	ok1(tdb->feature_flags & TDB_FEATURE_FLAG_RESIZE);
+
+	data = (TDB_DATA) { .dptr = discard_const_p(uint8_t, "data"), .dsize = 4 };
+	ok = true;
+	for (i = 0; i < NUM_RECORDS; i++) {
+		ok &= (tdb_store(tdb, num_key(i), data, TDB_INSERT) == 0);
+	}
+	ok1(ok);
+
+	ok1(tdb_hash_buckets(tdb, &buckets) == 0);
+	ok1(buckets > NUM_RECORDS / TDB_HASH_SPLIT_LENGTH);
+
+	ok = true;
+	for (i = 0; i < NUM_RECORDS; i++) {
+		ok &= (tdb_exists(tdb, num_key(i)) == 1);
+	}
+	ok1(ok);
+	ok1(tdb_check(tdb, NULL, NULL) == 0);
+
+	summary = tdb_summary(tdb);
+	ok1(summary != NULL && strstr(summary, "Resizable hash table: yes"));
+	free(summary);
+
+	memset(seen, 0, sizeof(seen));
+	count = 0;
+	ok1(tdb_traverse(tdb, count_fn, &count) == NUM_RECORDS);
+	ok1(count == NUM_RECORDS && all_seen_once(0, NUM_RECORDS));
+
+	memset(seen, 0, sizeof(seen));
+	count = 0;
+	for (key = tdb_firstkey(tdb); key.dptr != NULL; ) {
+		TDB_DATA next;
+
+		count_fn(tdb, key, data, &count);
+		next = tdb_nextkey(tdb, key);
+		free(key.dptr);
+		key = next;
+	}
+	ok1(count == NUM_RECORDS && all_seen_once(0, NUM_RECORDS));
+
+	/* The originals are seen exactly once while chains split */
+	memset(seen, 0, sizeof(seen));
+	count = 0;
+	ok1(tdb_traverse(tdb, grow_fn, &count) >= NUM_RECORDS);
+	ok1(all_seen_once(0, NUM_RECORDS));
+	ok1(tdb_hash_buckets(tdb, &buckets) == 0);
+	ok1(buckets > NUM_RECORDS * 2 / TDB_HASH_SPLIT_LENGTH);
+	ok1(tdb_check(tdb, NULL, NULL) == 0);
+
+	ok = true;
+	for (i = 0; i < NUM_RECORDS * 2; i += 2) {
+		ok &= (tdb_delete(tdb, num_key(i)) == 0);
+	}
+	for (i = 0; i < NUM_RECORDS * 2; i++) {
+		ok &= (tdb_exists(tdb, num_key(i)) == (i % 2));
+	}
+	ok1(ok);
+	ok1(tdb_check(tdb, NULL, NULL) == 0);
+
+	ok1(tdb_wipe_all(tdb) == 0);
+	ok1(tdb_hash_buckets(tdb, &buckets) == 0);
+	ok1(buckets == 7);
+
+	ok = true;
+	for (i = 0; i < NUM_RECORDS; i++) {
+		ok &= (tdb_store(tdb, num_key(i), data, TDB_INSERT) == 0);
+	}
+	ok1(ok && tdb_check(tdb, NULL, NULL) == 0);
+
+	tdb_close(tdb);
+
+	return exit_status();
+}
@@ -0,0 +1,196 @@
+#include "../common/tdb_private.h"
+#include "../common/io.c"
+#include "../common/tdb.c"
+#include "../common/lock.c"
+#include "../common/freelist.c"
+#include "../common/traverse.c"
+#include "../common/transaction.c"
+#include "../common/error.c"
+#include "../common/open.c"
+#include "../common/check.c"
+#include "../common/hash.c"
+#include "../common/mutex.c"
+#include "tap-interface.h"
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "logging.h"
+
+#define NUM_RECORDS 20000
+
+static uint8_t seen[NUM_RECORDS];
+
+static TDB_DATA num_key(unsigned i)
+{
+	static unsigned k;
+
+	k = i;
+	return (TDB_DATA) { .dptr = (uint8_t *)&k, .dsize = sizeof(k) };
+}
+
+/* Keys above NUM_RECORDS are the child's */
+static int count_fn(struct tdb_context *tdb, TDB_DATA key, TDB_DATA data,
+		    void *private_data)
+{
+	unsigned *count = private_data;
+	unsigned i;
+
+	if (key.dsize != sizeof(i)) {
+		return -1;
+	}
+	memcpy(&i, key.dptr, sizeof(i));
+	if (i < NUM_RECORDS) {
+		if ((data.dsize != sizeof(i)) ||
+		    (memcmp(data.dptr, &i, sizeof(i)) != 0)) {
+			return -1;
+		}
+		seen[i] += 1;
+	}
+	*count += 1;
+	return 0;
+}
+
+static int stop_fn(struct tdb_context *tdb, TDB_DATA key, TDB_DATA data,
+		   void *private_data)
+{
+	unsigned *count = private_data;
+
+	*count += 1;
+	return (*count == 10);
+}
+
+static int store_fn(struct tdb_context *tdb, TDB_DATA key, TDB_DATA data,
+		    void *private_data)
+{
+	int *ret = private_data;
+
+	*ret = tdb_store(tdb, key, data, TDB_REPLACE);
+	return 1;
+}
+
+static bool all_seen_once(void)
+{
+	unsigned i;
+
+	for (i = 0; i < NUM_RECORDS; i++) {
+		if (seen[i] != 1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool fill(struct tdb_context *tdb)
+{
+	unsigned i;
+	bool ok = true;
+
+	for (i = 0; i < NUM_RECORDS; i++) {
+		TDB_DATA data = num_key(i);
+		ok &= (tdb_store(tdb, data, data, TDB_INSERT) == 0);
+	}
+	return ok;
+}
+
+/* Keep changing records the parent doesn't look at */
+static void do_child(const char *name, int tdb_flags, int from)
+{
+	struct tdb_context *tdb;
+	unsigned i = NUM_RECORDS;
+	char c;
+
+	tdb = tdb_open_ex(name, 0, tdb_flags, O_RDWR, 0600, &taplogctx, NULL);
+	if (tdb == NULL) {
+		exit(1);
+	}
+
+	fcntl(from, F_SETFL, O_NONBLOCK);
+
+	while (read(from, &c, sizeof(c)) != 0) {
+		TDB_DATA data = num_key(i);
+
+		if (tdb_store(tdb, data, data, TDB_REPLACE) != 0) {
+			exit(2);
+		}
+		if ((i % 2) && (tdb_delete(tdb, num_key(i - 1)) != 0)) {
+			exit(3);
+		}
+		i = (i < NUM_RECORDS * 2) ? i + 1 : NUM_RECORDS;
+	}
+	exit(0);
+}
+
+static void test_parallel(const char *name, int tdb_flags)
+{
+	struct tdb_context *tdb;
+	unsigned count;
+	int ret, status;
+	int tochild[2];
+	pid_t child;
+
+	tdb = tdb_open_ex(name, 1031, tdb_flags, O_CREAT|O_TRUNC|O_RDWR,
+			  0600, &taplogctx, NULL);
+	ok1(tdb);
+	ok1(fill(tdb));
+
+	memset(seen, 0, sizeof(seen));
+	count = 0;
+	ok1(tdb_traverse_read_parallel(tdb, 4, count_fn, &count) ==
+	    NUM_RECORDS);
+	ok1(count == NUM_RECORDS && all_seen_once());
+
+	count = 0;
+	ok1(tdb_traverse_read_parallel(tdb, 4, stop_fn, &count) == 10);
+	ok1(count == 10);
+
+	/* Like tdb_traverse_read(), the database is read-only in fn */
+	ret = 0;
+	ok1(tdb_traverse_read_parallel(tdb, 4, store_fn, &ret) == 1);
+	ok1(ret == -1 && tdb_error(tdb) == TDB_ERR_RDONLY);
+
+	tdb_close(tdb);
+	tdb_flags &= ~TDB_CLEAR_IF_FIRST;
+
+	pipe(tochild);
+	child = fork();
+	if (child == 0) {
+		close(tochild[1]);
+		do_child(name, tdb_flags, tochild[0]);
+	}
+	close(tochild[0]);
+
+	tdb = tdb_open_ex(name, 0, tdb_flags, O_RDWR, 0600, &taplogctx, NULL);
+	ok1(tdb);
+
+	memset(seen, 0, sizeof(seen));
+	count = 0;
+	ok1(tdb_traverse_read_parallel(tdb, 8, count_fn, &count) >=
+	    NUM_RECORDS);
+	ok1(all_seen_once());
+
+	close(tochild[1]);
+	ok1(waitpid(child, &status, 0) == child &&
+	    WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	ok1(tdb_check(tdb, NULL, NULL) == 0);
+	tdb_close(tdb);
+}
+
+int main(int argc, char *argv[])
+{
+	int tdb_flags = TDB_INCOMPATIBLE_HASH|TDB_CLEAR_IF_FIRST;
+
+	plan_tests(26);
+
+	/* Without mutexes this is tdb_traverse_read() */
+	test_parallel("run-traverse-parallel.tdb", tdb_flags);
+
+	if (!tdb_runtime_check_for_robust_mutexes()) {
+		skip(13, "No robust mutex support");
+		return exit_status();
+	}
+	test_parallel("run-traverse-parallel-mutex.tdb",
+		      tdb_flags|TDB_MUTEX_LOCKING|TDB_RESIZABLE);
+
+	return exit_status();
+}
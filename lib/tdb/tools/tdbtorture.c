@@ -34,6 +34,9 @@ static int hash_size = 2;
 static unsigned loopnum;
 static int count_pipe;
 static bool mutex = false;
+static bool resizable = false;
+static bool size_classes = false;
+static bool optimistic = false;
 static struct tdb_logging_context log_ctx;
 
 #ifdef PRINTF_ATTRIBUTE
@@ -82,6 +85,21 @@ static char *randbuf(int len)
 	return buf;
 }
 
+/* Values are NUL-terminated randbuf()s, maybe several of them appended */
+static int check_parser(TDB_DATA key, TDB_DATA data, void *private_data)
+{
+	size_t i;
+
+	for (i=0; i<data.dsize; i++) {
+		if ((data.dptr[i] != '\0') &&
+		    ((data.dptr[i] < 'a') || (data.dptr[i] > 'z'))) {
+			fatal("tdb_parse_record saw a torn record");
+			return -1;
+		}
+	}
+	return 0;
+}
+
 static int cull_traverse(struct tdb_context *tdb, TDB_DATA key, TDB_DATA dbuf,
 			 void *state)
 {
@@ -211,6 +229,11 @@ static void addrec_db(void)
 	}
 #endif
 
+	if (optimistic) {
+		tdb_parse_record(db, key, check_parser, NULL);
+		goto next;
+	}
+
 	data = tdb_fetch(db, key);
 	if (data.dptr) free(data.dptr);
 
@@ -228,7 +251,7 @@ static int traverse_fn(struct tdb_context *tdb, TDB_DATA key, TDB_DATA dbuf,
 
 static void usage(void)
 {
-	printf("Usage: tdbtorture [-t] [-k] [-m] [-n NUM_PROCS] [-l NUM_LOOPS] [-s SEED] [-H HASH_SIZE]\n");
+	printf("Usage: tdbtorture [-t] [-k] [-m [-o]] [-r] [-c] [-n NUM_PROCS] [-l NUM_LOOPS] [-s SEED] [-H HASH_SIZE]\n");
 	exit(0);
 }
 
@@ -251,6 +274,15 @@ static int run_child(const char *filename, int i, int seed, unsigned num_loops,
 	if (mutex) {
 		tdb_flags |= TDB_MUTEX_LOCKING;
 	}
+	if (resizable) {
+		tdb_flags |= TDB_RESIZABLE;
+	}
+	if (size_classes) {
+		tdb_flags |= TDB_SIZE_CLASSES;
+	}
+	if (optimistic) {
+		tdb_flags |= TDB_OPTIMISTIC_READS;
+	}
 
 	db = tdb_open_ex(filename, hash_size, tdb_flags,
 			 O_RDWR | O_CREAT, 0600, &log_ctx, NULL);
@@ -324,7 +356,7 @@ int main(int argc, char * const *argv)
 
 	log_ctx.log_fn = tdb_log;
 
-	while ((c = getopt(argc, argv, "n:l:s:H:thkm")) != -1) {
+	while ((c = getopt(argc, argv, "n:l:s:H:thkmroc")) != -1) {
 		switch (c) {
 		case 'n':
 			num_procs = strtoul(optarg, NULL, 0);
@@ -351,6 +383,15 @@ int main(int argc, char * const *argv)
 				exit(1);
 			}
 			break;
+		case 'r':
+			resizable = true;
+			break;
+		case 'c':
+			size_classes = true;
+			break;
+		case 'o':
+			optimistic = true;
+			break;
 		default:
 			usage();
 		}
@@ -0,0 +1,510 @@
+/*
+   Unix SMB/CIFS implementation.
+
+   SMB2 compression transform handling [MS-SMB2] 2.2.42 and 3.1.4.4
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "includes.h"
+#include "system/filesys.h"
+#include "lib/util/iov_buf.h"
+#include "../libcli/smb/smb_common.h"
+#include "libcli/smb/smb2_negotiate_context.h"
+#include "libcli/smb/smb2_compression.h"
+#include "lib/compression/lzxpress.h"
+#include "lib/compression/lzxpress_huffman.h"
+
+static bool smb2_compression_algo_allowed(
+	const struct smb3_compression_capabilities *c,
+	uint16_t algo)
+{
+	size_t i;
+
+	for (i = 0; i < c->num_algos; i++) {
+		if (c->algos[i] == algo) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool smb2_compression_is_pattern(const uint8_t *p, size_t len)
+{
+	if (len == 0) {
+		return false;
+	}
+
+	/*
+	 * All bytes are equal if the buffer
+	 * matches itself shifted by one byte.
+	 */
+	return memcmp(p, p + 1, len - 1) == 0;
+}
+
+static ssize_t smb2_compression_compress_payload(TALLOC_CTX *mem_ctx,
+						 uint16_t algo,
+						 const uint8_t *in,
+						 size_t in_len,
+						 uint8_t *out,
+						 size_t out_len)
+{
+	struct lzxhuff_compressor_mem *cmp = NULL;
+	ssize_t ret;
+
+	if (in_len > UINT32_MAX || out_len > UINT32_MAX) {
+		return -1;
+	}
+
+	switch (algo) {
+	case SMB2_COMPRESSION_LZ77:
+		return lzxpress_compress(in, in_len, out, out_len);
+	case SMB2_COMPRESSION_LZ77_HUFFMAN:
+		cmp = talloc(mem_ctx, struct lzxhuff_compressor_mem);
+		if (cmp == NULL) {
+			return -1;
+		}
+		ret = lzxpress_huffman_compress(cmp, in, in_len, out, out_len);
+		TALLOC_FREE(cmp);
+		return ret;
+	default:
+		break;
+	}
+
+	return -1;
+}
+
+static bool smb2_compression_decompress_payload(uint16_t algo,
+						const uint8_t *in,
+						size_t in_len,
+						uint8_t *out,
+						size_t out_len)
+{
+	ssize_t ret;
+
+	if (in_len > UINT32_MAX || out_len > UINT32_MAX) {
+		return false;
+	}
+
+	switch (algo) {
+	case SMB2_COMPRESSION_LZ77:
+		ret = lzxpress_decompress(in, in_len, out, out_len);
+		break;
+	case SMB2_COMPRESSION_LZ77_HUFFMAN:
+		ret = lzxpress_huffman_decompress(in, in_len, out, out_len);
+		break;
+	default:
+		return false;
+	}
+
+	if (ret < 0) {
+		return false;
+	}
+
+	return (size_t)ret == out_len;
+}
+
+static bool smb2_compression_is_chained(const uint8_t *buf, size_t buflen)
+{
+	if (buflen < SMB2_COMP_TF_CHAINED_HDR_SIZE + SMB2_COMP_PL_HDR_SIZE) {
+		return false;
+	}
+
+	return SVAL(buf, SMB2_COMP_TF_FLAGS) == SMB2_COMPRESSION_FLAG_CHAINED;
+}
+
+NTSTATUS smb2_compression_original_size(const uint8_t *buf,
+					size_t buflen,
+					size_t *poriginal_size)
+{
+	uint32_t segment_size;
+	uint32_t offset;
+	size_t original_size;
+
+	if (buflen < SMB2_COMP_TF_CHAINED_HDR_SIZE) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	if (IVAL(buf, SMB2_COMP_TF_PROTOCOL_ID) != SMB2_COMP_TF_MAGIC) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	segment_size = IVAL(buf, SMB2_COMP_TF_ORIGINAL_SIZE);
+
+	if (smb2_compression_is_chained(buf, buflen)) {
+		/*
+		 * For chained compression OriginalCompressedSegmentSize
+		 * covers the whole message.
+		 */
+		*poriginal_size = segment_size;
+		return NT_STATUS_OK;
+	}
+
+	if (buflen < SMB2_COMP_TF_HDR_SIZE) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	/*
+	 * For unchained compression the first 'Offset' bytes
+	 * follow the header uncompressed.
+	 */
+	offset = IVAL(buf, SMB2_COMP_TF_OFFSET);
+	original_size = (size_t)offset + segment_size;
+
+	*poriginal_size = original_size;
+	return NT_STATUS_OK;
+}
+
+static NTSTATUS smb2_compression_decompress_unchained(
+	const struct smb3_compression_capabilities *c,
+	const uint8_t *buf,
+	size_t buflen,
+	uint8_t *out,
+	size_t out_len)
+{
+	uint16_t algo = SVAL(buf, SMB2_COMP_TF_ALGORITHM);
+	uint32_t segment_size = IVAL(buf, SMB2_COMP_TF_ORIGINAL_SIZE);
+	uint32_t offset = IVAL(buf, SMB2_COMP_TF_OFFSET);
+	const uint8_t *data = buf + SMB2_COMP_TF_HDR_SIZE;
+	size_t data_len = buflen - SMB2_COMP_TF_HDR_SIZE;
+	bool ok;
+
+	if (algo == SMB2_COMPRESSION_PATTERN_V1 ||
+	    !smb2_compression_algo_allowed(c, algo))
+	{
+		DBG_NOTICE("compression algorithm 0x%04x not negotiated\n",
+			   algo);
+		return NT_STATUS_BAD_COMPRESSION_BUFFER;
+	}
+
+	if (offset > data_len) {
+		return NT_STATUS_BAD_COMPRESSION_BUFFER;
+	}
+
+	if ((size_t)offset + segment_size != out_len) {
+		return NT_STATUS_BAD_COMPRESSION_BUFFER;
+	}
+
+	memcpy(out, data, offset);
+
+	ok = smb2_compression_decompress_payload(algo,
+						 data + offset,
+						 data_len - offset,
+						 out + offset,
+						 segment_size);
+	if (!ok) {
+		return NT_STATUS_BAD_COMPRESSION_BUFFER;
+	}
+
+	return NT_STATUS_OK;
+}
+
+static NTSTATUS smb2_compression_decompress_chained(
+	const struct smb3_compression_capabilities *c,
+	const uint8_t *buf,
+	size_t buflen,
+	uint8_t *out,
+	size_t out_len)
+{
+	size_t ofs = SMB2_COMP_TF_CHAINED_HDR_SIZE;
+	size_t out_ofs = 0;
+
+	if (!c->chained) {
+		DBG_NOTICE("chained compression not negotiated\n");
+		return NT_STATUS_BAD_COMPRESSION_BUFFER;
+	}
+
+	while (ofs < buflen) {
+		const uint8_t *pl = buf + ofs;
+		const uint8_t *data = NULL;
+		uint16_t algo;
+		uint32_t length;
+		uint32_t original_size;
+		uint32_t repetitions;
+		bool ok;
+
+		if (buflen - ofs < SMB2_COMP_PL_HDR_SIZE) {
+			return NT_STATUS_BAD_COMPRESSION_BUFFER;
+		}
+
+		algo = SVAL(pl, SMB2_COMP_PL_ALGORITHM);
+		length = IVAL(pl, SMB2_COMP_PL_LENGTH);
+		data = pl + SMB2_COMP_PL_HDR_SIZE;
+
+		ofs += SMB2_COMP_PL_HDR_SIZE;
+		if (length > buflen - ofs) {
+			return NT_STATUS_BAD_COMPRESSION_BUFFER;
+		}
+		ofs += length;
+
+		switch (algo) {
+		case SMB2_COMPRESSION_NONE:
+			if (length > out_len - out_ofs) {
+				return NT_STATUS_BAD_COMPRESSION_BUFFER;
+			}
+			memcpy(out + out_ofs, data, length);
+			out_ofs += length;
+			break;
+
+		case SMB2_COMPRESSION_PATTERN_V1:
+			if (!smb2_compression_algo_allowed(c, algo)) {
+				return NT_STATUS_BAD_COMPRESSION_BUFFER;
+			}
+			if (length != SMB2_COMP_PATTERN_V1_SIZE) {
+				return NT_STATUS_BAD_COMPRESSION_BUFFER;
+			}
+			repetitions = IVAL(data, 4);
+			if (repetitions > out_len - out_ofs) {
+				return NT_STATUS_BAD_COMPRESSION_BUFFER;
+			}
+			memset(out + out_ofs, CVAL(data, 0), repetitions);
+			out_ofs += repetitions;
+			break;
+
+		default:
+			if (!smb2_compression_algo_allowed(c, algo)) {
+				DBG_NOTICE("compression algorithm 0x%04x "
+					   "not negotiated\n",
+					   algo);
+				return NT_STATUS_BAD_COMPRESSION_BUFFER;
+			}
+			if (length < 4) {
+				return NT_STATUS_BAD_COMPRESSION_BUFFER;
+			}
+			original_size = IVAL(data, 0);
+			if (original_size > out_len - out_ofs) {
+				return NT_STATUS_BAD_COMPRESSION_BUFFER;
+			}
+			ok = smb2_compression_decompress_payload(
+				algo,
+				data + 4,
+				length - 4,
+				out + out_ofs,
+				original_size);
+			if (!ok) {
+				return NT_STATUS_BAD_COMPRESSION_BUFFER;
+			}
+			out_ofs += original_size;
+			break;
+		}
+	}
+
+	if (out_ofs != out_len) {
+		return NT_STATUS_BAD_COMPRESSION_BUFFER;
+	}
+
+	return NT_STATUS_OK;
+}
+
+NTSTATUS smb2_compression_decompress_pdu(
+	const struct smb3_compression_capabilities *c,
+	const uint8_t *buf,
+	size_t buflen,
+	uint8_t *out,
+	size_t out_len)
+{
+	size_t original_size = 0;
+	NTSTATUS status;
+
+	status = smb2_compression_original_size(buf, buflen, &original_size);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+
+	if (original_size != out_len) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	if (smb2_compression_is_chained(buf, buflen)) {
+		return smb2_compression_decompress_chained(c,
+							   buf,
+							   buflen,
+							   out,
+							   out_len);
+	}
+
+	return smb2_compression_decompress_unchained(c,
+						     buf,
+						     buflen,
+						     out,
+						     out_len);
+}
+
+NTSTATUS smb2_compression_compress_pdu(
+	TALLOC_CTX *mem_ctx,
+	const struct smb3_compression_capabilities *c,
+	const struct iovec *prefix,
+	int prefix_count,
+	const DATA_BLOB *payload,
+	DATA_BLOB *out)
+{
+	uint16_t algo = SMB2_COMPRESSION_NONE;
+	bool use_pattern = false;
+	ssize_t prefix_len;
+	size_t original_size;
+	size_t hdr_len;
+	size_t ofs;
+	uint8_t *buf = NULL;
+	ssize_t clen;
+	size_t i;
+
+	*out = data_blob_null;
+
+	prefix_len = iov_buflen(prefix, prefix_count);
+	if (prefix_len == -1) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	original_size = prefix_len + payload->length;
+	if (original_size < payload->length || original_size > UINT32_MAX) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	if (payload->length == 0) {
+		return NT_STATUS_OK;
+	}
+
+	/*
+	 * The negotiated algorithms are in the order
+	 * of our preference.
+	 */
+	for (i = 0; i < c->num_algos; i++) {
+		switch (c->algos[i]) {
+		case SMB2_COMPRESSION_PATTERN_V1:
+			if (c->chained) {
+				use_pattern = smb2_compression_is_pattern(
+					payload->data, payload->length);
+			}
+			break;
+		case SMB2_COMPRESSION_LZ77:
+		case SMB2_COMPRESSION_LZ77_HUFFMAN:
+			if (algo == SMB2_COMPRESSION_NONE) {
+				algo = c->algos[i];
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (!use_pattern && algo == SMB2_COMPRESSION_NONE) {
+		return NT_STATUS_OK;
+	}
+
+	if (c->chained) {
+		hdr_len = SMB2_COMP_TF_CHAINED_HDR_SIZE;
+		if (prefix_len > 0) {
+			hdr_len += SMB2_COMP_PL_HDR_SIZE + prefix_len;
+		}
+		hdr_len += SMB2_COMP_PL_HDR_SIZE;
+		if (use_pattern) {
+			hdr_len += SMB2_COMP_PATTERN_V1_SIZE;
+		} else {
+			/* OriginalPayloadSize */
+			hdr_len += 4;
+		}
+	} else {
+		hdr_len = SMB2_COMP_TF_HDR_SIZE + prefix_len;
+	}
+
+	if (hdr_len >= original_size) {
+		return NT_STATUS_OK;
+	}
+
+	/*
+	 * We only want the compressed form if it
+	 * is smaller than the original message.
+	 */
+	buf = talloc_array(mem_ctx, uint8_t, original_size - 1);
+	if (buf == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	SIVAL(buf, SMB2_COMP_TF_PROTOCOL_ID, SMB2_COMP_TF_MAGIC);
+
+	if (!c->chained) {
+		SIVAL(buf, SMB2_COMP_TF_ORIGINAL_SIZE, payload->length);
+		SSVAL(buf, SMB2_COMP_TF_ALGORITHM, algo);
+		SSVAL(buf, SMB2_COMP_TF_FLAGS, SMB2_COMPRESSION_FLAG_NONE);
+		SIVAL(buf, SMB2_COMP_TF_OFFSET, prefix_len);
+		ofs = SMB2_COMP_TF_HDR_SIZE;
+		iov_buf(prefix, prefix_count, buf + ofs, prefix_len);
+		ofs += prefix_len;
+
+		clen = smb2_compression_compress_payload(mem_ctx,
+							 algo,
+							 payload->data,
+							 payload->length,
+							 buf + ofs,
+							 original_size - 1 - ofs);
+		if (clen < 0) {
+			TALLOC_FREE(buf);
+			return NT_STATUS_OK;
+		}
+		ofs += clen;
+		goto done;
+	}
+
+	SIVAL(buf, SMB2_COMP_TF_ORIGINAL_SIZE, original_size);
+	ofs = SMB2_COMP_TF_CHAINED_HDR_SIZE;
+
+	if (prefix_len > 0) {
+		SSVAL(buf, ofs + SMB2_COMP_PL_ALGORITHM,
+		      SMB2_COMPRESSION_NONE);
+		SSVAL(buf, ofs + SMB2_COMP_PL_FLAGS,
+		      SMB2_COMPRESSION_FLAG_CHAINED);
+		SIVAL(buf, ofs + SMB2_COMP_PL_LENGTH, prefix_len);
+		ofs += SMB2_COMP_PL_HDR_SIZE;
+		iov_buf(prefix, prefix_count, buf + ofs, prefix_len);
+		ofs += prefix_len;
+	}
+
+	if (use_pattern) {
+		SSVAL(buf, ofs + SMB2_COMP_PL_ALGORITHM,
+		      SMB2_COMPRESSION_PATTERN_V1);
+		SSVAL(buf, ofs + SMB2_COMP_PL_FLAGS,
+		      SMB2_COMPRESSION_FLAG_CHAINED);
+		SIVAL(buf, ofs + SMB2_COMP_PL_LENGTH,
+		      SMB2_COMP_PATTERN_V1_SIZE);
+		ofs += SMB2_COMP_PL_HDR_SIZE;
+		SCVAL(buf, ofs + 0, payload->data[0]);	/* Pattern */
+		SCVAL(buf, ofs + 1, 0);			/* Reserved1 */
+		SSVAL(buf, ofs + 2, 0);			/* Reserved2 */
+		SIVAL(buf, ofs + 4, payload->length);	/* Repetitions */
+		ofs += SMB2_COMP_PATTERN_V1_SIZE;
+		goto done;
+	}
+
+	clen = smb2_compression_compress_payload(mem_ctx,
+						 algo,
+						 payload->data,
+						 payload->length,
+						 buf + hdr_len,
+						 original_size - 1 - hdr_len);
+	if (clen < 0) {
+		TALLOC_FREE(buf);
+		return NT_STATUS_OK;
+	}
+
+	SSVAL(buf, ofs + SMB2_COMP_PL_ALGORITHM, algo);
+	SSVAL(buf, ofs + SMB2_COMP_PL_FLAGS, SMB2_COMPRESSION_FLAG_CHAINED);
+	SIVAL(buf, ofs + SMB2_COMP_PL_LENGTH, 4 + clen);
+	SIVAL(buf, ofs + SMB2_COMP_PL_ORIGINAL_SIZE, payload->length);
+	ofs = hdr_len + clen;
+
+done:
+	*out = data_blob_const(buf, ofs);
+	return NT_STATUS_OK;
+}
@@ -0,0 +1,68 @@
+/*
+   Unix SMB/CIFS implementation.
+
+   SMB2 compression transform handling [MS-SMB2] 2.2.42 and 3.1.4.4
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _LIBCLI_SMB_SMB2_COMPRESSION_H_
+#define _LIBCLI_SMB_SMB2_COMPRESSION_H_
+
+struct iovec;
+struct smb3_compression_capabilities;
+
+/*
+ * Return the size of the message carried in the
+ * (chained or unchained) SMB2_COMPRESSION_TRANSFORM_HEADER
+ * at the start of buf, once it is decompressed.
+ */
+NTSTATUS smb2_compression_original_size(const uint8_t *buf,
+					size_t buflen,
+					size_t *poriginal_size);
+
+/*
+ * Decompress the compressed message in buf into out,
+ * out_len has to be the value returned by
+ * smb2_compression_original_size().
+ *
+ * Only the algorithms listed in c (and SMB2_COMPRESSION_NONE
+ * in chained payloads) are accepted.
+ */
+NTSTATUS smb2_compression_decompress_pdu(
+	const struct smb3_compression_capabilities *c,
+	const uint8_t *buf,
+	size_t buflen,
+	uint8_t *out,
+	size_t out_len);
+
+/*
+ * Build a compressed message out of an uncompressed prefix
+ * (typically the SMB2 header and the fixed size body) and
+ * the payload that should be compressed.
+ *
+ * If the compressed form would not be smaller than the
+ * original message NT_STATUS_OK is returned together with
+ * an empty *out blob, the caller is expected to send the
+ * message uncompressed in that case.
+ */
+NTSTATUS smb2_compression_compress_pdu(
+	TALLOC_CTX *mem_ctx,
+	const struct smb3_compression_capabilities *c,
+	const struct iovec *prefix,
+	int prefix_count,
+	const DATA_BLOB *payload,
+	DATA_BLOB *out);
+
+#endif /* _LIBCLI_SMB_SMB2_COMPRESSION_H_ */
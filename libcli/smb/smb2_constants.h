@@ -37,6 +37,33 @@
 
 #define SMB2_TF_FLAGS_ENCRYPTED     0x0001
 
+/* offsets into SMB2_COMPRESSION_TRANSFORM header elements (>= 0x311) */
+#define SMB2_COMP_TF_PROTOCOL_ID	0x00 /*  4 bytes */
+#define SMB2_COMP_TF_ORIGINAL_SIZE	0x04 /*  4 bytes */
+#define SMB2_COMP_TF_ALGORITHM		0x08 /*  2 bytes */
+#define SMB2_COMP_TF_FLAGS		0x0A /*  2 bytes */
+#define SMB2_COMP_TF_OFFSET		0x0C /*  4 bytes (unchained) */
+#define SMB2_COMP_TF_LENGTH		0x0C /*  4 bytes (chained) */
+
+#define SMB2_COMP_TF_HDR_SIZE		0x10 /* 16 bytes (unchained) */
+#define SMB2_COMP_TF_CHAINED_HDR_SIZE	0x08 /*  8 bytes (chained) */
+
+/* offsets into SMB2_COMPRESSION_CHAINED_PAYLOAD_HEADER elements */
+#define SMB2_COMP_PL_ALGORITHM		0x00 /*  2 bytes */
+#define SMB2_COMP_PL_FLAGS		0x02 /*  2 bytes */
+#define SMB2_COMP_PL_LENGTH		0x04 /*  4 bytes */
+#define SMB2_COMP_PL_ORIGINAL_SIZE	0x08 /*  4 bytes (optional) */
+
+#define SMB2_COMP_PL_HDR_SIZE		0x08 /*  8 bytes */
+
+/* SMB2_COMPRESSION_PATTERN_PAYLOAD_V1 */
+#define SMB2_COMP_PATTERN_V1_SIZE	0x08 /*  8 bytes */
+
+#define SMB2_COMP_TF_MAGIC 0x424D53FC /* 0xFC 'S' 'M' 'B' */
+
+#define SMB2_COMPRESSION_FLAG_NONE	0x0000
+#define SMB2_COMPRESSION_FLAG_CHAINED	0x0001
+
 /* offsets into header elements for a sync SMB2 request */
 #define SMB2_HDR_PROTOCOL_ID    0x00
 #define SMB2_HDR_LENGTH		0x04
@@ -169,6 +196,17 @@
 #define SMB2_RDMA_TRANSFORM_ENCRYPTION                 0x0001
 #define SMB2_RDMA_TRANSFORM_SIGNING                    0x0002
 
+/* Values for the SMB2_COMPRESSION_CAPABILITIES Context (>= 0x311) */
+#define SMB2_COMPRESSION_CAPABILITIES_FLAG_NONE        0x00000000
+#define SMB2_COMPRESSION_CAPABILITIES_FLAG_CHAINED     0x00000001
+
+#define SMB2_COMPRESSION_NONE                          0x0000
+#define SMB2_COMPRESSION_LZNT1                         0x0001
+#define SMB2_COMPRESSION_LZ77                          0x0002
+#define SMB2_COMPRESSION_LZ77_HUFFMAN                  0x0003
+#define SMB2_COMPRESSION_PATTERN_V1                    0x0004 /* chained only */
+#define SMB2_COMPRESSION_LZ4                           0x0005
+
 /* SMB2 session (request) flags */
 #define SMB2_SESSION_FLAG_BINDING       0x01
 /*      SMB2_SESSION_FLAG_ENCRYPT_DATA  0x04       only in dialect >= 0x310 */
@@ -299,6 +337,7 @@
 #define SMB2_CLOSE_FLAGS_FULL_INFORMATION (0x01)
 
 #define SMB2_READFLAG_READ_UNBUFFERED	0x01
+#define SMB2_READFLAG_REQUEST_COMPRESSED 0x02 /* only in dialect >= 0x311 */
 
 #define SMB2_WRITEFLAG_WRITE_THROUGH	0x00000001
 #define SMB2_WRITEFLAG_WRITE_UNBUFFERED	0x00000002
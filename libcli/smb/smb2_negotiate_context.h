@@ -68,6 +68,13 @@ struct smb3_encryption_capabilities {
 	uint16_t algos[SMB3_ENCRYTION_CAPABILITIES_MAX_ALGOS];
 };
 
+struct smb3_compression_capabilities {
+#define SMB3_COMPRESSION_CAPABILITIES_MAX_ALGOS 3
+	uint16_t num_algos;
+	uint16_t algos[SMB3_COMPRESSION_CAPABILITIES_MAX_ALGOS];
+	bool chained;
+};
+
 struct smb311_capabilities {
 	struct smb3_signing_capabilities signing;
 	struct smb3_encryption_capabilities encryption;
@@ -76,6 +83,7 @@ struct smb311_capabilities {
 
 const char *smb3_signing_algorithm_name(uint16_t algo);
 const char *smb3_encryption_algorithm_name(uint16_t algo);
+const char *smb3_compression_algorithm_name(uint16_t algo);
 
 struct smb311_capabilities smb311_capabilities_parse(
 	const char *role,
@@ -83,6 +91,10 @@ struct smb311_capabilities smb311_capabilities_parse(
 	const char *const *encryption_algos,
 	bool smb_encryption_over_quic);
 
+struct smb3_compression_capabilities smb3_compression_capabilities_parse(
+	const char *role,
+	const char *const *compression_algos);
+
 NTSTATUS smb311_capabilities_check(const struct smb311_capabilities *c,
 				   const char *debug_prefix,
 				   int debug_lvl,
@@ -0,0 +1,280 @@
+/*
+ * Unix SMB/CIFS implementation.
+ *
+ * Tests for the SMB2 compression transform helpers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "includes.h"
+#include "libcli/smb/smb_common.h"
+#include "libcli/smb/smb2_negotiate_context.h"
+#include "libcli/smb/smb2_compression.h"
+
+#define TEST_PAYLOAD_SIZE (1024 * 1024)
+
+static void roundtrip(uint16_t algo, bool chained, uint8_t fill)
+{
+	TALLOC_CTX *frame = talloc_stackframe();
+	struct smb3_compression_capabilities c = {
+		.num_algos = 2,
+		.algos = { algo, SMB2_COMPRESSION_PATTERN_V1, },
+		.chained = chained,
+	};
+	uint8_t hdr[SMB2_HDR_BODY];
+	uint8_t body[0x10];
+	struct iovec prefix[2] = {
+		{ .iov_base = hdr, .iov_len = sizeof(hdr), },
+		{ .iov_base = body, .iov_len = sizeof(body), },
+	};
+	DATA_BLOB payload;
+	DATA_BLOB compressed = data_blob_null;
+	size_t original_size = 0;
+	uint8_t *out = NULL;
+	NTSTATUS status;
+	size_t i;
+
+	memset(hdr, 0xfe, sizeof(hdr));
+	memset(body, 0x11, sizeof(body));
+
+	payload = data_blob_talloc(frame, NULL, TEST_PAYLOAD_SIZE);
+	assert_non_null(payload.data);
+	for (i = 0; i < payload.length; i++) {
+		payload.data[i] = (fill != 0) ? fill : (i % 251) & 0x7f;
+	}
+
+	status = smb2_compression_compress_pdu(
+		frame, &c, prefix, 2, &payload, &compressed);
+	assert_true(NT_STATUS_IS_OK(status));
+	assert_true(compressed.length > 0);
+	assert_true(compressed.length < sizeof(hdr) + sizeof(body) +
+					payload.length);
+
+	status = smb2_compression_original_size(compressed.data,
+						compressed.length,
+						&original_size);
+	assert_true(NT_STATUS_IS_OK(status));
+	assert_int_equal(original_size,
+			 sizeof(hdr) + sizeof(body) + payload.length);
+
+	out = talloc_array(frame, uint8_t, original_size);
+	assert_non_null(out);
+
+	status = smb2_compression_decompress_pdu(&c,
+						 compressed.data,
+						 compressed.length,
+						 out,
+						 original_size);
+	assert_true(NT_STATUS_IS_OK(status));
+	assert_memory_equal(out, hdr, sizeof(hdr));
+	assert_memory_equal(out + sizeof(hdr), body, sizeof(body));
+	assert_memory_equal(out + sizeof(hdr) + sizeof(body),
+			    payload.data,
+			    payload.length);
+
+	TALLOC_FREE(frame);
+}
+
+static void test_lz77_unchained(void **state)
+{
+	roundtrip(SMB2_COMPRESSION_LZ77, false, 0);
+}
+
+static void test_lz77_chained(void **state)
+{
+	roundtrip(SMB2_COMPRESSION_LZ77, true, 0);
+}
+
+static void test_lz77_huffman_unchained(void **state)
+{
+	roundtrip(SMB2_COMPRESSION_LZ77_HUFFMAN, false, 0);
+}
+
+static void test_lz77_huffman_chained(void **state)
+{
+	roundtrip(SMB2_COMPRESSION_LZ77_HUFFMAN, true, 0);
+}
+
+static void test_pattern_v1(void **state)
+{
+	roundtrip(SMB2_COMPRESSION_LZ77_HUFFMAN, true, 0x42);
+}
+
+/*
+ * Short pattern payloads must only be compressed if the transform,
+ * including the Pattern_V1 payload, is smaller than the original.
+ */
+static void test_pattern_v1_short(void **state)
+{
+	TALLOC_CTX *frame = talloc_stackframe();
+	struct smb3_compression_capabilities c = {
+		.num_algos = 1,
+		.algos = { SMB2_COMPRESSION_PATTERN_V1, },
+		.chained = true,
+	};
+	uint8_t hdr[SMB2_HDR_BODY];
+	struct iovec prefix = {
+		.iov_base = hdr, .iov_len = sizeof(hdr),
+	};
+	uint8_t data[64];
+	size_t len;
+
+	memset(hdr, 0xfe, sizeof(hdr));
+	memset(data, 0x42, sizeof(data));
+
+	for (len = 1; len <= sizeof(data); len++) {
+		DATA_BLOB payload = data_blob_const(data, len);
+		DATA_BLOB compressed = data_blob_null;
+		size_t original_size = 0;
+		uint8_t *out = NULL;
+		NTSTATUS status;
+
+		status = smb2_compression_compress_pdu(
+			frame, &c, &prefix, 1, &payload, &compressed);
+		assert_true(NT_STATUS_IS_OK(status));
+		if (compressed.length == 0) {
+			continue;
+		}
+		assert_true(compressed.length < sizeof(hdr) + len);
+		assert_true(compressed.length <=
+			    talloc_get_size(compressed.data));
+
+		status = smb2_compression_original_size(compressed.data,
+							compressed.length,
+							&original_size);
+		assert_true(NT_STATUS_IS_OK(status));
+		assert_int_equal(original_size, sizeof(hdr) + len);
+
+		out = talloc_array(frame, uint8_t, original_size);
+		assert_non_null(out);
+
+		status = smb2_compression_decompress_pdu(&c,
+							 compressed.data,
+							 compressed.length,
+							 out,
+							 original_size);
+		assert_true(NT_STATUS_IS_OK(status));
+		assert_memory_equal(out, hdr, sizeof(hdr));
+		assert_memory_equal(out + sizeof(hdr), data, len);
+	}
+
+	TALLOC_FREE(frame);
+}
+
+static void test_incompressible(void **state)
+{
+	TALLOC_CTX *frame = talloc_stackframe();
+	struct smb3_compression_capabilities c = {
+		.num_algos = 1,
+		.algos = { SMB2_COMPRESSION_LZ77_HUFFMAN, },
+		.chained = true,
+	};
+	uint8_t hdr[SMB2_HDR_BODY] = { 0, };
+	struct iovec prefix = {
+		.iov_base = hdr, .iov_len = sizeof(hdr),
+	};
+	DATA_BLOB payload;
+	DATA_BLOB compressed = data_blob_null;
+	NTSTATUS status;
+
+	payload = data_blob_talloc(frame, NULL, 4096);
+	assert_non_null(payload.data);
+	generate_random_buffer(payload.data, payload.length);
+
+	status = smb2_compression_compress_pdu(
+		frame, &c, &prefix, 1, &payload, &compressed);
+	assert_true(NT_STATUS_IS_OK(status));
+	assert_int_equal(compressed.length, 0);
+
+	TALLOC_FREE(frame);
+}
+
+static void test_not_negotiated(void **state)
+{
+	TALLOC_CTX *frame = talloc_stackframe();
+	struct smb3_compression_capabilities c = {
+		.num_algos = 1,
+		.algos = { SMB2_COMPRESSION_LZ77, },
+		.chained = false,
+	};
+	struct smb3_compression_capabilities other = {
+		.num_algos = 1,
+		.algos = { SMB2_COMPRESSION_LZ77_HUFFMAN, },
+		.chained = false,
+	};
+	uint8_t hdr[SMB2_HDR_BODY] = { 0, };
+	struct iovec prefix = {
+		.iov_base = hdr, .iov_len = sizeof(hdr),
+	};
+	DATA_BLOB payload;
+	DATA_BLOB compressed = data_blob_null;
+	size_t original_size = 0;
+	uint8_t *out = NULL;
+	NTSTATUS status;
+
+	payload = data_blob_talloc_zero(frame, 8192);
+	assert_non_null(payload.data);
+
+	status = smb2_compression_compress_pdu(
+		frame, &c, &prefix, 1, &payload, &compressed);
+	assert_true(NT_STATUS_IS_OK(status));
+	assert_true(compressed.length > 0);
+
+	status = smb2_compression_original_size(compressed.data,
+						compressed.length,
+						&original_size);
+	assert_true(NT_STATUS_IS_OK(status));
+
+	out = talloc_array(frame, uint8_t, original_size);
+	assert_non_null(out);
+
+	status = smb2_compression_decompress_pdu(&other,
+						 compressed.data,
+						 compressed.length,
+						 out,
+						 original_size);
+	assert_true(NT_STATUS_EQUAL(status, NT_STATUS_BAD_COMPRESSION_BUFFER));
+
+	TALLOC_FREE(frame);
+}
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_lz77_unchained),
+		cmocka_unit_test(test_lz77_chained),
+		cmocka_unit_test(test_lz77_huffman_unchained),
+		cmocka_unit_test(test_lz77_huffman_chained),
+		cmocka_unit_test(test_pattern_v1),
+		cmocka_unit_test(test_pattern_v1_short),
+		cmocka_unit_test(test_incompressible),
+		cmocka_unit_test(test_not_negotiated),
+	};
+
+	if (argc == 2) {
+		cmocka_set_test_filter(argv[1]);
+	}
+	cmocka_set_message_output(CM_OUTPUT_SUBUNIT);
+
+	rc = cmocka_run_group_tests(tests, NULL, NULL);
+
+	return rc;
+}
@@ -1963,6 +1963,7 @@ sub setup_fileserver
 
         smb3 unix extensions = yes
 	kernel change notify = yes
+	smbd parallel compound requests = yes
 	spotlight backend = elasticsearch
 	elasticsearch:address = $ip4
 	elasticsearch:port = 8080
@@ -524,6 +524,8 @@ plantestsuite("samba.unittests.smb1cli_session", "none",
               [os.path.join(bindir(), "default/libcli/smb/test_smb1cli_session")])
 plantestsuite("samba.unittests.smb_util_translate", "none",
               [os.path.join(bindir(), "default/libcli/smb/test_util_translate")])
+plantestsuite("samba.unittests.smb2_compression", "none",
+              [os.path.join(bindir(), "default/libcli/smb/test_smb2_compression")])
 
 plantestsuite(
     "samba.unittests.memset_explicit",
@@ -598,6 +600,9 @@ if ("HAVE_TCP_USER_TIMEOUT" in config_hash):
                   environ={'SOCKET_WRAPPER_DIR': ''})
 plantestsuite("samba.unittests.adouble", "none",
               [os.path.join(bindir(), "test_adouble")])
+if ("WITH_PROFILE" in config_hash):
+    plantestsuite("samba.unittests.smbprofile_hist", "none",
+                  [os.path.join(bindir(), "test_smbprofile_hist")])
 plantestsuite("samba.unittests.gnutls_aead_aes_256_cbc_hmac_sha512", "none",
               [os.path.join(bindir(), "test_gnutls_aead_aes_256_cbc_hmac_sha512")])
 plantestsuite("samba.unittests.gnutls_sp800_108", "none",
@@ -191,4 +191,18 @@ struct tevent_req *ctdbd_parse_send(TALLOC_CTX *mem_ctx,
 				    enum dbwrap_req_state *req_state);
 int ctdbd_parse_recv(struct tevent_req *req);
 
+struct tevent_req *ctdbd_parse_many_send(TALLOC_CTX *mem_ctx,
+					 struct tevent_context *ev,
+					 struct ctdbd_connection *conn,
+					 uint32_t db_id,
+					 const TDB_DATA *keys,
+					 const bool *local_copy,
+					 size_t num_keys,
+					 void (*parser)(size_t idx,
+							TDB_DATA key,
+							TDB_DATA data,
+							void *private_data),
+					 void *private_data);
+int ctdbd_parse_many_recv(struct tevent_req *req);
+
 #endif /* _CTDBD_CONN_H */
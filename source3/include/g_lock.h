@@ -95,6 +95,10 @@ NTSTATUS g_lock_write_data(struct g_lock_ctx *ctx, TDB_DATA key,
 int g_lock_locks_read(struct g_lock_ctx *ctx,
 		      int (*fn)(TDB_DATA key, void *private_data),
 		      void *private_data);
+int g_lock_locks_read_parallel(struct g_lock_ctx *ctx,
+			       unsigned num_threads,
+			       int (*fn)(TDB_DATA key, void *private_data),
+			       void *private_data);
 int g_lock_locks(struct g_lock_ctx *ctx,
 		 int (*fn)(TDB_DATA key, void *private_data),
 		 void *private_data);
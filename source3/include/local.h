@@ -146,7 +146,8 @@
 
 /* tdb flags for the databases having one entry per open file. */
 #define SMBD_VOLATILE_TDB_FLAGS \
-	(TDB_DEFAULT|TDB_VOLATILE|TDB_CLEAR_IF_FIRST|TDB_INCOMPATIBLE_HASH)
+	(TDB_DEFAULT|TDB_VOLATILE|TDB_CLEAR_IF_FIRST|TDB_INCOMPATIBLE_HASH|\
+	 TDB_RESIZABLE|TDB_SIZE_CLASSES)
 
 /* Characters we disallow in sharenames. */
 #define INVALID_SHARENAME_CHARS "%<>*?|/\\+=;:\","
@@ -30,6 +30,10 @@
 struct smbd_server_connection;
 struct tevent_context;
 
+#if ! defined __has_builtin
+#define __has_builtin(x) 0
+#endif
+
 #ifdef WITH_PROFILE
 
 #define SMBPROFILE_STATS_ALL_SECTIONS \
@@ -81,6 +85,7 @@ struct tevent_context;
 	SMBPROFILE_STATS_BASIC(syscall_fstat) \
 	SMBPROFILE_STATS_BASIC(syscall_lstat) \
 	SMBPROFILE_STATS_BASIC(syscall_fstatat) \
+	SMBPROFILE_STATS_BYTES(syscall_asys_fstatat) \
 	SMBPROFILE_STATS_BASIC(syscall_get_alloc_size) \
 	SMBPROFILE_STATS_BASIC(syscall_unlinkat) \
 	SMBPROFILE_STATS_BASIC(syscall_chmod) \
@@ -288,6 +293,7 @@ struct tevent_context;
 	SMBPROFILE_STATS_BASIC(syscall_fstat) \
 	SMBPROFILE_STATS_BASIC(syscall_lstat) \
 	SMBPROFILE_STATS_BASIC(syscall_fstatat) \
+	SMBPROFILE_STATS_BYTES(syscall_asys_fstatat) \
 	SMBPROFILE_STATS_BASIC(syscall_get_alloc_size) \
 	SMBPROFILE_STATS_BASIC(syscall_unlinkat) \
 	SMBPROFILE_STATS_BASIC(syscall_chmod) \
@@ -381,11 +387,32 @@ struct smbprofile_stats_basic_async {
 	struct smbprofile_stats_basic *stats;
 };
 
+/*
+ * Log-linear latency histogram: values below SMBPROFILE_HIST_SUB
+ * microseconds get a bucket each, above that every power of two is
+ * split into SMBPROFILE_HIST_SUB linear sub-buckets, which keeps the
+ * relative error below 25%. Everything at or above
+ * 2^(SMBPROFILE_HIST_MAX_EXP+1) microseconds (~33 seconds) lands in
+ * the last bucket. The buckets are not cumulative.
+ */
+#define SMBPROFILE_HIST_SUB_BITS 2
+#define SMBPROFILE_HIST_SUB (1 << SMBPROFILE_HIST_SUB_BITS)
+#define SMBPROFILE_HIST_MAX_EXP 24
+#define SMBPROFILE_HIST_BUCKETS \
+	(SMBPROFILE_HIST_SUB + \
+	 SMBPROFILE_HIST_SUB * \
+	 (SMBPROFILE_HIST_MAX_EXP - SMBPROFILE_HIST_SUB_BITS + 1) + 1)
+
+struct smbprofile_stats_hist {
+	uint64_t buckets[SMBPROFILE_HIST_BUCKETS];
+};
+
 struct smbprofile_stats_bytes {
 	uint64_t count;		/* number of events */
 	uint64_t time;		/* microseconds */
 	uint64_t idle;		/* idle time compared to 'time' microseconds */
 	uint64_t bytes;		/* bytes */
+	struct smbprofile_stats_hist hist; /* latency in microseconds */
 };
 
 struct smbprofile_stats_bytes_async {
@@ -403,6 +430,7 @@ struct smbprofile_stats_iobytes {
 	uint64_t idle;		/* idle time compared to 'time' microseconds */
 	uint64_t inbytes;	/* bytes read */
 	uint64_t outbytes;	/* bytes written */
+	struct smbprofile_stats_hist hist; /* latency in microseconds */
 };
 
 struct smbprofile_stats_iobytes_async {
@@ -516,9 +544,11 @@ struct profile_stats {
 } while(0)
 #define _SMBPROFILE_TIMER_ASYNC_END(_async) do { \
 	if ((_async).start != 0) { \
+		uint64_t _elapsed = profile_timestamp() - (_async).start; \
 		_SMBPROFILE_TIMER_ASYNC_SET_BUSY(_async); \
-		(_async).stats->time += profile_timestamp() - (_async).start; \
+		(_async).stats->time += _elapsed; \
 		(_async).stats->idle += (_async).idle_time; \
+		smbprofile_hist_update(&(_async).stats->hist, _elapsed); \
 	} \
 } while(0)
 
@@ -721,6 +751,68 @@ static inline void smbprofile_update_hist(struct smbprofile_stats_iobytes *s,
 	s->buckets[0]++;
 }
 
+static inline size_t smbprofile_hist_index(uint64_t microsecs)
+{
+	unsigned exp;
+	uint64_t sub;
+	size_t idx;
+
+	if (microsecs < SMBPROFILE_HIST_SUB) {
+		return microsecs;
+	}
+
+#if __has_builtin(__builtin_clzll)
+	exp = 63 - __builtin_clzll(microsecs);
+#else
+	{
+		uint64_t v = microsecs;
+
+		exp = 0;
+		while (v >>= 1) {
+			exp++;
+		}
+	}
+#endif
+	if (exp > SMBPROFILE_HIST_MAX_EXP) {
+		return SMBPROFILE_HIST_BUCKETS - 1;
+	}
+
+	sub = (microsecs >> (exp - SMBPROFILE_HIST_SUB_BITS)) &
+	      (SMBPROFILE_HIST_SUB - 1);
+	idx = SMBPROFILE_HIST_SUB +
+	      (exp - SMBPROFILE_HIST_SUB_BITS) * SMBPROFILE_HIST_SUB + sub;
+	return idx;
+}
+
+/*
+ * Exclusive upper bound in microseconds of histogram bucket idx,
+ * UINT64_MAX for the overflow bucket.
+ */
+static inline uint64_t smbprofile_hist_limit(size_t idx)
+{
+	size_t exp;
+	uint64_t sub;
+
+	if (idx < SMBPROFILE_HIST_SUB) {
+		return idx + 1;
+	}
+	if (idx >= SMBPROFILE_HIST_BUCKETS - 1) {
+		return UINT64_MAX;
+	}
+
+	idx -= SMBPROFILE_HIST_SUB;
+	exp = idx / SMBPROFILE_HIST_SUB;
+	sub = idx % SMBPROFILE_HIST_SUB;
+
+	return (SMBPROFILE_HIST_SUB + sub + 1) << exp;
+}
+
+static inline void smbprofile_hist_update(struct smbprofile_stats_hist *h,
+					  uint64_t microsecs)
+{
+	h->buckets[smbprofile_hist_index(microsecs)] += 1;
+}
+
 static inline bool smbprofile_dump_pending(void)
 {
 	if (smbprofile_state.internal.te == NULL) {
@@ -404,6 +404,7 @@
  * Version 53 - Change GET_QUOTA to take a fsp instead of a name
  * Version 53 - Add fsp to SET_QUOTA
  * Version 53 - Remove GETWD
+ * Version 53 - Add SMB_VFS_FSTATAT_SEND/RECV
  */
 
 #define SMB_VFS_INTERFACE_VERSION 53
@@ -1111,6 +1112,16 @@ struct vfs_fn_pointers {
 		const struct smb_filename *smb_fname,
 		SMB_STRUCT_STAT *sbuf,
 		int flags);
+	struct tevent_req *(*fstatat_send_fn)(
+				TALLOC_CTX *mem_ctx,
+				struct tevent_context *ev,
+				struct vfs_handle_struct *handle,
+				files_struct *dirfsp,
+				const struct smb_filename *smb_fname,
+				int flags);
+	int (*fstatat_recv_fn)(struct tevent_req *req,
+			       struct vfs_aio_state *aio_state,
+			       SMB_STRUCT_STAT *sbuf);
 	uint64_t (*get_alloc_size_fn)(struct vfs_handle_struct *handle, struct files_struct *fsp, const SMB_STRUCT_STAT *sbuf);
 	int (*unlinkat_fn)(struct vfs_handle_struct *handle,
 			struct files_struct *srcdir_fsp,
@@ -1591,6 +1602,16 @@ int smb_vfs_call_fstatat(
 	const struct smb_filename *smb_fname,
 	SMB_STRUCT_STAT *sbuf,
 	int flags);
+struct tevent_req *smb_vfs_call_fstatat_send(
+			TALLOC_CTX *mem_ctx,
+			struct tevent_context *ev,
+			struct vfs_handle_struct *handle,
+			files_struct *dirfsp,
+			const struct smb_filename *smb_fname,
+			int flags);
+int smb_vfs_call_fstatat_recv(struct tevent_req *req,
+			      struct vfs_aio_state *aio_state,
+			      SMB_STRUCT_STAT *sbuf);
 uint64_t smb_vfs_call_get_alloc_size(struct vfs_handle_struct *handle,
 				     struct files_struct *fsp,
 				     const SMB_STRUCT_STAT *sbuf);
@@ -2022,6 +2043,16 @@ int vfs_not_implemented_fstatat(
 	const struct smb_filename *smb_fname,
 	SMB_STRUCT_STAT *sbuf,
 	int flags);
+struct tevent_req *vfs_not_implemented_fstatat_send(
+			TALLOC_CTX *mem_ctx,
+			struct tevent_context *ev,
+			struct vfs_handle_struct *handle,
+			files_struct *dirfsp,
+			const struct smb_filename *smb_fname,
+			int flags);
+int vfs_not_implemented_fstatat_recv(struct tevent_req *req,
+				     struct vfs_aio_state *aio_state,
+				     SMB_STRUCT_STAT *sbuf);
 uint64_t vfs_not_implemented_get_alloc_size(struct vfs_handle_struct *handle,
 					    struct files_struct *fsp,
 					    const SMB_STRUCT_STAT *sbuf);
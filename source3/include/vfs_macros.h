@@ -260,6 +260,20 @@
 	smb_vfs_call_fstatat((handle)->next, (dirfsp), (smb_fname), \
 			     (sbuf), (flags))
 
+#define SMB_VFS_FSTATAT_SEND(mem_ctx, ev, dirfsp, smb_fname, flags) \
+	smb_vfs_call_fstatat_send((mem_ctx), (ev), \
+				  (dirfsp)->conn->vfs_handles, \
+				  (dirfsp), (smb_fname), (flags))
+#define SMB_VFS_FSTATAT_RECV(req, aio_state, sbuf) \
+	smb_vfs_call_fstatat_recv((req), (aio_state), (sbuf))
+
+#define SMB_VFS_NEXT_FSTATAT_SEND(mem_ctx, ev, handle, dirfsp, smb_fname, \
+				  flags) \
+	smb_vfs_call_fstatat_send((mem_ctx), (ev), (handle)->next, \
+				  (dirfsp), (smb_fname), (flags))
+#define SMB_VFS_NEXT_FSTATAT_RECV(req, aio_state, sbuf) \
+	smb_vfs_call_fstatat_recv((req), (aio_state), (sbuf))
+
 #define SMB_VFS_GET_ALLOC_SIZE(conn, fsp, sbuf) \
 	smb_vfs_call_get_alloc_size((conn)->vfs_handles, (fsp), (sbuf))
 #define SMB_VFS_NEXT_GET_ALLOC_SIZE(conn, fsp, sbuf) \
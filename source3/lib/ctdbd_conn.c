@@ -2209,6 +2209,29 @@ struct ctdbd_parse_state {
 
 static void ctdbd_parse_done(struct tevent_req *subreq);
 
+static int ctdbd_parse_reply(struct ctdb_req_header *hdr, TDB_DATA *data)
+{
+	struct ctdb_reply_call_old *reply = NULL;
+
+	if (hdr->operation != CTDB_REPLY_CALL) {
+		DBG_ERR("received invalid reply\n");
+		ctdb_packet_dump(hdr);
+		return EIO;
+	}
+
+	reply = (struct ctdb_reply_call_old *)hdr;
+
+	if (reply->datalen == 0) {
+		/*
+		 * Treat an empty record as non-existing
+		 */
+		return ENOENT;
+	}
+
+	*data = make_tdb_data(&reply->data[0], reply->datalen);
+	return 0;
+}
+
 struct tevent_req *ctdbd_parse_send(TALLOC_CTX *mem_ctx,
 				    struct tevent_context *ev,
 				    struct ctdbd_connection *conn,
@@ -2298,7 +2321,7 @@ static void ctdbd_parse_done(struct tevent_req *subreq)
 	struct ctdbd_parse_state *state = tevent_req_data(
 		req, struct ctdbd_parse_state);
 	struct ctdb_req_header *hdr = NULL;
-	struct ctdb_reply_call_old *reply = NULL;
+	TDB_DATA data;
 	int ret;
 
 	ret = ctdbd_req_recv(subreq, state, &hdr);
@@ -2309,32 +2332,242 @@ static void ctdbd_parse_done(struct tevent_req *subreq)
 	}
 	SMB_ASSERT(hdr != NULL);
 
-	if (hdr->operation != CTDB_REPLY_CALL) {
-		DBG_ERR("received invalid reply\n");
-		ctdb_packet_dump(hdr);
-		tevent_req_error(req, EIO);
+	ret = ctdbd_parse_reply(hdr, &data);
+	if (tevent_req_error(req, ret)) {
 		return;
 	}
 
-	reply = (struct ctdb_reply_call_old *)hdr;
+	state->parser(state->key, data, state->private_data);
 
-	if (reply->datalen == 0) {
-		/*
-		 * Treat an empty record as non-existing
-		 */
-		tevent_req_error(req, ENOENT);
+	tevent_req_done(req);
+	return;
+}
+
+int ctdbd_parse_recv(struct tevent_req *req)
+{
+	return tevent_req_simple_recv_unix(req);
+}
+
+/*
+ * Wait for the reply to a request that someone else wrote to ctdbd
+ */
+static struct tevent_req *ctdbd_reply_wait_send(
+	TALLOC_CTX *mem_ctx,
+	struct tevent_context *ev,
+	struct ctdbd_connection *conn,
+	uint32_t reqid)
+{
+	struct tevent_req *req = NULL;
+	struct ctdbd_req_state *state = NULL;
+	bool ok;
+
+	req = tevent_req_create(mem_ctx, &state, struct ctdbd_req_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	state->conn = conn;
+	state->ev = ev;
+	state->reqid = reqid;
+
+	ok = ctdbd_req_set_pending(req);
+	if (!ok) {
+		TALLOC_FREE(req);
+		return NULL;
+	}
+	return req;
+}
+
+struct ctdbd_parse_many_key {
+	struct tevent_req *req;
+	size_t idx;
+	TDB_DATA key;
+};
+
+struct ctdbd_parse_many_state {
+	struct ctdbd_parse_many_key *keys;
+	size_t num_pending;
+	uint8_t *buf;
+	struct iovec iov;
+	void (*parser)(size_t idx,
+		       TDB_DATA key,
+		       TDB_DATA data,
+		       void *private_data);
+	void *private_data;
+};
+
+static void ctdbd_parse_many_written(struct tevent_req *subreq);
+static void ctdbd_parse_many_done(struct tevent_req *subreq);
+
+/*
+ * Fetch a batch of records with CTDB_REQ_CALL. All packets go out
+ * with a single write, the replies are matched by reqid as they come
+ * in. As with ctdbd_parse_send(), a non-existing record is not an
+ * error, the parser is just not called for it.
+ */
+struct tevent_req *ctdbd_parse_many_send(TALLOC_CTX *mem_ctx,
+					 struct tevent_context *ev,
+					 struct ctdbd_connection *conn,
+					 uint32_t db_id,
+					 const TDB_DATA *keys,
+					 const bool *local_copy,
+					 size_t num_keys,
+					 void (*parser)(size_t idx,
+							TDB_DATA key,
+							TDB_DATA data,
+							void *private_data),
+					 void *private_data)
+{
+	struct tevent_req *req = NULL;
+	struct tevent_req *subreq = NULL;
+	struct ctdbd_parse_many_state *state = NULL;
+	const size_t hdrlen = offsetof(struct ctdb_req_call_old, data);
+	size_t i, buflen;
+	uint8_t *p = NULL;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct ctdbd_parse_many_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	*state = (struct ctdbd_parse_many_state) {
+		.parser = parser,
+		.private_data = private_data,
+	};
+
+	if (num_keys == 0) {
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
+
+	buflen = 0;
+	for (i=0; i<num_keys; i++) {
+		size_t tmp = buflen + hdrlen + keys[i].dsize;
+		if (tmp < buflen) {
+			tevent_req_error(req, EINVAL);
+			return tevent_req_post(req, ev);
+		}
+		buflen = tmp;
+	}
+
+	state->keys = talloc_array(
+		state, struct ctdbd_parse_many_key, num_keys);
+	if (tevent_req_nomem(state->keys, req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	/*
+	 * The packets are assembled in one buffer owned by us, see the
+	 * comment in ctdbd_parse_send() on the lifetime of the iovecs.
+	 */
+	state->buf = talloc_size(state, buflen);
+	if (tevent_req_nomem(state->buf, req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	p = state->buf;
+
+	for (i=0; i<num_keys; i++) {
+		struct ctdbd_parse_many_key *k = &state->keys[i];
+		struct ctdb_req_call_old ctdb_req = {
+			.hdr.length = hdrlen + keys[i].dsize,
+			.hdr.ctdb_magic = CTDB_MAGIC,
+			.hdr.ctdb_version = CTDB_PROTOCOL,
+			.hdr.operation = CTDB_REQ_CALL,
+			.hdr.reqid = ctdbd_next_reqid(conn),
+			.flags = local_copy[i] ? CTDB_WANT_READONLY : 0,
+			.callid = CTDB_FETCH_FUNC,
+			.db_id = db_id,
+			.keylen = keys[i].dsize,
+		};
+
+		memcpy(p, &ctdb_req, hdrlen);
+		p += hdrlen;
+		if (keys[i].dsize != 0) {
+			memcpy(p, keys[i].dptr, keys[i].dsize);
+		}
+
+		*k = (struct ctdbd_parse_many_key) {
+			.req = req,
+			.idx = i,
+			.key = make_tdb_data(p, keys[i].dsize),
+		};
+		p += keys[i].dsize;
+
+		subreq = ctdbd_reply_wait_send(
+			state->keys, ev, conn, ctdb_req.hdr.reqid);
+		if (tevent_req_nomem(subreq, req)) {
+			return tevent_req_post(req, ev);
+		}
+		tevent_req_set_callback(subreq, ctdbd_parse_many_done, k);
+		state->num_pending += 1;
+	}
+
+	state->iov = (struct iovec) {
+		.iov_base = state->buf, .iov_len = buflen,
+	};
+
+	subreq = writev_send(
+		state, ev, conn->outgoing, conn->fd, false, &state->iov, 1);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, ctdbd_parse_many_written, req);
+
+	return req;
+}
+
+static void ctdbd_parse_many_written(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	ssize_t nwritten;
+	int err;
+
+	nwritten = writev_recv(subreq, &err);
+	TALLOC_FREE(subreq);
+	if (nwritten == -1) {
+		tevent_req_error(req, err);
+		return;
+	}
+}
+
+static void ctdbd_parse_many_done(struct tevent_req *subreq)
+{
+	struct ctdbd_parse_many_key *k = tevent_req_callback_data(
+		subreq, struct ctdbd_parse_many_key);
+	struct tevent_req *req = k->req;
+	struct ctdbd_parse_many_state *state = tevent_req_data(
+		req, struct ctdbd_parse_many_state);
+	struct ctdb_req_header *hdr = NULL;
+	TDB_DATA data;
+	int ret;
+
+	ret = ctdbd_req_recv(subreq, state, &hdr);
+	TALLOC_FREE(subreq);
+	if (tevent_req_error(req, ret)) {
+		DBG_DEBUG("ctdb_req_recv failed %s\n", strerror(ret));
 		return;
 	}
+	SMB_ASSERT(hdr != NULL);
 
-	state->parser(state->key,
-		      make_tdb_data(&reply->data[0], reply->datalen),
-		      state->private_data);
+	ret = ctdbd_parse_reply(hdr, &data);
+	if (ret == 0) {
+		state->parser(k->idx, k->key, data, state->private_data);
+	}
+	TALLOC_FREE(hdr);
 
-	tevent_req_done(req);
-	return;
+	if ((ret != 0) && (ret != ENOENT)) {
+		tevent_req_error(req, ret);
+		return;
+	}
+
+	state->num_pending -= 1;
+	if (state->num_pending == 0) {
+		tevent_req_done(req);
+	}
 }
 
-int ctdbd_parse_recv(struct tevent_req *req)
+int ctdbd_parse_many_recv(struct tevent_req *req)
 {
 	return tevent_req_simple_recv_unix(req);
 }
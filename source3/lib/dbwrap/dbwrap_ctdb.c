@@ -1504,6 +1504,151 @@ static NTSTATUS db_ctdb_parse_record_recv(struct tevent_req *req)
 	return tevent_req_simple_recv_ntstatus(req);
 }
 
+struct db_ctdb_parse_records_state {
+	void (*parser)(size_t idx,
+		       TDB_DATA key,
+		       TDB_DATA data,
+		       void *private_data);
+	void *private_data;
+	size_t idx;
+	size_t *remote_idx;
+};
+
+static void db_ctdb_parse_records_local_parser(
+	TDB_DATA key, TDB_DATA data, void *private_data)
+{
+	struct db_ctdb_parse_records_state *state = private_data;
+	state->parser(state->idx, key, data, state->private_data);
+}
+
+static void db_ctdb_parse_records_remote_parser(
+	size_t idx, TDB_DATA key, TDB_DATA data, void *private_data)
+{
+	struct db_ctdb_parse_records_state *state = private_data;
+	state->parser(
+		state->remote_idx[idx], key, data, state->private_data);
+}
+
+static void db_ctdb_parse_records_done(struct tevent_req *subreq);
+
+static struct tevent_req *db_ctdb_parse_records_send(
+	TALLOC_CTX *mem_ctx,
+	struct tevent_context *ev,
+	struct db_context *db,
+	const TDB_DATA *keys,
+	size_t num_keys,
+	void (*parser)(size_t idx,
+		       TDB_DATA key,
+		       TDB_DATA data,
+		       void *private_data),
+	void *private_data)
+{
+	struct db_ctdb_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_ctdb_ctx);
+	struct tevent_req *req = NULL;
+	struct tevent_req *subreq = NULL;
+	struct db_ctdb_parse_records_state *state = NULL;
+	struct db_ctdb_parse_record_state local = {
+		.my_vnn = get_my_vnn(),
+	};
+	TDB_DATA *remote_keys = NULL;
+	bool *local_copy = NULL;
+	size_t i, num_remote;
+	NTSTATUS status;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct db_ctdb_parse_records_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	*state = (struct db_ctdb_parse_records_state) {
+		.parser = parser,
+		.private_data = private_data,
+	};
+
+	state->remote_idx = talloc_array(state, size_t, num_keys);
+	remote_keys = talloc_array(state, TDB_DATA, num_keys);
+	local_copy = talloc_array(state, bool, num_keys);
+	if ((num_keys != 0) &&
+	    ((state->remote_idx == NULL) ||
+	     (remote_keys == NULL) ||
+	     (local_copy == NULL))) {
+		tevent_req_oom(req);
+		return tevent_req_post(req, ev);
+	}
+
+	local.parser = db_ctdb_parse_records_local_parser;
+	local.private_data = state;
+
+	/*
+	 * Serve what we can from our local copy, collect the rest to
+	 * go to ctdbd in one burst.
+	 */
+	num_remote = 0;
+
+	for (i=0; i<num_keys; i++) {
+		state->idx = i;
+		local.empty_record = false;
+
+		status = db_ctdb_try_parse_local_record(ctx, keys[i], &local);
+		if (NT_STATUS_EQUAL(status,
+				    NT_STATUS_MORE_PROCESSING_REQUIRED)) {
+			state->remote_idx[num_remote] = i;
+			remote_keys[num_remote] = keys[i];
+			local_copy[num_remote] = local.ask_for_readonly_copy;
+			num_remote += 1;
+			continue;
+		}
+		if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+			continue;
+		}
+		if (tevent_req_nterror(req, status)) {
+			return tevent_req_post(req, ev);
+		}
+	}
+
+	if (num_remote == 0) {
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
+
+	subreq = ctdbd_parse_many_send(state,
+				       ev,
+				       ctdb_async_ctx.async_conn,
+				       ctx->db_id,
+				       remote_keys,
+				       local_copy,
+				       num_remote,
+				       db_ctdb_parse_records_remote_parser,
+				       state);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, db_ctdb_parse_records_done, req);
+
+	return req;
+}
+
+static void db_ctdb_parse_records_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	int ret;
+
+	ret = ctdbd_parse_many_recv(subreq);
+	TALLOC_FREE(subreq);
+	if (ret != 0) {
+		tevent_req_nterror(req, map_nt_error_from_unix(ret));
+		return;
+	}
+	tevent_req_done(req);
+}
+
+static NTSTATUS db_ctdb_parse_records_recv(struct tevent_req *req)
+{
+	return tevent_req_simple_recv_ntstatus(req);
+}
+
 struct traverse_state {
 	struct db_context *db;
 	int (*fn)(struct db_record *rec, void *private_data);
@@ -1974,6 +2119,8 @@ struct db_context *db_open_ctdb(TALLOC_CTX *mem_ctx,
 	result->parse_record = db_ctdb_parse_record;
 	result->parse_record_send = db_ctdb_parse_record_send;
 	result->parse_record_recv = db_ctdb_parse_record_recv;
+	result->parse_records_send = db_ctdb_parse_records_send;
+	result->parse_records_recv = db_ctdb_parse_records_recv;
 	result->traverse = db_ctdb_traverse;
 	result->traverse_read = db_ctdb_traverse_read;
 	result->get_seqnum = db_ctdb_get_seqnum;
@@ -718,6 +718,31 @@ static int dbwrap_watched_traverse_read(struct db_context *db,
 	return ret;
 }
 
+static int dbwrap_watched_traverse_read_parallel(
+	struct db_context *db,
+	unsigned num_threads,
+	int (*fn)(struct db_record *rec, void *private_data),
+	void *private_data)
+{
+	struct db_watched_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_watched_ctx);
+	struct dbwrap_watched_traverse_state state = {
+		.db = db, .fn = fn, .private_data = private_data };
+	NTSTATUS status;
+	int ret;
+
+	status = dbwrap_traverse_read_parallel(
+		ctx->backend,
+		num_threads,
+		dbwrap_watched_traverse_fn,
+		&state,
+		&ret);
+	if (!NT_STATUS_IS_OK(status)) {
+		return -1;
+	}
+	return ret;
+}
+
 static int dbwrap_watched_get_seqnum(struct db_context *db)
 {
 	struct db_watched_ctx *ctx = talloc_get_type_abort(
@@ -875,6 +900,100 @@ static NTSTATUS dbwrap_watched_parse_record_recv(struct tevent_req *req)
 	return NT_STATUS_OK;
 }
 
+struct dbwrap_watched_parse_records_state {
+	struct db_context *db;
+	void (*parser)(size_t idx,
+		       TDB_DATA key,
+		       TDB_DATA data,
+		       void *private_data);
+	void *private_data;
+};
+
+static void dbwrap_watched_parse_records_parser(
+	size_t idx, TDB_DATA key, TDB_DATA data, void *private_data)
+{
+	struct dbwrap_watched_parse_records_state *state = private_data;
+	TDB_DATA userdata;
+	bool ok;
+
+	ok = dbwrap_watch_rec_parse(data, NULL, NULL, &userdata);
+	if (!ok) {
+		/*
+		 * Like dbwrap_watched_parse_record(), treat this as
+		 * not found
+		 */
+		dbwrap_watch_log_invalid_record(state->db, key, data);
+		return;
+	}
+
+	state->parser(idx, key, userdata, state->private_data);
+}
+
+static void dbwrap_watched_parse_records_done(struct tevent_req *subreq);
+
+static struct tevent_req *dbwrap_watched_parse_records_send(
+	TALLOC_CTX *mem_ctx,
+	struct tevent_context *ev,
+	struct db_context *db,
+	const TDB_DATA *keys,
+	size_t num_keys,
+	void (*parser)(size_t idx,
+		       TDB_DATA key,
+		       TDB_DATA data,
+		       void *private_data),
+	void *private_data)
+{
+	struct db_watched_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_watched_ctx);
+	struct tevent_req *req = NULL;
+	struct tevent_req *subreq = NULL;
+	struct dbwrap_watched_parse_records_state *state = NULL;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct dbwrap_watched_parse_records_state);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	*state = (struct dbwrap_watched_parse_records_state) {
+		.db = db,
+		.parser = parser,
+		.private_data = private_data,
+	};
+
+	subreq = dbwrap_parse_records_send(state,
+					   ev,
+					   ctx->backend,
+					   keys,
+					   num_keys,
+					   dbwrap_watched_parse_records_parser,
+					   state);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, dbwrap_watched_parse_records_done, req);
+	return req;
+}
+
+static void dbwrap_watched_parse_records_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	NTSTATUS status;
+
+	status = dbwrap_parse_records_recv(subreq);
+	TALLOC_FREE(subreq);
+	if (tevent_req_nterror(req, status)) {
+		return;
+	}
+	tevent_req_done(req);
+}
+
+static NTSTATUS dbwrap_watched_parse_records_recv(struct tevent_req *req)
+{
+	return tevent_req_simple_recv_ntstatus(req);
+}
+
 static int dbwrap_watched_exists(struct db_context *db, TDB_DATA key)
 {
 	struct db_watched_ctx *ctx = talloc_get_type_abort(
@@ -920,6 +1039,7 @@ struct db_context *db_open_watched(TALLOC_CTX *mem_ctx,
 	db->do_locked = dbwrap_watched_do_locked;
 	db->traverse = dbwrap_watched_traverse;
 	db->traverse_read = dbwrap_watched_traverse_read;
+	db->traverse_read_parallel = dbwrap_watched_traverse_read_parallel;
 	db->get_seqnum = dbwrap_watched_get_seqnum;
 	db->transaction_start = dbwrap_watched_transaction_start;
 	db->transaction_commit = dbwrap_watched_transaction_commit;
@@ -927,6 +1047,8 @@ struct db_context *db_open_watched(TALLOC_CTX *mem_ctx,
 	db->parse_record = dbwrap_watched_parse_record;
 	db->parse_record_send = dbwrap_watched_parse_record_send;
 	db->parse_record_recv = dbwrap_watched_parse_record_recv;
+	db->parse_records_send = dbwrap_watched_parse_records_send;
+	db->parse_records_recv = dbwrap_watched_parse_records_recv;
 	db->exists = dbwrap_watched_exists;
 	db->id = dbwrap_watched_id;
 	db->name = dbwrap_name(ctx->backend);
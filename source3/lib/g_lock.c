@@ -1581,6 +1581,31 @@ int g_lock_locks_read(struct g_lock_ctx *ctx,
 	return count;
 }
 
+int g_lock_locks_read_parallel(struct g_lock_ctx *ctx,
+			       unsigned num_threads,
+			       int (*fn)(TDB_DATA key, void *private_data),
+			       void *private_data)
+{
+	struct g_lock_locks_state state;
+	NTSTATUS status;
+	int count;
+
+	SMB_ASSERT(!ctx->busy);
+
+	state.fn = fn;
+	state.private_data = private_data;
+
+	status = dbwrap_traverse_read_parallel(ctx->db,
+					       num_threads,
+					       g_lock_locks_fn,
+					       &state,
+					       &count);
+	if (!NT_STATUS_IS_OK(status)) {
+		return -1;
+	}
+	return count;
+}
+
 int g_lock_locks(struct g_lock_ctx *ctx,
 		 int (*fn)(TDB_DATA key, void *private_data),
 		 void *private_data)
@@ -1767,10 +1767,12 @@ static int share_mode_forall_fn(TDB_DATA key, void *private_data)
 	return 0;
 }
 
-int share_mode_forall_read(int (*fn)(struct file_id fid,
-				     const struct share_mode_data *data,
-				     void *private_data),
-			   void *private_data)
+static int share_mode_forall_read_threads(
+	unsigned num_threads,
+	int (*fn)(struct file_id fid,
+		  const struct share_mode_data *data,
+		  void *private_data),
+	void *private_data)
 {
 	struct share_mode_forall_state state = {
 		.ro_fn = fn,
@@ -1782,14 +1784,22 @@ int share_mode_forall_read(int (*fn)(struct file_id fid,
 		return 0;
 	}
 
-	ret = g_lock_locks_read(
-		lock_ctx, share_mode_forall_fn, &state);
+	ret = g_lock_locks_read_parallel(
+		lock_ctx, num_threads, share_mode_forall_fn, &state);
 	if (ret < 0) {
 		DBG_ERR("g_lock_locks failed\n");
 	}
 	return ret;
 }
 
+int share_mode_forall_read(int (*fn)(struct file_id fid,
+				     const struct share_mode_data *data,
+				     void *private_data),
+			   void *private_data)
+{
+	return share_mode_forall_read_threads(1, fn, private_data);
+}
+
 int share_mode_forall(int (*fn)(struct file_id fid,
 				struct share_mode_data *data,
 				void *private_data),
@@ -1937,6 +1947,27 @@ int share_entry_forall_read(int (*fn)(struct file_id fid,
 	return share_mode_forall_read(share_entry_ro_traverse_fn, &state);
 }
 
+/*
+ * Like share_entry_forall_read(), but let up to num_threads threads
+ * walk locking.tdb. fn is still called serially from this thread.
+ */
+int share_entry_forall_read_parallel(
+	unsigned num_threads,
+	int (*fn)(struct file_id fid,
+		  const struct share_mode_data *data,
+		  const struct share_mode_entry *entry,
+		  void *private_data),
+	void *private_data)
+{
+	struct share_entry_forall_state state = {
+		.ro_fn = fn,
+		.private_data = private_data,
+	};
+
+	return share_mode_forall_read_threads(
+		num_threads, share_entry_ro_traverse_fn, &state);
+}
+
 int share_entry_forall(int (*fn)(struct file_id fid,
 				 struct share_mode_data *data,
 				 struct share_mode_entry *entry,
@@ -87,6 +87,13 @@ int share_entry_forall_read(int (*ro_fn)(struct file_id fid,
 					 const struct share_mode_entry *entry,
 					 void *private_data),
 			    void *private_data);
+int share_entry_forall_read_parallel(
+	unsigned num_threads,
+	int (*ro_fn)(struct file_id fid,
+		     const struct share_mode_data *data,
+		     const struct share_mode_entry *entry,
+		     void *private_data),
+	void *private_data);
 int share_entry_forall(int (*fn)(struct file_id fid,
 				 struct share_mode_data *data,
 				 struct share_mode_entry *entry,
@@ -22,7 +22,7 @@
 #include "smbd/globals.h"
 #include "../libcli/security/security.h"
 #include "dbwrap/dbwrap.h"
-#include "dbwrap/dbwrap_rbt.h"
+#include "dbwrap/dbwrap_hash.h"
 #include "dbwrap/dbwrap_open.h"
 #include "../lib/util/util_tdb.h"
 #include "librpc/gen_ndr/ndr_ioctl.h"
@@ -51,7 +51,7 @@ NTSTATUS vfs_offload_token_ctx_init(TALLOC_CTX *mem_ctx,
 		return NT_STATUS_NO_MEMORY;
 	}
 
-	ctx->db_ctx = db_open_rbt(mem_ctx);
+	ctx->db_ctx = db_open_hash(mem_ctx);
 	if (ctx->db_ctx == NULL) {
 		TALLOC_FREE(ctx);
 		return NT_STATUS_INTERNAL_ERROR;
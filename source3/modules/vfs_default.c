@@ -1424,6 +1424,244 @@ static int vfswrap_fstatat(
 	return result;
 }
 
+struct vfswrap_fstatat_state {
+	struct vfs_pthreadpool_job_state job_state;
+
+	int dirfd;
+	int flags;
+	bool fake_dir_create_times;
+	int ret;
+	SMB_STRUCT_STAT sbuf;
+};
+
+static int vfswrap_fstatat_state_destructor(
+		struct vfswrap_fstatat_state *state)
+{
+	return -1;
+}
+
+static void vfswrap_fstatat_do_sync(struct tevent_req *req);
+static void vfswrap_fstatat_do_async(void *private_data);
+static void vfswrap_fstatat_done(struct tevent_req *subreq);
+
+static struct tevent_req *vfswrap_fstatat_send(
+			TALLOC_CTX *mem_ctx,
+			struct tevent_context *ev,
+			struct vfs_handle_struct *handle,
+			files_struct *dirfsp,
+			const struct smb_filename *smb_fname,
+			int flags)
+{
+	struct tevent_req *req = NULL;
+	struct tevent_req *subreq = NULL;
+	struct vfswrap_fstatat_state *state = NULL;
+	bool do_async = false;
+
+	SMB_ASSERT(!is_named_stream(smb_fname));
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct vfswrap_fstatat_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	*state = (struct vfswrap_fstatat_state) {
+		.job_state.ev = ev,
+		.job_state.handle = handle,
+		.job_state.dir_fsp = dirfsp,
+		.job_state.smb_fname = smb_fname,
+		.dirfd = fsp_get_pathref_fd(dirfsp),
+		.flags = flags,
+		.fake_dir_create_times = lp_fake_directory_create_times(
+			SNUM(handle->conn)),
+	};
+
+	do_async = vfswrap_check_async_with_thread_creds(
+		dirfsp->conn->sconn->pool);
+
+	SMBPROFILE_BYTES_ASYNC_START_X(SNUM(handle->conn),
+				       syscall_asys_fstatat,
+				       state->job_state.profile_bytes,
+				       state->job_state.profile_bytes_x,
+				       0);
+
+	if (state->dirfd == -1) {
+		DBG_ERR("Need a valid directory fd\n");
+		tevent_req_error(req, EINVAL);
+		return tevent_req_post(req, ev);
+	}
+
+	if (!do_async) {
+		vfswrap_fstatat_do_sync(req);
+		return tevent_req_post(req, ev);
+	}
+
+	/*
+	 * Now allocate all parameters from a memory context that won't go away
+	 * no matter what. These parameters will get used in threads and we
+	 * can't reliably cancel threads, so all buffers passed to the threads
+	 * must not be freed before all referencing threads terminate.
+	 */
+
+	state->job_state.name = talloc_strdup(state, smb_fname->base_name);
+	if (tevent_req_nomem(state->job_state.name, req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	if (geteuid() == sec_initial_uid()) {
+		state->job_state.token = root_unix_token(state);
+	} else {
+		state->job_state.token = copy_unix_token(
+					state,
+					dirfsp->conn->session_info->unix_token);
+	}
+
+	if (tevent_req_nomem(state->job_state.token, req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	SMBPROFILE_BYTES_ASYNC_SET_IDLE_X(state->job_state.profile_bytes,
+					  state->job_state.profile_bytes_x);
+
+	subreq = pthreadpool_tevent_job_send(
+			state,
+			ev,
+			dirfsp->conn->sconn->pool,
+			vfswrap_fstatat_do_async,
+			state);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, vfswrap_fstatat_done, req);
+
+	talloc_set_destructor(state, vfswrap_fstatat_state_destructor);
+
+	return req;
+}
+
+static void vfswrap_fstatat_do_sync(struct tevent_req *req)
+{
+	struct vfswrap_fstatat_state *state = tevent_req_data(
+		req, struct vfswrap_fstatat_state);
+
+	state->ret = vfswrap_fstatat(state->job_state.handle,
+				     state->job_state.dir_fsp,
+				     state->job_state.smb_fname,
+				     &state->sbuf,
+				     state->flags);
+	if (state->ret == -1) {
+		tevent_req_error(req, errno);
+		return;
+	}
+
+	tevent_req_done(req);
+}
+
+static void vfswrap_fstatat_do_async(void *private_data)
+{
+	struct vfswrap_fstatat_state *state = talloc_get_type_abort(
+		private_data, struct vfswrap_fstatat_state);
+	struct timespec start_time;
+	struct timespec end_time;
+	int ret;
+
+	PROFILE_TIMESTAMP(&start_time);
+	SMBPROFILE_BYTES_ASYNC_SET_BUSY_X(state->job_state.profile_bytes,
+					  state->job_state.profile_bytes_x);
+
+	/* Become the correct credential on this thread. */
+	ret = set_thread_credentials(state->job_state.token->uid,
+				     state->job_state.token->gid,
+				     (size_t)state->job_state.token->ngroups,
+				     state->job_state.token->groups);
+	if (ret != 0) {
+		state->ret = -1;
+		state->job_state.vfs_aio_state.error = errno;
+		goto end_profile;
+	}
+
+	/*
+	 * No fchdir() needed, fstatat() is
+	 * relative to the directory fd.
+	 */
+	state->ret = sys_fstatat(state->dirfd,
+				 state->job_state.name,
+				 &state->sbuf,
+				 state->flags,
+				 state->fake_dir_create_times);
+	if (state->ret == -1) {
+		state->job_state.vfs_aio_state.error = errno;
+	}
+
+end_profile:
+	PROFILE_TIMESTAMP(&end_time);
+	state->job_state.vfs_aio_state.duration = nsec_time_diff(&end_time, &start_time);
+	SMBPROFILE_BYTES_ASYNC_SET_IDLE_X(state->job_state.profile_bytes,
+					state->job_state.profile_bytes_x);
+}
+
+static void vfswrap_fstatat_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct vfswrap_fstatat_state *state = tevent_req_data(
+		req, struct vfswrap_fstatat_state);
+	int ret;
+	bool ok;
+
+	/*
+	 * Make sure we run as the user again
+	 */
+	ok = change_to_user_and_service_by_fsp(state->job_state.dir_fsp);
+	SMB_ASSERT(ok);
+
+	ret = pthreadpool_tevent_job_recv(subreq);
+	TALLOC_FREE(subreq);
+
+	SMBPROFILE_BYTES_ASYNC_END_X(state->job_state.profile_bytes,
+				state->job_state.profile_bytes_x);
+	talloc_set_destructor(state, NULL);
+	if (ret != 0) {
+		if (ret != EAGAIN) {
+			tevent_req_error(req, ret);
+			return;
+		}
+		/*
+		 * If we get EAGAIN from pthreadpool_tevent_job_recv() this
+		 * means the lower level pthreadpool failed to create a new
+		 * thread. Fallback to sync processing in that case to allow
+		 * some progress for the client.
+		 */
+		vfswrap_fstatat_do_sync(req);
+		return;
+	}
+
+	if (state->ret == -1) {
+		tevent_req_error(req, state->job_state.vfs_aio_state.error);
+		return;
+	}
+
+	tevent_req_done(req);
+}
+
+static int vfswrap_fstatat_recv(struct tevent_req *req,
+				struct vfs_aio_state *aio_state,
+				SMB_STRUCT_STAT *sbuf)
+{
+	struct vfswrap_fstatat_state *state = tevent_req_data(
+		req, struct vfswrap_fstatat_state);
+
+	if (tevent_req_is_unix_error(req, &aio_state->error)) {
+		tevent_req_received(req);
+		return -1;
+	}
+
+	*aio_state = state->job_state.vfs_aio_state;
+	*sbuf = state->sbuf;
+
+	tevent_req_received(req);
+	return 0;
+}
+
 static NTSTATUS vfswrap_translate_name(struct vfs_handle_struct *handle,
 				       const char *name,
 				       enum vfs_translate_direction direction,
@@ -4104,6 +4342,8 @@ static struct vfs_fn_pointers vfs_default_fns = {
 	.fstat_fn = vfswrap_fstat,
 	.lstat_fn = vfswrap_lstat,
 	.fstatat_fn = vfswrap_fstatat,
+	.fstatat_send_fn = vfswrap_fstatat_send,
+	.fstatat_recv_fn = vfswrap_fstatat_recv,
 	.get_alloc_size_fn = vfswrap_get_alloc_size,
 	.unlinkat_fn = vfswrap_unlinkat,
 	.fchmod_fn = vfswrap_fchmod,
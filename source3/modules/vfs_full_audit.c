@@ -140,6 +140,8 @@ typedef enum _vfs_op_type {
 	SMB_VFS_OP_FSTAT,
 	SMB_VFS_OP_LSTAT,
 	SMB_VFS_OP_FSTATAT,
+	SMB_VFS_OP_FSTATAT_SEND,
+	SMB_VFS_OP_FSTATAT_RECV,
 	SMB_VFS_OP_GET_ALLOC_SIZE,
 	SMB_VFS_OP_UNLINKAT,
 	SMB_VFS_OP_FCHMOD,
@@ -274,6 +276,8 @@ static struct {
 	{ SMB_VFS_OP_FSTAT,	"fstat" },
 	{ SMB_VFS_OP_LSTAT,	"lstat" },
 	{ SMB_VFS_OP_FSTATAT,	"fstatat" },
+	{ SMB_VFS_OP_FSTATAT_SEND,	"fstatat_send" },
+	{ SMB_VFS_OP_FSTATAT_RECV,	"fstatat_recv" },
 	{ SMB_VFS_OP_GET_ALLOC_SIZE,	"get_alloc_size" },
 	{ SMB_VFS_OP_UNLINKAT,	"unlinkat" },
 	{ SMB_VFS_OP_FCHMOD,	"fchmod" },
@@ -1738,6 +1742,125 @@ static int smb_full_audit_fstatat(
 
 	return result;
 }
+
+struct smb_full_audit_fstatat_state {
+	struct vfs_aio_state aio_state;
+	vfs_handle_struct *handle;
+	files_struct *dirfsp;
+	const struct smb_filename *smb_fname;
+	int ret;
+	SMB_STRUCT_STAT sbuf;
+};
+
+static void smb_full_audit_fstatat_done(struct tevent_req *subreq);
+
+static struct tevent_req *smb_full_audit_fstatat_send(
+			TALLOC_CTX *mem_ctx,
+			struct tevent_context *ev,
+			struct vfs_handle_struct *handle,
+			files_struct *dirfsp,
+			const struct smb_filename *smb_fname,
+			int flags)
+{
+	struct tevent_req *req = NULL;
+	struct tevent_req *subreq = NULL;
+	struct smb_full_audit_fstatat_state *state = NULL;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct smb_full_audit_fstatat_state);
+	if (req == NULL) {
+		do_log(SMB_VFS_OP_FSTATAT_SEND,
+		       strerror(ENOMEM),
+		       handle,
+		       "%s/%s",
+		       fsp_str_do_log(dirfsp),
+		       smb_fname_str_do_log(handle->conn, smb_fname));
+		return NULL;
+	}
+	*state = (struct smb_full_audit_fstatat_state) {
+		.handle = handle,
+		.dirfsp = dirfsp,
+		.smb_fname = smb_fname,
+	};
+
+	subreq = SMB_VFS_NEXT_FSTATAT_SEND(state,
+					   ev,
+					   handle,
+					   dirfsp,
+					   smb_fname,
+					   flags);
+	if (tevent_req_nomem(subreq, req)) {
+		do_log(SMB_VFS_OP_FSTATAT_SEND,
+		       strerror(ENOMEM),
+		       handle,
+		       "%s/%s",
+		       fsp_str_do_log(dirfsp),
+		       smb_fname_str_do_log(handle->conn, smb_fname));
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, smb_full_audit_fstatat_done, req);
+
+	do_log(SMB_VFS_OP_FSTATAT_SEND,
+	       NULL,
+	       handle,
+	       "%s/%s",
+	       fsp_str_do_log(dirfsp),
+	       smb_fname_str_do_log(handle->conn, smb_fname));
+
+	return req;
+}
+
+static void smb_full_audit_fstatat_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct smb_full_audit_fstatat_state *state = tevent_req_data(
+		req, struct smb_full_audit_fstatat_state);
+
+	state->ret = SMB_VFS_NEXT_FSTATAT_RECV(subreq,
+					       &state->aio_state,
+					       &state->sbuf);
+	TALLOC_FREE(subreq);
+	if (state->ret == -1) {
+		tevent_req_error(req, state->aio_state.error);
+		return;
+	}
+
+	tevent_req_done(req);
+}
+
+static int smb_full_audit_fstatat_recv(struct tevent_req *req,
+				       struct vfs_aio_state *aio_state,
+				       SMB_STRUCT_STAT *sbuf)
+{
+	struct smb_full_audit_fstatat_state *state = tevent_req_data(
+		req, struct smb_full_audit_fstatat_state);
+
+	if (tevent_req_is_unix_error(req, &aio_state->error)) {
+		do_log(SMB_VFS_OP_FSTATAT_RECV,
+		       errmsg_unix(aio_state->error),
+		       state->handle,
+		       "%s/%s",
+		       fsp_str_do_log(state->dirfsp),
+		       smb_fname_str_do_log(state->handle->conn,
+					    state->smb_fname));
+		tevent_req_received(req);
+		return -1;
+	}
+
+	do_log(SMB_VFS_OP_FSTATAT_RECV,
+	       NULL,
+	       state->handle,
+	       "%s/%s",
+	       fsp_str_do_log(state->dirfsp),
+	       smb_fname_str_do_log(state->handle->conn, state->smb_fname));
+
+	*aio_state = state->aio_state;
+	*sbuf = state->sbuf;
+
+	tevent_req_received(req);
+	return 0;
+}
 static uint64_t smb_full_audit_get_alloc_size(vfs_handle_struct *handle,
 		       files_struct *fsp, const SMB_STRUCT_STAT *sbuf)
 {
@@ -3162,6 +3285,8 @@ static struct vfs_fn_pointers vfs_full_audit_fns = {
 	.fstat_fn = smb_full_audit_fstat,
 	.lstat_fn = smb_full_audit_lstat,
 	.fstatat_fn = smb_full_audit_fstatat,
+	.fstatat_send_fn = smb_full_audit_fstatat_send,
+	.fstatat_recv_fn = smb_full_audit_fstatat_recv,
 	.get_alloc_size_fn = smb_full_audit_get_alloc_size,
 	.unlinkat_fn = smb_full_audit_unlinkat,
 	.fchmod_fn = smb_full_audit_fchmod,
@@ -45,6 +45,7 @@ struct open_how;
 #include "lib/util/tevent_unix.h"
 #include "lib/util/sys_rw.h"
 #include "lib/util/iov_buf.h"
+#include "lib/util/bitmap.h"
 #include "smbprofile.h"
 #include <liburing.h>
 
@@ -59,6 +60,21 @@ struct vfs_io_uring_config {
 	bool need_retry;
 	struct vfs_io_uring_request *queue;
 	struct vfs_io_uring_request *pending;
+	/* set once the kernel rejected IORING_OP_STATX */
+	bool no_statx;
+	/* used slots of the registered file table, NULL if disabled */
+	struct bitmap *fixed_files;
+	unsigned num_fixed_files;
+};
+
+/*
+ * fsp extension remembering the slot in the registered
+ * file table. The fd is stored as well, so that we
+ * notice if the fsp got a new fd without a close.
+ */
+struct vfs_io_uring_fixed_file {
+	int fd;
+	unsigned slot;
 };
 
 struct vfs_io_uring_request {
@@ -179,6 +195,7 @@ static int vfs_io_uring_connect(vfs_handle_struct *handle, const char *service,
 	int ret;
 	struct vfs_io_uring_config *config;
 	unsigned num_entries;
+	unsigned num_fixed_files;
 	bool sqpoll;
 	unsigned flags = 0;
 
@@ -229,6 +246,49 @@ static int vfs_io_uring_connect(vfs_handle_struct *handle, const char *service,
 	}
 #endif /* HAVE_IO_URING_RING_DONTFORK */
 
+	num_fixed_files = lp_parm_ulong(SNUM(handle->conn),
+					"io_uring",
+					"num_fixed_files",
+					0);
+	if (num_fixed_files > 0) {
+		int *fds = NULL;
+		unsigned i;
+
+		fds = talloc_array(config, int, num_fixed_files);
+		if (fds == NULL) {
+			SMB_VFS_NEXT_DISCONNECT(handle);
+			errno = ENOMEM;
+			return -1;
+		}
+		for (i = 0; i < num_fixed_files; i++) {
+			fds[i] = -1;
+		}
+
+		/*
+		 * Register a sparse table, the slots are
+		 * filled as files are read or written.
+		 */
+		ret = io_uring_register_files(&config->uring,
+					      fds,
+					      num_fixed_files);
+		TALLOC_FREE(fds);
+		if (ret < 0) {
+			DBG_WARNING("io_uring_register_files(%u) failed: %s, "
+				    "not using fixed files\n",
+				    num_fixed_files,
+				    strerror(-ret));
+		} else {
+			config->fixed_files = bitmap_talloc(config,
+							    num_fixed_files);
+			if (config->fixed_files == NULL) {
+				SMB_VFS_NEXT_DISCONNECT(handle);
+				errno = ENOMEM;
+				return -1;
+			}
+			config->num_fixed_files = num_fixed_files;
+		}
+	}
+
 	config->fde = tevent_add_fd(handle->conn->sconn->ev_ctx,
 				    config,
 				    config->uring.ring_fd,
@@ -432,8 +492,128 @@ static int vfs_io_uring_openat(struct vfs_handle_struct *handle,
 	return SMB_VFS_NEXT_OPENAT(handle, dirfsp, smb_fname, fsp, how);
 }
 
+static void vfs_io_uring_fixed_file_unregister(
+	struct vfs_io_uring_config *config,
+	struct vfs_io_uring_fixed_file *ff)
+{
+	int fd = -1;
+	int ret;
+
+	if (config->uring.ring_fd != -1) {
+		ret = io_uring_register_files_update(&config->uring,
+						     ff->slot,
+						     &fd,
+						     1);
+		if (ret < 0) {
+			DBG_WARNING("Unregistering slot %u failed: %s\n",
+				    ff->slot,
+				    strerror(-ret));
+			/*
+			 * Don't reuse the slot, the
+			 * old file is still in there.
+			 */
+			return;
+		}
+	}
+	bitmap_clear(config->fixed_files, ff->slot);
+}
+
+/*
+ * Return the fd to be used in an sqe for fsp. If the file is
+ * (or can be) registered in the fixed file table, this is the
+ * slot index and *sqe_flags gets IOSQE_FIXED_FILE.
+ *
+ * Using fixed files saves the kernel an fget()/fput() pair
+ * per request.
+ */
+static int vfs_io_uring_fsp_fd(struct vfs_handle_struct *handle,
+			       struct vfs_io_uring_config *config,
+			       struct files_struct *fsp,
+			       unsigned *sqe_flags)
+{
+	struct vfs_io_uring_fixed_file *ff = NULL;
+	int fd = fsp_get_io_fd(fsp);
+	int slot;
+	int ret;
+
+	*sqe_flags = 0;
+
+	if (config->fixed_files == NULL || config->uring.ring_fd == -1) {
+		return fd;
+	}
+
+	ff = VFS_FETCH_FSP_EXTENSION(handle, fsp);
+	if (ff != NULL) {
+		if (ff->fd == fd) {
+			*sqe_flags = IOSQE_FIXED_FILE;
+			return ff->slot;
+		}
+		vfs_io_uring_fixed_file_unregister(config, ff);
+		VFS_REMOVE_FSP_EXTENSION(handle, fsp);
+		ff = NULL;
+	}
+
+	slot = bitmap_find(config->fixed_files, 0);
+	if (slot == -1) {
+		/* Table full, use the plain fd */
+		return fd;
+	}
+
+	ff = VFS_ADD_FSP_EXTENSION(handle,
+				   fsp,
+				   struct vfs_io_uring_fixed_file,
+				   NULL);
+	if (ff == NULL) {
+		return fd;
+	}
+
+	ret = io_uring_register_files_update(&config->uring, slot, &fd, 1);
+	if (ret < 0) {
+		DBG_DEBUG("Registering %s in slot %d failed: %s\n",
+			  fsp_str_dbg(fsp),
+			  slot,
+			  strerror(-ret));
+		VFS_REMOVE_FSP_EXTENSION(handle, fsp);
+		return fd;
+	}
+
+	*ff = (struct vfs_io_uring_fixed_file) {
+		.fd = fd,
+		.slot = slot,
+	};
+	bitmap_set(config->fixed_files, slot);
+
+	*sqe_flags = IOSQE_FIXED_FILE;
+	return slot;
+}
+
+static int vfs_io_uring_close(struct vfs_handle_struct *handle,
+			      struct files_struct *fsp)
+{
+	struct vfs_io_uring_config *config = NULL;
+	struct vfs_io_uring_fixed_file *ff = NULL;
+
+	SMB_VFS_HANDLE_GET_DATA(handle, config,
+				struct vfs_io_uring_config,
+				smb_panic(__location__));
+
+	/*
+	 * The registered file table holds a reference,
+	 * the file would not really be closed otherwise.
+	 */
+	ff = VFS_FETCH_FSP_EXTENSION(handle, fsp);
+	if (ff != NULL) {
+		vfs_io_uring_fixed_file_unregister(config, ff);
+		VFS_REMOVE_FSP_EXTENSION(handle, fsp);
+	}
+
+	return SMB_VFS_NEXT_CLOSE(handle, fsp);
+}
+
 struct vfs_io_uring_pread_state {
 	struct files_struct *fsp;
+	int fd;
+	unsigned sqe_flags;
 	off_t offset;
 	struct iovec iov;
 	size_t nread;
@@ -480,6 +660,8 @@ static struct tevent_req *vfs_io_uring_pread_send(struct vfs_handle_struct *hand
 	}
 
 	state->fsp = fsp;
+	state->fd = vfs_io_uring_fsp_fd(handle, config, fsp,
+					&state->sqe_flags);
 	state->offset = offset;
 	state->iov.iov_base = (void *)data;
 	state->iov.iov_len = n;
@@ -496,9 +678,10 @@ static struct tevent_req *vfs_io_uring_pread_send(struct vfs_handle_struct *hand
 static void vfs_io_uring_pread_submit(struct vfs_io_uring_pread_state *state)
 {
 	io_uring_prep_readv(&state->ur.sqe,
-			    fsp_get_io_fd(state->fsp),
+			    state->fd,
 			    &state->iov, 1,
 			    state->offset);
+	io_uring_sqe_set_flags(&state->ur.sqe, state->sqe_flags);
 	vfs_io_uring_request_submit(&state->ur);
 }
 
@@ -582,6 +765,8 @@ static ssize_t vfs_io_uring_pread_recv(struct tevent_req *req,
 
 struct vfs_io_uring_pwrite_state {
 	struct files_struct *fsp;
+	int fd;
+	unsigned sqe_flags;
 	off_t offset;
 	struct iovec iov;
 	size_t nwritten;
@@ -629,6 +814,8 @@ static struct tevent_req *vfs_io_uring_pwrite_send(struct vfs_handle_struct *han
 	}
 
 	state->fsp = fsp;
+	state->fd = vfs_io_uring_fsp_fd(handle, config, fsp,
+					&state->sqe_flags);
 	state->offset = offset;
 	state->iov.iov_base = discard_const(data);
 	state->iov.iov_len = n;
@@ -646,14 +833,14 @@ static void vfs_io_uring_pwrite_submit(struct vfs_io_uring_pwrite_state *state)
 {
 	if (!state->fsp->fsp_flags.posix_append) {
 		io_uring_prep_writev(&state->ur.sqe,
-				     fsp_get_io_fd(state->fsp),
+				     state->fd,
 				     &state->iov, 1,
 				     state->offset);
 	}
 	else {
 #ifdef HAVE_IO_URING_PREP_WRITEV2
 		io_uring_prep_writev2(&state->ur.sqe,
-				      fsp_get_io_fd(state->fsp),
+				      state->fd,
 				      &state->iov, 1,
 				      -1,
 				      RWF_APPEND);
@@ -662,6 +849,7 @@ static void vfs_io_uring_pwrite_submit(struct vfs_io_uring_pwrite_state *state)
 		smb_panic("Unexpected POSIX append-IO");
 #endif
 	}
+	io_uring_sqe_set_flags(&state->ur.sqe, state->sqe_flags);
 	vfs_io_uring_request_submit(&state->ur);
 }
 
@@ -758,6 +946,8 @@ static struct tevent_req *vfs_io_uring_fsync_send(struct vfs_handle_struct *hand
 	struct tevent_req *req = NULL;
 	struct vfs_io_uring_fsync_state *state = NULL;
 	struct vfs_io_uring_config *config = NULL;
+	unsigned sqe_flags;
+	int fd;
 
 	SMB_VFS_HANDLE_GET_DATA(handle, config,
 				struct vfs_io_uring_config,
@@ -776,9 +966,11 @@ static struct tevent_req *vfs_io_uring_fsync_send(struct vfs_handle_struct *hand
 				     state->ur.profile_bytes, 0);
 	SMBPROFILE_BYTES_ASYNC_SET_IDLE(state->ur.profile_bytes);
 
+	fd = vfs_io_uring_fsp_fd(handle, config, fsp, &sqe_flags);
 	io_uring_prep_fsync(&state->ur.sqe,
-			    fsp_get_io_fd(fsp),
+			    fd,
 			    0); /* fsync_flags */
+	io_uring_sqe_set_flags(&state->ur.sqe, sqe_flags);
 	vfs_io_uring_request_submit(&state->ur);
 
 	if (!tevent_req_is_in_progress(req)) {
@@ -835,15 +1027,225 @@ static int vfs_io_uring_fsync_recv(struct tevent_req *req,
 	return 0;
 }
 
+#ifdef HAVE_IO_URING_PREP_STATX
+struct vfs_io_uring_fstatat_state {
+	struct vfs_io_uring_request ur;
+	struct vfs_handle_struct *handle;
+	files_struct *dirfsp;
+	const struct smb_filename *smb_fname;
+	char *name;
+	int flags;
+	bool fake_dir_create_times;
+	struct statx stx;
+	SMB_STRUCT_STAT sbuf;
+};
+
+static void vfs_io_uring_fstatat_completion(struct vfs_io_uring_request *cur,
+					    const char *location);
+static void vfs_io_uring_fstatat_sync(struct vfs_io_uring_fstatat_state *state,
+				      const char *location);
+
+static struct tevent_req *vfs_io_uring_fstatat_send(
+			TALLOC_CTX *mem_ctx,
+			struct tevent_context *ev,
+			struct vfs_handle_struct *handle,
+			files_struct *dirfsp,
+			const struct smb_filename *smb_fname,
+			int flags)
+{
+	struct tevent_req *req = NULL;
+	struct vfs_io_uring_fstatat_state *state = NULL;
+	struct vfs_io_uring_config *config = NULL;
+	int dirfd;
+
+	SMB_VFS_HANDLE_GET_DATA(handle, config,
+				struct vfs_io_uring_config,
+				smb_panic(__location__));
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct vfs_io_uring_fstatat_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	state->ur.config = config;
+	state->ur.req = req;
+	state->ur.completion_fn = vfs_io_uring_fstatat_completion;
+	state->handle = handle;
+	state->dirfsp = dirfsp;
+	state->smb_fname = smb_fname;
+	state->flags = flags;
+	state->fake_dir_create_times = lp_fake_directory_create_times(
+		SNUM(handle->conn));
+
+	SMBPROFILE_BYTES_ASYNC_START(syscall_asys_fstatat, profile_p,
+				     state->ur.profile_bytes, 0);
+	SMBPROFILE_BYTES_ASYNC_SET_IDLE(state->ur.profile_bytes);
+
+	dirfd = fsp_get_pathref_fd(dirfsp);
+
+	if (config->no_statx || dirfd == -1) {
+		vfs_io_uring_fstatat_sync(state, __location__);
+		return tevent_req_post(req, ev);
+	}
+
+	/*
+	 * The kernel reads the path when it
+	 * executes the sqe, so it has to live
+	 * as long as the request.
+	 */
+	state->name = talloc_strdup(state, smb_fname->base_name);
+	if (tevent_req_nomem(state->name, req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	io_uring_prep_statx(&state->ur.sqe,
+			    dirfd,
+			    state->name,
+			    flags,
+			    STATX_BASIC_STATS,
+			    &state->stx);
+	vfs_io_uring_request_submit(&state->ur);
+
+	if (!tevent_req_is_in_progress(req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	tevent_req_defer_callback(req, ev);
+	return req;
+}
+
+static void vfs_io_uring_fstatat_sync(struct vfs_io_uring_fstatat_state *state,
+				      const char *location)
+{
+	int ret;
+
+	PROFILE_TIMESTAMP(&state->ur.start_time);
+	ret = SMB_VFS_NEXT_FSTATAT(state->handle,
+				   state->dirfsp,
+				   state->smb_fname,
+				   &state->sbuf,
+				   state->flags);
+	PROFILE_TIMESTAMP(&state->ur.end_time);
+	if (ret == -1) {
+		_tevent_req_error(state->ur.req, errno, location);
+		return;
+	}
+
+	tevent_req_done(state->ur.req);
+}
+
+static void vfs_io_uring_fstatat_completion(struct vfs_io_uring_request *cur,
+					    const char *location)
+{
+	struct vfs_io_uring_fstatat_state *state = tevent_req_data(
+		cur->req, struct vfs_io_uring_fstatat_state);
+	const struct statx *stx = &state->stx;
+	struct stat st;
+	bool ok;
+
+	/*
+	 * We rely on being inside the _send() function
+	 * or tevent_req_defer_callback() being called
+	 * already.
+	 */
+
+	if (cur->cqe.res == -EINVAL && !cur->config->no_statx) {
+		/*
+		 * Kernels before 5.6 don't know
+		 * IORING_OP_STATX, remember that and
+		 * use the synchronous fstatat() from now on.
+		 *
+		 * We may be called from the fd handler,
+		 * so become the correct user first.
+		 */
+		DBG_NOTICE("IORING_OP_STATX not supported, "
+			   "falling back to fstatat()\n");
+		cur->config->no_statx = true;
+		ok = change_to_user_and_service_by_fsp(state->dirfsp);
+		SMB_ASSERT(ok);
+		vfs_io_uring_fstatat_sync(state, location);
+		return;
+	}
+
+	if (cur->cqe.res < 0) {
+		int err = -cur->cqe.res;
+		_tevent_req_error(cur->req, err, location);
+		return;
+	}
+
+	if (cur->cqe.res > 0) {
+		/* This is not expected! */
+		DBG_ERR("got cur->cqe.res=%d\n", (int)cur->cqe.res);
+		tevent_req_error(cur->req, EIO);
+		return;
+	}
+
+	/*
+	 * Go via struct stat, so that we get the same
+	 * birthtime emulation as sys_fstatat().
+	 */
+	st = (struct stat) {
+		.st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor),
+		.st_ino = stx->stx_ino,
+		.st_mode = stx->stx_mode,
+		.st_nlink = stx->stx_nlink,
+		.st_uid = stx->stx_uid,
+		.st_gid = stx->stx_gid,
+		.st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor),
+		.st_size = stx->stx_size,
+		.st_blksize = stx->stx_blksize,
+		.st_blocks = stx->stx_blocks,
+		.st_atim.tv_sec = stx->stx_atime.tv_sec,
+		.st_atim.tv_nsec = stx->stx_atime.tv_nsec,
+		.st_mtim.tv_sec = stx->stx_mtime.tv_sec,
+		.st_mtim.tv_nsec = stx->stx_mtime.tv_nsec,
+		.st_ctim.tv_sec = stx->stx_ctime.tv_sec,
+		.st_ctim.tv_nsec = stx->stx_ctime.tv_nsec,
+	};
+	init_stat_ex_from_stat(&state->sbuf, &st,
+			       state->fake_dir_create_times);
+
+	tevent_req_done(cur->req);
+}
+
+static int vfs_io_uring_fstatat_recv(struct tevent_req *req,
+				     struct vfs_aio_state *vfs_aio_state,
+				     SMB_STRUCT_STAT *sbuf)
+{
+	struct vfs_io_uring_fstatat_state *state = tevent_req_data(
+		req, struct vfs_io_uring_fstatat_state);
+
+	SMBPROFILE_BYTES_ASYNC_END(state->ur.profile_bytes);
+	vfs_aio_state->duration = nsec_time_diff(&state->ur.end_time,
+						 &state->ur.start_time);
+
+	if (tevent_req_is_unix_error(req, &vfs_aio_state->error)) {
+		tevent_req_received(req);
+		return -1;
+	}
+
+	vfs_aio_state->error = 0;
+	*sbuf = state->sbuf;
+
+	tevent_req_received(req);
+	return 0;
+}
+#endif /* HAVE_IO_URING_PREP_STATX */
+
 static struct vfs_fn_pointers vfs_io_uring_fns = {
 	.connect_fn = vfs_io_uring_connect,
 	.openat_fn = vfs_io_uring_openat,
+	.close_fn = vfs_io_uring_close,
 	.pread_send_fn = vfs_io_uring_pread_send,
 	.pread_recv_fn = vfs_io_uring_pread_recv,
 	.pwrite_send_fn = vfs_io_uring_pwrite_send,
 	.pwrite_recv_fn = vfs_io_uring_pwrite_recv,
 	.fsync_send_fn = vfs_io_uring_fsync_send,
 	.fsync_recv_fn = vfs_io_uring_fsync_recv,
+#ifdef HAVE_IO_URING_PREP_STATX
+	.fstatat_send_fn = vfs_io_uring_fstatat_send,
+	.fstatat_recv_fn = vfs_io_uring_fstatat_recv,
+#endif
 };
 
 static_decl_vfs;
@@ -392,6 +392,53 @@ int vfs_not_implemented_fstatat(
 	return -1;
 }
 
+struct vfs_not_implemented_fstatat_state {
+	struct vfs_aio_state aio_state;
+	SMB_STRUCT_STAT sbuf;
+};
+
+_PUBLIC_
+struct tevent_req *vfs_not_implemented_fstatat_send(
+			TALLOC_CTX *mem_ctx,
+			struct tevent_context *ev,
+			struct vfs_handle_struct *handle,
+			files_struct *dirfsp,
+			const struct smb_filename *smb_fname,
+			int flags)
+{
+	struct tevent_req *req = NULL;
+	struct vfs_not_implemented_fstatat_state *state = NULL;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct vfs_not_implemented_fstatat_state);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	tevent_req_error(req, ENOSYS);
+	return tevent_req_post(req, ev);
+}
+
+_PUBLIC_
+int vfs_not_implemented_fstatat_recv(struct tevent_req *req,
+				     struct vfs_aio_state *aio_state,
+				     SMB_STRUCT_STAT *sbuf)
+{
+	struct vfs_not_implemented_fstatat_state *state = tevent_req_data(
+		req, struct vfs_not_implemented_fstatat_state);
+
+	if (tevent_req_is_unix_error(req, &aio_state->error)) {
+		tevent_req_received(req);
+		return -1;
+	}
+
+	*aio_state = state->aio_state;
+	*sbuf = state->sbuf;
+
+	tevent_req_received(req);
+	return 0;
+}
+
 _PUBLIC_
 uint64_t vfs_not_implemented_get_alloc_size(struct vfs_handle_struct *handle,
 					    struct files_struct *fsp,
@@ -1089,6 +1136,8 @@ static struct vfs_fn_pointers vfs_not_implemented_fns = {
 	.fstat_fn = vfs_not_implemented_fstat,
 	.lstat_fn = vfs_not_implemented_lstat,
 	.fstatat_fn = vfs_not_implemented_fstatat,
+	.fstatat_send_fn = vfs_not_implemented_fstatat_send,
+	.fstatat_recv_fn = vfs_not_implemented_fstatat_recv,
 	.get_alloc_size_fn = vfs_not_implemented_get_alloc_size,
 	.unlinkat_fn = vfs_not_implemented_unlinkat,
 	.fchmod_fn = vfs_not_implemented_fchmod,
@@ -1126,6 +1126,100 @@ static int smb_time_audit_fstatat(
 	return result;
 }
 
+struct smb_time_audit_fstatat_state {
+	struct vfs_aio_state aio_state;
+	files_struct *dirfsp;
+	const struct smb_filename *smb_fname;
+	int ret;
+	SMB_STRUCT_STAT sbuf;
+};
+
+static void smb_time_audit_fstatat_done(struct tevent_req *subreq);
+
+static struct tevent_req *smb_time_audit_fstatat_send(
+			TALLOC_CTX *mem_ctx,
+			struct tevent_context *ev,
+			struct vfs_handle_struct *handle,
+			files_struct *dirfsp,
+			const struct smb_filename *smb_fname,
+			int flags)
+{
+	struct tevent_req *req = NULL;
+	struct tevent_req *subreq = NULL;
+	struct smb_time_audit_fstatat_state *state = NULL;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct smb_time_audit_fstatat_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	*state = (struct smb_time_audit_fstatat_state) {
+		.dirfsp = dirfsp,
+		.smb_fname = smb_fname,
+	};
+
+	subreq = SMB_VFS_NEXT_FSTATAT_SEND(state,
+					   ev,
+					   handle,
+					   dirfsp,
+					   smb_fname,
+					   flags);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, smb_time_audit_fstatat_done, req);
+
+	return req;
+}
+
+static void smb_time_audit_fstatat_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct smb_time_audit_fstatat_state *state = tevent_req_data(
+		req, struct smb_time_audit_fstatat_state);
+
+	state->ret = SMB_VFS_NEXT_FSTATAT_RECV(subreq,
+					       &state->aio_state,
+					       &state->sbuf);
+	TALLOC_FREE(subreq);
+	if (state->ret == -1) {
+		tevent_req_error(req, state->aio_state.error);
+		return;
+	}
+
+	tevent_req_done(req);
+}
+
+static int smb_time_audit_fstatat_recv(struct tevent_req *req,
+				       struct vfs_aio_state *aio_state,
+				       SMB_STRUCT_STAT *sbuf)
+{
+	struct smb_time_audit_fstatat_state *state = tevent_req_data(
+		req, struct smb_time_audit_fstatat_state);
+	double timediff;
+
+	timediff = state->aio_state.duration * 1.0e-9;
+
+	if (timediff > audit_timeout) {
+		smb_time_audit_log_at("async fstatat",
+				      timediff,
+				      state->dirfsp,
+				      state->smb_fname);
+	}
+
+	if (tevent_req_is_unix_error(req, &aio_state->error)) {
+		tevent_req_received(req);
+		return -1;
+	}
+
+	*aio_state = state->aio_state;
+	*sbuf = state->sbuf;
+
+	tevent_req_received(req);
+	return 0;
+}
+
 static uint64_t smb_time_audit_get_alloc_size(vfs_handle_struct *handle,
 					      files_struct *fsp,
 					      const SMB_STRUCT_STAT *sbuf)
@@ -2699,6 +2793,8 @@ static struct vfs_fn_pointers vfs_time_audit_fns = {
 	.fstat_fn = smb_time_audit_fstat,
 	.lstat_fn = smb_time_audit_lstat,
 	.fstatat_fn = smb_time_audit_fstatat,
+	.fstatat_send_fn = smb_time_audit_fstatat_send,
+	.fstatat_recv_fn = smb_time_audit_fstatat_recv,
 	.get_alloc_size_fn = smb_time_audit_get_alloc_size,
 	.unlinkat_fn = smb_time_audit_unlinkat,
 	.fchmod_fn = smb_time_audit_fchmod,
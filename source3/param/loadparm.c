@@ -276,6 +276,8 @@ static const struct loadparm_service _sDefault =
 	.honor_change_notify_privilege = false,
 	.volume_serial_number = -1,
 	.smb3_unix_extensions = true,
+	.smb3_compress_data = false,
+	.smb3_compression_threshold = 4096,
 	.dummy = ""
 };
 
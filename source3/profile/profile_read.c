@@ -26,6 +26,16 @@
 #include "lib/util/byteorder.h"
 #include "source3/include/smbprofile.h"
 
+static void smbprofile_hist_accumulate(struct smbprofile_stats_hist *acc,
+				       const struct smbprofile_stats_hist *add)
+{
+	size_t i;
+
+	for (i = 0; i < SMBPROFILE_HIST_BUCKETS; i++) {
+		acc->buckets[i] += add->buckets[i];
+	}
+}
+
 void smbprofile_stats_accumulate(struct profile_stats *acc,
 				 const struct profile_stats *add)
 {
@@ -58,6 +68,9 @@ void smbprofile_stats_accumulate(struct profile_stats *acc,
 			add->values.name##_stats.idle;  \
 		acc->values.name##_stats.bytes +=       \
 			add->values.name##_stats.bytes; \
+		smbprofile_hist_accumulate(             \
+			&acc->values.name##_stats.hist, \
+			&add->values.name##_stats.hist); \
 	} while (0);
 #define SMBPROFILE_STATS_IOBYTES(name)                     \
 	do {                                               \
@@ -93,6 +106,9 @@ void smbprofile_stats_accumulate(struct profile_stats *acc,
 			add->values.name##_stats.inbytes;  \
 		acc->values.name##_stats.outbytes +=       \
 			add->values.name##_stats.outbytes; \
+		smbprofile_hist_accumulate(                \
+			&acc->values.name##_stats.hist,    \
+			&add->values.name##_stats.hist);   \
 	} while (0);
 #define SMBPROFILE_STATS_SECTION_END
 #define SMBPROFILE_STATS_END
@@ -150,6 +166,7 @@ int smbprofile_magic(const struct profile_stats *stats, uint64_t *_magic)
 		__UPDATE(#name "+time");  \
 		__UPDATE(#name "+idle");  \
 		__UPDATE(#name "+bytes"); \
+		__UPDATE(#name "+hist");  \
 	} while (0);
 #define SMBPROFILE_STATS_IOBYTES(name)       \
 	do {                                 \
@@ -158,6 +175,7 @@ int smbprofile_magic(const struct profile_stats *stats, uint64_t *_magic)
 		__UPDATE(#name "+idle");     \
 		__UPDATE(#name "+inbytes");  \
 		__UPDATE(#name "+outbytes"); \
+		__UPDATE(#name "+hist");     \
 	} while (0);
 #define SMBPROFILE_STATS_SECTION_END
 #define SMBPROFILE_STATS_END
@@ -0,0 +1,80 @@
+/*
+ * Unix SMB/CIFS implementation.
+ * Tests for the smbprofile latency histogram buckets
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "source3/include/smbprofile.h"
+
+/*
+ * Every bucket covers [limit(idx-1), limit(idx)), the
+ * first and the last value must map back to the bucket.
+ */
+static void test_smbprofile_hist_boundaries(void **state)
+{
+	uint64_t lower = 0;
+	size_t idx;
+
+	for (idx = 0; idx < SMBPROFILE_HIST_BUCKETS - 1; idx++) {
+		uint64_t limit = smbprofile_hist_limit(idx);
+
+		assert_true(limit > lower);
+		assert_int_equal(smbprofile_hist_index(lower), idx);
+		assert_int_equal(smbprofile_hist_index(limit - 1), idx);
+
+		lower = limit;
+	}
+
+	assert_int_equal(smbprofile_hist_limit(SMBPROFILE_HIST_BUCKETS - 1),
+			 UINT64_MAX);
+	assert_int_equal(smbprofile_hist_index(lower),
+			 SMBPROFILE_HIST_BUCKETS - 1);
+	assert_int_equal(smbprofile_hist_index(UINT64_MAX),
+			 SMBPROFILE_HIST_BUCKETS - 1);
+}
+
+static void test_smbprofile_hist_update(void **state)
+{
+	struct smbprofile_stats_hist h = {};
+	uint64_t lower = 0;
+	size_t idx;
+
+	for (idx = 0; idx < SMBPROFILE_HIST_BUCKETS - 1; idx++) {
+		uint64_t limit = smbprofile_hist_limit(idx);
+
+		smbprofile_hist_update(&h, lower);
+		smbprofile_hist_update(&h, limit - 1);
+		assert_int_equal(h.buckets[idx], 2);
+
+		lower = limit;
+	}
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_smbprofile_hist_boundaries),
+		cmocka_unit_test(test_smbprofile_hist_update),
+	};
+
+	cmocka_set_message_output(CM_OUTPUT_SUBUNIT);
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
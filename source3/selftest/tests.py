@@ -548,6 +548,7 @@ local_tests = [
     "LOCAL-GENCACHE",
     "LOCAL-BASE64",
     "LOCAL-RBTREE",
+    "LOCAL-DBWRAP-HASH",
     "LOCAL-MEMCACHE",
     "LOCAL-STREAM-NAME",
     "LOCAL-STR-MATCH-MSWILD",
@@ -576,6 +577,7 @@ local_tests = [
     "LOCAL-DBWRAP-WATCH3",
     "LOCAL-DBWRAP-WATCH4",
     "LOCAL-DBWRAP-DO-LOCKED1",
+    "LOCAL-DBWRAP-PARSE-RECORDS1",
     "LOCAL-G-LOCK1",
     "LOCAL-G-LOCK2",
     "LOCAL-G-LOCK3",
@@ -2025,7 +2027,8 @@ if have_cluster_support:
 
     CLUSTERED_LOCAL_TESTS = [
         "ctdbd-conn1",
-        "local-dbwrap-ctdb1"
+        "local-dbwrap-ctdb1",
+        "local-dbwrap-ctdb-parse-records1"
     ]
 
     for t in CLUSTERED_LOCAL_TESTS:
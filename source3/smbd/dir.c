@@ -51,6 +51,23 @@ struct smb_Dir {
 	bool case_sensitive;
 	files_struct *fsp; /* Back pointer to containing fsp, only
 			      set from OpenDir_fsp(). */
+
+	/*
+	 * Names read by dptr_readahead(), ReadDirName()
+	 * returns them before reading more from the directory.
+	 */
+	char **readahead;
+	size_t readahead_ofs;
+	size_t readahead_num;
+
+	/*
+	 * "smbd directory cache": Either the cached names we
+	 * return instead of reading the directory, or the
+	 * entry we fill while reading it.
+	 */
+	struct smbd_dircache_ref *dircache_ref;
+	size_t dircache_ofs;
+	struct smbd_dircache_entry *dircache_rec;
 };
 
 struct dptr_struct {
@@ -996,6 +1013,27 @@ static int smb_Dir_destructor(struct smb_Dir *dir_hnd)
 	return 0;
 }
 
+static void smb_Dir_dircache_start(struct smb_Dir *dir_hnd)
+{
+	struct smbd_dircache_ref *ref = NULL;
+
+	TALLOC_FREE(dir_hnd->dircache_rec);
+
+	/*
+	 * Look up first, names from the old reference
+	 * might still be in use by our caller.
+	 */
+	ref = smbd_dircache_lookup(dir_hnd, dir_hnd->fsp);
+	TALLOC_FREE(dir_hnd->dircache_ref);
+	dir_hnd->dircache_ref = ref;
+	dir_hnd->dircache_ofs = 0;
+
+	if (ref == NULL) {
+		dir_hnd->dircache_rec = smbd_dircache_record_start(
+			dir_hnd, dir_hnd->fsp);
+	}
+}
+
 /*******************************************************************
  Open a directory.
 ********************************************************************/
@@ -1164,6 +1202,8 @@ static NTSTATUS OpenDir_fsp(
 
 	talloc_set_destructor(dir_hnd, smb_Dir_destructor);
 
+	smb_Dir_dircache_start(dir_hnd);
+
 	*_dir_hnd = dir_hnd;
 	return NT_STATUS_OK;
 
@@ -1179,19 +1219,18 @@ static NTSTATUS OpenDir_fsp(
  Don't check for veto or invisible files.
 ********************************************************************/
 
-const char *ReadDirName(struct smb_Dir *dir_hnd, char **ptalloced)
+static const char *ReadDirName_vfs(struct smb_Dir *dir_hnd, char **ptalloced)
 {
 	const char *n;
 	char *talloced = NULL;
 	connection_struct *conn = dir_hnd->conn;
 
-	if (dir_hnd->file_number < 2) {
-		if (dir_hnd->file_number == 0) {
-			n = ".";
-		} else {
-			n = "..";
+	if (dir_hnd->dircache_ref != NULL) {
+		n = smbd_dircache_ref_name(dir_hnd->dircache_ref,
+					   dir_hnd->dircache_ofs);
+		if (n != NULL) {
+			dir_hnd->dircache_ofs++;
 		}
-		dir_hnd->file_number++;
 		*ptalloced = NULL;
 		return n;
 	}
@@ -1254,14 +1293,162 @@ const char *ReadDirName(struct smb_Dir *dir_hnd, char **ptalloced)
 			TALLOC_FREE(talloced);
 			continue;
 		}
+		smbd_dircache_record_add(&dir_hnd->dircache_rec, n);
 		*ptalloced = talloced;
-		dir_hnd->file_number++;
 		return n;
 	}
+	smbd_dircache_record_done(&dir_hnd->dircache_rec);
 	*ptalloced = NULL;
 	return NULL;
 }
 
+static void ReadDirName_free_readahead(struct smb_Dir *dir_hnd)
+{
+	TALLOC_FREE(dir_hnd->readahead);
+	dir_hnd->readahead_ofs = 0;
+	dir_hnd->readahead_num = 0;
+}
+
+const char *ReadDirName(struct smb_Dir *dir_hnd, char **ptalloced)
+{
+	const char *n;
+
+	if (dir_hnd->file_number < 2) {
+		if (dir_hnd->file_number == 0) {
+			n = ".";
+		} else {
+			n = "..";
+		}
+		dir_hnd->file_number++;
+		*ptalloced = NULL;
+		return n;
+	}
+
+	if (dir_hnd->readahead_ofs < dir_hnd->readahead_num) {
+		char *name = dir_hnd->readahead[dir_hnd->readahead_ofs];
+
+		/*
+		 * The caller frees or moves the name, it
+		 * must not go away with the array.
+		 */
+		talloc_steal(dir_hnd, name);
+		dir_hnd->readahead[dir_hnd->readahead_ofs] = NULL;
+		dir_hnd->readahead_ofs++;
+		if (dir_hnd->readahead_ofs == dir_hnd->readahead_num) {
+			ReadDirName_free_readahead(dir_hnd);
+		}
+		dir_hnd->file_number++;
+		*ptalloced = name;
+		return name;
+	}
+
+	n = ReadDirName_vfs(dir_hnd, ptalloced);
+	if (n != NULL) {
+		dir_hnd->file_number++;
+	}
+	return n;
+}
+
+/*******************************************************************
+ Read up to max_names names ahead, they are returned by
+ ReadDirName() later. This allows callers to look at the
+ next names (e.g. to prefetch their metadata) before
+ processing them. The returned array is only valid until
+ the next call into the directory handle.
+********************************************************************/
+
+const char * const *dptr_readahead(struct dptr_struct *dptr,
+				   size_t max_names,
+				   size_t *_num_names)
+{
+	struct smb_Dir *dir_hnd = dptr->dir_hnd;
+	size_t first;
+	size_t i;
+
+	*_num_names = 0;
+
+	if (!dptr->has_wild) {
+		/*
+		 * dptr_ReadDirName() doesn't traverse
+		 * the directory in this case.
+		 */
+		return NULL;
+	}
+
+	if (max_names == 0) {
+		return NULL;
+	}
+
+	if (dir_hnd->readahead_ofs > 0) {
+		/*
+		 * Move the names not yet returned to the front
+		 */
+		first = dir_hnd->readahead_num - dir_hnd->readahead_ofs;
+		memmove(dir_hnd->readahead,
+			dir_hnd->readahead + dir_hnd->readahead_ofs,
+			first * sizeof(char *));
+		dir_hnd->readahead_ofs = 0;
+		dir_hnd->readahead_num = first;
+	}
+	first = dir_hnd->readahead_num;
+
+	dir_hnd->readahead = talloc_realloc(dir_hnd,
+					    dir_hnd->readahead,
+					    char *,
+					    first + max_names);
+	if (dir_hnd->readahead == NULL) {
+		dir_hnd->readahead_ofs = 0;
+		dir_hnd->readahead_num = 0;
+		return NULL;
+	}
+
+	for (i = 0; i < max_names; i++) {
+		const char *n = NULL;
+		char *talloced = NULL;
+		char *name = NULL;
+
+		n = ReadDirName_vfs(dir_hnd, &talloced);
+		if (n == NULL) {
+			break;
+		}
+
+		if (talloced != NULL) {
+			name = talloc_move(dir_hnd->readahead, &talloced);
+		} else {
+			name = talloc_strdup(dir_hnd->readahead, n);
+		}
+		if (name == NULL) {
+			/*
+			 * We've consumed the entry, but there
+			 * is no way to give it back.
+			 */
+			DBG_ERR("talloc_strdup failed, skipping %s\n", n);
+			continue;
+		}
+		dir_hnd->readahead[first + i] = name;
+		dir_hnd->readahead_num = first + i + 1;
+	}
+
+	if (dir_hnd->readahead_num == 0) {
+		ReadDirName_free_readahead(dir_hnd);
+		return NULL;
+	}
+
+	*_num_names = dir_hnd->readahead_num - first;
+	return (const char * const *)&dir_hnd->readahead[first];
+}
+
+/*******************************************************************
+ Return the number of names read ahead but not yet returned.
+********************************************************************/
+
+size_t dptr_readahead_pending(struct dptr_struct *dptr)
+{
+	struct smb_Dir *dir_hnd = dptr->dir_hnd;
+
+	return dir_hnd->readahead_num - dir_hnd->readahead_ofs;
+}
+
 /*******************************************************************
  Rewind to the start.
 ********************************************************************/
@@ -1270,6 +1457,8 @@ void RewindDir(struct smb_Dir *dir_hnd)
 {
 	SMB_VFS_REWINDDIR(dir_hnd->conn, dir_hnd->dir);
 	dir_hnd->file_number = 0;
+	ReadDirName_free_readahead(dir_hnd);
+	smb_Dir_dircache_start(dir_hnd);
 }
 
 struct have_file_open_below_state {
@@ -45,6 +45,10 @@ bool dptr_get_priv(struct dptr_struct *dptr);
 bool dptr_has_wild(struct dptr_struct *dptr);
 const char *dptr_path(struct smbd_server_connection *sconn, int key);
 char *dptr_ReadDirName(TALLOC_CTX *ctx, struct dptr_struct *dptr);
+const char * const *dptr_readahead(struct dptr_struct *dptr,
+				   size_t max_names,
+				   size_t *_num_names);
+size_t dptr_readahead_pending(struct dptr_struct *dptr);
 void dptr_RewindDir(struct dptr_struct *dptr);
 void dptr_set_priv(struct dptr_struct *dptr);
 const char *dptr_wcard(struct smbd_server_connection *sconn, int key);
@@ -97,4 +101,23 @@ void smbd_dirptr_push_overflow(struct dptr_struct *dirptr,
 			       struct smb_filename **_smb_fname,
 			       uint32_t mode);
 void smbd_dirptr_set_last_name_sent(struct dptr_struct *dirptr, char **_fname);
+
+/* The following definitions come from smbd/dir_cache.c */
+
+struct smbd_dircache_ref;
+struct smbd_dircache_entry;
+
+struct smbd_dircache_ref *smbd_dircache_lookup(TALLOC_CTX *mem_ctx,
+					       struct files_struct *dirfsp);
+const char *smbd_dircache_ref_name(struct smbd_dircache_ref *ref,
+				   size_t idx);
+struct smbd_dircache_entry *smbd_dircache_record_start(
+	TALLOC_CTX *mem_ctx,
+	struct files_struct *dirfsp);
+void smbd_dircache_record_add(struct smbd_dircache_entry **_e,
+			      const char *name);
+void smbd_dircache_record_done(struct smbd_dircache_entry **_e);
+bool smbd_dircache_notify(struct smbd_server_connection *sconn,
+			  const void *private_data);
+void smbd_dircache_flush(struct smbd_server_connection *sconn);
 #endif
@@ -0,0 +1,490 @@
+/*
+ * Unix SMB/CIFS implementation.
+ * Cache of directory listings
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This caches the names ReadDirName() got from the file system for
+ * directories that are listed over and over again, see the "smbd
+ * directory cache" parameter.
+ *
+ * An entry is only used as long as the directory's mtime and ctime
+ * did not change. In addition the directory is registered with
+ * notifyd, which sees the changes of all smbds and (with "kernel
+ * change notify") the ones done locally on the server. A
+ * notification removes the entry, this covers file systems with
+ * coarse timestamps.
+ *
+ * Only the names are cached. Everything that depends on the user
+ * (visibility, permissions) or changes without touching the
+ * directory (stat, DOS attributes) is still looked up per entry.
+ */
+
+#include "includes.h"
+#include "system/filesys.h"
+#include "smbd/smbd.h"
+#include "smbd/globals.h"
+#include "source3/smbd/dir.h"
+
+struct smbd_dircache_entry;
+
+struct smbd_dircache {
+	struct smbd_server_connection *sconn;
+	/* most recently used first */
+	struct smbd_dircache_entry *entries;
+	/* entries being filled by a directory scan */
+	struct smbd_dircache_entry *recording;
+	size_t num_names;
+};
+
+/*
+ * The names of a directory. A smb_Dir using them holds a
+ * reference, so they can outlive their cache entry.
+ */
+struct smbd_dircache_list {
+	struct smbd_dircache_entry *entry;
+	unsigned refcount;
+	size_t num_names;
+	char **names;
+};
+
+struct smbd_dircache_entry {
+	struct smbd_dircache_entry *prev, *next;
+	struct smbd_dircache *cache;
+	int snum;
+	struct file_id id;
+	struct timespec mtime;
+	struct timespec ctime;
+	/* registered with notifyd, NULL if not (yet) */
+	char *notify_path;
+	/* still being filled by a directory scan */
+	bool recording;
+	/* a notify arrived during the scan */
+	bool invalid;
+	struct smbd_dircache_list *list;
+};
+
+struct smbd_dircache_ref {
+	struct smbd_dircache_list *list;
+};
+
+static int smbd_dircache_destructor(struct smbd_dircache *cache)
+{
+	struct smbd_dircache_entry *e = NULL;
+
+	/*
+	 * At exit notify_ctx might already be gone, notifyd
+	 * cleans up the registrations of exited processes.
+	 */
+	while (cache->recording != NULL) {
+		e = cache->recording;
+		DLIST_REMOVE(cache->recording, e);
+		e->notify_path = NULL;
+		e->cache = NULL;
+		e->invalid = true;
+	}
+	for (e = cache->entries; e != NULL; e = e->next) {
+		e->notify_path = NULL;
+	}
+	return 0;
+}
+
+static struct smbd_dircache *smbd_dircache_get(
+	struct smbd_server_connection *sconn)
+{
+	struct smbd_dircache *cache = sconn->searches.dircache;
+
+	if (cache != NULL) {
+		return cache;
+	}
+
+	cache = talloc_zero(sconn, struct smbd_dircache);
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->sconn = sconn;
+	talloc_set_destructor(cache, smbd_dircache_destructor);
+
+	sconn->searches.dircache = cache;
+	return cache;
+}
+
+static void smbd_dircache_list_release(struct smbd_dircache_list *list)
+{
+	SMB_ASSERT(list->refcount > 0);
+	list->refcount -= 1;
+
+	if ((list->refcount == 0) && (list->entry == NULL)) {
+		TALLOC_FREE(list);
+	}
+}
+
+static int smbd_dircache_entry_destructor(struct smbd_dircache_entry *e)
+{
+	struct smbd_dircache *cache = e->cache;
+	struct smbd_dircache_list *list = e->list;
+
+	if (cache == NULL) {
+		/* orphaned recording, the list is our child */
+		return 0;
+	}
+
+	if (e->notify_path != NULL) {
+		notify_remove(cache->sconn->notify_ctx, e, e->notify_path);
+	}
+
+	if (e->recording) {
+		DLIST_REMOVE(cache->recording, e);
+	} else {
+		DLIST_REMOVE(cache->entries, e);
+		cache->num_names -= list->num_names;
+	}
+
+	list->entry = NULL;
+	e->list = NULL;
+
+	if (list->refcount > 0) {
+		/*
+		 * Still in use by a directory scan,
+		 * smbd_dircache_list_release() frees it.
+		 */
+		talloc_steal(NULL, list);
+	}
+
+	return 0;
+}
+
+static bool smbd_dircache_dir_times(struct files_struct *dirfsp,
+				    struct timespec *mtime,
+				    struct timespec *ctime)
+{
+	int ret;
+
+	/*
+	 * The stat of the handle might be from the
+	 * open, a while ago.
+	 */
+	ret = SMB_VFS_FSTAT(dirfsp, &dirfsp->fsp_name->st);
+	if (ret == -1) {
+		DBG_DEBUG("SMB_VFS_FSTAT(%s) failed: %s\n",
+			  fsp_str_dbg(dirfsp),
+			  strerror(errno));
+		return false;
+	}
+
+	*mtime = dirfsp->fsp_name->st.st_ex_mtime;
+	*ctime = dirfsp->fsp_name->st.st_ex_ctime;
+	return true;
+}
+
+static int smbd_dircache_ref_destructor(struct smbd_dircache_ref *ref)
+{
+	smbd_dircache_list_release(ref->list);
+	ref->list = NULL;
+	return 0;
+}
+
+static bool smbd_dircache_usable(struct files_struct *dirfsp)
+{
+	if (!lp_smbd_directory_cache(SNUM(dirfsp->conn))) {
+		return false;
+	}
+	if (lp_smbd_directory_cache_size() <= 0) {
+		return false;
+	}
+	if (dirfsp->conn->sconn->notify_ctx == NULL) {
+		return false;
+	}
+	if (dirfsp->fsp_name->twrp != 0) {
+		/* Snapshots may share the file_id */
+		return false;
+	}
+	return true;
+}
+
+struct smbd_dircache_ref *smbd_dircache_lookup(TALLOC_CTX *mem_ctx,
+					       struct files_struct *dirfsp)
+{
+	struct smbd_server_connection *sconn = dirfsp->conn->sconn;
+	struct smbd_dircache *cache = sconn->searches.dircache;
+	struct smbd_dircache_entry *e = NULL;
+	struct smbd_dircache_ref *ref = NULL;
+	struct timespec mtime;
+	struct timespec ctime;
+	bool ok;
+
+	if (cache == NULL) {
+		return NULL;
+	}
+	if (!smbd_dircache_usable(dirfsp)) {
+		return NULL;
+	}
+
+	for (e = cache->entries; e != NULL; e = e->next) {
+		if ((e->snum == SNUM(dirfsp->conn)) &&
+		    file_id_equal(&e->id, &dirfsp->file_id)) {
+			break;
+		}
+	}
+	if (e == NULL) {
+		return NULL;
+	}
+
+	ok = smbd_dircache_dir_times(dirfsp, &mtime, &ctime);
+	if (!ok) {
+		return NULL;
+	}
+
+	if (!timespec_equal(&mtime, &e->mtime) ||
+	    !timespec_equal(&ctime, &e->ctime)) {
+		DBG_DEBUG("%s changed, dropping cache entry\n",
+			  fsp_str_dbg(dirfsp));
+		TALLOC_FREE(e);
+		return NULL;
+	}
+
+	ref = talloc(mem_ctx, struct smbd_dircache_ref);
+	if (ref == NULL) {
+		return NULL;
+	}
+	ref->list = e->list;
+	ref->list->refcount += 1;
+	talloc_set_destructor(ref, smbd_dircache_ref_destructor);
+
+	DLIST_PROMOTE(cache->entries, e);
+
+	DBG_DEBUG("Using %zu cached names for %s\n",
+		  e->list->num_names,
+		  fsp_str_dbg(dirfsp));
+
+	return ref;
+}
+
+const char *smbd_dircache_ref_name(struct smbd_dircache_ref *ref,
+				   size_t idx)
+{
+	struct smbd_dircache_list *list = ref->list;
+
+	if (idx >= list->num_names) {
+		return NULL;
+	}
+	return list->names[idx];
+}
+
+struct smbd_dircache_entry *smbd_dircache_record_start(
+	TALLOC_CTX *mem_ctx,
+	struct files_struct *dirfsp)
+{
+	struct smbd_dircache *cache = NULL;
+	struct smbd_dircache_entry *e = NULL;
+	char *notify_path = NULL;
+	size_t len;
+	NTSTATUS status;
+	bool ok;
+
+	if (!smbd_dircache_usable(dirfsp)) {
+		return NULL;
+	}
+
+	cache = smbd_dircache_get(dirfsp->conn->sconn);
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	e = talloc_zero(mem_ctx, struct smbd_dircache_entry);
+	if (e == NULL) {
+		return NULL;
+	}
+	e->cache = cache;
+	e->snum = SNUM(dirfsp->conn);
+	e->id = dirfsp->file_id;
+
+	e->list = talloc_zero(e, struct smbd_dircache_list);
+	if (e->list == NULL) {
+		TALLOC_FREE(e);
+		return NULL;
+	}
+	e->list->entry = e;
+	e->recording = true;
+
+	/*
+	 * Take the timestamps before the scan,
+	 * a change during the scan invalidates the entry.
+	 */
+	ok = smbd_dircache_dir_times(dirfsp, &e->mtime, &e->ctime);
+	if (!ok) {
+		TALLOC_FREE(e);
+		return NULL;
+	}
+
+	DLIST_ADD(cache->recording, e);
+	talloc_set_destructor(e, smbd_dircache_entry_destructor);
+
+	len = fsp_fullbasepath(dirfsp, NULL, 0);
+	notify_path = talloc_array(e, char, len + 1);
+	if (notify_path == NULL) {
+		TALLOC_FREE(e);
+		return NULL;
+	}
+	fsp_fullbasepath(dirfsp, notify_path, len + 1);
+
+	status = notify_add(cache->sconn->notify_ctx,
+			    notify_path,
+			    FILE_NOTIFY_CHANGE_FILE_NAME |
+			    FILE_NOTIFY_CHANGE_DIR_NAME,
+			    0,
+			    e);
+	if (!NT_STATUS_IS_OK(status)) {
+		DBG_DEBUG("notify_add(%s) failed: %s\n",
+			  notify_path,
+			  nt_errstr(status));
+		TALLOC_FREE(e);
+		return NULL;
+	}
+	e->notify_path = notify_path;
+
+	return e;
+}
+
+void smbd_dircache_record_add(struct smbd_dircache_entry **_e,
+			      const char *name)
+{
+	struct smbd_dircache_entry *e = *_e;
+	struct smbd_dircache_list *list = NULL;
+	size_t max_names = lp_smbd_directory_cache_size();
+	char **tmp = NULL;
+
+	if (e == NULL) {
+		return;
+	}
+	list = e->list;
+
+	if (e->invalid || (list->num_names >= max_names)) {
+		goto fail;
+	}
+
+	if (talloc_array_length(list->names) == list->num_names) {
+		size_t new_size = MAX(list->num_names * 2, 16);
+
+		tmp = talloc_realloc(list, list->names, char *, new_size);
+		if (tmp == NULL) {
+			goto fail;
+		}
+		list->names = tmp;
+	}
+
+	list->names[list->num_names] = talloc_strdup(list->names, name);
+	if (list->names[list->num_names] == NULL) {
+		goto fail;
+	}
+	list->num_names += 1;
+	return;
+
+fail:
+	TALLOC_FREE(*_e);
+}
+
+void smbd_dircache_record_done(struct smbd_dircache_entry **_e)
+{
+	struct smbd_dircache_entry *e = *_e;
+	struct smbd_dircache *cache = NULL;
+	struct smbd_dircache_entry *old = NULL;
+	size_t max_names = lp_smbd_directory_cache_size();
+
+	if (e == NULL) {
+		return;
+	}
+	*_e = NULL;
+	cache = e->cache;
+
+	if ((cache == NULL) || e->invalid) {
+		TALLOC_FREE(e);
+		return;
+	}
+
+	for (old = cache->entries; old != NULL; old = old->next) {
+		if ((old->snum == e->snum) && file_id_equal(&old->id, &e->id)) {
+			TALLOC_FREE(old);
+			break;
+		}
+	}
+
+	DLIST_REMOVE(cache->recording, e);
+	e->recording = false;
+	talloc_steal(cache, e);
+
+	DLIST_ADD(cache->entries, e);
+	cache->num_names += e->list->num_names;
+
+	while (cache->num_names > max_names) {
+		struct smbd_dircache_entry *last = DLIST_TAIL(cache->entries);
+
+		if (last == e) {
+			break;
+		}
+		TALLOC_FREE(last);
+	}
+}
+
+bool smbd_dircache_notify(struct smbd_server_connection *sconn,
+			  const void *private_data)
+{
+	struct smbd_dircache *cache = sconn->searches.dircache;
+	struct smbd_dircache_entry *e = NULL;
+
+	if (cache == NULL) {
+		return false;
+	}
+
+	for (e = cache->recording; e != NULL; e = e->next) {
+		if (e == private_data) {
+			e->invalid = true;
+			return true;
+		}
+	}
+
+	for (e = cache->entries; e != NULL; e = e->next) {
+		if (e == private_data) {
+			DBG_DEBUG("Dropping %s\n", e->notify_path);
+			TALLOC_FREE(e);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void smbd_dircache_flush(struct smbd_server_connection *sconn)
+{
+	struct smbd_dircache *cache = sconn->searches.dircache;
+	struct smbd_dircache_entry *e = NULL;
+
+	if (cache == NULL) {
+		return;
+	}
+
+	/*
+	 * Without the notify registrations we
+	 * could miss changes, start over.
+	 */
+	for (e = cache->recording; e != NULL; e = e->next) {
+		e->invalid = true;
+	}
+	while (cache->entries != NULL) {
+		e = cache->entries;
+		TALLOC_FREE(e);
+	}
+}
@@ -24,6 +24,7 @@
 #include "system/select.h"
 #include "librpc/gen_ndr/smbXsrv.h"
 #include "smbprofile.h"
+#include "libcli/smb/smb2_negotiate_context.h"
 
 #ifdef USE_DMAPI
 struct smbd_dmapi_context;
@@ -445,6 +446,30 @@ struct smbXsrv_connection {
 		struct smbd_smb2_send_queue *send_queue;
 		size_t send_queue_len;
 
+		struct {
+			/*
+			 * SO_ZEROCOPY is enabled on the socket,
+			 * the error queue carries the completion
+			 * notifications.
+			 */
+			bool active;
+			/*
+			 * The kernel told us it copied the data
+			 * anyway, don't use MSG_ZEROCOPY anymore.
+			 */
+			bool copied;
+			/*
+			 * The id the next successful
+			 * sendmsg(MSG_ZEROCOPY) gets.
+			 */
+			uint64_t next_id;
+			/*
+			 * Entries which are completely sent,
+			 * but still referenced by the kernel.
+			 */
+			struct smbd_smb2_send_queue *queue;
+		} zerocopy;
+
 		struct {
 			/*
 			 * seq_low is the lowest sequence number
@@ -510,6 +535,11 @@ struct smbXsrv_connection {
 			uint32_t max_write;
 			uint16_t sign_algo;
 			uint16_t cipher;
+			/*
+			 * The negotiated compression algorithms,
+			 * num_algos is 0 if compression is not used.
+			 */
+			struct smb3_compression_capabilities compression;
 			bool posix_extensions_negotiated;
 		} server;
 
@@ -594,6 +624,24 @@ struct smbd_smb2_send_queue {
 	struct iovec *vector;
 	int count;
 
+	/*
+	 * The vector is still being encrypted by a helper
+	 * thread, this and all following entries have
+	 * to wait.
+	 */
+	bool encryption_pending;
+
+	/*
+	 * Ids of the sendmsg(MSG_ZEROCOPY) calls for
+	 * this entry, the memory can only be freed once
+	 * all of them are completed.
+	 */
+	struct {
+		uint64_t first_id;
+		uint64_t num_ids;
+		uint64_t num_completed;
+	} zerocopy;
+
 	struct {
 		struct tevent_req *req;
 		struct timeval timeout;
@@ -626,6 +674,8 @@ struct smbd_smb2_request {
 	bool was_encrypted;
 	/* Should we encrypt? */
 	bool do_encryption;
+	/* Should we try to compress the response? */
+	bool do_compression;
 	struct tevent_timer *async_te;
 	bool compound_related;
 	NTSTATUS compound_create_err;
@@ -649,6 +699,17 @@ struct smbd_smb2_request {
 	struct smb2_signing_key *last_sign_key;
 	struct smbXsrv_preauth *preauth;
 
+	/*
+	 * A helper thread encrypts the response or
+	 * decrypts the request in our buffers.
+	 */
+	struct tevent_req *crypto_subreq;
+	/*
+	 * The leading SMB2_TRANSFORM header of the request
+	 * was already decrypted by a helper thread.
+	 */
+	bool tf_decrypted;
+
 	struct timeval request_time;
 
 	SMBPROFILE_IOBYTES_ASYNC_STATE_X(profile, profile_x);
@@ -803,6 +864,8 @@ struct smbd_server_connection {
 	struct {
 		struct bitmap *dptr_bmap;
 		struct dptr_struct *dirptrs;
+		/* "smbd directory cache", see dir_cache.c */
+		struct smbd_dircache *dircache;
 	} searches;
 
 	uint64_t num_requests;
@@ -26,6 +26,7 @@
 #include "librpc/gen_ndr/ndr_file_id.h"
 #include "libcli/security/privileges.h"
 #include "libcli/security/security.h"
+#include "source3/smbd/dir.h"
 
 struct notify_change_event {
 	struct timespec when;
@@ -279,6 +280,10 @@ void notify_callback(struct smbd_server_connection *sconn,
 	struct notify_fsp_state state = {
 		.notified_fsp = private_data, .when = when, .e = e
 	};
+
+	if (smbd_dircache_notify(sconn, private_data)) {
+		return;
+	}
 	files_forall(sconn, notify_fsp_cb, &state);
 }
 
@@ -545,6 +550,7 @@ void smbd_notifyd_restarted(struct messaging_context *msg,
 	struct smbd_server_connection *sconn = talloc_get_type_abort(
 		private_data, struct smbd_server_connection);
 
+	smbd_dircache_flush(sconn);
 	TALLOC_FREE(sconn->notify_ctx);
 
 	sconn->notify_ctx = notify_init(sconn, sconn->msg_ctx,
@@ -2558,6 +2558,25 @@ static NTSTATUS delay_for_oplock(files_struct *fsp,
 		goto grant;
 	}
 
+	if ((state.total_lease_types == SMB2_LEASE_NONE) &&
+	    ((requested & SMB2_LEASE_WRITE) == 0)) {
+		/*
+		 * The share mode flags are an upper bound of the
+		 * leases and oplocks held on the file: Nobody has
+		 * one, so there's nothing to break or wait for. As
+		 * we don't ask for write caching, walking the share
+		 * entries would not change what we grant.
+		 *
+		 * This only helps as long as nobody holds a lease
+		 * or oplock on the file, e.g. clients that don't
+		 * use them. Once one is granted, every open walks
+		 * all entries again.
+		 */
+		DBG_DEBUG("No leases on %s, skipping share entries\n",
+			  fsp_str_dbg(fsp));
+		goto grant;
+	}
+
 	if (lp_parm_bool(GLOBAL_SECTION_SNUM,
 			 "smbd lease break",
 			 "debug hung procs",
@@ -218,6 +218,7 @@ NTSTATUS smbd_smb2_request_process_negprot(struct smbd_smb2_request *req)
 	struct smb2_negotiate_context *in_cipher = NULL;
 	struct smb2_negotiate_context *in_sign_algo = NULL;
 	struct smb2_negotiate_context *in_transport_caps = NULL;
+	struct smb2_negotiate_context *in_compression = NULL;
 	struct smb2_negotiate_contexts out_c = { .num_contexts = 0, };
 	const struct smb311_capabilities default_smb3_capabilities =
 		smb311_capabilities_parse(
@@ -225,6 +226,10 @@ NTSTATUS smbd_smb2_request_process_negprot(struct smbd_smb2_request *req)
 			lp_server_smb3_signing_algorithms(),
 			lp_server_smb3_encryption_algorithms(),
 			true);
+	const struct smb3_compression_capabilities default_smb3_compression =
+		smb3_compression_capabilities_parse(
+			"server",
+			lp_server_smb3_compression_algorithms());
 	DATA_BLOB out_negotiate_context_blob = data_blob_null;
 	uint32_t out_negotiate_context_offset = 0;
 	uint16_t out_negotiate_context_count = 0;
@@ -384,6 +389,8 @@ NTSTATUS smbd_smb2_request_process_negprot(struct smbd_smb2_request *req)
 					SMB2_SIGNING_CAPABILITIES);
 	in_transport_caps =  smb2_negotiate_context_find(&in_c,
 					SMB2_TRANSPORT_CAPABILITIES);
+	in_compression = smb2_negotiate_context_find(&in_c,
+					SMB2_COMPRESSION_CAPABILITIES);
 
 	/* negprot_spnego() returns the server guid in the first 16 bytes */
 	negprot_spnego_blob = negprot_spnego(req, xconn);
@@ -720,6 +727,110 @@ NTSTATUS smbd_smb2_request_process_negprot(struct smbd_smb2_request *req)
 		}
 	}
 
+	if (in_compression != NULL &&
+	    default_smb3_compression.num_algos > 0)
+	{
+		struct smb3_compression_capabilities *srv_comp =
+			&xconn->smb2.server.compression;
+		size_t needed = 8;
+		uint16_t comp_count;
+		uint32_t comp_flags;
+		const uint8_t *p;
+		uint8_t buf[8 + 2 * SMB3_COMPRESSION_CAPABILITIES_MAX_ALGOS];
+		size_t si;
+		size_t i;
+
+		if (in_compression->data.length < needed) {
+			return smbd_smb2_request_error(req,
+					NT_STATUS_INVALID_PARAMETER);
+		}
+
+		comp_count = SVAL(in_compression->data.data, 0);
+		comp_flags = IVAL(in_compression->data.data, 4);
+		if (comp_count == 0) {
+			return smbd_smb2_request_error(req,
+					NT_STATUS_INVALID_PARAMETER);
+		}
+
+		p = in_compression->data.data + needed;
+		needed += comp_count * 2;
+
+		if (in_compression->data.length < needed) {
+			return smbd_smb2_request_error(req,
+					NT_STATUS_INVALID_PARAMETER);
+		}
+
+		*srv_comp = (struct smb3_compression_capabilities) {
+			.chained = (comp_flags &
+				    SMB2_COMPRESSION_CAPABILITIES_FLAG_CHAINED),
+		};
+
+		/*
+		 * The server algorithms are listed with the
+		 * lowest idx being preferred, we keep that order.
+		 */
+		for (si = 0; si < default_smb3_compression.num_algos; si++) {
+			uint16_t algo = default_smb3_compression.algos[si];
+
+			if (algo == SMB2_COMPRESSION_PATTERN_V1 &&
+			    !srv_comp->chained)
+			{
+				/* Pattern_V1 is only valid in chains */
+				continue;
+			}
+
+			for (i = 0; i < comp_count; i++) {
+				if (SVAL(p, i * 2) != algo) {
+					continue;
+				}
+
+				srv_comp->algos[srv_comp->num_algos] = algo;
+				srv_comp->num_algos += 1;
+				break;
+			}
+		}
+
+		if (srv_comp->num_algos == 1 &&
+		    srv_comp->algos[0] == SMB2_COMPRESSION_PATTERN_V1)
+		{
+			/*
+			 * Pattern_V1 alone is not useful,
+			 * all other data would be sent uncompressed.
+			 */
+			srv_comp->num_algos = 0;
+		}
+
+		if (srv_comp->num_algos == 0) {
+			srv_comp->chained = false;
+		}
+
+		SSVAL(buf, 2, 0); /* Padding */
+		SIVAL(buf, 4, srv_comp->chained ?
+			      SMB2_COMPRESSION_CAPABILITIES_FLAG_CHAINED :
+			      SMB2_COMPRESSION_CAPABILITIES_FLAG_NONE);
+		if (srv_comp->num_algos == 0) {
+			SSVAL(buf, 0, 1); /* CompressionAlgorithmCount */
+			SSVAL(buf, 8, SMB2_COMPRESSION_NONE);
+			needed = 10;
+		} else {
+			SSVAL(buf, 0, srv_comp->num_algos);
+			for (i = 0; i < srv_comp->num_algos; i++) {
+				SSVAL(buf, 8 + i * 2, srv_comp->algos[i]);
+			}
+			needed = 8 + srv_comp->num_algos * 2;
+		}
+
+		status = smb2_negotiate_context_add(
+			req,
+			&out_c,
+			SMB2_COMPRESSION_CAPABILITIES,
+			buf,
+			needed);
+		if (!NT_STATUS_IS_OK(status)) {
+			return smbd_smb2_request_error(req, status);
+		}
+	}
+
 	status = smb311_capabilities_check(&default_smb3_capabilities,
 					   "smb2srv_negprot",
 					   DBGLVL_NOTICE,
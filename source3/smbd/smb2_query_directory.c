@@ -231,11 +231,23 @@ struct smbd_smb2_query_directory_state {
 	int last_entry_off;
 	size_t max_async_dosmode_active;
 	uint32_t async_dosmode_active;
+	/*
+	 * Stat prefetching: we read ahead up to prefetch_max
+	 * names and stat them in parallel. prefetch_batch is
+	 * the number of names read ahead for the stats still
+	 * running, they are at the end of the readahead list.
+	 */
+	size_t prefetch_max;
+	size_t prefetch_batch;
+	uint32_t prefetch_active;
+	bool prefetch_waiting;
 	bool done;
 };
 
 static bool smb2_query_directory_next_entry(struct tevent_req *req);
 static void smb2_query_directory_dos_mode_done(struct tevent_req *subreq);
+static bool smb2_query_directory_prefetch(struct tevent_req *req);
+static void smb2_query_directory_prefetch_done(struct tevent_req *subreq);
 static void smb2_query_directory_waited(struct tevent_req *subreq);
 
 static struct tevent_req *smbd_smb2_query_directory_send(TALLOC_CTX *mem_ctx,
@@ -485,7 +497,13 @@ static struct tevent_req *smbd_smb2_query_directory_send(TALLOC_CTX *mem_ctx,
 		}
 	}
 
-	if (state->async_dosmode) {
+	if (state->max_count > 1) {
+		int prefetch = lp_smbd_async_stat_prefetch(SNUM(conn));
+
+		state->prefetch_max = MAX(prefetch, 0);
+	}
+
+	if (state->async_dosmode || state->prefetch_max > 0) {
 		/*
 		 * Should we only set async_internal
 		 * if we're not the last request in
@@ -533,6 +551,13 @@ static bool smb2_query_directory_next_entry(struct tevent_req *req)
 
 	SMB_ASSERT(space_remaining >= 0);
 
+	if (state->prefetch_max > 0) {
+		bool wait = smb2_query_directory_prefetch(req);
+		if (wait) {
+			return true;
+		}
+	}
+
 	status = smbd_dirptr_lanman2_entry(state,
 					   state->dirfsp,
 					   state->smbreq->flags2,
@@ -654,6 +679,145 @@ last_entry_done:
 
 static void smb2_query_directory_check_next_entry(struct tevent_req *req);
 
+/*
+ * Returns true if the stats for the next
+ * entries are still running, we continue in
+ * smb2_query_directory_prefetch_done().
+ */
+static bool smb2_query_directory_prefetch(struct tevent_req *req)
+{
+	struct smbd_smb2_query_directory_state *state = tevent_req_data(
+		req, struct smbd_smb2_query_directory_state);
+	struct files_struct *dirfsp = state->dirfsp;
+	struct dptr_struct *dptr = dirfsp->dptr;
+	const char * const *names = NULL;
+	size_t num_names = 0;
+	size_t pending;
+	size_t i;
+
+	pending = dptr_readahead_pending(dptr);
+
+	if (state->prefetch_active == 0 &&
+	    pending <= state->prefetch_max / 2)
+	{
+		/*
+		 * Start the next batch while the
+		 * rest of the current one is used.
+		 */
+		names = dptr_readahead(dptr, state->prefetch_max, &num_names);
+		state->prefetch_batch = num_names;
+	}
+
+	for (i = 0; i < num_names; i++) {
+		struct tevent_req *subreq = NULL;
+		struct smb_filename *smb_fname = NULL;
+
+		if (IS_VETO_PATH(dirfsp->conn, names[i])) {
+			continue;
+		}
+
+		smb_fname = synthetic_smb_fname(state,
+						names[i],
+						NULL,
+						NULL,
+						dirfsp->fsp_name->twrp,
+						dirfsp->fsp_name->flags);
+		if (smb_fname == NULL) {
+			break;
+		}
+
+		subreq = SMB_VFS_FSTATAT_SEND(state,
+					      state->ev,
+					      dirfsp,
+					      smb_fname,
+					      AT_SYMLINK_NOFOLLOW);
+		if (subreq == NULL) {
+			TALLOC_FREE(smb_fname);
+			break;
+		}
+		talloc_steal(subreq, smb_fname);
+
+		if (!tevent_req_is_in_progress(subreq)) {
+			/*
+			 * The VFS stack can't do an async
+			 * fstatat, prefetching would only
+			 * double the work.
+			 */
+			DBG_DEBUG("No async fstatat for %s, "
+				  "disabling prefetch\n",
+				  fsp_str_dbg(dirfsp));
+			TALLOC_FREE(subreq);
+			state->prefetch_max = 0;
+			break;
+		}
+
+		tevent_req_set_callback(subreq,
+					smb2_query_directory_prefetch_done,
+					req);
+		state->prefetch_active++;
+	}
+
+	if (state->prefetch_active == 0) {
+		state->prefetch_batch = 0;
+		return false;
+	}
+
+	pending = dptr_readahead_pending(dptr);
+	if (pending > state->prefetch_batch) {
+		/*
+		 * The next name is from an earlier batch
+		 */
+		return false;
+	}
+
+	state->prefetch_waiting = true;
+	return true;
+}
+
+static void smb2_query_directory_prefetch_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req =
+		tevent_req_callback_data(subreq,
+		struct tevent_req);
+	struct smbd_smb2_query_directory_state *state =
+		tevent_req_data(req,
+		struct smbd_smb2_query_directory_state);
+	struct vfs_aio_state aio_state = { .error = 0, };
+	SMB_STRUCT_STAT sbuf;
+	bool ok;
+
+	/*
+	 * Make sure we run as the user again
+	 */
+	ok = change_to_user_and_service_by_fsp(state->dirfsp);
+	SMB_ASSERT(ok);
+
+	/*
+	 * We only warm the caches of the file system
+	 * for smbd_dirptr_lanman2_entry(), errors
+	 * are found there again. The result is not
+	 * used: it is path based and taken before the
+	 * open, the entry might have been replaced since.
+	 * The fstat after the open is cheap with warm
+	 * caches.
+	 */
+	SMB_VFS_FSTATAT_RECV(subreq, &aio_state, &sbuf);
+	TALLOC_FREE(subreq);
+
+	state->prefetch_active--;
+	if (state->prefetch_active > 0) {
+		return;
+	}
+	state->prefetch_batch = 0;
+
+	if (!state->prefetch_waiting) {
+		return;
+	}
+	state->prefetch_waiting = false;
+
+	smb2_query_directory_check_next_entry(req);
+}
+
 static void smb2_query_directory_dos_mode_done(struct tevent_req *subreq)
 {
 	struct tevent_req *req =
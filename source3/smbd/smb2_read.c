@@ -97,6 +97,25 @@ NTSTATUS smbd_smb2_request_process_read(struct smbd_smb2_request *req)
 		return smbd_smb2_request_error(req, NT_STATUS_FILE_CLOSED);
 	}
 
+	/*
+	 * MS-SMB2 3.3.5.12: compress the response if the share
+	 * asks for it or the client explicitly requested it,
+	 * but only if it's large enough to be worth the effort.
+	 *
+	 * in_length is only an upper bound, the length that was
+	 * really read is checked again in
+	 * smbd_smb2_request_read_done().
+	 */
+	if (xconn->smb2.server.compression.num_algos > 0 &&
+	    !IS_IPC(in_fsp->conn) &&
+	    in_length >= (uint32_t)lp_smb3_compression_threshold(
+				SNUM(in_fsp->conn)) &&
+	    (lp_smb3_compress_data(SNUM(in_fsp->conn)) ||
+	     (in_flags & SMB2_READFLAG_REQUEST_COMPRESSED)))
+	{
+		req->do_compression = true;
+	}
+
 	subreq = smbd_smb2_read_send(req, req->sconn->ev_ctx,
 				     req, in_fsp,
 				     in_flags,
@@ -174,6 +193,17 @@ static void smbd_smb2_request_read_done(struct tevent_req *subreq)
 
 	outdyn = out_data_buffer;
 
+	/*
+	 * A short read (e.g. at EOF) may leave less data than
+	 * is worth compressing.
+	 */
+	if (req->do_compression &&
+	    out_data_buffer.length < (size_t)lp_smb3_compression_threshold(
+				SNUM(req->tcon->compat)))
+	{
+		req->do_compression = false;
+	}
+
 	error = smbd_smb2_request_done(req, outbody, &outdyn);
 	if (!NT_STATUS_IS_OK(error)) {
 		smbd_server_connection_terminate(req->xconn,
@@ -345,6 +375,7 @@ static NTSTATUS schedule_smb2_sendfile_read(struct smbd_smb2_request *smb2req,
 	 * We cannot use sendfile if...
 	 * We were not configured to do so OR
 	 * Signing is active OR
+	 * The response should be compressed OR
 	 * This is a compound SMB2 operation OR
 	 * fsp is a STREAM file OR
 	 * It's not a regular file OR
@@ -357,6 +388,7 @@ static NTSTATUS schedule_smb2_sendfile_read(struct smbd_smb2_request *smb2req,
 	if (!lp__use_sendfile(SNUM(fsp->conn)) ||
 	    smb2req->do_signing ||
 	    smb2req->do_encryption ||
+	    smb2req->do_compression ||
 	    smbd_smb2_is_compound(smb2req) ||
 	    fsp_is_alternate_stream(fsp) ||
 	    (!S_ISREG(fsp->fsp_name->st.st_ex_mode)) ||
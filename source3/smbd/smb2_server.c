@@ -36,6 +36,8 @@
 #include "lib/async_req/async_sock.h"
 #include "auth.h"
 #include "libcli/smb/smbXcli_base.h"
+#include "libcli/smb/smb2_compression.h"
+#include "lib/pthreadpool/pthreadpool_tevent.h"
 #include "source3/lib/substitute.h"
 
 #if defined(LINUX)
@@ -52,6 +54,14 @@
 #include "lib/crypto/gnutls_helpers.h"
 #include <gnutls/gnutls.h>
 #include <gnutls/crypto.h>
+#ifdef HAVE_LINUX_ERRQUEUE_H
+#include <linux/errqueue.h>
+#endif
+
+#if defined(HAVE_LINUX_ERRQUEUE_H) && defined(SO_ZEROCOPY) && \
+    defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define SMBD_SMB2_ZEROCOPY 1
+#endif
 
 #undef DBGC_CLASS
 #define DBGC_CLASS DBGC_SMB2
@@ -61,6 +71,8 @@ static void smbd_smb2_connection_handler(struct tevent_context *ev,
 					 uint16_t flags,
 					 void *private_data);
 static NTSTATUS smbd_smb2_flush_send_queue(struct smbXsrv_connection *xconn);
+static void smbd_smb2_zerocopy_abort(struct smbXsrv_connection *xconn);
+static void smbd_smb2_zerocopy_flush(struct smbXsrv_connection *xconn);
 
 static const struct smbd_smb2_dispatch_table {
 	uint16_t opcode;
@@ -344,6 +356,26 @@ static NTSTATUS smbd_initialize_smb2(struct smbXsrv_connection *xconn,
 	}
 #endif
 
+#ifdef SMBD_SMB2_ZEROCOPY
+	if (lp_smb2_zerocopy_send_threshold() > 0 &&
+	    xconn->transport.type != SMB_TRANSPORT_TYPE_QUIC)
+	{
+		int one = 1;
+
+		rc = setsockopt(xconn->transport.sock,
+				SOL_SOCKET,
+				SO_ZEROCOPY,
+				&one,
+				sizeof(one));
+		if (rc == 0) {
+			xconn->smb2.zerocopy.active = true;
+		} else {
+			DBG_NOTICE("setsockopt(SO_ZEROCOPY) failed: %s\n",
+				   strerror(errno));
+		}
+	}
+#endif /* SMBD_SMB2_ZEROCOPY */
+
 	return NT_STATUS_OK;
 }
 
@@ -376,6 +408,16 @@ static bool smb2_setup_nbt_length(struct iovec *vector, int count)
 
 static int smbd_smb2_request_destructor(struct smbd_smb2_request *req)
 {
+	if (req->crypto_subreq != NULL) {
+		/*
+		 * A helper thread still works on our
+		 * buffers, the completion function
+		 * frees us.
+		 */
+		req->xconn = NULL;
+		return -1;
+	}
+
 	TALLOC_FREE(req->first_enc_key);
 	TALLOC_FREE(req->last_sign_key);
 	return 0;
@@ -546,8 +588,18 @@ static NTSTATUS smbd_smb2_inbuf_parse_compound(struct smbXsrv_connection *xconn,
 			tf_iov[1].iov_base = (void *)hdr;
 			tf_iov[1].iov_len = enc_len;
 
-			status = smb2_signing_decrypt_pdu(s->global->decryption_key,
-							  tf_iov, 2);
+			if (req->tf_decrypted) {
+				/*
+				 * smbd_smb2_request_decrypt_send()
+				 * already did the work.
+				 */
+				req->tf_decrypted = false;
+				status = NT_STATUS_OK;
+			} else {
+				status = smb2_signing_decrypt_pdu(
+					s->global->decryption_key,
+					tf_iov, 2);
+			}
 			if (!NT_STATUS_IS_OK(status)) {
 				TALLOC_FREE(iov_alloc);
 				return status;
@@ -557,6 +609,93 @@ static NTSTATUS smbd_smb2_inbuf_parse_compound(struct smbXsrv_connection *xconn,
 			len = enc_len;
 		}
 
+		if (IVAL(hdr, 0) == SMB2_COMP_TF_MAGIC) {
+			struct smb3_compression_capabilities *c =
+				&xconn->smb2.server.compression;
+			size_t prefix_len = taken;
+			size_t suffix_len = buflen - (taken + len);
+			size_t dec_len = 0;
+			uint8_t *dec_buf = NULL;
+			NTSTATUS status;
+
+			if (c->num_algos == 0) {
+				DBG_NOTICE("Got SMB2_COMPRESSION_TRANSFORM "
+					   "header, but compression was not "
+					   "negotiated\n");
+				goto inval;
+			}
+
+			/*
+			 * The compression transform always covers the
+			 * whole message, or the whole payload of an
+			 * SMB2_TRANSFORM header.
+			 */
+			if (tf != NULL && hdr != tf + tf_len) {
+				goto inval;
+			}
+			if (tf == NULL && taken != 0) {
+				goto inval;
+			}
+
+			status = smb2_compression_original_size(hdr,
+								len,
+								&dec_len);
+			if (!NT_STATUS_IS_OK(status)) {
+				goto inval;
+			}
+
+			/*
+			 * The decompressed message can't be larger
+			 * than a message we would have accepted
+			 * uncompressed.
+			 */
+			if (dec_len < (SMB2_HDR_BODY + 2) ||
+			    dec_len > 0xFFFFFF)
+			{
+				DBG_NOTICE("Invalid decompressed size %zu\n",
+					   dec_len);
+				goto inval;
+			}
+
+			dec_buf = talloc_array(mem_ctx,
+					       uint8_t,
+					       prefix_len + dec_len + suffix_len);
+			if (dec_buf == NULL) {
+				TALLOC_FREE(iov_alloc);
+				return NT_STATUS_NO_MEMORY;
+			}
+
+			memcpy(dec_buf, first_hdr, prefix_len);
+
+			status = smb2_compression_decompress_pdu(
+				c, hdr, len, dec_buf + prefix_len, dec_len);
+			if (!NT_STATUS_IS_OK(status)) {
+				DBG_NOTICE("Failed to decompress message: "
+					   "%s\n",
+					   nt_errstr(status));
+				TALLOC_FREE(dec_buf);
+				TALLOC_FREE(iov_alloc);
+				return status;
+			}
+
+			memcpy(dec_buf + prefix_len + dec_len,
+			       hdr + len,
+			       suffix_len);
+
+			/*
+			 * The already parsed vectors still point
+			 * into the original buffer, which stays
+			 * alive as long as the request.
+			 */
+			first_hdr = dec_buf;
+			buflen = prefix_len + dec_len + suffix_len;
+			hdr = first_hdr + taken;
+			len = dec_len;
+			if (tf != NULL) {
+				verified_buflen = taken + dec_len;
+			}
+		}
+
 		/*
 		 * We need the header plus the body length field
 		 */
@@ -1568,6 +1707,7 @@ void smbXsrv_connection_disconnect_transport(struct smbXsrv_connection *xconn,
 	}
 
 	xconn->transport.status = status;
+	smbd_smb2_zerocopy_abort(xconn);
 	TALLOC_FREE(xconn->transport.fde);
 	if (xconn->transport.sock != -1) {
 		xconn->transport.sock = -1;
@@ -1575,6 +1715,7 @@ void smbXsrv_connection_disconnect_transport(struct smbXsrv_connection *xconn,
 	smbd_smb2_send_queue_ack_fail(&xconn->ack.queue, status);
 	smbd_smb2_send_queue_ack_fail(&xconn->smb2.send_queue, status);
 	xconn->smb2.send_queue_len = 0;
+	smbd_smb2_zerocopy_flush(xconn);
 	DO_PROFILE_INC(disconnect);
 }
 
@@ -2092,6 +2233,240 @@ static void smbd_smb2_request_pending_timer(struct tevent_context *ev,
 					    struct timeval current_time,
 					    void *private_data);
 
+static NTSTATUS smbd_smb2_request_send_processed(
+	struct smbd_smb2_request *req)
+{
+	int idx = req->current_idx;
+	NTSTATUS status;
+
+	status = smb2_send_async_interim_response(req);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+	TALLOC_FREE(req->first_enc_key);
+
+	req->current_idx = 1;
+
+	/*
+	 * Re-arrange the in.vectors to remove what
+	 * we just sent.
+	 */
+	memmove(&req->in.vector[1],
+		&req->in.vector[idx],
+		sizeof(req->in.vector[0])*(req->in.vector_count - idx));
+	req->in.vector_count = 1 + (req->in.vector_count - idx);
+
+	/* Re-arrange the out.vectors to match. */
+	memmove(&req->out.vector[1],
+		&req->out.vector[idx],
+		sizeof(req->out.vector[0])*(req->out.vector_count - idx));
+	req->out.vector_count = 1 + (req->out.vector_count - idx);
+
+	if (req->in.vector_count == 1 + SMBD_SMB2_NUM_IOV_PER_REQ) {
+		uint8_t *outhdr = NULL;
+		uint32_t flags;
+
+		/*
+		 * We only have one remaining request as
+		 * we've processed everything else.
+		 * This is no longer a compound request.
+		 */
+		req->compound_related = false;
+		outhdr = SMBD_SMB2_OUT_HDR_PTR(req);
+		flags = (IVAL(outhdr, SMB2_HDR_FLAGS) & ~SMB2_HDR_FLAG_CHAINED);
+		SIVAL(outhdr, SMB2_HDR_FLAGS, flags);
+	}
+
+	return NT_STATUS_OK;
+}
+
+/*
+ * Copy the requests following the current one into a new
+ * smbd_smb2_request. This is only possible if none of them
+ * is related to the current one.
+ */
+static struct smbd_smb2_request *smbd_smb2_request_copy_remaining(
+	struct smbd_smb2_request *req)
+{
+	struct smbd_smb2_request *nreq = NULL;
+	int first_idx = req->current_idx + SMBD_SMB2_NUM_IOV_PER_REQ;
+	int count = req->in.vector_count - first_idx;
+	struct iovec *iov = NULL;
+	int idx;
+	NTSTATUS status;
+
+	if (count <= 0) {
+		return NULL;
+	}
+
+	if (req->smb1req != NULL) {
+		/* receivefile is only used for single requests */
+		return NULL;
+	}
+
+	for (idx = first_idx;
+	     idx < req->in.vector_count;
+	     idx += SMBD_SMB2_NUM_IOV_PER_REQ)
+	{
+		const uint8_t *inhdr = SMBD_SMB2_IDX_HDR_IOV(req,in,idx)->iov_base;
+		uint32_t flags = IVAL(inhdr, SMB2_HDR_FLAGS);
+
+		if (flags & SMB2_HDR_FLAG_CHAINED) {
+			return NULL;
+		}
+	}
+
+	nreq = smbd_smb2_request_allocate(req->xconn);
+	if (nreq == NULL) {
+		return NULL;
+	}
+	nreq->request_time = req->request_time;
+
+	if ((1 + count) <= ARRAY_SIZE(nreq->in._vector)) {
+		iov = nreq->in._vector;
+	} else {
+		iov = talloc_zero_array(nreq, struct iovec, 1 + count);
+		if (iov == NULL) {
+			TALLOC_FREE(nreq);
+			return NULL;
+		}
+	}
+
+	for (idx = 0; idx < count; idx += SMBD_SMB2_NUM_IOV_PER_REQ) {
+		const struct iovec *src = &req->in.vector[first_idx + idx];
+		struct iovec *dst = &iov[1 + idx];
+		size_t hdr_len = src[SMBD_SMB2_HDR_IOV_OFS].iov_len;
+		size_t body_len = src[SMBD_SMB2_BODY_IOV_OFS].iov_len;
+		size_t dyn_len = src[SMBD_SMB2_DYN_IOV_OFS].iov_len;
+		uint8_t *buf = NULL;
+
+		if (src[SMBD_SMB2_TF_IOV_OFS].iov_len != 0) {
+			/*
+			 * Already decrypted, it just tells
+			 * smbd_smb2_request_dispatch() that
+			 * the request was encrypted.
+			 */
+			buf = talloc_memdup(nreq,
+				src[SMBD_SMB2_TF_IOV_OFS].iov_base,
+				src[SMBD_SMB2_TF_IOV_OFS].iov_len);
+			if (buf == NULL) {
+				TALLOC_FREE(nreq);
+				return NULL;
+			}
+			dst[SMBD_SMB2_TF_IOV_OFS].iov_base = buf;
+			dst[SMBD_SMB2_TF_IOV_OFS].iov_len =
+				src[SMBD_SMB2_TF_IOV_OFS].iov_len;
+		}
+
+		/*
+		 * smbd_smb2_inbuf_parse_compound() gave us
+		 * header, body and dynamic part in one piece.
+		 */
+		buf = talloc_memdup(nreq,
+				    src[SMBD_SMB2_HDR_IOV_OFS].iov_base,
+				    hdr_len + body_len + dyn_len);
+		if (buf == NULL) {
+			TALLOC_FREE(nreq);
+			return NULL;
+		}
+		dst[SMBD_SMB2_HDR_IOV_OFS].iov_base = buf;
+		dst[SMBD_SMB2_HDR_IOV_OFS].iov_len = hdr_len;
+		dst[SMBD_SMB2_BODY_IOV_OFS].iov_base = buf + hdr_len;
+		dst[SMBD_SMB2_BODY_IOV_OFS].iov_len = body_len;
+		dst[SMBD_SMB2_DYN_IOV_OFS].iov_base = buf + hdr_len + body_len;
+		dst[SMBD_SMB2_DYN_IOV_OFS].iov_len = dyn_len;
+	}
+
+	nreq->in.vector = iov;
+	nreq->in.vector_count = 1 + count;
+	nreq->current_idx = 1;
+
+	/*
+	 * The message ids were already checked
+	 * by smbd_smb2_request_validate().
+	 */
+	status = smbd_smb2_request_setup_out(nreq);
+	if (!NT_STATUS_IS_OK(status)) {
+		TALLOC_FREE(nreq);
+		return NULL;
+	}
+
+	return nreq;
+}
+
+/*
+ * The current request of an unrelated compound chain goes
+ * async. [MS-SMB2] 3.3.5.2.7.1 lets us handle the remaining
+ * requests as if they were received separately, so they get
+ * their own smbd_smb2_request and don't wait for the current
+ * one. Each request is replied to individually.
+ */
+static NTSTATUS smbd_smb2_request_split_compound(
+	struct smbd_smb2_request *req)
+{
+	struct smbd_smb2_request *nreq = NULL;
+	struct tevent_immediate *im = NULL;
+	const uint8_t *inhdr = SMBD_SMB2_IN_HDR_PTR(req);
+	uint16_t opcode = SVAL(inhdr, SMB2_HDR_OPCODE);
+	NTSTATUS status;
+
+	if (!lp_smbd_parallel_compound_requests()) {
+		return NT_STATUS_OK;
+	}
+
+	if (opcode < SMB2_OP_CREATE) {
+		/*
+		 * The following requests might need the
+		 * session or tree connect set up here.
+		 */
+		return NT_STATUS_OK;
+	}
+
+	nreq = smbd_smb2_request_copy_remaining(req);
+	if (nreq == NULL) {
+		return NT_STATUS_OK;
+	}
+
+	im = tevent_create_immediate(nreq);
+	if (im == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	if (req->current_idx > 1) {
+		status = smbd_smb2_request_send_processed(req);
+		if (!NT_STATUS_IS_OK(status)) {
+			return status;
+		}
+	}
+
+	req->in.vector_count = req->current_idx + SMBD_SMB2_NUM_IOV_PER_REQ;
+	req->out.vector_count = req->current_idx + SMBD_SMB2_NUM_IOV_PER_REQ;
+
+	if (req->current_idx == 1) {
+		uint8_t *outhdr = SMBD_SMB2_OUT_HDR_PTR(req);
+		uint32_t flags = IVAL(outhdr, SMB2_HDR_FLAGS);
+
+		req->compound_related = false;
+		SIVAL(outhdr, SMB2_HDR_FLAGS, flags & ~SMB2_HDR_FLAG_CHAINED);
+	}
+
+	DBG_DEBUG("mid %" PRIu64 " went async, dispatching %d "
+		  "remaining compound requests separately\n",
+		  BVAL(inhdr, SMB2_HDR_MESSAGE_ID),
+		  (nreq->in.vector_count - 1) / SMBD_SMB2_NUM_IOV_PER_REQ);
+
+	/*
+	 * As in smbd_smb2_request_reply() the remaining
+	 * requests are processed before new incoming ones,
+	 * they may be cancelled by them.
+	 */
+	tevent_schedule_immediate(im,
+				  req->xconn->client->raw_ev_ctx,
+				  smbd_smb2_request_dispatch_immediate,
+				  nreq);
+	return NT_STATUS_OK;
+}
+
 NTSTATUS smbd_smb2_request_pending_queue(struct smbd_smb2_request *req,
 					 struct tevent_req *subreq,
 					 uint32_t defer_time)
@@ -2127,6 +2502,13 @@ NTSTATUS smbd_smb2_request_pending_queue(struct smbd_smb2_request *req,
 		return NT_STATUS_OK;
 	}
 
+	if (req->in.vector_count > req->current_idx + SMBD_SMB2_NUM_IOV_PER_REQ) {
+		status = smbd_smb2_request_split_compound(req);
+		if (!NT_STATUS_IS_OK(status)) {
+			return status;
+		}
+	}
+
 	if (req->async_internal || defer_time == 0) {
 		/*
 		 * An SMB2 request implementation wants to handle the request
@@ -2176,42 +2558,10 @@ NTSTATUS smbd_smb2_request_pending_queue(struct smbd_smb2_request *req,
 		 * interim response containing the
 		 * set of replies already generated.
 		 */
-		int idx = req->current_idx;
-
-		status = smb2_send_async_interim_response(req);
+		status = smbd_smb2_request_send_processed(req);
 		if (!NT_STATUS_IS_OK(status)) {
 			return status;
 		}
-		TALLOC_FREE(req->first_enc_key);
-
-		req->current_idx = 1;
-
-		/*
-		 * Re-arrange the in.vectors to remove what
-		 * we just sent.
-		 */
-		memmove(&req->in.vector[1],
-			&req->in.vector[idx],
-			sizeof(req->in.vector[0])*(req->in.vector_count - idx));
-		req->in.vector_count = 1 + (req->in.vector_count - idx);
-
-		/* Re-arrange the out.vectors to match. */
-		memmove(&req->out.vector[1],
-			&req->out.vector[idx],
-			sizeof(req->out.vector[0])*(req->out.vector_count - idx));
-		req->out.vector_count = 1 + (req->out.vector_count - idx);
-
-		if (req->in.vector_count == 1 + SMBD_SMB2_NUM_IOV_PER_REQ) {
-			/*
-			 * We only have one remaining request as
-			 * we've processed everything else.
-			 * This is no longer a compound request.
-			 */
-			req->compound_related = false;
-			outhdr = SMBD_SMB2_OUT_HDR_PTR(req);
-			flags = (IVAL(outhdr, SMB2_HDR_FLAGS) & ~SMB2_HDR_FLAG_CHAINED);
-			SIVAL(outhdr, SMB2_HDR_FLAGS, flags);
-		}
 	}
 	TALLOC_FREE(req->last_sign_key);
 
@@ -3699,81 +4049,492 @@ static void smbd_smb2_request_reply_update_counts(struct smbd_smb2_request *req)
 	}
 }
 
-static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
+static NTSTATUS smbd_smb2_request_compress(struct smbd_smb2_request *req)
 {
 	struct smbXsrv_connection *xconn = req->xconn;
 	int first_idx = 1;
-	struct iovec *firsttf = SMBD_SMB2_IDX_TF_IOV(req,out,first_idx);
-	struct iovec *outhdr = SMBD_SMB2_OUT_HDR_IOV(req);
-	struct iovec *outdyn = SMBD_SMB2_OUT_DYN_IOV(req);
+	struct iovec *outhdr = SMBD_SMB2_IDX_HDR_IOV(req,out,first_idx);
+	struct iovec *outbody = SMBD_SMB2_IDX_BODY_IOV(req,out,first_idx);
+	struct iovec *outdyn = SMBD_SMB2_IDX_DYN_IOV(req,out,first_idx);
+	DATA_BLOB payload;
+	DATA_BLOB compressed = data_blob_null;
 	NTSTATUS status;
-	bool ok;
-
-	req->subreq = NULL;
-	TALLOC_FREE(req->async_te);
-
-	/* MS-SMB2: 3.3.4.1 Sending Any Outgoing Message */
-	smbd_smb2_request_reply_update_counts(req);
 
-	if (req->do_encryption &&
-	    (firsttf->iov_len == 0) &&
-	    (!smb2_signing_key_valid(req->first_enc_key)) &&
-	    (req->session != NULL) &&
-	    smb2_signing_key_valid(req->session->global->encryption_key))
-	{
-		struct smb2_signing_key *encryption_key =
-			req->session->global->encryption_key;
-		uint8_t *tf;
-		uint64_t session_id = req->session->global->session_wire_id;
-		uint64_t nonce_high;
-		uint64_t nonce_low;
+	if (!req->do_compression) {
+		return NT_STATUS_OK;
+	}
 
-		status = smb2_get_new_nonce(req->session,
-					    &nonce_high,
-					    &nonce_low);
-		if (!NT_STATUS_IS_OK(status)) {
-			return status;
-		}
+	if (xconn->smb2.server.compression.num_algos == 0) {
+		return NT_STATUS_OK;
+	}
 
-		/*
-		 * We need to place the SMB2_TRANSFORM header before the
-		 * first SMB2 header
-		 */
+	/*
+	 * We only compress single responses,
+	 * not compound chains.
+	 */
+	if (req->out.vector_count != 1 + SMBD_SMB2_NUM_IOV_PER_REQ) {
+		return NT_STATUS_OK;
+	}
 
-		/*
-		 * we need to remember the encryption key
-		 * and defer the signing/encryption until
-		 * we are sure that we do not change
-		 * the header again.
-		 */
-		status = smb2_signing_key_copy(req,
-					       encryption_key,
-					       &req->first_enc_key);
-		if (!NT_STATUS_IS_OK(status)) {
-			return status;
-		}
+	/*
+	 * Nothing to compress or the payload
+	 * will be sent via sendfile.
+	 */
+	if (outdyn->iov_base == NULL || outdyn->iov_len == 0) {
+		return NT_STATUS_OK;
+	}
 
-		tf = talloc_zero_array(req, uint8_t,
-				       SMB2_TF_HDR_SIZE);
-		if (tf == NULL) {
-			return NT_STATUS_NO_MEMORY;
-		}
+	/*
+	 * The SMB2 header and the fixed body are kept
+	 * uncompressed, only the payload gets compressed.
+	 */
+	payload = data_blob_const(outdyn->iov_base, outdyn->iov_len);
 
-		SIVAL(tf, SMB2_TF_PROTOCOL_ID, SMB2_TF_MAGIC);
-		SBVAL(tf, SMB2_TF_NONCE+0, nonce_low);
-		SBVAL(tf, SMB2_TF_NONCE+8, nonce_high);
-		SBVAL(tf, SMB2_TF_SESSION_ID, session_id);
+	status = smb2_compression_compress_pdu(req,
+					       &xconn->smb2.server.compression,
+					       outhdr,
+					       2,
+					       &payload,
+					       &compressed);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
 
-		firsttf->iov_base = (void *)tf;
-		firsttf->iov_len = SMB2_TF_HDR_SIZE;
+	if (compressed.length == 0) {
+		DBG_DEBUG("payload of %zu bytes not compressible\n",
+			  payload.length);
+		return NT_STATUS_OK;
 	}
 
-	if ((req->current_idx > SMBD_SMB2_NUM_IOV_PER_REQ) &&
-	    (smb2_signing_key_valid(req->last_sign_key)) &&
-	    (firsttf->iov_len == 0))
-	{
-		int last_idx = req->current_idx - SMBD_SMB2_NUM_IOV_PER_REQ;
-		struct iovec *lasthdr = SMBD_SMB2_IDX_HDR_IOV(req,out,last_idx);
+	DBG_DEBUG("compressed %zu bytes payload into %zu bytes message\n",
+		  payload.length, compressed.length);
+
+	*outhdr = (struct iovec) {
+		.iov_base = (void *)compressed.data,
+		.iov_len = compressed.length,
+	};
+	*outbody = (struct iovec) { .iov_len = 0, };
+	*outdyn = (struct iovec) { .iov_len = 0, };
+
+	return NT_STATUS_OK;
+}
+
+struct smbd_smb2_crypto_state {
+	struct smbd_smb2_request *req;
+	struct smb2_signing_key *key;
+	struct iovec _vector[2];
+	struct iovec *vector;
+	int count;
+	bool encrypt;
+	NTSTATUS status;
+};
+
+/*
+ * Check if a message of len bytes should be encrypted or
+ * decrypted by a helper thread instead of the main thread.
+ * This allows all channels of a multichannel session
+ * to make use of more than one cpu.
+ */
+static bool smbd_smb2_crypto_offload(const struct smb2_signing_key *key,
+				     size_t len)
+{
+	int threshold = lp_server_smb3_encryption_offload_threshold();
+
+	if (threshold <= 0) {
+		return false;
+	}
+
+	if (len < (size_t)threshold) {
+		return false;
+	}
+
+	if (!smb2_signing_key_valid(key)) {
+		return false;
+	}
+
+	switch (key->cipher_algo_id) {
+	case SMB2_ENCRYPTION_AES128_GCM:
+	case SMB2_ENCRYPTION_AES256_GCM:
+		break;
+	default:
+		/*
+		 * The non gnutls_aead_cipher_encryptv2()
+		 * code path uses talloc_tos(), which is
+		 * not available in a helper thread.
+		 */
+		return false;
+	}
+
+	if (CHECK_DEBUGLVL(DBGLVL_INFO)) {
+		/*
+		 * smb2_signing_{en,de}crypt_pdu() log at
+		 * this level, which is not thread safe.
+		 */
+		return false;
+	}
+
+	return true;
+}
+
+static void smbd_smb2_crypto_do(void *private_data)
+{
+	struct smbd_smb2_crypto_state *state = talloc_get_type_abort(
+		private_data, struct smbd_smb2_crypto_state);
+
+	if (state->encrypt) {
+		state->status = smb2_signing_encrypt_pdu(state->key,
+							 state->vector,
+							 state->count);
+	} else {
+		state->status = smb2_signing_decrypt_pdu(state->key,
+							 state->vector,
+							 state->count);
+	}
+}
+
+static NTSTATUS smbd_smb2_crypto_recv(struct tevent_req *subreq,
+				      struct smbd_smb2_crypto_state *state)
+{
+	int ret;
+
+	ret = pthreadpool_tevent_job_recv(subreq);
+	if (ret != 0) {
+		if (ret != EAGAIN) {
+			return map_nt_error_from_unix_common(ret);
+		}
+		/*
+		 * If we get EAGAIN from pthreadpool_tevent_job_recv() this
+		 * means the lower level pthreadpool failed to create a new
+		 * thread. Fallback to sync processing in that case to allow
+		 * some progress for the client.
+		 */
+		smbd_smb2_crypto_do(state);
+	}
+
+	return state->status;
+}
+
+static void smbd_smb2_request_encrypt_done(struct tevent_req *subreq);
+
+/*
+ * Start encrypting the response in a helper thread,
+ * smbd_smb2_flush_with_sendmsg() holds back the
+ * send queue until smbd_smb2_request_encrypt_done()
+ * marks it as ready.
+ */
+static NTSTATUS smbd_smb2_request_encrypt_send(struct smbd_smb2_request *req,
+					       struct iovec *vector,
+					       int count)
+{
+	struct smbXsrv_connection *xconn = req->xconn;
+	struct smbd_smb2_crypto_state *state = NULL;
+	struct tevent_req *subreq = NULL;
+
+	state = talloc_zero(req, struct smbd_smb2_crypto_state);
+	if (state == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+	*state = (struct smbd_smb2_crypto_state) {
+		.req = req,
+		.key = req->first_enc_key,
+		.vector = vector,
+		.count = count,
+		.encrypt = true,
+		.status = NT_STATUS_INTERNAL_ERROR,
+	};
+
+	subreq = pthreadpool_tevent_job_send(state,
+					     xconn->client->raw_ev_ctx,
+					     req->sconn->pool,
+					     smbd_smb2_crypto_do,
+					     state);
+	if (subreq == NULL) {
+		TALLOC_FREE(state);
+		return NT_STATUS_NO_MEMORY;
+	}
+	tevent_req_set_callback(subreq, smbd_smb2_request_encrypt_done, state);
+
+	req->crypto_subreq = subreq;
+	return NT_STATUS_OK;
+}
+
+static void smbd_smb2_request_encrypt_done(struct tevent_req *subreq)
+{
+	struct smbd_smb2_crypto_state *state = tevent_req_callback_data(
+		subreq, struct smbd_smb2_crypto_state);
+	struct smbd_smb2_request *req = state->req;
+	struct smbXsrv_connection *xconn = req->xconn;
+	NTSTATUS status;
+
+	req->crypto_subreq = NULL;
+
+	if (xconn == NULL) {
+		/*
+		 * The connection is gone,
+		 * see smbd_smb2_request_destructor().
+		 */
+		TALLOC_FREE(subreq);
+		talloc_free(req);
+		return;
+	}
+
+	status = smbd_smb2_crypto_recv(subreq, state);
+	TALLOC_FREE(subreq);
+	TALLOC_FREE(state);
+	TALLOC_FREE(req->first_enc_key);
+	if (!NT_STATUS_IS_OK(status)) {
+		smbd_server_connection_terminate(xconn, nt_errstr(status));
+		return;
+	}
+
+	req->queue_entry.encryption_pending = false;
+
+	status = smbd_smb2_flush_send_queue(xconn);
+	if (!NT_STATUS_IS_OK(status)) {
+		smbd_server_connection_terminate(xconn, nt_errstr(status));
+		return;
+	}
+}
+
+static NTSTATUS smbd_smb2_advance_incoming(struct smbXsrv_connection *xconn,
+					   size_t n);
+static void smbd_smb2_request_decrypt_done(struct tevent_req *subreq);
+
+/*
+ * Start decrypting a large incoming SMB2_TRANSFORM message
+ * in a helper thread. Returns NT_STATUS_PENDING if that
+ * happened, we stop reading from the socket until
+ * smbd_smb2_request_decrypt_done() continues the
+ * processing of the request.
+ *
+ * Everything else is left to smbd_smb2_inbuf_parse_compound(),
+ * including the error handling.
+ */
+static NTSTATUS smbd_smb2_request_decrypt_send(struct smbXsrv_connection *xconn,
+					       struct smbd_smb2_request *req,
+					       NTTIME now)
+{
+	struct smbd_smb2_request_read_state *read_state =
+		&xconn->smb2.request_read_state;
+	struct smbd_smb2_crypto_state *state = NULL;
+	struct smbXsrv_session *session = NULL;
+	struct tevent_req *subreq = NULL;
+	uint8_t *tf = read_state->pktbuf;
+	size_t enc_len;
+	uint64_t uid;
+	NTSTATUS status;
+
+	if (req->tf_decrypted || read_state->doing_receivefile) {
+		return NT_STATUS_OK;
+	}
+
+	if (xconn->protocol < PROTOCOL_SMB3_00 ||
+	    xconn->smb2.server.cipher == 0 ||
+	    !xconn->smb2.got_authenticated_session)
+	{
+		return NT_STATUS_OK;
+	}
+
+	if (read_state->pktlen < SMB2_TF_HDR_SIZE) {
+		return NT_STATUS_OK;
+	}
+
+	if (IVAL(tf, 0) != SMB2_TF_MAGIC) {
+		return NT_STATUS_OK;
+	}
+
+	enc_len = IVAL(tf, SMB2_TF_MSG_SIZE);
+	if (read_state->pktlen != SMB2_TF_HDR_SIZE + enc_len) {
+		return NT_STATUS_OK;
+	}
+
+	uid = BVAL(tf, SMB2_TF_SESSION_ID);
+	status = smb2srv_session_lookup_conn(xconn, uid, now, &session);
+	if (!NT_STATUS_IS_OK(status)) {
+		return NT_STATUS_OK;
+	}
+
+	if (!smbd_smb2_crypto_offload(session->global->decryption_key,
+				      enc_len))
+	{
+		return NT_STATUS_OK;
+	}
+
+	state = talloc_zero(req, struct smbd_smb2_crypto_state);
+	if (state == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+	*state = (struct smbd_smb2_crypto_state) {
+		.req = req,
+		._vector = {
+			[0] = (struct iovec) {
+				.iov_base = (void *)tf,
+				.iov_len = SMB2_TF_HDR_SIZE,
+			},
+			[1] = (struct iovec) {
+				.iov_base = (void *)(tf + SMB2_TF_HDR_SIZE),
+				.iov_len = enc_len,
+			},
+		},
+		.count = 2,
+		.encrypt = false,
+		.status = NT_STATUS_INTERNAL_ERROR,
+	};
+	state->vector = state->_vector;
+
+	/*
+	 * The gnutls cipher handle of the session key
+	 * must not be used by more than one thread.
+	 */
+	status = smb2_signing_key_copy(state,
+				       session->global->decryption_key,
+				       &state->key);
+	if (!NT_STATUS_IS_OK(status)) {
+		TALLOC_FREE(state);
+		return status;
+	}
+
+	subreq = pthreadpool_tevent_job_send(state,
+					     xconn->client->raw_ev_ctx,
+					     req->sconn->pool,
+					     smbd_smb2_crypto_do,
+					     state);
+	if (subreq == NULL) {
+		TALLOC_FREE(state);
+		return NT_STATUS_NO_MEMORY;
+	}
+	tevent_req_set_callback(subreq, smbd_smb2_request_decrypt_done, state);
+
+	req->crypto_subreq = subreq;
+	TEVENT_FD_NOT_READABLE(xconn->transport.fde);
+
+	return NT_STATUS_PENDING;
+}
+
+static void smbd_smb2_request_decrypt_done(struct tevent_req *subreq)
+{
+	struct smbd_smb2_crypto_state *state = tevent_req_callback_data(
+		subreq, struct smbd_smb2_crypto_state);
+	struct smbd_smb2_request *req = state->req;
+	struct smbXsrv_connection *xconn = req->xconn;
+	NTSTATUS status;
+
+	req->crypto_subreq = NULL;
+
+	if (xconn == NULL) {
+		/*
+		 * The connection is gone,
+		 * see smbd_smb2_request_destructor().
+		 */
+		TALLOC_FREE(subreq);
+		talloc_free(req);
+		return;
+	}
+
+	status = smbd_smb2_crypto_recv(subreq, state);
+	TALLOC_FREE(subreq);
+	TALLOC_FREE(state);
+	if (!NT_STATUS_IS_OK(status)) {
+		smbd_server_connection_terminate(xconn, nt_errstr(status));
+		return;
+	}
+
+	if (!NT_STATUS_IS_OK(xconn->transport.status)) {
+		/*
+		 * we're not supposed to do any io
+		 */
+		return;
+	}
+
+	/*
+	 * Continue where smbd_smb2_advance_incoming()
+	 * stopped for us, the whole pdu is already
+	 * read from the socket.
+	 */
+	req->tf_decrypted = true;
+
+	status = smbd_smb2_advance_incoming(xconn, 0);
+	if (!NT_STATUS_IS_OK(status)) {
+		smbd_server_connection_terminate(xconn, nt_errstr(status));
+		return;
+	}
+}
+
+static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
+{
+	struct smbXsrv_connection *xconn = req->xconn;
+	int first_idx = 1;
+	struct iovec *firsttf = SMBD_SMB2_IDX_TF_IOV(req,out,first_idx);
+	struct iovec *outhdr = SMBD_SMB2_OUT_HDR_IOV(req);
+	struct iovec *outdyn = SMBD_SMB2_OUT_DYN_IOV(req);
+	NTSTATUS status;
+	bool ok;
+
+	req->subreq = NULL;
+	TALLOC_FREE(req->async_te);
+
+	/* MS-SMB2: 3.3.4.1 Sending Any Outgoing Message */
+	smbd_smb2_request_reply_update_counts(req);
+
+	if (req->do_encryption &&
+	    (firsttf->iov_len == 0) &&
+	    (!smb2_signing_key_valid(req->first_enc_key)) &&
+	    (req->session != NULL) &&
+	    smb2_signing_key_valid(req->session->global->encryption_key))
+	{
+		struct smb2_signing_key *encryption_key =
+			req->session->global->encryption_key;
+		uint8_t *tf;
+		uint64_t session_id = req->session->global->session_wire_id;
+		uint64_t nonce_high;
+		uint64_t nonce_low;
+
+		status = smb2_get_new_nonce(req->session,
+					    &nonce_high,
+					    &nonce_low);
+		if (!NT_STATUS_IS_OK(status)) {
+			return status;
+		}
+
+		/*
+		 * We need to place the SMB2_TRANSFORM header before the
+		 * first SMB2 header
+		 */
+
+		/*
+		 * we need to remember the encryption key
+		 * and defer the signing/encryption until
+		 * we are sure that we do not change
+		 * the header again.
+		 */
+		status = smb2_signing_key_copy(req,
+					       encryption_key,
+					       &req->first_enc_key);
+		if (!NT_STATUS_IS_OK(status)) {
+			return status;
+		}
+
+		tf = talloc_zero_array(req, uint8_t,
+				       SMB2_TF_HDR_SIZE);
+		if (tf == NULL) {
+			return NT_STATUS_NO_MEMORY;
+		}
+
+		SIVAL(tf, SMB2_TF_PROTOCOL_ID, SMB2_TF_MAGIC);
+		SBVAL(tf, SMB2_TF_NONCE+0, nonce_low);
+		SBVAL(tf, SMB2_TF_NONCE+8, nonce_high);
+		SBVAL(tf, SMB2_TF_SESSION_ID, session_id);
+
+		firsttf->iov_base = (void *)tf;
+		firsttf->iov_len = SMB2_TF_HDR_SIZE;
+	}
+
+	if ((req->current_idx > SMBD_SMB2_NUM_IOV_PER_REQ) &&
+	    (smb2_signing_key_valid(req->last_sign_key)) &&
+	    (firsttf->iov_len == 0))
+	{
+		int last_idx = req->current_idx - SMBD_SMB2_NUM_IOV_PER_REQ;
+		struct iovec *lasthdr = SMBD_SMB2_IDX_HDR_IOV(req,out,last_idx);
 
 		/*
 		 * As we are sure the header of the last request in the
@@ -3847,11 +4608,6 @@ static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
 		req->compound_related = false;
 	}
 
-	ok = smb2_setup_nbt_length(req->out.vector, req->out.vector_count);
-	if (!ok) {
-		return NT_STATUS_INVALID_PARAMETER_MIX;
-	}
-
 	/* Set credit for these operations (zero credits if this
 	   is a final reply for an async operation). */
 	smb2_calculate_credits(req, req);
@@ -3859,14 +4615,7 @@ static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
 	/*
 	 * now check if we need to sign the current response
 	 */
-	if (firsttf->iov_len == SMB2_TF_HDR_SIZE) {
-		status = smb2_signing_encrypt_pdu(req->first_enc_key,
-					firsttf,
-					req->out.vector_count - first_idx);
-		if (!NT_STATUS_IS_OK(status)) {
-			return status;
-		}
-	} else if (req->do_signing) {
+	if (firsttf->iov_len != SMB2_TF_HDR_SIZE && req->do_signing) {
 		struct smbXsrv_session *x = req->session;
 		struct smb2_signing_key *signing_key =
 			smbd_smb2_signing_key(x, xconn, NULL);
@@ -3878,7 +4627,47 @@ static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
 			return status;
 		}
 	}
-	TALLOC_FREE(req->first_enc_key);
+
+	/*
+	 * MS-SMB2 3.1.4.4: compression happens after
+	 * signing and before encryption.
+	 */
+	status = smbd_smb2_request_compress(req);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+
+	ok = smb2_setup_nbt_length(req->out.vector, req->out.vector_count);
+	if (!ok) {
+		return NT_STATUS_INVALID_PARAMETER_MIX;
+	}
+
+	if (firsttf->iov_len == SMB2_TF_HDR_SIZE) {
+		int count = req->out.vector_count - first_idx;
+		ssize_t len = iov_buflen(firsttf, count);
+		bool offload = false;
+
+		if (req->preauth == NULL && len != -1) {
+			offload = smbd_smb2_crypto_offload(req->first_enc_key,
+							   len);
+		}
+
+		if (offload) {
+			status = smbd_smb2_request_encrypt_send(req,
+								firsttf,
+								count);
+		} else {
+			status = smb2_signing_encrypt_pdu(req->first_enc_key,
+							  firsttf,
+							  count);
+		}
+		if (!NT_STATUS_IS_OK(status)) {
+			return status;
+		}
+	}
+	if (req->crypto_subreq == NULL) {
+		TALLOC_FREE(req->first_enc_key);
+	}
 
 	if (req->preauth != NULL) {
 		gnutls_hash_hd_t hash_hnd = NULL;
@@ -3946,6 +4735,7 @@ static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
 	req->queue_entry.mem_ctx = req;
 	req->queue_entry.vector = req->out.vector;
 	req->queue_entry.count = req->out.vector_count;
+	req->queue_entry.encryption_pending = (req->crypto_subreq != NULL);
 	DLIST_ADD_END(xconn->smb2.send_queue, &req->queue_entry);
 	xconn->smb2.send_queue_len++;
 
@@ -4868,6 +5658,231 @@ static int socket_error_from_errno(int ret,
 	return sys_errno;
 }
 
+#ifdef SMBD_SMB2_ZEROCOPY
+static bool smbd_smb2_want_zerocopy(struct smbXsrv_connection *xconn,
+				    struct smbd_smb2_send_queue *e)
+{
+	ssize_t len;
+
+	if (!xconn->smb2.zerocopy.active || xconn->smb2.zerocopy.copied) {
+		return false;
+	}
+
+	if (e->ack.req != NULL) {
+		/*
+		 * The memory of entries waiting for
+		 * an ack is not owned by the queue.
+		 */
+		return false;
+	}
+
+	len = iov_buflen(e->vector, e->count);
+	if (len == -1) {
+		return false;
+	}
+
+	return ((size_t)len >= (size_t)lp_smb2_zerocopy_send_threshold());
+}
+
+static void smbd_smb2_zerocopy_account(struct smbd_smb2_send_queue *e,
+				       uint64_t first,
+				       uint64_t last)
+{
+	uint64_t e_first = e->zerocopy.first_id;
+	uint64_t e_last;
+
+	if (e->zerocopy.num_ids == 0) {
+		return;
+	}
+	e_last = e_first + e->zerocopy.num_ids - 1;
+
+	first = MAX(first, e_first);
+	last = MIN(last, e_last);
+	if (first > last) {
+		return;
+	}
+
+	e->zerocopy.num_completed += last - first + 1;
+}
+
+/*
+ * The kernel has released the buffers of the
+ * sendmsg(MSG_ZEROCOPY) calls with the ids lo..hi.
+ */
+static void smbd_smb2_zerocopy_complete(struct smbXsrv_connection *xconn,
+					uint32_t lo,
+					uint32_t hi)
+{
+	struct smbd_smb2_send_queue *e = NULL;
+	struct smbd_smb2_send_queue *n = NULL;
+	uint64_t next_id = xconn->smb2.zerocopy.next_id;
+	uint64_t first;
+	uint64_t last;
+
+	/*
+	 * The kernel only reports the lower 32 bits,
+	 * but all pending ids are close to next_id.
+	 */
+	first = next_id - (uint32_t)((uint32_t)next_id - lo);
+	last = first + (uint32_t)(hi - lo);
+
+	/*
+	 * Only the head of the send queue
+	 * can be partially sent.
+	 */
+	if (xconn->smb2.send_queue != NULL) {
+		smbd_smb2_zerocopy_account(xconn->smb2.send_queue,
+					   first,
+					   last);
+	}
+
+	for (e = xconn->smb2.zerocopy.queue; e != NULL; e = n) {
+		n = e->next;
+
+		smbd_smb2_zerocopy_account(e, first, last);
+		if (e->zerocopy.num_completed < e->zerocopy.num_ids) {
+			continue;
+		}
+
+		DLIST_REMOVE(xconn->smb2.zerocopy.queue, e);
+		talloc_free(e->mem_ctx);
+	}
+}
+
+static NTSTATUS smbd_smb2_zerocopy_drain(struct smbXsrv_connection *xconn)
+{
+	while (true) {
+		uint8_t cbuf[CMSG_SPACE(sizeof(struct sock_extended_err) +
+					sizeof(struct sockaddr_storage))];
+		struct msghdr msg = {
+			.msg_control = cbuf,
+			.msg_controllen = sizeof(cbuf),
+		};
+		struct cmsghdr *cmsg = NULL;
+		int ret;
+
+		ret = recvmsg(xconn->transport.sock,
+			      &msg,
+			      MSG_ERRQUEUE|MSG_DONTWAIT);
+		if (ret == -1) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return NT_STATUS_OK;
+			}
+			if (errno == EINTR) {
+				continue;
+			}
+			return map_nt_error_from_unix_common(errno);
+		}
+
+		for (cmsg = CMSG_FIRSTHDR(&msg);
+		     cmsg != NULL;
+		     cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			const struct sock_extended_err *serr = NULL;
+
+			if (!(cmsg->cmsg_level == IPPROTO_IP &&
+			      cmsg->cmsg_type == IP_RECVERR) &&
+			    !(cmsg->cmsg_level == IPPROTO_IPV6 &&
+			      cmsg->cmsg_type == IPV6_RECVERR))
+			{
+				continue;
+			}
+
+			serr = (const struct sock_extended_err *)
+				(void *)CMSG_DATA(cmsg);
+			if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+				continue;
+			}
+
+			if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+				/*
+				 * E.g. loopback or a nic without
+				 * scatter-gather, the copy is done
+				 * anyway and the notifications are
+				 * just overhead.
+				 */
+				if (!xconn->smb2.zerocopy.copied) {
+					DBG_INFO("kernel copied MSG_ZEROCOPY "
+						 "data, disabling zerocopy\n");
+				}
+				xconn->smb2.zerocopy.copied = true;
+			}
+
+			smbd_smb2_zerocopy_complete(xconn,
+						    serr->ee_info,
+						    serr->ee_data);
+		}
+	}
+}
+#endif /* SMBD_SMB2_ZEROCOPY */
+
+/*
+ * Called before the socket is closed: consume the
+ * pending notifications, the buffers still referenced
+ * after that must not go out on the wire anymore.
+ */
+static void smbd_smb2_zerocopy_abort(struct smbXsrv_connection *xconn)
+{
+#ifdef SMBD_SMB2_ZEROCOPY
+	struct linger abort_linger = {
+		.l_onoff = 1,
+		.l_linger = 0,
+	};
+	NTSTATUS status;
+	int ret;
+
+	if (xconn->smb2.zerocopy.queue == NULL) {
+		return;
+	}
+	if (xconn->transport.sock == -1) {
+		return;
+	}
+
+	status = smbd_smb2_zerocopy_drain(xconn);
+	if (!NT_STATUS_IS_OK(status)) {
+		DBG_DEBUG("smbd_smb2_zerocopy_drain failed: %s\n",
+			  nt_errstr(status));
+	}
+
+	if (xconn->smb2.zerocopy.queue == NULL) {
+		return;
+	}
+
+	/*
+	 * The kernel pins our pages until the peer acked
+	 * the data, but it does not prevent us from
+	 * overwriting them. A lingering close would keep
+	 * sending from them after we freed the buffers,
+	 * so reset the connection, this drops the unsent
+	 * data together with the references to our pages.
+	 */
+	ret = setsockopt(xconn->transport.sock,
+			 SOL_SOCKET,
+			 SO_LINGER,
+			 &abort_linger,
+			 sizeof(abort_linger));
+	if (ret == -1) {
+		DBG_WARNING("setsockopt(SO_LINGER) failed: %s\n",
+			    strerror(errno));
+	}
+#endif /* SMBD_SMB2_ZEROCOPY */
+}
+
+static void smbd_smb2_zerocopy_flush(struct smbXsrv_connection *xconn)
+{
+	struct smbd_smb2_send_queue *e = NULL;
+
+	/*
+	 * Called after the socket is closed, see
+	 * smbd_smb2_zerocopy_abort(), the kernel
+	 * no longer sends from the buffers.
+	 */
+	while ((e = xconn->smb2.zerocopy.queue) != NULL) {
+		DLIST_REMOVE(xconn->smb2.zerocopy.queue, e);
+		talloc_free(e->mem_ctx);
+	}
+}
+
 static NTSTATUS smbd_smb2_advance_send_queue(struct smbXsrv_connection *xconn,
 					     struct smbd_smb2_send_queue **_e,
 					     size_t n)
@@ -4889,6 +5904,16 @@ static NTSTATUS smbd_smb2_advance_send_queue(struct smbXsrv_connection *xconn,
 	xconn->smb2.send_queue_len--;
 	DLIST_REMOVE(xconn->smb2.send_queue, e);
 
+	if (e->zerocopy.num_completed < e->zerocopy.num_ids) {
+		/*
+		 * The kernel still references our buffers,
+		 * smbd_smb2_zerocopy_complete() frees them.
+		 */
+		*_e = NULL;
+		DLIST_ADD_END(xconn->smb2.zerocopy.queue, e);
+		return NT_STATUS_OK;
+	}
+
 	if (e->ack.req == NULL) {
 		*_e = NULL;
 		talloc_free(e->mem_ctx);
@@ -4916,6 +5941,17 @@ static NTSTATUS smbd_smb2_flush_with_sendmsg(struct smbXsrv_connection *xconn)
 	while (xconn->smb2.send_queue != NULL) {
 		struct smbd_smb2_send_queue *e = xconn->smb2.send_queue;
 		unsigned sendmsg_flags = 0;
+		bool zerocopy = false;
+
+		if (e->encryption_pending) {
+			/*
+			 * Responses have to go out in order,
+			 * smbd_smb2_request_encrypt_done()
+			 * flushes the queue again.
+			 */
+			TEVENT_FD_NOT_WRITEABLE(xconn->transport.fde);
+			return NT_STATUS_OK;
+		}
 
 		if (!NT_STATUS_IS_OK(xconn->transport.status)) {
 			/*
@@ -4993,8 +6029,27 @@ static NTSTATUS smbd_smb2_flush_with_sendmsg(struct smbXsrv_connection *xconn)
 #ifdef MSG_DONTWAIT
 		sendmsg_flags |= MSG_DONTWAIT;
 #endif
+#ifdef SMBD_SMB2_ZEROCOPY
+		zerocopy = smbd_smb2_want_zerocopy(xconn, e);
+		if (zerocopy) {
+			sendmsg_flags |= MSG_ZEROCOPY;
+		}
+#endif
 
 		ret = sendmsg(xconn->transport.sock, &e->msg, sendmsg_flags);
+#ifdef SMBD_SMB2_ZEROCOPY
+		if (ret == -1 && errno == ENOBUFS && zerocopy) {
+			/*
+			 * We hit the optmem limit for pending
+			 * notifications, copy this time.
+			 */
+			zerocopy = false;
+			sendmsg_flags &= ~MSG_ZEROCOPY;
+			ret = sendmsg(xconn->transport.sock,
+				      &e->msg,
+				      sendmsg_flags);
+		}
+#endif
 		if (ret == 0) {
 			/* propagate end of file */
 			return NT_STATUS_INTERNAL_ERROR;
@@ -5012,6 +6067,15 @@ static NTSTATUS smbd_smb2_flush_with_sendmsg(struct smbXsrv_connection *xconn)
 			return status;
 		}
 
+		if (zerocopy) {
+			if (e->zerocopy.num_ids == 0) {
+				e->zerocopy.first_id =
+					xconn->smb2.zerocopy.next_id;
+			}
+			e->zerocopy.num_ids += 1;
+			xconn->smb2.zerocopy.next_id += 1;
+		}
+
 		status = smbd_smb2_advance_send_queue(xconn, &e, ret);
 		if (NT_STATUS_EQUAL(status, NT_STATUS_RETRY)) {
 			/* retry later */
@@ -5180,6 +6244,18 @@ got_full:
 	req->request_time = timeval_current();
 	now = timeval_to_nttime(&req->request_time);
 
+	status = smbd_smb2_request_decrypt_send(xconn, req, now);
+	if (NT_STATUS_EQUAL(status, NT_STATUS_PENDING)) {
+		/*
+		 * smbd_smb2_request_decrypt_done()
+		 * will continue.
+		 */
+		return NT_STATUS_OK;
+	}
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+
 	status = smbd_smb2_inbuf_parse_compound(xconn,
 						now,
 						state->pktbuf,
@@ -5262,6 +6338,44 @@ static NTSTATUS smbd_smb2_io_handler(struct smbXsrv_connection *xconn,
 		return NT_STATUS_OK;
 	}
 
+#ifdef SMBD_SMB2_ZEROCOPY
+	if ((fde_flags & TEVENT_FD_ERROR) && xconn->smb2.zerocopy.active) {
+		socklen_t len = sizeof(err);
+
+		/*
+		 * The MSG_ZEROCOPY completion notifications
+		 * on the error queue also cause POLLERR.
+		 * Once they are consumed, we only have a
+		 * real error if SO_ERROR is set. Polling
+		 * again is not reliable, a completion may
+		 * arrive in between and raise POLLERR again,
+		 * we'll just be called again for that.
+		 */
+		status = smbd_smb2_zerocopy_drain(xconn);
+		if (!NT_STATUS_IS_OK(status)) {
+			smbXsrv_connection_disconnect_transport(xconn,
+								status);
+			return status;
+		}
+		err = 0;
+		ret = getsockopt(xconn->transport.sock,
+				 SOL_SOCKET,
+				 SO_ERROR,
+				 &err,
+				 &len);
+		if (ret == -1) {
+			err = errno;
+		}
+		if (err != 0) {
+			status = map_nt_error_from_unix_common(err);
+			smbXsrv_connection_disconnect_transport(xconn,
+								status);
+			return status;
+		}
+		fde_flags &= ~TEVENT_FD_ERROR;
+	}
+#endif /* SMBD_SMB2_ZEROCOPY */
+
 	if (fde_flags & TEVENT_FD_ERROR) {
 		ret = samba_socket_poll_or_sock_error(xconn->transport.sock);
 		if (ret == -1) {
@@ -5289,7 +6403,7 @@ static NTSTATUS smbd_smb2_io_handler(struct smbXsrv_connection *xconn,
 		return NT_STATUS_OK;
 	}
 
-	if (state->req == NULL) {
+	if (state->req == NULL || state->req->crypto_subreq != NULL) {
 		TEVENT_FD_NOT_READABLE(xconn->transport.fde);
 		return NT_STATUS_OK;
 	}
@@ -1761,6 +1761,138 @@ int smb_vfs_call_fstatat(
 	return handle->fns->fstatat_fn(handle, dirfsp, smb_fname, sbuf, flags);
 }
 
+struct smb_vfs_call_fstatat_state {
+	files_struct *dirfsp;
+	int (*recv_fn)(struct tevent_req *req,
+		       struct vfs_aio_state *aio_state,
+		       SMB_STRUCT_STAT *sbuf);
+	int retval;
+	SMB_STRUCT_STAT sbuf;
+	struct vfs_aio_state aio_state;
+};
+
+static void smb_vfs_call_fstatat_done(struct tevent_req *subreq);
+
+struct tevent_req *smb_vfs_call_fstatat_send(
+			TALLOC_CTX *mem_ctx,
+			struct tevent_context *ev,
+			struct vfs_handle_struct *handle,
+			files_struct *dirfsp,
+			const struct smb_filename *smb_fname,
+			int flags)
+{
+	struct tevent_req *req = NULL;
+	struct smb_vfs_call_fstatat_state *state = NULL;
+	struct tevent_req *subreq = NULL;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct smb_vfs_call_fstatat_state);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	smb_vfs_assert_allowed();
+
+	/*
+	 * Modules which only implement the sync fstatat
+	 * may rewrite the path or modify the result,
+	 * so we must not bypass them. If we find
+	 * one before an async implementation, we
+	 * use the sync path.
+	 */
+	while (handle->fns->fstatat_send_fn == NULL) {
+		if (handle->fns->fstatat_fn != NULL) {
+			break;
+		}
+		handle = handle->next;
+	}
+
+	*state = (struct smb_vfs_call_fstatat_state) {
+		.dirfsp = dirfsp,
+		.recv_fn = handle->fns->fstatat_recv_fn,
+	};
+
+	if (handle->fns->fstatat_send_fn == NULL) {
+		struct timespec start_time;
+		struct timespec end_time;
+
+		clock_gettime_mono(&start_time);
+		state->retval = handle->fns->fstatat_fn(handle,
+							dirfsp,
+							smb_fname,
+							&state->sbuf,
+							flags);
+		clock_gettime_mono(&end_time);
+		state->aio_state.duration = nsec_time_diff(&end_time,
+							   &start_time);
+		if (state->retval == -1) {
+			tevent_req_error(req, errno);
+			return tevent_req_post(req, ev);
+		}
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
+
+	subreq = handle->fns->fstatat_send_fn(mem_ctx,
+					      ev,
+					      handle,
+					      dirfsp,
+					      smb_fname,
+					      flags);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_defer_callback(req, ev);
+
+	tevent_req_set_callback(subreq, smb_vfs_call_fstatat_done, req);
+	return req;
+}
+
+static void smb_vfs_call_fstatat_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct smb_vfs_call_fstatat_state *state = tevent_req_data(
+		req, struct smb_vfs_call_fstatat_state);
+	bool ok;
+
+	/*
+	 * Make sure we run as the user again
+	 */
+	ok = change_to_user_and_service_by_fsp(state->dirfsp);
+	SMB_ASSERT(ok);
+
+	state->retval = state->recv_fn(subreq,
+				       &state->aio_state,
+				       &state->sbuf);
+	TALLOC_FREE(subreq);
+	if (state->retval == -1) {
+		tevent_req_error(req, state->aio_state.error);
+		return;
+	}
+
+	tevent_req_done(req);
+}
+
+int smb_vfs_call_fstatat_recv(struct tevent_req *req,
+			      struct vfs_aio_state *aio_state,
+			      SMB_STRUCT_STAT *sbuf)
+{
+	struct smb_vfs_call_fstatat_state *state = tevent_req_data(
+		req, struct smb_vfs_call_fstatat_state);
+
+	if (tevent_req_is_unix_error(req, &aio_state->error)) {
+		tevent_req_received(req);
+		return -1;
+	}
+
+	*aio_state = state->aio_state;
+	*sbuf = state->sbuf;
+
+	tevent_req_received(req);
+	return 0;
+}
+
 uint64_t smb_vfs_call_get_alloc_size(struct vfs_handle_struct *handle,
 				     struct files_struct *fsp,
 				     const SMB_STRUCT_STAT *sbuf)
@@ -0,0 +1,149 @@
+/*
+ * Unix SMB/CIFS implementation.
+ * Compare the in-memory dbwrap backends
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "includes.h"
+#include "system/filesys.h"
+#include "lib/dbwrap/dbwrap.h"
+#include "lib/dbwrap/dbwrap_rbt.h"
+#include "lib/dbwrap/dbwrap_hash.h"
+#include "lib/dbwrap/dbwrap_tdb.h"
+#include "proto.h"
+
+extern int torture_numops;
+
+static void bench_dbwrap_inmem_parser(TDB_DATA key, TDB_DATA data,
+				      void *private_data)
+{
+	size_t *sum = private_data;
+	*sum += data.dsize;
+}
+
+static bool bench_dbwrap_inmem(const char *name, struct db_context *db)
+{
+	struct timeval start;
+	double store_secs, parse_secs, delete_secs;
+	uint8_t value[64] = { 0 };
+	size_t sum = 0;
+	int i;
+	NTSTATUS status;
+
+	start = timeval_current();
+
+	for (i=0; i<torture_numops; i++) {
+		char key[32];
+
+		snprintf(key, sizeof(key), "key-%d", i);
+		status = dbwrap_store(db,
+				      string_tdb_data(key),
+				      make_tdb_data(value, sizeof(value)),
+				      0);
+		if (!NT_STATUS_IS_OK(status)) {
+			d_fprintf(stderr, "%s: dbwrap_store failed: %s\n",
+				  name, nt_errstr(status));
+			return false;
+		}
+	}
+
+	store_secs = timeval_elapsed(&start);
+	start = timeval_current();
+
+	for (i=0; i<torture_numops * 4; i++) {
+		char key[32];
+
+		snprintf(key, sizeof(key), "key-%d",
+			 (int)((i * 7919LL) % torture_numops));
+		status = dbwrap_parse_record(db,
+					     string_tdb_data(key),
+					     bench_dbwrap_inmem_parser,
+					     &sum);
+		if (!NT_STATUS_IS_OK(status)) {
+			d_fprintf(stderr, "%s: dbwrap_parse_record failed: "
+				  "%s\n", name, nt_errstr(status));
+			return false;
+		}
+	}
+
+	parse_secs = timeval_elapsed(&start);
+	start = timeval_current();
+
+	for (i=0; i<torture_numops; i++) {
+		char key[32];
+
+		snprintf(key, sizeof(key), "key-%d", i);
+		status = dbwrap_delete(db, string_tdb_data(key));
+		if (!NT_STATUS_IS_OK(status)) {
+			d_fprintf(stderr, "%s: dbwrap_delete failed: %s\n",
+				  name, nt_errstr(status));
+			return false;
+		}
+	}
+
+	delete_secs = timeval_elapsed(&start);
+
+	printf("%s: %d stores %f, %d parses %f, %d deletes %f seconds\n",
+	       name,
+	       torture_numops, store_secs,
+	       torture_numops * 4, parse_secs,
+	       torture_numops, delete_secs);
+
+	return true;
+}
+
+bool run_bench_dbwrap_inmem(int dummy)
+{
+	struct db_context *db = NULL;
+	bool ok;
+
+	if (torture_numops <= 0) {
+		return false;
+	}
+
+	db = db_open_rbt(talloc_tos());
+	if (db == NULL) {
+		d_fprintf(stderr, "db_open_rbt failed\n");
+		return false;
+	}
+	ok = bench_dbwrap_inmem("rbt", db);
+	TALLOC_FREE(db);
+	if (!ok) {
+		return false;
+	}
+
+	db = db_open_hash(talloc_tos());
+	if (db == NULL) {
+		d_fprintf(stderr, "db_open_hash failed\n");
+		return false;
+	}
+	ok = bench_dbwrap_inmem("hash", db);
+	TALLOC_FREE(db);
+	if (!ok) {
+		return false;
+	}
+
+	db = db_open_tdb(talloc_tos(), "bench_dbwrap_inmem.tdb", 0,
+			 TDB_INTERNAL|TDB_INCOMPATIBLE_HASH, O_RDWR|O_CREAT,
+			 0600, DBWRAP_LOCK_ORDER_NONE, DBWRAP_FLAG_NONE);
+	if (db == NULL) {
+		d_fprintf(stderr, "db_open_tdb failed\n");
+		return false;
+	}
+	ok = bench_dbwrap_inmem("tdb", db);
+	TALLOC_FREE(db);
+
+	return ok;
+}
@@ -166,10 +166,13 @@ bool run_dbwrap_watch2(int dummy);
 bool run_dbwrap_watch3(int dummy);
 bool run_dbwrap_watch4(int dummy);
 bool run_dbwrap_do_locked1(int dummy);
+bool run_dbwrap_parse_records1(int dummy);
 bool run_idmap_tdb_common_test(int dummy);
 bool run_local_dbwrap_ctdb1(int dummy);
+bool run_local_dbwrap_ctdb_parse_records1(int dummy);
 bool run_qpathinfo_bufsize(int dummy);
 bool run_bench_pthreadpool(int dummy);
+bool run_bench_dbwrap_inmem(int dummy);
 bool run_messaging_read1(int dummy);
 bool run_messaging_read2(int dummy);
 bool run_messaging_read3(int dummy);
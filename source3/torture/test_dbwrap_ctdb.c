@@ -25,6 +25,7 @@
 #include "messages.h"
 #include "lib/messages_ctdb.h"
 #include "lib/global_contexts.h"
+#include "lib/util/tevent_ntstatus.h"
 
 bool run_local_dbwrap_ctdb1(int dummy)
 {
@@ -161,3 +162,203 @@ fail:
 	TALLOC_FREE(db);
 	return ret;
 }
+
+#define CTDB_PARSE_RECORDS1_NUM_KEYS 30
+
+struct ctdb_parse_records1_key {
+	uint32_t pid;
+	uint32_t idx;
+};
+
+struct ctdb_parse_records1_state {
+	struct ctdb_parse_records1_key keys[CTDB_PARSE_RECORDS1_NUM_KEYS];
+	unsigned seen[CTDB_PARSE_RECORDS1_NUM_KEYS];
+	bool ok;
+};
+
+static void ctdb_parse_records1_parser(size_t idx, TDB_DATA key,
+				       TDB_DATA data, void *private_data)
+{
+	struct ctdb_parse_records1_state *state = private_data;
+	uint32_t val;
+
+	if ((idx >= CTDB_PARSE_RECORDS1_NUM_KEYS) ||
+	    (key.dsize != sizeof(state->keys[idx])) ||
+	    (memcmp(key.dptr, &state->keys[idx], key.dsize) != 0) ||
+	    (data.dsize != sizeof(uint32_t))) {
+		state->ok = false;
+		return;
+	}
+	memcpy(&val, data.dptr, sizeof(val));
+	if (val != idx * 3) {
+		state->ok = false;
+		return;
+	}
+	state->seen[idx] += 1;
+}
+
+static struct db_context *ctdb_parse_records1_open(void)
+{
+	struct db_context *db = NULL;
+
+	db = db_open_ctdb(talloc_tos(),
+			  global_messaging_context(),
+			  "torture_parse_records.tdb",
+			  0,
+			  TDB_DEFAULT,
+			  O_RDWR|O_CREAT,
+			  0755,
+			  DBWRAP_LOCK_ORDER_1,
+			  DBWRAP_FLAG_NONE);
+	if (db == NULL) {
+		perror("db_open_ctdb failed");
+	}
+	return db;
+}
+
+static bool ctdb_parse_records1_store(struct db_context *db,
+				      struct ctdb_parse_records1_state *state,
+				      size_t i)
+{
+	uint32_t val = i * 3;
+	NTSTATUS status;
+
+	status = dbwrap_store(
+		db,
+		make_tdb_data((uint8_t *)&state->keys[i],
+			      sizeof(state->keys[i])),
+		make_tdb_data((uint8_t *)&val, sizeof(val)),
+		0);
+	if (!NT_STATUS_IS_OK(status)) {
+		fprintf(stderr, "dbwrap_store failed: %s\n",
+			nt_errstr(status));
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Exercise dbwrap_parse_records over ctdb: Keys with i%3==0 are
+ * stored through another node, so this node has to fetch them via the
+ * batched ctdbd_parse_many path. Keys with i%3==1 are stored locally
+ * and must be served from the local copy. Keys with i%3==2 do not
+ * exist, they also go to ctdbd and must not reach the parser.
+ */
+
+bool run_local_dbwrap_ctdb_parse_records1(int dummy)
+{
+	struct ctdb_parse_records1_state state = { .ok = true };
+	TDB_DATA keys[CTDB_PARSE_RECORDS1_NUM_KEYS];
+	struct db_context *db = NULL;
+	struct tevent_req *req = NULL;
+	const char *other_node = getenv("CTDB_SOCKET_NODE1");
+	pid_t child, waited;
+	int wstatus;
+	NTSTATUS status;
+	bool ret = false;
+	size_t i;
+
+	for (i=0; i<CTDB_PARSE_RECORDS1_NUM_KEYS; i++) {
+		state.keys[i] = (struct ctdb_parse_records1_key) {
+			.pid = getpid(), .idx = i,
+		};
+		keys[i] = make_tdb_data((uint8_t *)&state.keys[i],
+					sizeof(state.keys[i]));
+	}
+
+	if (other_node == NULL) {
+		fprintf(stderr, "CTDB_SOCKET_NODE1 not set, storing all "
+			"records locally\n");
+	} else {
+		/*
+		 * The child connects to the other node before anyone
+		 * in this process has set up messaging.
+		 */
+		child = fork();
+		if (child == -1) {
+			fprintf(stderr, "fork failed: %s\n", strerror(errno));
+			return false;
+		}
+		if (child == 0) {
+			lp_do_parameter(-1, "ctdbd socket", other_node);
+			db = ctdb_parse_records1_open();
+			if (db == NULL) {
+				_exit(1);
+			}
+			for (i=0; i<CTDB_PARSE_RECORDS1_NUM_KEYS; i+=3) {
+				if (!ctdb_parse_records1_store(db, &state, i)) {
+					_exit(2);
+				}
+			}
+			TALLOC_FREE(db);
+			_exit(0);
+		}
+
+		waited = waitpid(child, &wstatus, 0);
+		if (waited == -1) {
+			fprintf(stderr, "waitpid failed: %s\n",
+				strerror(errno));
+			return false;
+		}
+		if (!WIFEXITED(wstatus) || (WEXITSTATUS(wstatus) != 0)) {
+			fprintf(stderr, "child failed\n");
+			return false;
+		}
+	}
+
+	db = ctdb_parse_records1_open();
+	if (db == NULL) {
+		return false;
+	}
+
+	for (i=0; i<CTDB_PARSE_RECORDS1_NUM_KEYS; i++) {
+		if ((i % 3 == 2) || ((i % 3 == 0) && (other_node != NULL))) {
+			continue;
+		}
+		if (!ctdb_parse_records1_store(db, &state, i)) {
+			goto fail;
+		}
+	}
+
+	req = dbwrap_parse_records_send(talloc_tos(),
+					global_event_context(),
+					db,
+					keys,
+					CTDB_PARSE_RECORDS1_NUM_KEYS,
+					ctdb_parse_records1_parser,
+					&state);
+	if (req == NULL) {
+		fprintf(stderr, "dbwrap_parse_records_send failed\n");
+		goto fail;
+	}
+	if (!tevent_req_poll_ntstatus(req, global_event_context(), &status)) {
+		fprintf(stderr, "tevent_req_poll_ntstatus failed: %s\n",
+			nt_errstr(status));
+		goto fail;
+	}
+	status = dbwrap_parse_records_recv(req);
+	TALLOC_FREE(req);
+	if (!NT_STATUS_IS_OK(status)) {
+		fprintf(stderr, "dbwrap_parse_records_recv failed: %s\n",
+			nt_errstr(status));
+		goto fail;
+	}
+
+	if (!state.ok) {
+		fprintf(stderr, "parser got unexpected data\n");
+		goto fail;
+	}
+	for (i=0; i<CTDB_PARSE_RECORDS1_NUM_KEYS; i++) {
+		unsigned expected = (i % 3 == 2) ? 0 : 1;
+		if (state.seen[i] != expected) {
+			fprintf(stderr, "key %zu parsed %u times, "
+				"expected %u\n", i, state.seen[i], expected);
+			goto fail;
+		}
+	}
+
+	ret = true;
+fail:
+	TALLOC_FREE(db);
+	return ret;
+}
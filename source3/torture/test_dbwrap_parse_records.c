@@ -0,0 +1,165 @@
+/*
+ * Unix SMB/CIFS implementation.
+ * Test dbwrap_parse_records API
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "includes.h"
+#include "torture/proto.h"
+#include "system/filesys.h"
+#include "lib/dbwrap/dbwrap.h"
+#include "lib/dbwrap/dbwrap_open.h"
+#include "lib/dbwrap/dbwrap_watch.h"
+#include "lib/util/tevent_ntstatus.h"
+#include "lib/global_contexts.h"
+
+#define PARSE_RECORDS1_NUM_KEYS 20
+
+struct parse_records1_state {
+	uint32_t vals[PARSE_RECORDS1_NUM_KEYS];
+	unsigned seen[PARSE_RECORDS1_NUM_KEYS];
+	bool ok;
+};
+
+static void parse_records1_parser(size_t idx, TDB_DATA key, TDB_DATA data,
+				  void *private_data)
+{
+	struct parse_records1_state *state = private_data;
+	uint32_t val;
+
+	if ((idx >= PARSE_RECORDS1_NUM_KEYS) ||
+	    (key.dsize != sizeof(uint32_t)) ||
+	    (data.dsize != sizeof(uint32_t))) {
+		state->ok = false;
+		return;
+	}
+	memcpy(&val, data.dptr, sizeof(val));
+	if (val != state->vals[idx] * 3) {
+		state->ok = false;
+		return;
+	}
+	state->seen[idx] += 1;
+}
+
+bool run_dbwrap_parse_records1(int dummy)
+{
+	struct tevent_context *ev;
+	struct messaging_context *msg;
+	struct db_context *backend;
+	struct db_context *db;
+	struct tevent_req *req;
+	const char *dbname = "test_parse_records.tdb";
+	struct parse_records1_state state = { .ok = true };
+	TDB_DATA keys[PARSE_RECORDS1_NUM_KEYS];
+	bool ret = false;
+	NTSTATUS status;
+	size_t i;
+
+	ev = global_event_context();
+	if (ev == NULL) {
+		fprintf(stderr, "global_event_context() failed\n");
+		return false;
+	}
+	msg = global_messaging_context();
+	if (msg == NULL) {
+		fprintf(stderr, "global_messaging_context() failed\n");
+		return false;
+	}
+
+	backend = db_open(talloc_tos(), dbname, 0,
+			  TDB_CLEAR_IF_FIRST, O_CREAT|O_RDWR, 0644,
+			  DBWRAP_LOCK_ORDER_1, DBWRAP_FLAG_NONE);
+	if (backend == NULL) {
+		fprintf(stderr, "db_open failed: %s\n", strerror(errno));
+		return false;
+	}
+
+	db = db_open_watched(talloc_tos(), &backend, msg);
+	if (db == NULL) {
+		fprintf(stderr, "db_open_watched failed: %s\n",
+			strerror(errno));
+		return false;
+	}
+
+	/*
+	 * Only store the even keys, the odd ones must not be parsed
+	 */
+	for (i=0; i<PARSE_RECORDS1_NUM_KEYS; i++) {
+		uint32_t val;
+
+		state.vals[i] = i;
+		keys[i] = make_tdb_data((uint8_t *)&state.vals[i],
+					sizeof(state.vals[i]));
+
+		if (i % 2 != 0) {
+			continue;
+		}
+
+		val = i * 3;
+		status = dbwrap_store(db,
+				      keys[i],
+				      make_tdb_data((uint8_t *)&val,
+						    sizeof(val)),
+				      0);
+		if (!NT_STATUS_IS_OK(status)) {
+			fprintf(stderr, "dbwrap_store failed: %s\n",
+				nt_errstr(status));
+			goto fail;
+		}
+	}
+
+	req = dbwrap_parse_records_send(talloc_tos(),
+					ev,
+					db,
+					keys,
+					PARSE_RECORDS1_NUM_KEYS,
+					parse_records1_parser,
+					&state);
+	if (req == NULL) {
+		fprintf(stderr, "dbwrap_parse_records_send failed\n");
+		goto fail;
+	}
+	if (!tevent_req_poll_ntstatus(req, ev, &status)) {
+		fprintf(stderr, "tevent_req_poll_ntstatus failed: %s\n",
+			nt_errstr(status));
+		goto fail;
+	}
+	status = dbwrap_parse_records_recv(req);
+	TALLOC_FREE(req);
+	if (!NT_STATUS_IS_OK(status)) {
+		fprintf(stderr, "dbwrap_parse_records_recv failed: %s\n",
+			nt_errstr(status));
+		goto fail;
+	}
+
+	if (!state.ok) {
+		fprintf(stderr, "parser got unexpected data\n");
+		goto fail;
+	}
+	for (i=0; i<PARSE_RECORDS1_NUM_KEYS; i++) {
+		unsigned expected = (i % 2 == 0) ? 1 : 0;
+		if (state.seen[i] != expected) {
+			fprintf(stderr, "key %zu parsed %u times, "
+				"expected %u\n", i, state.seen[i], expected);
+			goto fail;
+		}
+	}
+
+	ret = true;
+fail:
+	TALLOC_FREE(db);
+	unlink(dbname);
+	return ret;
+}
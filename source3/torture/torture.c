@@ -34,6 +34,7 @@
 #include "dbwrap/dbwrap.h"
 #include "dbwrap/dbwrap_open.h"
 #include "dbwrap/dbwrap_rbt.h"
+#include "dbwrap/dbwrap_hash.h"
 #include "async_smb.h"
 #include "source3/include/client.h"
 #include "source3/libsmb/proto.h"
@@ -13773,22 +13774,14 @@ static int local_rbtree_traverse_delete(struct db_record *rec, void *private_dat
 	return 0;
 }
 
-static bool run_local_rbtree(int dummy)
+static bool local_inmem_db_test(struct db_context *db)
 {
-	struct db_context *db;
 	bool ret = false;
 	int i;
 	NTSTATUS status;
 	int count = 0;
 	int count2 = 0;
 
-	db = db_open_rbt(NULL);
-
-	if (db == NULL) {
-		d_fprintf(stderr, "db_open_rbt failed\n");
-		return false;
-	}
-
 	if (!rbt_testflags(db, "firstkey", "firstval")) {
 		goto done;
 	}
@@ -13839,6 +13832,34 @@ static bool run_local_rbtree(int dummy)
 	return ret;
 }
 
+static bool run_local_rbtree(int dummy)
+{
+	struct db_context *db;
+
+	db = db_open_rbt(NULL);
+
+	if (db == NULL) {
+		d_fprintf(stderr, "db_open_rbt failed\n");
+		return false;
+	}
+
+	return local_inmem_db_test(db);
+}
+
+static bool run_local_dbwrap_hash(int dummy)
+{
+	struct db_context *db;
+
+	db = db_open_hash(NULL);
+
+	if (db == NULL) {
+		d_fprintf(stderr, "db_open_hash failed\n");
+		return false;
+	}
+
+	return local_inmem_db_test(db);
+}
+
 
 /*
   local test for character set functions
@@ -16265,6 +16286,10 @@ static struct {
 		.name  = "LOCAL-DBWRAP-DO-LOCKED1",
 		.fn    = run_dbwrap_do_locked1,
 	},
+	{
+		.name  = "LOCAL-DBWRAP-PARSE-RECORDS1",
+		.fn    = run_dbwrap_parse_records1,
+	},
 	{
 		.name  = "LOCAL-MESSAGING-READ1",
 		.fn    = run_messaging_read1,
@@ -16309,6 +16334,10 @@ static struct {
 		.name  = "LOCAL-RBTREE",
 		.fn    = run_local_rbtree,
 	},
+	{
+		.name  = "LOCAL-DBWRAP-HASH",
+		.fn    = run_local_dbwrap_hash,
+	},
 	{
 		.name  = "LOCAL-MEMCACHE",
 		.fn    = run_local_memcache,
@@ -16381,10 +16410,18 @@ static struct {
 		.name  = "LOCAL-DBWRAP-CTDB1",
 		.fn    = run_local_dbwrap_ctdb1,
 	},
+	{
+		.name  = "LOCAL-DBWRAP-CTDB-PARSE-RECORDS1",
+		.fn    = run_local_dbwrap_ctdb_parse_records1,
+	},
 	{
 		.name  = "LOCAL-BENCH-PTHREADPOOL",
 		.fn    = run_bench_pthreadpool,
 	},
+	{
+		.name  = "LOCAL-BENCH-DBWRAP-INMEM",
+		.fn    = run_bench_dbwrap_inmem,
+	},
 	{
 		.name  = "LOCAL-PTHREADPOOL-TEVENT",
 		.fn    = run_pthreadpool_tevent,
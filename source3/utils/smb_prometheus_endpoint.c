@@ -34,6 +34,8 @@ struct export_state {
 	bool sent_help_smb2_request_outbytes : 1;
 	bool sent_help_smb2_request_hist : 1;
 	bool sent_help_smb2_request_failed : 1;
+	bool sent_help_smb2_request_latency : 1;
+	bool sent_help_vfs_latency : 1;
 };
 
 static void export_count(const char *name,
@@ -249,6 +251,116 @@ static void export_iobytes_buckets(const char *svc,
 	}
 }
 
+static void export_hist(const char *metric,
+			const char *svc,
+			const char *operation,
+			const struct smbprofile_stats_hist *hist,
+			uint64_t sum,
+			struct export_state *state)
+{
+	uint64_t cumulative = 0;
+	size_t i;
+
+	for (i = 0; i < SMBPROFILE_HIST_BUCKETS - 1; i++) {
+		cumulative += hist->buckets[i];
+		/*
+		 * smbprofile_hist_limit() is exclusive,
+		 * Prometheus wants the inclusive bound.
+		 */
+		evbuffer_add_printf(state->buf,
+				    "%s_bucket "
+				    "{share=\"%s\",operation=\"%s\","
+				    "le=\"%" PRIu64 "\"} "
+				    "%" PRIu64 "\n",
+				    metric,
+				    svc,
+				    operation,
+				    smbprofile_hist_limit(i) - 1,
+				    cumulative);
+	}
+	cumulative += hist->buckets[SMBPROFILE_HIST_BUCKETS - 1];
+	evbuffer_add_printf(state->buf,
+			    "%s_bucket "
+			    "{share=\"%s\",operation=\"%s\",le=\"+Inf\"} "
+			    "%" PRIu64 "\n",
+			    metric,
+			    svc,
+			    operation,
+			    cumulative);
+	evbuffer_add_printf(state->buf,
+			    "%s_sum {share=\"%s\",operation=\"%s\"} "
+			    "%" PRIu64 "\n",
+			    metric,
+			    svc,
+			    operation,
+			    sum);
+	evbuffer_add_printf(state->buf,
+			    "%s_count {share=\"%s\",operation=\"%s\"} "
+			    "%" PRIu64 "\n",
+			    metric,
+			    svc,
+			    operation,
+			    cumulative);
+}
+
+static void export_iobytes_latency(const char *svc,
+				   const char *name,
+				   const struct smbprofile_stats_iobytes *val,
+				   struct export_state *state)
+{
+	bool is_smb2;
+
+	is_smb2 = (strncmp(name, "smb2_", 5) == 0);
+	if (is_smb2) {
+		if (!state->sent_help_smb2_request_latency) {
+			evbuffer_add_printf(
+				state->buf,
+				"# HELP smb_smb2_request_latency_microseconds "
+				"Log-linear histogram of latencies for SMB2 "
+				"requests\n"
+				"# TYPE smb_smb2_request_latency_microseconds "
+				"histogram\n");
+			state->sent_help_smb2_request_latency = true;
+		}
+
+		export_hist("smb_smb2_request_latency_microseconds",
+			    svc,
+			    name + 5,
+			    &val->hist,
+			    val->time,
+			    state);
+	}
+}
+
+static void export_bytes_latency(const char *svc,
+				 const char *name,
+				 const struct smbprofile_stats_bytes *val,
+				 struct export_state *state)
+{
+	bool is_syscall;
+
+	is_syscall = (strncmp(name, "syscall_", 8) == 0);
+	if (is_syscall) {
+		if (!state->sent_help_vfs_latency) {
+			evbuffer_add_printf(
+				state->buf,
+				"# HELP smb_vfs_latency_microseconds "
+				"Log-linear histogram of latencies for VFS "
+				"operations\n"
+				"# TYPE smb_vfs_latency_microseconds "
+				"histogram\n");
+			state->sent_help_vfs_latency = true;
+		}
+
+		export_hist("smb_vfs_latency_microseconds",
+			    svc,
+			    name + 8,
+			    &val->hist,
+			    val->time,
+			    state);
+	}
+}
+
 static void export_iobytes_failed(const char *svc,
 				  const char *name,
 				  const struct smbprofile_stats_iobytes *val,
@@ -412,6 +524,58 @@ static void export_profile_stats(const struct profile_stats *stats,
 #undef SMBPROFILE_STATS_IOBYTES
 #undef SMBPROFILE_STATS_SECTION_END
 #undef SMBPROFILE_STATS_END
+
+#define SMBPROFILE_STATS_START
+#define SMBPROFILE_STATS_SECTION_START(name, display)
+#define SMBPROFILE_STATS_COUNT(name)
+#define SMBPROFILE_STATS_TIME(name)
+#define SMBPROFILE_STATS_BASIC(name)
+#define SMBPROFILE_STATS_BYTES(name)
+#define SMBPROFILE_STATS_IOBYTES(name)                              \
+	do {                                                        \
+		export_iobytes_latency("",                          \
+				       #name,                       \
+				       &stats->values.name##_stats, \
+				       state);                      \
+	} while (0);
+#define SMBPROFILE_STATS_SECTION_END
+#define SMBPROFILE_STATS_END
+	SMBPROFILE_STATS_ALL_SECTIONS
+#undef SMBPROFILE_STATS_START
+#undef SMBPROFILE_STATS_SECTION_START
+#undef SMBPROFILE_STATS_COUNT
+#undef SMBPROFILE_STATS_TIME
+#undef SMBPROFILE_STATS_BASIC
+#undef SMBPROFILE_STATS_BYTES
+#undef SMBPROFILE_STATS_IOBYTES
+#undef SMBPROFILE_STATS_SECTION_END
+#undef SMBPROFILE_STATS_END
+
+#define SMBPROFILE_STATS_START
+#define SMBPROFILE_STATS_SECTION_START(name, display)
+#define SMBPROFILE_STATS_COUNT(name)
+#define SMBPROFILE_STATS_TIME(name)
+#define SMBPROFILE_STATS_BASIC(name)
+#define SMBPROFILE_STATS_BYTES(name)                              \
+	do {                                                      \
+		export_bytes_latency("",                          \
+				     #name,                       \
+				     &stats->values.name##_stats, \
+				     state);                      \
+	} while (0);
+#define SMBPROFILE_STATS_IOBYTES(name)
+#define SMBPROFILE_STATS_SECTION_END
+#define SMBPROFILE_STATS_END
+	SMBPROFILE_STATS_ALL_SECTIONS
+#undef SMBPROFILE_STATS_START
+#undef SMBPROFILE_STATS_SECTION_START
+#undef SMBPROFILE_STATS_COUNT
+#undef SMBPROFILE_STATS_TIME
+#undef SMBPROFILE_STATS_BASIC
+#undef SMBPROFILE_STATS_BYTES
+#undef SMBPROFILE_STATS_IOBYTES
+#undef SMBPROFILE_STATS_SECTION_END
+#undef SMBPROFILE_STATS_END
 }
 
 static void export_profile_persvc_stats(const struct profile_stats *stats,
@@ -542,6 +706,58 @@ static void export_profile_persvc_stats(const struct profile_stats *stats,
 #undef SMBPROFILE_STATS_IOBYTES
 #undef SMBPROFILE_STATS_SECTION_END
 #undef SMBPROFILE_STATS_END
+
+#define SMBPROFILE_STATS_START
+#define SMBPROFILE_STATS_SECTION_START(name, display)
+#define SMBPROFILE_STATS_COUNT(name)
+#define SMBPROFILE_STATS_TIME(name)
+#define SMBPROFILE_STATS_BASIC(name)
+#define SMBPROFILE_STATS_BYTES(name)
+#define SMBPROFILE_STATS_IOBYTES(name)                              \
+	do {                                                        \
+		export_iobytes_latency(svc,                         \
+				       #name,                       \
+				       &stats->values.name##_stats, \
+				       state);                      \
+	} while (0);
+#define SMBPROFILE_STATS_SECTION_END
+#define SMBPROFILE_STATS_END
+	SMBPROFILE_STATS_PERSVC_SECTIONS
+#undef SMBPROFILE_STATS_START
+#undef SMBPROFILE_STATS_SECTION_START
+#undef SMBPROFILE_STATS_COUNT
+#undef SMBPROFILE_STATS_TIME
+#undef SMBPROFILE_STATS_BASIC
+#undef SMBPROFILE_STATS_BYTES
+#undef SMBPROFILE_STATS_IOBYTES
+#undef SMBPROFILE_STATS_SECTION_END
+#undef SMBPROFILE_STATS_END
+
+#define SMBPROFILE_STATS_START
+#define SMBPROFILE_STATS_SECTION_START(name, display)
+#define SMBPROFILE_STATS_COUNT(name)
+#define SMBPROFILE_STATS_TIME(name)
+#define SMBPROFILE_STATS_BASIC(name)
+#define SMBPROFILE_STATS_BYTES(name)                              \
+	do {                                                      \
+		export_bytes_latency(svc,                         \
+				     #name,                       \
+				     &stats->values.name##_stats, \
+				     state);                      \
+	} while (0);
+#define SMBPROFILE_STATS_IOBYTES(name)
+#define SMBPROFILE_STATS_SECTION_END
+#define SMBPROFILE_STATS_END
+	SMBPROFILE_STATS_PERSVC_SECTIONS
+#undef SMBPROFILE_STATS_START
+#undef SMBPROFILE_STATS_SECTION_START
+#undef SMBPROFILE_STATS_COUNT
+#undef SMBPROFILE_STATS_TIME
+#undef SMBPROFILE_STATS_BASIC
+#undef SMBPROFILE_STATS_BYTES
+#undef SMBPROFILE_STATS_IOBYTES
+#undef SMBPROFILE_STATS_SECTION_END
+#undef SMBPROFILE_STATS_END
 }
 
 static int export_profile_persvc(const char *key,
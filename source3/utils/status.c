@@ -1098,6 +1098,7 @@ int main(int argc, const char *argv[])
 	char *db_path;
 	bool ok;
 	struct loadparm_context *lp_ctx = NULL;
+	int traverse_threads;
 
 	state.first = true;
 	state.json_output = false;
@@ -1301,8 +1302,16 @@ int main(int argc, const char *argv[])
 			goto done;
 		}
 
+		/*
+		 * On a big locking.tdb we mostly wait for page faults,
+		 * let a few threads do that.
+		 */
+		traverse_threads = lp_parm_int(
+			-1, "smbstatus", "traverse threads", 4);
+
 		prepare_share_mode(&state);
-		result = share_entry_forall_read(print_share_mode, &state);
+		result = share_entry_forall_read_parallel(
+			MAX(traverse_threads, 1), print_share_mode, &state);
 
 		if (result == 0 && !state.json_output) {
 			fprintf(stderr, "No locked files\n");
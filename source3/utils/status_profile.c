@@ -76,6 +76,89 @@ static void print_buckets(struct traverse_state *state,
 		 s->buckets[9]);
 }
 
+/*
+ * Upper bound in microseconds of the histogram bucket holding the
+ * given percentile (in permille), 0 if there are no samples.
+ */
+static uint64_t hist_percentile(const struct smbprofile_stats_hist *h,
+				unsigned permille)
+{
+	uint64_t total = 0;
+	uint64_t rank;
+	uint64_t seen = 0;
+	size_t i;
+
+	for (i = 0; i < SMBPROFILE_HIST_BUCKETS; i++) {
+		total += h->buckets[i];
+	}
+	if (total == 0) {
+		return 0;
+	}
+
+	rank = (total * permille + 999) / 1000;
+
+	for (i = 0; i < SMBPROFILE_HIST_BUCKETS - 1; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank) {
+			return smbprofile_hist_limit(i);
+		}
+	}
+
+	/* Overflow bucket, report its lower bound */
+	return smbprofile_hist_limit(SMBPROFILE_HIST_BUCKETS - 2);
+}
+
+static void print_latency(struct traverse_state *state,
+			  const char *secname,
+			  const char *section,
+			  const char *name,
+			  const struct smbprofile_stats_hist *h)
+{
+	static const struct {
+		const char *field;
+		unsigned permille;
+	} percentiles[] = {
+		{ "latency_p50", 500 },
+		{ "latency_p90", 900 },
+		{ "latency_p99", 990 },
+		{ "latency_p999", 999 },
+	};
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(percentiles); i++) {
+		uintmax_t val = hist_percentile(h, percentiles[i].permille);
+
+		if (!state->json_output) {
+			char *label = talloc_asprintf(talloc_tos(),
+						      "%s_%s:",
+						      name,
+						      percentiles[i].field);
+			if (label == NULL) {
+				return;
+			}
+			if (secname != NULL) {
+				d_printf("%s %-59s%20ju\n", secname, label, val);
+			} else {
+				d_printf("%-59s%20ju\n", label, val);
+			}
+			TALLOC_FREE(label);
+		} else if (secname != NULL) {
+			add_profile_persvc_item_to_json(state,
+							secname,
+							section,
+							name,
+							percentiles[i].field,
+							val);
+		} else {
+			add_profile_item_to_json(state,
+						 section,
+						 name,
+						 percentiles[i].field,
+						 val);
+		}
+	}
+}
+
 /*******************************************************************
  dump the elements of the persvc profile structure
   ******************************************************************/
@@ -128,6 +211,11 @@ static void status_profile_dump_persvc_stats(struct traverse_state *state,
 		__PRINT_FIELD_LINE(#name, name##_stats, time);  \
 		__PRINT_FIELD_LINE(#name, name##_stats, idle);  \
 		__PRINT_FIELD_LINE(#name, name##_stats, bytes); \
+		print_latency(state,                            \
+			      secname,                          \
+			      latest_section,                   \
+			      #name,                            \
+			      &(*pstats).values.name##_stats.hist); \
 	} while (0);
 #define SMBPROFILE_STATS_IOBYTES(name)                                       \
 	do {                                                                 \
@@ -138,6 +226,11 @@ static void status_profile_dump_persvc_stats(struct traverse_state *state,
 		__PRINT_FIELD_LINE(#name, name##_stats, idle);               \
 		__PRINT_FIELD_LINE(#name, name##_stats, inbytes);            \
 		__PRINT_FIELD_LINE(#name, name##_stats, outbytes);           \
+		print_latency(state,                                         \
+			      secname,                                       \
+			      latest_section,                                \
+			      #name,                                         \
+			      &(*pstats).values.name##_stats.hist);          \
 	} while (0);
 #define SMBPROFILE_STATS_SECTION_END
 #define SMBPROFILE_STATS_END
@@ -218,6 +311,8 @@ bool status_profile_dump(bool verbose,
 	__PRINT_FIELD_LINE(#name, name##_stats,  time); \
 	__PRINT_FIELD_LINE(#name, name##_stats,  idle); \
 	__PRINT_FIELD_LINE(#name, name##_stats,  bytes); \
+	print_latency(state, NULL, latest_section, #name, \
+		      &stats.values.name##_stats.hist); \
 } while(0);
 #define SMBPROFILE_STATS_IOBYTES(name) do { \
 	__PRINT_FIELD_LINE(#name, name##_stats,  count); \
@@ -227,6 +322,8 @@ bool status_profile_dump(bool verbose,
 	__PRINT_FIELD_LINE(#name, name##_stats,  idle); \
 	__PRINT_FIELD_LINE(#name, name##_stats,  inbytes); \
 	__PRINT_FIELD_LINE(#name, name##_stats,  outbytes); \
+	print_latency(state, NULL, latest_section, #name, \
+		      &stats.values.name##_stats.hist); \
 } while(0);
 #define SMBPROFILE_STATS_SECTION_END
 #define SMBPROFILE_STATS_END
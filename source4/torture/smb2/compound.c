@@ -3400,6 +3400,343 @@ done:
 	return ret;
 }
 
+static struct {
+	struct smb2_request *req[4];
+	size_t order[4];
+	size_t num_done;
+} parallel_info;
+
+static void parallel_compound_done(struct smb2_request *req)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(parallel_info.req); i++) {
+		if (parallel_info.req[i] != req) {
+			continue;
+		}
+		if (parallel_info.num_done < ARRAY_SIZE(parallel_info.order)) {
+			parallel_info.order[parallel_info.num_done] = i;
+		}
+		parallel_info.num_done++;
+		return;
+	}
+}
+
+/*
+ * Sends an unrelated compound chain of GETINFO requests
+ * with a NOTIFY on the directory dh as second element.
+ * The NOTIFY blocks, the GETINFO requests don't.
+ */
+static bool parallel_compound_send(struct torture_context *tctx,
+				   struct smb2_tree *tree,
+				   size_t num_reqs,
+				   const struct smb2_handle *handles,
+				   struct smb2_handle dh,
+				   union smb_fileinfo *info,
+				   struct smb2_notify *n)
+{
+	size_t i;
+
+	ZERO_STRUCT(parallel_info);
+
+	smb2_transport_compound_start(tree->session->transport, num_reqs);
+
+	for (i = 0; i < num_reqs; i++) {
+		struct smb2_request *req = NULL;
+
+		if (i == 1) {
+			ZERO_STRUCTP(n);
+			n->in.recursive = 0;
+			n->in.buffer_size = 1000;
+			n->in.file.handle = dh;
+			n->in.completion_filter = FILE_NOTIFY_CHANGE_FILE_NAME;
+			req = smb2_notify_send(tree, n);
+		} else {
+			ZERO_STRUCT(info[i]);
+			info[i].generic.level = RAW_FILEINFO_BASIC_INFORMATION;
+			info[i].generic.in.file.handle = handles[i];
+			req = smb2_getinfo_file_send(tree, &info[i]);
+		}
+		torture_assert_not_null(tctx, req, "send failed\n");
+
+		req->async.fn = parallel_compound_done;
+		parallel_info.req[i] = req;
+	}
+
+	return true;
+}
+
+/*
+ * Waits for the NOTIFY to go async. The GETINFO requests
+ * behind it must be answered while it is still pending,
+ * in request order. *pending is false if the server
+ * completed the NOTIFY instead, smbd without
+ * "smbd parallel compound requests" cancels it.
+ */
+static bool parallel_compound_wait(struct torture_context *tctx,
+				   size_t num_reqs,
+				   bool *pending)
+{
+	struct smb2_request *nreq = parallel_info.req[1];
+	size_t expected = 0;
+	size_t i;
+
+	WAIT_FOR_ASYNC_RESPONSE(nreq);
+
+	*pending = nreq->cancel.can_cancel &&
+		   nreq->state <= SMB2_REQUEST_RECV;
+	if (!*pending) {
+		return true;
+	}
+
+	while (parallel_info.num_done < num_reqs - 1 &&
+	       nreq->state <= SMB2_REQUEST_RECV)
+	{
+		if (tevent_loop_once(tctx->ev) != 0) {
+			break;
+		}
+	}
+
+	torture_assert(tctx, nreq->state <= SMB2_REQUEST_RECV,
+		       "notify finished\n");
+	torture_assert_int_equal(tctx, parallel_info.num_done, num_reqs - 1,
+				 "not all getinfo requests finished\n");
+
+	for (i = 0; i < parallel_info.num_done; i++) {
+		if (expected == 1) {
+			expected++;
+		}
+		torture_assert_int_equal(tctx, parallel_info.order[i],
+					 expected,
+					 "wrong reply order\n");
+		expected++;
+	}
+
+	return true;
+}
+
+/*
+ * An unrelated GETINFO+NOTIFY+GETINFO chain. The second
+ * GETINFO does not wait for the NOTIFY.
+ */
+static bool test_compound_parallel_notify(struct torture_context *tctx,
+					  struct smb2_tree *tree)
+{
+	const char *dname = "compound_parallel_notify";
+	const char *fname = "compound_parallel_notify\\file.dat";
+	const char *fname2 = "compound_parallel_notify\\file2.dat";
+	struct smb2_handle dh = {};
+	struct smb2_handle h = {};
+	struct smb2_handle h2 = {};
+	struct smb2_handle handles[3] = {};
+	union smb_fileinfo info[3] = {};
+	struct smb2_notify n = {};
+	bool pending = false;
+	NTSTATUS status;
+	bool ret = true;
+
+	smb2_deltree(tree, dname);
+
+	status = torture_smb2_testdir(tree, dname, &dh);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	status = torture_smb2_testfile(tree, fname, &h);
+	CHECK_STATUS(status, NT_STATUS_OK);
+
+	handles[0] = h;
+	handles[2] = h;
+	ret = parallel_compound_send(tctx, tree, 3, handles, dh, info, &n);
+	torture_assert_goto(tctx, ret, ret, done,
+			    "parallel_compound_send failed\n");
+
+	ret = parallel_compound_wait(tctx, 3, &pending);
+	torture_assert_goto(tctx, ret, ret, done,
+			    "parallel_compound_wait failed\n");
+	if (!pending) {
+		torture_skip_goto(tctx, done,
+				  "compound requests are not "
+				  "processed in parallel");
+	}
+
+	status = smb2_getinfo_file_recv(parallel_info.req[0], tctx, &info[0]);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	status = smb2_getinfo_file_recv(parallel_info.req[2], tctx, &info[2]);
+	CHECK_STATUS(status, NT_STATUS_OK);
+
+	/* Now let the NOTIFY finish. */
+	status = torture_smb2_testfile(tree, fname2, &h2);
+	CHECK_STATUS(status, NT_STATUS_OK);
+
+	status = smb2_notify_recv(parallel_info.req[1], tctx, &n);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	CHECK_VAL(n.out.num_changes, 1);
+	CHECK_VAL(n.out.changes[0].action, NOTIFY_ACTION_ADDED);
+
+	CHECK_VAL(parallel_info.num_done, 3);
+	CHECK_VAL(parallel_info.order[2], 1);
+
+done:
+	if (!smb2_util_handle_empty(h2)) {
+		smb2_util_close(tree, h2);
+	}
+	if (!smb2_util_handle_empty(h)) {
+		smb2_util_close(tree, h);
+	}
+	if (!smb2_util_handle_empty(dh)) {
+		smb2_util_close(tree, dh);
+	}
+	smb2_deltree(tree, dname);
+	return ret;
+}
+
+/*
+ * The third request of an unrelated GETINFO+NOTIFY+GETINFO+GETINFO
+ * chain fails, this must not affect the other ones.
+ */
+static bool test_compound_parallel_error(struct torture_context *tctx,
+					 struct smb2_tree *tree)
+{
+	const char *dname = "compound_parallel_error";
+	const char *fname = "compound_parallel_error\\file.dat";
+	const char *fname2 = "compound_parallel_error\\file2.dat";
+	struct smb2_handle dh = {};
+	struct smb2_handle h = {};
+	struct smb2_handle h2 = {};
+	struct smb2_handle handles[4] = {};
+	union smb_fileinfo info[4] = {};
+	struct smb2_notify n = {};
+	bool pending = false;
+	NTSTATUS status;
+	bool ret = true;
+
+	smb2_deltree(tree, dname);
+
+	status = torture_smb2_testdir(tree, dname, &dh);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	status = torture_smb2_testfile(tree, fname, &h);
+	CHECK_STATUS(status, NT_STATUS_OK);
+
+	handles[0] = h;
+	handles[2] = h;
+	handles[2].data[0] += 1;
+	handles[3] = h;
+	ret = parallel_compound_send(tctx, tree, 4, handles, dh, info, &n);
+	torture_assert_goto(tctx, ret, ret, done,
+			    "parallel_compound_send failed\n");
+
+	ret = parallel_compound_wait(tctx, 4, &pending);
+	torture_assert_goto(tctx, ret, ret, done,
+			    "parallel_compound_wait failed\n");
+	if (!pending) {
+		torture_skip_goto(tctx, done,
+				  "compound requests are not "
+				  "processed in parallel");
+	}
+
+	status = smb2_getinfo_file_recv(parallel_info.req[0], tctx, &info[0]);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	status = smb2_getinfo_file_recv(parallel_info.req[2], tctx, &info[2]);
+	CHECK_STATUS(status, NT_STATUS_FILE_CLOSED);
+	status = smb2_getinfo_file_recv(parallel_info.req[3], tctx, &info[3]);
+	CHECK_STATUS(status, NT_STATUS_OK);
+
+	/* Now let the NOTIFY finish. */
+	status = torture_smb2_testfile(tree, fname2, &h2);
+	CHECK_STATUS(status, NT_STATUS_OK);
+
+	status = smb2_notify_recv(parallel_info.req[1], tctx, &n);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	CHECK_VAL(n.out.num_changes, 1);
+	CHECK_VAL(n.out.changes[0].action, NOTIFY_ACTION_ADDED);
+
+	CHECK_VAL(parallel_info.num_done, 4);
+	CHECK_VAL(parallel_info.order[3], 1);
+
+done:
+	if (!smb2_util_handle_empty(h2)) {
+		smb2_util_close(tree, h2);
+	}
+	if (!smb2_util_handle_empty(h)) {
+		smb2_util_close(tree, h);
+	}
+	if (!smb2_util_handle_empty(dh)) {
+		smb2_util_close(tree, dh);
+	}
+	smb2_deltree(tree, dname);
+	return ret;
+}
+
+/*
+ * Cancel the pending NOTIFY of an unrelated GETINFO+NOTIFY+GETINFO
+ * chain after the other requests were answered.
+ */
+static bool test_compound_parallel_cancel(struct torture_context *tctx,
+					  struct smb2_tree *tree)
+{
+	const char *dname = "compound_parallel_cancel";
+	const char *fname = "compound_parallel_cancel\\file.dat";
+	struct smb2_handle dh = {};
+	struct smb2_handle h = {};
+	struct smb2_handle handles[3] = {};
+	union smb_fileinfo info[3] = {};
+	struct smb2_notify n = {};
+	bool pending = false;
+	NTSTATUS status;
+	bool ret = true;
+
+	smb2_deltree(tree, dname);
+
+	status = torture_smb2_testdir(tree, dname, &dh);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	status = torture_smb2_testfile(tree, fname, &h);
+	CHECK_STATUS(status, NT_STATUS_OK);
+
+	handles[0] = h;
+	handles[2] = h;
+	ret = parallel_compound_send(tctx, tree, 3, handles, dh, info, &n);
+	torture_assert_goto(tctx, ret, ret, done,
+			    "parallel_compound_send failed\n");
+
+	ret = parallel_compound_wait(tctx, 3, &pending);
+	torture_assert_goto(tctx, ret, ret, done,
+			    "parallel_compound_wait failed\n");
+	if (!pending) {
+		torture_skip_goto(tctx, done,
+				  "compound requests are not "
+				  "processed in parallel");
+	}
+
+	status = smb2_cancel(parallel_info.req[1]);
+	CHECK_STATUS(status, NT_STATUS_OK);
+
+	status = smb2_notify_recv(parallel_info.req[1], tctx, &n);
+	CHECK_STATUS(status, NT_STATUS_CANCELLED);
+
+	status = smb2_getinfo_file_recv(parallel_info.req[0], tctx, &info[0]);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	status = smb2_getinfo_file_recv(parallel_info.req[2], tctx, &info[2]);
+	CHECK_STATUS(status, NT_STATUS_OK);
+
+	CHECK_VAL(parallel_info.num_done, 3);
+	CHECK_VAL(parallel_info.order[2], 1);
+
+	/* The handle is still usable. */
+	ZERO_STRUCT(info[0]);
+	info[0].generic.level = RAW_FILEINFO_BASIC_INFORMATION;
+	info[0].generic.in.file.handle = h;
+	status = smb2_getinfo_file(tree, tctx, &info[0]);
+	CHECK_STATUS(status, NT_STATUS_OK);
+
+done:
+	if (!smb2_util_handle_empty(h)) {
+		smb2_util_close(tree, h);
+	}
+	if (!smb2_util_handle_empty(dh)) {
+		smb2_util_close(tree, dh);
+	}
+	smb2_deltree(tree, dname);
+	return ret;
+}
+
 struct torture_suite *torture_smb2_compound_init(TALLOC_CTX *ctx)
 {
 	struct torture_suite *suite = torture_suite_create(ctx, "compound");
@@ -3477,6 +3814,12 @@ struct torture_suite *torture_smb2_compound_async_init(TALLOC_CTX *ctx)
 		test_compound_rename_last);
 	torture_suite_add_2smb2_test(suite, "rename_middle",
 		test_compound_rename_middle);
+	torture_suite_add_1smb2_test(suite, "parallel_notify",
+		test_compound_parallel_notify);
+	torture_suite_add_1smb2_test(suite, "parallel_error",
+		test_compound_parallel_error);
+	torture_suite_add_1smb2_test(suite, "parallel_cancel",
+		test_compound_parallel_cancel);
 
 	suite->description = talloc_strdup(suite, "SMB2-COMPOUND-ASYNC tests");
 
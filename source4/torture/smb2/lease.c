@@ -6411,6 +6411,106 @@ done:
 	return ret;
 }
 
+/*
+ * Opens that neither request nor find a lease or oplock on the file
+ * don't look at the other opens. Make sure mixing them with leases
+ * still gives the right grants and breaks.
+ */
+static bool test_lease_nolease_opens(struct torture_context *tctx,
+				     struct smb2_tree *tree)
+{
+	TALLOC_CTX *mem_ctx = talloc_new(tctx);
+	struct smb2_create io;
+	struct smb2_lease ls;
+	struct smb2_handle h1 = {};
+	struct smb2_handle h2 = {};
+	struct smb2_handle h3 = {};
+	struct smb2_handle h4 = {};
+	NTSTATUS status;
+	const char *fname = "lease_nolease_opens.dat";
+	bool ret = true;
+	uint32_t caps;
+
+	caps = smb2cli_conn_server_capabilities(tree->session->transport->conn);
+	torture_assert_goto(tctx, caps & SMB2_CAP_LEASING, ret, done, "leases are not supported");
+
+	tree->session->transport->lease.handler	= torture_lease_handler;
+	tree->session->transport->lease.private_data = tree;
+
+	smb2_util_unlink(tree, fname);
+	torture_reset_lease_break_info(tctx, &lease_break_info);
+
+	/* No lease anywhere */
+	smb2_oplock_create(&io, fname, smb2_util_oplock_level(""));
+	status = smb2_create(tree, mem_ctx, &io);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	CHECK_CREATED(&io, CREATED, FILE_ATTRIBUTE_ARCHIVE);
+	CHECK_VAL(io.out.oplock_level, smb2_util_oplock_level(""));
+	h1 = io.out.file.handle;
+
+	/* No lease on the file yet, a read lease is granted */
+	smb2_lease_create(&io, &ls, false, fname, LEASE1, smb2_util_lease_state("RH"));
+	status = smb2_create(tree, mem_ctx, &io);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	CHECK_CREATED(&io, EXISTED, FILE_ATTRIBUTE_ARCHIVE);
+	CHECK_LEASE(&io, "RH", true, LEASE1, 0);
+	h2 = io.out.file.handle;
+
+	/* An open without a lease doesn't break RH */
+	smb2_oplock_create(&io, fname, smb2_util_oplock_level(""));
+	status = smb2_create(tree, mem_ctx, &io);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	CHECK_CREATED(&io, EXISTED, FILE_ATTRIBUTE_ARCHIVE);
+	h3 = io.out.file.handle;
+	CHECK_NO_BREAK(tctx);
+
+	/* Other opens are there, no write caching */
+	smb2_lease_create(&io, &ls, false, fname, LEASE2, smb2_util_lease_state("RHW"));
+	status = smb2_create(tree, mem_ctx, &io);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	CHECK_CREATED(&io, EXISTED, FILE_ATTRIBUTE_ARCHIVE);
+	CHECK_LEASE(&io, "RH", true, LEASE2, 0);
+	h4 = io.out.file.handle;
+	CHECK_NO_BREAK(tctx);
+
+	smb2_util_close(tree, h1);
+	smb2_util_close(tree, h2);
+	smb2_util_close(tree, h3);
+	smb2_util_close(tree, h4);
+	ZERO_STRUCT(h1);
+	ZERO_STRUCT(h2);
+	ZERO_STRUCT(h3);
+	ZERO_STRUCT(h4);
+
+	/* Alone on the file, write caching is granted */
+	smb2_lease_create(&io, &ls, false, fname, LEASE1, smb2_util_lease_state("RHW"));
+	status = smb2_create(tree, mem_ctx, &io);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	CHECK_CREATED(&io, EXISTED, FILE_ATTRIBUTE_ARCHIVE);
+	CHECK_LEASE(&io, "RHW", true, LEASE1, 0);
+	h1 = io.out.file.handle;
+
+	/* An open without a lease breaks the write caching */
+	smb2_oplock_create(&io, fname, smb2_util_oplock_level(""));
+	status = smb2_create(tree, mem_ctx, &io);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	CHECK_CREATED(&io, EXISTED, FILE_ATTRIBUTE_ARCHIVE);
+	h2 = io.out.file.handle;
+	CHECK_BREAK_INFO("RHW", "RH", LEASE1);
+
+ done:
+	smb2_util_close(tree, h1);
+	smb2_util_close(tree, h2);
+	smb2_util_close(tree, h3);
+	smb2_util_close(tree, h4);
+
+	smb2_util_unlink(tree, fname);
+
+	talloc_free(mem_ctx);
+
+	return ret;
+}
+
 struct torture_suite *torture_smb2_lease_init(TALLOC_CTX *ctx)
 {
 	struct torture_suite *suite =
@@ -6477,6 +6577,8 @@ struct torture_suite *torture_smb2_lease_init(TALLOC_CTX *ctx)
 				     torture_rename_dir_openfile);
 	torture_suite_add_1smb2_test(suite, "lease-epoch", test_lease_epoch);
 	torture_suite_add_1smb2_test(suite, "two-leases", test_two_leases);
+	torture_suite_add_1smb2_test(suite, "nolease_opens",
+				     test_lease_nolease_opens);
 
 	suite->description = talloc_strdup(suite, "SMB2-LEASE tests");
 